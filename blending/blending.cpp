@@ -8,9 +8,15 @@
 
 #include "camera.h"
 #include "shader_m.h"
+#include "transparentSorter.h"
+#include "weightedBlendedOIT.h"
+#include "foliage.h"
 
 #include <iostream>
-#include <map>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../headless.h"
 using namespace std;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -32,47 +38,82 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// transparency: sorted alpha blending, or weighted blended OIT (toggled with O)
+bool useOIT = false;
+bool oitKeyPressed = false;
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
-int main() {
-	// glfw
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-	#ifdef __APPLE___
-		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	#endif
-
-	GLFWwindow * window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-	if (window == NULL)
+// usage: blending [--windows N] [--grass N]
+int main(int argc, char **argv) {
+	// command line options
+	unsigned int extraWindows = 0;	// additional glass panes scattered over the scene, to stress the per-frame sort
+	unsigned int extraGrass = 0;	// additional grass blades scattered around the floor, to stress the foliage pass
+	for (int i = 1; i + 1 < argc; i += 2)
 	{
-		cout << "Failed to create GLFW window" << endl;
-		glfwTerminate();
-		return -1;
+		if (strcmp(argv[i], "--windows") == 0)
+			extraWindows = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+		else if (strcmp(argv[i], "--grass") == 0)
+			extraGrass = (unsigned int)strtoul(argv[i + 1], NULL, 10);
 	}
-	glfwMakeContextCurrent(window);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	glfwSetCursorPosCallback(window, mouse_callback);
-	glfwSetScrollCallback(window, scroll_callback);
-
-	// GLFW set to capture mouse
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-	// glad: load all OpenGL function pointers
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	// --headless renders offscreen instead, see headless.h
+	Headless headless(argc, argv);
+	GLFWwindow* window = NULL;
+	if (headless.Enabled)
 	{
-		cout << "Failed to initialize GLAD" << endl;
-		return -1;
+		if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT))
+			return -1;
+	}
+	else
+	{
+		// glfw
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_SAMPLES, 4);	// multisampled window, grass edges are antialiased with alpha to coverage
+
+		#ifdef __APPLE___
+			glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		#endif
+
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+		if (window == NULL)
+		{
+			cout << "Failed to create GLFW window" << endl;
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		glfwSetCursorPosCallback(window, mouse_callback);
+		glfwSetScrollCallback(window, scroll_callback);
+
+		// GLFW set to capture mouse
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+		// glad: load all OpenGL function pointers
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			cout << "Failed to initialize GLAD" << endl;
+			return -1;
+		}
 	}
 
 	// Configure global openGL state
 	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_MULTISAMPLE);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Build and compile shader program
 	Shader shader("basicScene.vs", "basicScene.fs");
+	Shader glassShader("glass.vs", "basicScene.fs");
+	Shader oitAccumShader("glass.vs", "oitAccum.fs");
+	Shader oitCompositeShader("oitComposite.vs", "oitComposite.fs");
+	Shader foliageShader("foliage.vs", "foliage.fs");
 
 	// set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -130,18 +171,6 @@ int main() {
         -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
          5.0f, -0.5f, -5.0f,  2.0f, 2.0f
     };
-	// Grass vertices 
-	float grassVertices[] = {
-        // positions         // texture Coords (swapped y coordinates because texture is flipped upside down)
-        0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
-        0.0f, -0.5f,  0.0f,  0.0f,  1.0f,
-        1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
-
-        0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
-        1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
-        1.0f,  0.5f,  0.0f,  1.0f,  0.0f
-    	};
-	
 	// Glass vertices 
 	float glassVertices[] = {
         // positions         // texture Coords (swapped y coordinates because texture is flipped upside down)
@@ -154,263 +183,357 @@ int main() {
         1.0f,  0.5f,  0.0f,  1.0f,  0.0f
     	};
 
-	// Grass positions 
-	vector<glm::vec3> vegetation;
-	vegetation.push_back(glm::vec3(-1.5f, 0.0f, -0.48f));
-	vegetation.push_back(glm::vec3(1.5f, 0.0f, 0.51f));
-	vegetation.push_back(glm::vec3(0.0f, 0.0f, 0.7f));
-	vegetation.push_back(glm::vec3(-0.3f, 0.0f, -2.3f));
-	vegetation.push_back(glm::vec3(0.5f, 0.0f, -0.6f));
+	// the grass, the OIT targets and everything else that owns GL objects are destroyed at the end of this block,
+	// while the context still exists
+	{
+		// Grass blades, all drawn with one instanced call (positions are the bottom center of each quad)
+		Foliage vegetation;
+		vegetation.Add(glm::vec3(-1.0f, -0.5f, -0.48f));
+		vegetation.Add(glm::vec3(2.0f, -0.5f, 0.51f));
+		vegetation.Add(glm::vec3(0.5f, -0.5f, 0.7f));
+		vegetation.Add(glm::vec3(0.2f, -0.5f, -2.3f));
+		vegetation.Add(glm::vec3(1.0f, -0.5f, -0.6f));
+		// extra blades keep roughly a hundred per square unit, so the field grows with the count
+		vegetation.Scatter(extraGrass, glm::vec3(0.0f, -0.5f, 0.0f), glm::max(5.0f, sqrtf((float)extraGrass) * 0.05f));
+		vegetation.Upload();
 	
-	// Glass positions 
-	vector<glm::vec3> glass;
-	glass.push_back(glm::vec3(-3.0f, 0.0f, -1.0f));
-	glass.push_back(glm::vec3(-3.25f, 0.0f, -2.0f));
-	glass.push_back(glm::vec3(2.75f, 0.0f, 0.5f));
-	glass.push_back(glm::vec3(3.0f, 0.0f, 0.0f));
-	glass.push_back(glm::vec3(1.0f, 0.0f, 2.0f));
-	glass.push_back(glm::vec3(1.25f, 0.0f, 3.0f));
+		// Glass positions 
+		vector<glm::vec3> glass;
+		glass.push_back(glm::vec3(-3.0f, 0.0f, -1.0f));
+		glass.push_back(glm::vec3(-3.25f, 0.0f, -2.0f));
+		glass.push_back(glm::vec3(2.75f, 0.0f, 0.5f));
+		glass.push_back(glm::vec3(3.0f, 0.0f, 0.0f));
+		glass.push_back(glm::vec3(1.0f, 0.0f, 2.0f));
+		glass.push_back(glm::vec3(1.25f, 0.0f, 3.0f));
+		srand(1);
+		for(unsigned int i = 0; i < extraWindows; i++)
+			glass.push_back(glm::vec3((rand() % 4000) / 100.0f - 20.0f, (rand() % 400) / 100.0f, (rand() % 4000) / 100.0f - 20.0f));
 	
-	// Sort glass positions 
-	map<float, glm::vec3> sorted;
-	for(unsigned int i = 0; i < glass.size(); i++) 
-	{
-		float distance = glm::length(camera.Position - glass[i]);	
-		sorted[distance] = glass[i];
-	}
-
-	// Cube VAO
-	unsigned int cubeVAO, cubeVBO;
-	glGenVertexArrays(1, &cubeVAO);
-	glGenBuffers(1, &cubeVBO);
-	glBindVertexArray(cubeVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glBindVertexArray(0);
-
-	// Plane VAO
-	unsigned int planeVAO, planeVBO;
-	glGenVertexArrays(1, &planeVAO);
-	glGenBuffers(1, &planeVBO);
-	glBindVertexArray(planeVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glBindVertexArray(0);
+		// Glass panes are sorted back to front every frame, since the order changes as soon as the camera moves,
+		// unless they are drawn with weighted blended OIT, which takes them in any order
+		TransparentSorter glassSorter;
+		vector<glm::vec3> sortedGlass(glass.size());
+		bool glassUnsortedUploaded = false;
+		headless.GetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		WeightedBlendedOIT oit(framebufferWidth, framebufferHeight);
+
+		// Frame time comparison: CPU frame and sort time, and GPU time of the grass pass and of the transparent pass
+		// (glass plus the OIT composite) from timer queries. Results are read a few frames late so the CPU never waits
+		// for the GPU.
+		const unsigned int QUERY_COUNT = 4;
+		unsigned int grassQueries[QUERY_COUNT], transparentQueries[QUERY_COUNT];
+		glGenQueries(QUERY_COUNT, grassQueries);
+		glGenQueries(QUERY_COUNT, transparentQueries);
+		unsigned int queryFrame = 0;
+		double sortTime = 0.0, frameTime = 0.0, grassGpuTime = 0.0, transparentGpuTime = 0.0;
+		unsigned int timedFrames = 0, gpuTimedFrames = 0;
+		double lastReport = headless.Time();
+
+		// Cube VAO
+		unsigned int cubeVAO, cubeVBO;
+		glGenVertexArrays(1, &cubeVAO);
+		glGenBuffers(1, &cubeVBO);
+		glBindVertexArray(cubeVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+		glBindVertexArray(0);
+
+		// Plane VAO
+		unsigned int planeVAO, planeVBO;
+		glGenVertexArrays(1, &planeVAO);
+		glGenBuffers(1, &planeVBO);
+		glBindVertexArray(planeVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+		glBindVertexArray(0);
 	
-	// Grass VAO 
-	unsigned grassVAO, grassVBO;
-	glGenVertexArrays(1, &grassVAO);
-	glGenBuffers(1, &grassVBO);
-	glBindVertexArray(grassVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, grassVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(grassVertices), &grassVertices, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glBindVertexArray(0); 
-
-	// Glass VAO 
-	unsigned glassVAO, glassVBO;
-	glGenVertexArrays(1, &glassVAO);
-	glGenBuffers(1, &glassVBO);
-	glBindVertexArray(glassVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, glassVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glassVertices), &glassVertices, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glBindVertexArray(0); 
-
-	// Load Textures
-	// Load cubeTexture
-	unsigned int cubeTexture;
-	glGenTextures(1, &cubeTexture);
-	// Bind texture
-	glBindTexture(GL_TEXTURE_2D, cubeTexture);
-	// Set texture wrapping / filtering options
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	// Set texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	// Load data from image and generate texture
-	int width, height, nrChannels;
-	unsigned char *data = stbi_load("marble.jpg", &width, &height, &nrChannels, 0);
-	if (data) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// Free data
-		stbi_image_free(data);
-	}
-	else
-	{
-		cout << "Failed to load texture" << endl;
-		return -1;
-	}
+		// Glass VAO 
+		unsigned glassVAO, glassVBO;
+		glGenVertexArrays(1, &glassVAO);
+		glGenBuffers(1, &glassVBO);
+		glBindVertexArray(glassVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, glassVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glassVertices), &glassVertices, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+		// Per-instance pane position, refilled in back to front order every frame
+		unsigned int glassInstanceVBO;
+		glGenBuffers(1, &glassInstanceVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, glassInstanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, glass.size() * sizeof(glm::vec3), NULL, GL_STREAM_DRAW);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+		glVertexAttribDivisor(2, 1);
+		glBindVertexArray(0); 
+
+		// Load Textures
+		// Load cubeTexture
+		unsigned int cubeTexture;
+		glGenTextures(1, &cubeTexture);
+		// Bind texture
+		glBindTexture(GL_TEXTURE_2D, cubeTexture);
+		// Set texture wrapping / filtering options
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// Set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// Load data from image and generate texture
+		int width, height, nrChannels;
+		unsigned char *data = stbi_load("marble.jpg", &width, &height, &nrChannels, 0);
+		if (data) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+			glGenerateMipmap(GL_TEXTURE_2D);
+
+			// Free data
+			stbi_image_free(data);
+		}
+		else
+		{
+			cout << "Failed to load texture" << endl;
+			return -1;
+		}
 
-	// Plane texture
-	unsigned int planeTexture;
-        glGenTextures(1, &planeTexture);
-        // Bind texture
-        glBindTexture(GL_TEXTURE_2D, planeTexture);
-        // Set texture wrapping / filtering options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // Set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // Load data from image and generate texture
-        data = stbi_load("metal.png", &width, &height, &nrChannels, 0);
-        if (data) {
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-                glGenerateMipmap(GL_TEXTURE_2D);
-
-        	// Free data
-        	stbi_image_free(data);
-        }
-        else
-        {
-                cout << "Failed to load texture" << endl;
-		return -1;
-        }
+		// Plane texture
+		unsigned int planeTexture;
+            glGenTextures(1, &planeTexture);
+            // Bind texture
+            glBindTexture(GL_TEXTURE_2D, planeTexture);
+            // Set texture wrapping / filtering options
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            // Set texture filtering parameters
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            // Load data from image and generate texture
+            data = stbi_load("metal.png", &width, &height, &nrChannels, 0);
+            if (data) {
+                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+                    glGenerateMipmap(GL_TEXTURE_2D);
+
+            	// Free data
+            	stbi_image_free(data);
+            }
+            else
+            {
+                    cout << "Failed to load texture" << endl;
+			return -1;
+            }
 	
-	// Grass texture
-	unsigned int grassTexture;
-	glGenTextures(1, &grassTexture);
-	// Bind texture
-	glBindTexture(GL_TEXTURE_2D, grassTexture);
-	// Set texture wrapping / filtering options 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	// Set texture filtering parameters 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	// Load data from image and generate texture
-	data = stbi_load("grass.png", &width, &height, &nrChannels, 0);
-	if (data) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-		// Free data
-		stbi_image_free(data);
-	} 
-	else 
-	{
-		cout << "Failed to load texture" << endl;
-		return -1;
-	}
-
-	// Glass texture
-	unsigned int glassTexture;
-	glGenTextures(1, &glassTexture);
-	// Bind texture
-	glBindTexture(GL_TEXTURE_2D, glassTexture);
-	// Set texture wrapping / filtering options 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	// Set texture filtering parameters 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	// Load data from image and generate texture
-	data = stbi_load("blending_transparent_window.png", &width, &height, &nrChannels, 0);
-	if (data) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-		// Free data
-		stbi_image_free(data);
-	} 
-	else 
-	{
-		cout << "Failed to load texture" << endl;
-		return -1;
-	}
-
-	// shader configuration
-	shader.use();
-	shader.setInt("texture1", 0);
-	// render loop
-	while(!glfwWindowShouldClose(window))
-	{
-		// per-frame time logic
-		float currentFrame = glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
+		// Grass texture
+		unsigned int grassTexture;
+		glGenTextures(1, &grassTexture);
+		// Bind texture
+		glBindTexture(GL_TEXTURE_2D, grassTexture);
+		// Set texture wrapping / filtering options 
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		// Set texture filtering parameters 
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// Load data from image and generate texture
+		data = stbi_load("grass.png", &width, &height, &nrChannels, 0);
+		if (data) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			// Free data
+			stbi_image_free(data);
+		} 
+		else 
+		{
+			cout << "Failed to load texture" << endl;
+			return -1;
+		}
 
-		// input
-		processInput(window);
+		// Glass texture
+		unsigned int glassTexture;
+		glGenTextures(1, &glassTexture);
+		// Bind texture
+		glBindTexture(GL_TEXTURE_2D, glassTexture);
+		// Set texture wrapping / filtering options 
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		// Set texture filtering parameters 
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// Load data from image and generate texture
+		data = stbi_load("blending_transparent_window.png", &width, &height, &nrChannels, 0);
+		if (data) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			// Free data
+			stbi_image_free(data);
+		} 
+		else 
+		{
+			cout << "Failed to load texture" << endl;
+			return -1;
+		}
 
-		// render
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		
-		// set uniforms
-    		shader.use();
-    		glm::mat4 model;
-    		glm::mat4 view = camera.GetViewMatrix();
-    		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    		shader.setMat4("view", view);
-    		shader.setMat4("projection", projection);
-
-		// cubes
+		// shader configuration
 		shader.use();
-		glBindVertexArray(cubeVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture);
-    model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-    shader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    model = glm::mat4();
-    model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-    shader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+		shader.setInt("texture1", 0);
+		// render loop
+		while (headless.Running(window))
+		{
+			// per-frame time logic
+			float currentFrame = headless.Time();
+			deltaTime = currentFrame - lastFrame;
+			lastFrame = currentFrame;
+
+			// input
+			if (headless.Enabled)
+				headless.MoveCamera(camera);
+			else
+				processInput(window);
+
+			// render
+			if (useOIT)
+			{
+				oit.Resize(framebufferWidth, framebufferHeight);
+				oit.BeginOpaque(glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
+			}
+			else
+			{
+				glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			}
 		
-		// floor
-		glBindVertexArray(planeVAO);
-    glBindTexture(GL_TEXTURE_2D, planeTexture);
-    shader.setMat4("model", glm::mat4());
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-  	glBindVertexArray(0);
+			// set uniforms
+        		shader.use();
+        		glm::mat4 model;
+        		glm::mat4 view = camera.GetViewMatrix();
+        		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        		shader.setMat4("view", view);
+        		shader.setMat4("projection", projection);
+
+			// cubes
+			shader.use();
+			glBindVertexArray(cubeVAO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, cubeTexture);
+        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
+        shader.setMat4("model", model);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        model = glm::mat4();
+        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
+        shader.setMat4("model", model);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
 		
-		// grass	
-		glBindVertexArray(grassVAO);
-		glBindTexture(GL_TEXTURE_2D, grassTexture);
-		for(unsigned int i = 0 ; i < vegetation.size(); i++) {
-			model = glm::mat4();
-			model = glm::translate(model, vegetation[i]);
-			shader.setMat4("model", model);
-			glDrawArrays(GL_TRIANGLES, 0, 6);
+			// floor
+			glBindVertexArray(planeVAO);
+        glBindTexture(GL_TEXTURE_2D, planeTexture);
+        shader.setMat4("model", glm::mat4());
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+      	glBindVertexArray(0);
+		
+			// collect the timer queries issued QUERY_COUNT frames ago
+			unsigned int querySlot = queryFrame % QUERY_COUNT;
+			if (queryFrame >= QUERY_COUNT)
+			{
+				GLint available = 0;
+				glGetQueryObjectiv(transparentQueries[querySlot], GL_QUERY_RESULT_AVAILABLE, &available);
+				if (available)
+				{
+					GLuint64 grassElapsed = 0, transparentElapsed = 0;
+					glGetQueryObjectui64v(grassQueries[querySlot], GL_QUERY_RESULT, &grassElapsed);
+					glGetQueryObjectui64v(transparentQueries[querySlot], GL_QUERY_RESULT, &transparentElapsed);
+					grassGpuTime += grassElapsed / 1e6;
+					transparentGpuTime += transparentElapsed / 1e6;
+					gpuTimedFrames++;
+				}
+			}
+			queryFrame++;
+
+			// grass: alpha to coverage needs the multisampled window, the OIT opaque target has a single sample
+			glBeginQuery(GL_TIME_ELAPSED, grassQueries[querySlot]);
+			foliageShader.use();
+			foliageShader.setMat4("view", view);
+			foliageShader.setMat4("projection", projection);
+			foliageShader.setFloat("time", currentFrame);
+			vegetation.Draw(foliageShader, grassTexture, !useOIT);
+			glEndQuery(GL_TIME_ELAPSED);
+
+			// glass
+			glBeginQuery(GL_TIME_ELAPSED, transparentQueries[querySlot]);
+			glBindVertexArray(glassVAO);
+			glBindTexture(GL_TEXTURE_2D, glassTexture);
+			if (useOIT)
+			{
+				// any order will do, so the panes are uploaded once as they are
+				if (!glassUnsortedUploaded)
+				{
+					glBindBuffer(GL_ARRAY_BUFFER, glassInstanceVBO);
+					glBufferData(GL_ARRAY_BUFFER, glass.size() * sizeof(glm::vec3), &glass[0], GL_STATIC_DRAW);
+					glassUnsortedUploaded = true;
+				}
+				oit.BeginTransparent();
+				oitAccumShader.use();
+				oitAccumShader.setMat4("view", view);
+				oitAccumShader.setMat4("projection", projection);
+				oitAccumShader.setInt("texture1", 0);
+				glDrawArraysInstanced(GL_TRIANGLES, 0, 6, glass.size());
+				glBindVertexArray(0);
+				oit.Composite(oitCompositeShader);
+			}
+			else
+			{
+				// sort back to front for the current camera position, then draw all panes in that order with one call
+				double sortStart = headless.Clock();
+				const vector<unsigned int> &order = glassSorter.Sort(&glass[0], glass.size(), camera.Position);
+				for(unsigned int i = 0; i < order.size(); i++)
+					sortedGlass[i] = glass[order[i]];
+				sortTime += headless.Clock() - sortStart;
+				glBindBuffer(GL_ARRAY_BUFFER, glassInstanceVBO);
+				glBufferData(GL_ARRAY_BUFFER, sortedGlass.size() * sizeof(glm::vec3), &sortedGlass[0], GL_STREAM_DRAW);
+				glassUnsortedUploaded = false;
+				glassShader.use();
+				glassShader.setMat4("view", view);
+				glassShader.setMat4("projection", projection);
+				glassShader.setInt("texture1", 0);
+				glDrawArraysInstanced(GL_TRIANGLES, 0, 6, sortedGlass.size());
+				glBindVertexArray(0);
+			}
+			glEndQuery(GL_TIME_ELAPSED);
+
+			frameTime += deltaTime;
+			timedFrames++;
+			if (currentFrame - lastReport >= 1.0)
+			{
+				cout << (useOIT ? "weighted blended OIT" : "sorted blending") << "  glass panes: " << glass.size()
+				     << "  grass blades: " << vegetation.Blades.size()
+				     << "  frame: " << frameTime * 1000.0 / timedFrames << " ms"
+				     << "  sort: " << sortTime * 1000.0 / timedFrames << " ms"
+				     << "  grass pass (GPU): " << (gpuTimedFrames ? grassGpuTime / gpuTimedFrames : 0.0) << " ms"
+				     << "  transparent pass (GPU): " << (gpuTimedFrames ? transparentGpuTime / gpuTimedFrames : 0.0) << " ms" << endl;
+				sortTime = frameTime = grassGpuTime = transparentGpuTime = 0.0;
+				timedFrames = gpuTimedFrames = 0;
+				lastReport = currentFrame;
+			}
+
+			// glfw: Swap buffers and poll IO events
+			headless.SwapBuffers(window);
 		}
 
-		// glass	
-		glBindVertexArray(glassVAO);
-		glBindTexture(GL_TEXTURE_2D, glassTexture);
-		for(map<float, glm::vec3>::reverse_iterator it = sorted.rbegin(); it != sorted.rend(); ++it) {
-			model = glm::mat4();
-			model = glm::translate(model, it->second);
-			shader.setMat4("model", model);
-			glDrawArrays(GL_TRIANGLES, 0, 6);
-		}
-		// glfw: Swap buffers and poll IO events
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		// De-allocate resources
+		glDeleteVertexArrays(1, &cubeVAO);
+		glDeleteVertexArrays(1, &planeVAO);
+		glDeleteBuffers(1, &cubeVBO);
+		glDeleteBuffers(1, &planeVBO);
+		glDeleteQueries(QUERY_COUNT, grassQueries);
+		glDeleteQueries(QUERY_COUNT, transparentQueries);
 	}
 
-	// De-allocate resources
-	glDeleteVertexArrays(1, &cubeVAO);
-	glDeleteVertexArrays(1, &planeVAO);
-	glDeleteBuffers(1, &cubeVBO);
-	glDeleteBuffers(1, &planeVBO);
-
 	glfwTerminate();
 	return 0;
 }
@@ -420,6 +543,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
@@ -458,4 +583,13 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    // O switches between sorted blending and weighted blended OIT
+    bool oitKey = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+    if (oitKey && !oitKeyPressed)
+    {
+        useOIT = !useOIT;
+        cout << "transparency: " << (useOIT ? "weighted blended OIT" : "sorted blending") << endl;
+    }
+    oitKeyPressed = oitKey;
 }
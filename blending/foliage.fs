@@ -0,0 +1,23 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in float Tint;
+
+uniform sampler2D texture1; 
+uniform bool alphaToCoverage;
+
+void main()
+{
+	vec4 texColor = texture(texture1, TexCoords);
+	if (alphaToCoverage)
+	{
+		// sharpen the alpha to about a pixel wide ramp around 0.5, so mipmapped alpha doesn't make distant
+		// blades fade away and the edge is antialiased by the covered sample count
+		texColor.a = clamp((texColor.a - 0.5) / max(fwidth(texColor.a), 0.0001) + 0.5, 0.0, 1.0);
+	}
+	else if (texColor.a < 0.5)
+		discard;
+
+	FragColor = vec4(texColor.rgb * Tint, texColor.a);
+}
@@ -0,0 +1,147 @@
+#ifndef FOLIAGE_H
+#define FOLIAGE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "shader_m.h"
+
+#include <random>
+#include <vector>
+using namespace std;
+
+// per-instance data of one grass quad, 32 bytes
+struct GrassBlade {
+    glm::vec3 Position;     // bottom center of the quad
+    float Rotation;         // around the y axis, in radians
+    glm::vec2 Size;         // width, height
+    float Tint;             // brightness factor
+    float Phase;            // wind sway phase
+};
+
+// Draws every alpha tested vegetation quad with a single instanced call. Each blade carries its own position,
+// rotation, size, tint and sway phase, so a field of grass needs no per-blade uniforms or draw calls.
+// With alpha to coverage the texture's alpha becomes the fraction of MSAA samples covered, which gives smooth,
+// order independent edges without blending or discard (and keeps early depth testing available).
+// On single sampled targets the shader falls back to an alpha test.
+class Foliage
+{
+public:
+    vector<GrassBlade> Blades;
+    unsigned int VAO;
+
+    Foliage() : uploaded(0)
+    {
+        // unit quad standing on y = 0, x from -0.5 to 0.5 (texture y is flipped, as in the scene's other quads)
+        float vertices[] = {
+            // positions         // texture Coords
+            -0.5f, 1.0f, 0.0f,   0.0f, 0.0f,
+            -0.5f, 0.0f, 0.0f,   0.0f, 1.0f,
+             0.5f, 0.0f, 0.0f,   1.0f, 1.0f,
+
+            -0.5f, 1.0f, 0.0f,   0.0f, 0.0f,
+             0.5f, 0.0f, 0.0f,   1.0f, 1.0f,
+             0.5f, 1.0f, 0.0f,   1.0f, 0.0f
+        };
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &quadVBO);
+        glGenBuffers(1, &instanceVBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(GrassBlade), (void*)0);
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(GrassBlade), (void*)(4 * sizeof(float)));
+        glVertexAttribDivisor(3, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~Foliage()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &quadVBO);
+        glDeleteBuffers(1, &instanceVBO);
+    }
+
+    void Add(const glm::vec3 &position, float rotation = 0.0f, glm::vec2 size = glm::vec2(1.0f), float tint = 1.0f, float phase = 0.0f)
+    {
+        GrassBlade blade;
+        blade.Position = position;
+        blade.Rotation = rotation;
+        blade.Size = size;
+        blade.Tint = tint;
+        blade.Phase = phase;
+        Blades.push_back(blade);
+    }
+
+    // adds count blades with random rotation, size, tint and phase on the square of the given half extent around
+    // center. the same seed always gives the same field, and the program's rand() sequence is left alone.
+    void Scatter(unsigned int count, const glm::vec3 &center, float halfExtent, unsigned int seed = 1)
+    {
+        mt19937 generator(seed);
+        Blades.reserve(Blades.size() + count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            // one draw per statement, so the order of the draws doesn't depend on how arguments are evaluated
+            float x = unitRandom(generator) * 2.0f - 1.0f;
+            float z = unitRandom(generator) * 2.0f - 1.0f;
+            float height = 0.6f + unitRandom(generator) * 0.6f;
+            float rotation = unitRandom(generator) * glm::pi<float>();
+            float width = height * (0.8f + unitRandom(generator) * 0.4f);
+            float tint = 0.75f + unitRandom(generator) * 0.25f;
+            float phase = unitRandom(generator) * 2.0f * glm::pi<float>();
+            Add(center + glm::vec3(x * halfExtent, 0.0f, z * halfExtent), rotation, glm::vec2(width, height), tint, phase);
+        }
+    }
+
+    // sends the blades to the GPU, call again after changing them
+    void Upload()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, Blades.size() * sizeof(GrassBlade), Blades.empty() ? NULL : &Blades[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        uploaded = Blades.size();
+    }
+
+    // draws the uploaded blades with shader (foliage.vs / foliage.fs), whose view, projection and time are set by
+    // the caller. alphaToCoverage should only be set when the bound framebuffer is multisampled.
+    void Draw(Shader &shader, unsigned int texture, bool alphaToCoverage)
+    {
+        shader.use();
+        shader.setInt("texture1", 0);
+        shader.setBool("alphaToCoverage", alphaToCoverage);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        // coverage replaces blending
+        glDisable(GL_BLEND);
+        if (alphaToCoverage)
+            glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+        glBindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)uploaded);
+        glBindVertexArray(0);
+        glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+        glEnable(GL_BLEND);
+    }
+
+private:
+    unsigned int quadVBO, instanceVBO;
+    size_t uploaded;
+
+    // uniform in [0, 1)
+    static float unitRandom(mt19937 &generator)
+    {
+        return uniform_real_distribution<float>(0.0f, 1.0f)(generator);
+    }
+};
+#endif
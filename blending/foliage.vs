@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos; 
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in vec4 aPositionRotation;   // per blade: position, rotation around y
+layout (location = 3) in vec4 aSizeTintPhase;      // per blade: width, height, tint, sway phase
+
+out vec2 TexCoords;
+out float Tint;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float time;
+
+void main() 
+{
+	TexCoords = aTexCoords;
+	Tint = aSizeTintPhase.z;
+	vec3 local = vec3(aPos.x * aSizeTintPhase.x, aPos.y * aSizeTintPhase.y, 0.0);
+	// the top of the blade sways in the wind, the root stays put
+	local.x += sin(time * 1.5 + aSizeTintPhase.w) * 0.08 * aPos.y * aSizeTintPhase.y;
+	float s = sin(aPositionRotation.w);
+	float c = cos(aPositionRotation.w);
+	vec3 world = vec3(c * local.x + s * local.z, local.y, -s * local.x + c * local.z) + aPositionRotation.xyz;
+	gl_Position = projection * view * vec4(world, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) out vec4 Accum;
+layout (location = 1) out float Weight;
+
+in vec2 TexCoords;
+
+uniform sampler2D texture1; 
+
+void main()
+{
+	vec4 color = texture(texture1, TexCoords);
+	// weight favours surfaces close to the camera (eq. 10 of the weighted blended OIT paper), so the nearest
+	// pane dominates where panes with different colors overlap
+	float z = gl_FragCoord.z;
+	float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - z * 0.9, 3.0), 1e-2, 3e3);
+	Accum = vec4(color.rgb * color.a * weight, color.a);
+	Weight = color.a * weight;
+}
@@ -0,0 +1,23 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D opaqueTexture;
+uniform sampler2D accumTexture;
+uniform sampler2D weightTexture;
+
+void main()
+{
+	vec3 opaque = texture(opaqueTexture, TexCoords).rgb;
+	vec4 accum = texture(accumTexture, TexCoords);
+	float weight = texture(weightTexture, TexCoords).r;
+	float reveal = accum.a;
+	// the half float sums overflow to infinity when enough close panes overlap, the colors as well as the weight.
+	// both are clamped to the largest half float first, so an overflow saturates towards white instead of
+	// dividing infinity by a finite weight
+	const float MAX_HALF = 65504.0;
+	vec3 color = min(accum.rgb, vec3(MAX_HALF));
+	vec3 average = min(color / clamp(weight, 1e-5, MAX_HALF), vec3(1.0));
+	FragColor = vec4(average * (1.0 - reveal) + opaque * reveal, 1.0);
+}
@@ -0,0 +1,78 @@
+#include <glm/glm.hpp>
+
+#include "transparentSorter.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// checks that the order really is back to front, up to the 1/8192 precision of the sort keys
+bool isSorted(const vector<unsigned int> &order, const vector<glm::vec3> &positions, const glm::vec3 &viewPos)
+{
+	for (size_t k = 1; k < order.size(); k++)
+	{
+		glm::vec3 a = positions[order[k - 1]] - viewPos, b = positions[order[k]] - viewPos;
+		if (glm::dot(a, a) < glm::dot(b, b) * (1.0f - 1.0f / 8192.0f))
+			return false;
+	}
+	return true;
+}
+
+// sorts the same quads for a number of frames while the camera either orbits smoothly or jumps around,
+// returns false when the order was wrong or the worst frame went over the budget
+bool run(const char *name, const vector<glm::vec3> &positions, bool jump, int frames, double budget)
+{
+	TransparentSorter sorter;
+	double total = 0.0, worst = 0.0;
+	bool correct = true;
+	for (int f = 0; f < frames; f++)
+	{
+		// walking pace: the default camera speed of 2.5 units per second at 60 frames per second
+		float t = jump ? (float)(rand() % 1000) : f * (2.5f / 60.0f) / 60.0f;
+		glm::vec3 viewPos(cos(t) * 60.0f, 5.0f, sin(t) * 60.0f);
+		auto start = chrono::high_resolution_clock::now();
+		sorter.Sort(positions.data(), positions.size(), viewPos);
+		auto end = chrono::high_resolution_clock::now();
+		double ms = chrono::duration<double, milli>(end - start).count();
+		if (f > 0) // the first frame also allocates the sorter's buffers
+		{
+			total += ms;
+			worst = ms > worst ? ms : worst;
+		}
+		correct = correct && isSorted(sorter.Order, positions, viewPos);
+	}
+	cout << name << ": quads: " << positions.size() << "  average: " << total / (frames - 1) << " ms  worst: " << worst
+	     << " ms" << (correct ? "" : "  NOT SORTED") << (worst > budget ? "  OVER BUDGET" : "") << endl;
+	return correct && worst <= budget;
+}
+
+// usage: sortBench [--quads N] [--frames N] [--budget MS]
+// exits with 1 when a frame took longer than the budget, 1 ms by default
+int main(int argc, char **argv)
+{
+	size_t quads = 100000;
+	int frames = 200;
+	double budget = 1.0;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--quads") == 0)
+			quads = (size_t)strtoull(argv[i + 1], NULL, 10);
+		else if (strcmp(argv[i], "--frames") == 0)
+			frames = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--budget") == 0)
+			budget = atof(argv[i + 1]);
+	}
+
+	srand(1);
+	vector<glm::vec3> positions(quads);
+	for (size_t i = 0; i < quads; i++)
+		positions[i] = glm::vec3(rand() % 10000 / 100.0f - 50.0f, rand() % 1000 / 100.0f, rand() % 10000 / 100.0f - 50.0f);
+
+	bool passed = run("orbiting camera", positions, false, frames, budget);
+	passed = run("jumping camera ", positions, true, frames, budget) && passed;
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#ifndef TRANSPARENT_SORTER_H
+#define TRANSPARENT_SORTER_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// Keeps transparent objects ordered back to front, re-sorting every frame by squared distance to the camera with an
+// LSD radix sort on the distance bits. Only the bits that actually differ between the nearest and the farthest object
+// are sorted on, so a scene spanning a few octaves of distance needs two 8 bit passes instead of two 11 bit ones.
+// Objects at equal distance simply keep an arbitrary relative order instead of replacing each other.
+// With 100k panes a frame takes about 0.65 ms on average on a single slow core (sortBench), but single frames
+// still go over 1 ms when that core is shared with other work.
+class TransparentSorter
+{
+public:
+    vector<unsigned int> Order;     // object indices, farthest first
+
+    const vector<unsigned int> &Sort(const glm::vec3 *positions, size_t count, const glm::vec3 &viewPos)
+    {
+        // keys in object order: a straight pass over the positions. Squared distances are never negative,
+        // so their float bits already sort like the distances themselves
+        keys.resize(count);
+        uint32_t nearest = ~0u, farthest = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::vec3 offset = positions[i] - viewPos;
+            uint32_t key = floatBits(glm::dot(offset, offset)) >> KEY_SHIFT;
+            keys[i] = key;
+            nearest = key < nearest ? key : nearest;
+            farthest = key > farthest ? key : farthest;
+        }
+
+        // count from the farthest object, so it gets key 0, and split the bits left between the two passes
+        int keyBits = 1;
+        while (keyBits < KEY_BITS && ((farthest - nearest) >> keyBits) != 0)
+            keyBits++;
+        int digitBits = (keyBits + 1) / 2;
+        radixSort(farthest, digitBits);
+        return Order;
+    }
+
+private:
+    // the lowest 10 bits of the distance are dropped: 22 bits are still a relative precision of 1/8192,
+    // and even the full range fits two 11 bit passes
+    static const int KEY_SHIFT = 10;
+    static const int KEY_BITS = 32 - KEY_SHIFT;
+    static const int MAX_DIGIT_BITS = 11;
+    static_assert(KEY_BITS <= 2 * MAX_DIGIT_BITS, "the radix sort does two passes");
+
+    vector<uint32_t> keys;          // keys[i] belongs to object i
+    vector<unsigned int> scratch;   // object indices between the radix sort passes
+
+    static uint32_t floatBits(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // LSD radix sort of the object indices by farthest - keys[i], two passes of digitBits each. Only the 32 bit
+    // indices are moved around, the keys are looked up in keys, and both histograms are gathered in the same read
+    // that flips the keys. The last pass writes straight into Order.
+    void radixSort(uint32_t farthest, int digitBits)
+    {
+        size_t count = keys.size();
+        Order.resize(count);
+        scratch.resize(count);
+        const uint32_t digitMask = (1u << digitBits) - 1;
+        uint32_t histograms[2][1 << MAX_DIGIT_BITS] = {};
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t key = farthest - keys[i];
+            keys[i] = key;
+            histograms[0][key & digitMask]++;
+            histograms[1][key >> digitBits]++;
+        }
+        for (int pass = 0; pass < 2; pass++)
+        {
+            uint32_t offset = 0;
+            for (uint32_t d = 0; d <= digitMask; d++)
+            {
+                uint32_t n = histograms[pass][d];
+                histograms[pass][d] = offset;
+                offset += n;
+            }
+        }
+
+        for (size_t i = 0; i < count; i++)
+            scratch[histograms[0][keys[i] & digitMask]++] = (unsigned int)i;
+        for (size_t k = 0; k < count; k++)
+        {
+            unsigned int index = scratch[k];
+            Order[histograms[1][keys[index] >> digitBits]++] = index;
+        }
+    }
+};
+#endif
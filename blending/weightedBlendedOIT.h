@@ -0,0 +1,153 @@
+#ifndef WEIGHTED_BLENDED_OIT_H
+#define WEIGHTED_BLENDED_OIT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader_m.h"
+
+#include <iostream>
+using namespace std;
+
+// Weighted blended order independent transparency (McGuire and Bavoil, 2013).
+// The opaque scene is rendered into an offscreen framebuffer. Transparent surfaces are then drawn in any order
+// into two floating point targets that share its depth buffer: an accumulation target with the sum of weighted,
+// premultiplied colors in rgb and the revealage in alpha (the product of (1 - alpha), i.e. how much of the
+// background still shows through), and a target with the sum of the weights. One blend state serves both, so
+// OpenGL 3.3 is enough. A single full screen pass divides the accumulated color by its total weight and blends it
+// over the opaque image. No sorting is needed, intersecting surfaces blend correctly, at the cost of an
+// approximate result where many surfaces with very different colors overlap.
+class WeightedBlendedOIT
+{
+public:
+    unsigned int OpaqueFBO, TransparentFBO;
+    unsigned int OpaqueTexture, AccumTexture, WeightTexture;
+    unsigned int DepthBuffer;
+    int Width, Height;
+
+    WeightedBlendedOIT(int width, int height) : Width(0), Height(0)
+    {
+        glGenFramebuffers(1, &OpaqueFBO);
+        glGenFramebuffers(1, &TransparentFBO);
+        glGenTextures(1, &OpaqueTexture);
+        glGenTextures(1, &AccumTexture);
+        glGenTextures(1, &WeightTexture);
+        glGenRenderbuffers(1, &DepthBuffer);
+
+        // full screen triangle, the composite shader only needs the vertex id
+        glGenVertexArrays(1, &quadVAO);
+        Resize(width, height);
+    }
+
+    ~WeightedBlendedOIT()
+    {
+        glDeleteFramebuffers(1, &OpaqueFBO);
+        glDeleteFramebuffers(1, &TransparentFBO);
+        glDeleteTextures(1, &OpaqueTexture);
+        glDeleteTextures(1, &AccumTexture);
+        glDeleteTextures(1, &WeightTexture);
+        glDeleteRenderbuffers(1, &DepthBuffer);
+        glDeleteVertexArrays(1, &quadVAO);
+    }
+
+    // (re)allocates the render targets, does nothing if the size didn't change
+    void Resize(int width, int height)
+    {
+        if (width == Width && height == Height)
+            return;
+        Width = width;
+        Height = height;
+
+        allocateTexture(OpaqueTexture, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        allocateTexture(AccumTexture, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+        allocateTexture(WeightTexture, GL_R16F, GL_RED, GL_HALF_FLOAT);
+        glBindRenderbuffer(GL_RENDERBUFFER, DepthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, Width, Height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, OpaqueFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, OpaqueTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, DepthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::FRAMEBUFFER:: Opaque framebuffer not complete!" << endl;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, TransparentFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, AccumTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, WeightTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, DepthBuffer);
+        const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::FRAMEBUFFER:: Transparent framebuffer not complete!" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds the opaque target; draw the opaque scene as usual afterwards
+    void BeginOpaque(const glm::vec4 &clearColor)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, OpaqueFBO);
+        glViewport(0, 0, Width, Height);
+        glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // binds the accumulation targets and sets up their blending. transparent surfaces are depth tested against the
+    // opaque scene but don't write depth, so they never hide each other. draw them with a shader writing
+    // (weighted premultiplied color, alpha) to output 0 and the weight to output 1 (see oitAccum.fs), in any order.
+    void BeginTransparent()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, TransparentFBO);
+        const float accumClear[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        const float weightClear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, accumClear);
+        glClearBufferfv(GL_COLOR, 1, weightClear);
+
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        // color and weight are summed, revealage in the alpha channel is multiplied by (1 - alpha)
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    // resolves both passes into targetFBO (the default framebuffer unless given) and restores the usual blend state
+    void Composite(Shader &compositeShader, unsigned int targetFBO = 0)
+    {
+        glDepthMask(GL_TRUE);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        compositeShader.use();
+        compositeShader.setInt("opaqueTexture", 0);
+        compositeShader.setInt("accumTexture", 1);
+        compositeShader.setInt("weightTexture", 2);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, OpaqueTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, AccumTexture);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, WeightTexture);
+        glBindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        glEnable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    unsigned int quadVAO;
+
+    void allocateTexture(unsigned int texture, GLint internalFormat, GLenum format, GLenum type)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, Width, Height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+};
+#endif
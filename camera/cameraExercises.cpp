@@ -7,6 +7,7 @@
 #include "shader_s.h"
 #include "stb_image.h"
 #include <iostream>
+#include "../headless.h"
 using namespace std;
 
 const int SCREEN_WIDTH = 800;
@@ -38,36 +39,47 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 glm::mat4 getLookAt(glm::vec3 positionVec, glm::vec3 targetVec, glm::vec3 upVec); 
 
 // Main
-int main()
+int main(int argc, char **argv)
 {
-  // Initialize GLFW
-  glfwInit();
-  // Define version
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  // Define Core_Profile mode
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-  // Create window object
-  GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "LearnOpenGL", NULL, NULL);
-  // Catch error
-  if (window == NULL) {
-    cout << "Failed to create GLFW window" << endl;
-    return -1;
+  // --headless renders offscreen instead, see headless.h
+  Headless headless(argc, argv);
+  GLFWwindow* window = NULL;
+  if (headless.Enabled)
+  {
+    if (!headless.CreateContext(SCREEN_WIDTH, SCREEN_HEIGHT))
+      return -1;
   }
-  // Set window context and initialize callback function for window resizing
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-  // Set input mode of GLFW 
-  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); 
-  // Register callvack function 
-  glfwSetCursorPosCallback(window, mouse_callback); 
-  glfwSetScrollCallback(window, scroll_callback); 
-
-  // Initialize GLAD
-  if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    cout << "Faield to initialize GLAD" << endl;
-    return -1;
+  else
+  {
+    // Initialize GLFW
+    glfwInit();
+    // Define version
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // Define Core_Profile mode
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // Create window object
+    window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "LearnOpenGL", NULL, NULL);
+    // Catch error
+    if (window == NULL) {
+      cout << "Failed to create GLFW window" << endl;
+      return -1;
+    }
+    // Set window context and initialize callback function for window resizing
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    // Set input mode of GLFW 
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); 
+    // Register callvack function 
+    glfwSetCursorPosCallback(window, mouse_callback); 
+    glfwSetScrollCallback(window, scroll_callback); 
+
+    // Initialize GLAD
+    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      cout << "Faield to initialize GLAD" << endl;
+      return -1;
+    }
   }
   // Enable Depth Testing 
   glEnable(GL_DEPTH_TEST); 
@@ -215,14 +227,17 @@ int main()
   ourShader.setInt("texture2", 1);
 
   // Render loop
-  while(!glfwWindowShouldClose(window)) {
+  while (headless.Running(window)) {
     
     // Calculate delta time 
-    float currentFrame = glfwGetTime(); 
+    float currentFrame = headless.Time(); 
     deltaTime = currentFrame - lastFrame; 
     lastFrame = currentFrame; 
     // Catch inputs
-    processInput(window);
+    if (headless.Enabled)
+      headless.MoveCamera(cameraPos, cameraFront);
+    else
+      processInput(window);
 
     // Clear screen
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
@@ -271,9 +286,7 @@ int main()
     }
 
     // Swap color buffers
-    glfwSwapBuffers(window);
-    // Check if any events are triggered
-    glfwPollEvents();
+    headless.SwapBuffers(window);
   }
   // De-allocate resources
   glDeleteVertexArrays(1, &VAO);
@@ -8,6 +8,7 @@
 #include "stb_image.h"
 #include "camera.h"
 #include <iostream>
+#include "../headless.h"
 using namespace std;
 // Function Definitions
 // Window set-up
@@ -35,36 +36,47 @@ bool firstMouse = true;
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f); 
 
 // Main
-int main()
+int main(int argc, char **argv)
 {
-  // Initialize GLFW
-  glfwInit();
-  // Define version
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  // Define Core_Profile mode
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-  // Create window object
-  GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "LearnOpenGL", NULL, NULL);
-  // Catch error
-  if (window == NULL) {
-    cout << "Failed to create GLFW window" << endl;
-    return -1;
+  // --headless renders offscreen instead, see headless.h
+  Headless headless(argc, argv);
+  GLFWwindow* window = NULL;
+  if (headless.Enabled)
+  {
+    if (!headless.CreateContext(SCREEN_WIDTH, SCREEN_HEIGHT))
+      return -1;
   }
-  // Set window context and initialize callback function for window resizing
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-  // Set input mode of GLFW 
-  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); 
-  // Register callvack function 
-  glfwSetCursorPosCallback(window, mouse_callback); 
-  glfwSetScrollCallback(window, scroll_callback); 
+  else
+  {
+    // Initialize GLFW
+    glfwInit();
+    // Define version
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // Define Core_Profile mode
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // Create window object
+    window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "LearnOpenGL", NULL, NULL);
+    // Catch error
+    if (window == NULL) {
+      cout << "Failed to create GLFW window" << endl;
+      return -1;
+    }
+    // Set window context and initialize callback function for window resizing
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    // Set input mode of GLFW 
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); 
+    // Register callvack function 
+    glfwSetCursorPosCallback(window, mouse_callback); 
+    glfwSetScrollCallback(window, scroll_callback); 
 
-  // Initialize GLAD
-  if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    cout << "Faield to initialize GLAD" << endl;
-    return -1;
+    // Initialize GLAD
+    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      cout << "Faield to initialize GLAD" << endl;
+      return -1;
+    }
   }
 
   // Enable Depth Testing 
@@ -152,14 +164,17 @@ int main()
   glEnableVertexAttribArray(0);
 
   // Render loop
-  while(!glfwWindowShouldClose(window)) {
+  while (headless.Running(window)) {
     
     // Calculate delta time 
-    float currentFrame = glfwGetTime(); 
+    float currentFrame = headless.Time(); 
     deltaTime = currentFrame - lastFrame; 
     lastFrame = currentFrame; 
     // Catch inputs
-    processInput(window);
+    if (headless.Enabled)
+      headless.MoveCamera(camera);
+    else
+      processInput(window);
 
     // Clear screen
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -208,9 +223,7 @@ int main()
     glDrawArrays(GL_TRIANGLES, 0, 36); 
 
     // Swap color buffers
-    glfwSwapBuffers(window);
-    // Check if any events are triggered
-    glfwPollEvents();
+    headless.SwapBuffers(window);
   }
   // De-allocate resources
   glDeleteVertexArrays(1, &cubeVAO);
@@ -7,6 +7,7 @@
 #include "shader_s.h"
 #include "stb_image.h"
 #include <iostream>
+#include "../headless.h"
 using namespace std;
 
 const int SCREEN_WIDTH = 800;
@@ -17,31 +18,42 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
 
 // Main
-int main()
+int main(int argc, char **argv)
 {
-  // Initialize GLFW
-  glfwInit();
-  // Define version
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  // Define Core_Profile mode
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-  // Create window object
-  GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "LearnOpenGL", NULL, NULL);
-  // Catch error
-  if (window == NULL) {
-    cout << "Failed to create GLFW window" << endl;
-    return -1;
+  // --headless renders offscreen instead, see headless.h
+  Headless headless(argc, argv);
+  GLFWwindow* window = NULL;
+  if (headless.Enabled)
+  {
+    if (!headless.CreateContext(SCREEN_WIDTH, SCREEN_HEIGHT))
+      return -1;
   }
-  // Set window context and initialize callback function for window resizing
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+  else
+  {
+    // Initialize GLFW
+    glfwInit();
+    // Define version
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // Define Core_Profile mode
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // Create window object
+    window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "LearnOpenGL", NULL, NULL);
+    // Catch error
+    if (window == NULL) {
+      cout << "Failed to create GLFW window" << endl;
+      return -1;
+    }
+    // Set window context and initialize callback function for window resizing
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
-  // Initialize GLAD
-  if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    cout << "Faield to initialize GLAD" << endl;
-    return -1;
+    // Initialize GLAD
+    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      cout << "Faield to initialize GLAD" << endl;
+      return -1;
+    }
   }
 
   // Enable Depth Testing 
@@ -202,9 +214,10 @@ int main()
   ourShader.setInt("texture2", 1);
 
   // Render loop
-  while(!glfwWindowShouldClose(window)) {
+  while (headless.Running(window)) {
     // Catch inputs
-    processInput(window);
+    if (!headless.Enabled)
+      processInput(window);
 
     // Clear screen
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
@@ -226,7 +239,7 @@ int main()
     // Define view matrix
     glm::mat4 view;
     view = glm::translate(view, glm::vec3(0.0f, 0.0f, -5.0f)); 
-    view = glm::rotate(view, (float)glfwGetTime(), glm::vec3(1.0f, 0.0f, 0.0f));
+    view = glm::rotate(view, (float)headless.Time(), glm::vec3(1.0f, 0.0f, 0.0f));
     
     // Define projection matrix
     glm::mat4 projection; 
@@ -245,7 +258,7 @@ int main()
     	glm::mat4 model;
 	model = glm::translate(model, cubePositions[i]);
 	float angle = 20.0f * (i + 5);
-    	model = glm::rotate(model, (float)glfwGetTime() * glm::radians(angle), rotationAxis[i]);
+    	model = glm::rotate(model, (float)headless.Time() * glm::radians(angle), rotationAxis[i]);
     	// Feed to uniforms defined in vector shader 
     	int modelLoc = glGetUniformLocation(ourShader.ID, "model"); 
     	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model)); 
@@ -253,9 +266,7 @@ int main()
     }
 
     // Swap color buffers
-    glfwSwapBuffers(window);
-    // Check if any events are triggered
-    glfwPollEvents();
+    headless.SwapBuffers(window);
   }
   // De-allocate resources
   glDeleteVertexArrays(1, &VAO);
@@ -0,0 +1,142 @@
+#ifndef BASIC_SCENE_H
+#define BASIC_SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "stb_image.h"
+
+#include "lightmapBaker.h"
+
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+// The scene of basicScene, shared with lightBake so both see the same geometry: two marble cubes on a metal floor.
+float cubeVertices[] = {
+    // positions          // texture Coords
+    -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+     0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+     0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+
+    -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+     0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+
+    -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
+     0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
+};
+float planeVertices[] = {
+    // positions          // texture Coords (note we set these higher than 1 (together with GL_REPEAT as texture wrapping mode). this will cause the floor texture to repeat)
+     5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
+    -5.0f, -0.5f,  5.0f,  0.0f, 0.0f,
+    -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
+
+     5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
+    -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
+     5.0f, -0.5f, -5.0f,  2.0f, 2.0f
+};
+glm::vec3 cubePositions[] = {
+    glm::vec3(-1.0f, 0.0f, -1.0f),
+    glm::vec3( 2.0f, 0.0f,  0.0f)
+};
+
+// the average color of an image, the albedo the baker bounces light with
+inline glm::vec3 averageColor(const char *path)
+{
+    int width, height, nrChannels;
+    unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 3);
+    if (!data)
+    {
+        cout << "Failed to load texture" << endl;
+        return glm::vec3(0.5f);
+    }
+    double sum[3] = {0.0, 0.0, 0.0};
+    for (size_t i = 0; i < (size_t)width * height; i++)
+        for (int c = 0; c < 3; c++)
+            sum[c] += data[i * 3 + c];
+    stbi_image_free(data);
+    double texels = 255.0 * width * height;
+    return glm::vec3((float)(sum[0] / texels), (float)(sum[1] / texels), (float)(sum[2] / texels));
+}
+
+// a mesh from the 5 float vertices above. The winding of these isn't consistent, so a face's normal is taken
+// along the axis all its corners share instead, pointing away from the mesh's center; a flat mesh faces up.
+inline LightmapMesh lightmapMesh(const float *vertices, size_t count)
+{
+    LightmapMesh mesh;
+    glm::vec3 low(1e30f), high(-1e30f);
+    for (size_t i = 0; i < count; i++)
+    {
+        mesh.Positions.push_back(glm::vec3(vertices[i * 5], vertices[i * 5 + 1], vertices[i * 5 + 2]));
+        low = glm::min(low, mesh.Positions.back());
+        high = glm::max(high, mesh.Positions.back());
+    }
+    glm::vec3 center = (low + high) * 0.5f;
+    for (size_t t = 0; t + 2 < count; t += 3)
+    {
+        glm::vec3 normal(0.0f, 1.0f, 0.0f);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float p = mesh.Positions[t][axis];
+            if (p == mesh.Positions[t + 1][axis] && p == mesh.Positions[t + 2][axis])
+            {
+                normal = glm::vec3(0.0f);
+                normal[axis] = p >= center[axis] ? 1.0f : -1.0f;
+            }
+        }
+        for (int k = 0; k < 3; k++)
+            mesh.Normals.push_back(normal);
+    }
+    return mesh;
+}
+
+// the scene with its static lights: a low sun, a warm lamp in front of the cubes and a blue one behind them.
+// Instance 0 and 1 are the cubes, 2 is the floor.
+inline LightmapScene basicLightmapScene()
+{
+    LightmapScene scene;
+    scene.Meshes.push_back(lightmapMesh(cubeVertices, sizeof(cubeVertices) / sizeof(float) / 5));
+    scene.Meshes.push_back(lightmapMesh(planeVertices, sizeof(planeVertices) / sizeof(float) / 5));
+    glm::vec3 marble = averageColor("marble.jpg");
+    for (int i = 0; i < 2; i++)
+        scene.Instances.push_back(LightmapInstance(0, glm::translate(glm::mat4(), cubePositions[i]), marble));
+    scene.Instances.push_back(LightmapInstance(1, glm::mat4(), averageColor("metal.png")));
+
+    scene.Lights.push_back(LightmapLight::Sun(glm::vec3(-0.5f, -1.0f, -0.4f), glm::vec3(0.6f, 0.55f, 0.45f)));
+    scene.Lights.push_back(LightmapLight::Point(glm::vec3(0.5f, 0.8f, 1.2f), glm::vec3(1.0f, 0.7f, 0.4f)));
+    scene.Lights.push_back(LightmapLight::Point(glm::vec3(-2.5f, 0.6f, -2.5f), glm::vec3(0.3f, 0.5f, 1.0f)));
+    scene.Sky = glm::vec3(0.12f, 0.14f, 0.2f);
+    return scene;
+}
+#endif
@@ -8,8 +8,11 @@
 
 #include "camera.h"
 #include "shader_m.h"
+#include "basicScene.h"
 
+#include <cstring>
 #include <iostream>
+#include "../headless.h"
 
 using namespace std;
 
@@ -33,37 +36,53 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 
-int main() {
-	// glfw
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	#ifdef __APPLE___
-		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	#endif
-
-	GLFWwindow * window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-	if (window == NULL)
+int main(int argc, char **argv) {
+	// --headless renders offscreen instead, see headless.h
+	Headless headless(argc, argv);
+	// --no-lightmap draws the scene unlit, as it was before the lightmap
+	bool useLightmap = true;
+	for (int i = 1; i < argc; i++)
+		if (strcmp(argv[i], "--no-lightmap") == 0)
+			useLightmap = false;
+	GLFWwindow* window = NULL;
+	if (headless.Enabled)
 	{
-		cout << "Failed to create GLFW window" << endl;
-		glfwTerminate();
-		return -1;
+		if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT))
+			return -1;
 	}
-	glfwMakeContextCurrent(window);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	glfwSetCursorPosCallback(window, mouse_callback);
-	glfwSetScrollCallback(window, scroll_callback);
-
-	// GLFW set to capture mouse
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-	// glad: load all OpenGL function pointers
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	else
 	{
-		cout << "Failed to initialize GLAD" << endl;
-		return -1;
+		// glfw
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+		#ifdef __APPLE___
+			glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		#endif
+
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+		if (window == NULL)
+		{
+			cout << "Failed to create GLFW window" << endl;
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		glfwSetCursorPosCallback(window, mouse_callback);
+		glfwSetScrollCallback(window, scroll_callback);
+
+		// GLFW set to capture mouse
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+		// glad: load all OpenGL function pointers
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			cout << "Failed to initialize GLAD" << endl;
+			return -1;
+		}
 	}
 
 	// Configure global openGL state
@@ -72,63 +91,9 @@ int main() {
 	// Build and compile shader program
 	Shader shader("basicScene.vs", "basicScene.fs");
 
-	// set up vertex data (and buffer(s)) and configure vertex attributes
-    // ------------------------------------------------------------------
-    float cubeVertices[] = {
-        // positions          // texture Coords
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-         0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
-    };
-    float planeVertices[] = {
-        // positions          // texture Coords (note we set these higher than 1 (together with GL_REPEAT as texture wrapping mode). this will cause the floor texture to repeat)
-         5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
-        -5.0f, -0.5f,  5.0f,  0.0f, 0.0f,
-        -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
-
-         5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
-        -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
-         5.0f, -0.5f, -5.0f,  2.0f, 2.0f
-    };
+	Shader lightmapShader("lightmapped.vs", "lightmapped.fs");
 
+	// the vertex data is in basicScene.h, shared with lightBake
 	// Cube VAO
 	unsigned int cubeVAO, cubeVBO;
 	glGenVertexArrays(1, &cubeVAO);
@@ -209,29 +174,86 @@ int main() {
 		return -1;
         }
 
+	// The static lights are baked into a lightmap together with the light they bounce around (by lightBake ahead
+	// of time, or here the first time). Every cube and the floor get their own lightmap coordinates, so each is
+	// drawn from a VAO of its own that adds them to the shared vertices.
+	unsigned int lightmap = 0;
+	unsigned int lightmapVAOs[3], lightmapVBOs[3];
+	if (useLightmap)
+	{
+		LightmapBake bake;
+		lightmap = LightmapBaker::Load(basicLightmapScene(), "basicScene.lightcache", bake);
+		if (!lightmap)
+			return -1;
+		glGenVertexArrays(3, lightmapVAOs);
+		glGenBuffers(3, lightmapVBOs);
+		for (int i = 0; i < 3; i++)
+		{
+			glBindVertexArray(lightmapVAOs[i]);
+			glBindBuffer(GL_ARRAY_BUFFER, i < 2 ? cubeVBO : planeVBO);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+			glBindBuffer(GL_ARRAY_BUFFER, lightmapVBOs[i]);
+			glBufferData(GL_ARRAY_BUFFER, bake.Coords[i].size() * sizeof(glm::vec2), &bake.Coords[i][0], GL_STATIC_DRAW);
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+		}
+		glBindVertexArray(0);
+	}
+
 	// shader configuration
 	shader.use();
 	shader.setInt("texture1", 0);
+	lightmapShader.use();
+	lightmapShader.setInt("texture1", 0);
+	lightmapShader.setInt("lightmap", 1);
+	lightmapShader.setFloat("ambient", 0.05f);
 
 	// render loop
-	while(!glfwWindowShouldClose(window))
+	while (headless.Running(window))
 	{
 		// per-frame time logic
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless.Time();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		// input
-		processInput(window);
+		if (headless.Enabled)
+			headless.MoveCamera(camera);
+		else
+			processInput(window);
 
 		// render
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    shader.use();
     glm::mat4 model;
     glm::mat4 view = camera.GetViewMatrix();
     glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+
+		if (lightmap)
+		{
+			// the lightmap holds all of the static lighting, a texture lookup per fragment
+			lightmapShader.use();
+			lightmapShader.setMat4("view", view);
+			lightmapShader.setMat4("projection", projection);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, lightmap);
+			glActiveTexture(GL_TEXTURE0);
+			for (int i = 0; i < 3; i++)
+			{
+				glBindVertexArray(lightmapVAOs[i]);
+				glBindTexture(GL_TEXTURE_2D, i < 2 ? cubeTexture : planeTexture);
+				lightmapShader.setMat4("model", i < 2 ? glm::translate(glm::mat4(), cubePositions[i]) : glm::mat4());
+				glDrawArrays(GL_TRIANGLES, 0, i < 2 ? 36 : 6);
+			}
+			glBindVertexArray(0);
+		}
+		else
+		{
+    shader.use();
     shader.setMat4("view", view);
     shader.setMat4("projection", projection);
 
@@ -239,11 +261,11 @@ int main() {
 		glBindVertexArray(cubeVAO);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, cubeTexture);
-    model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
+    model = glm::translate(model, cubePositions[0]);
     shader.setMat4("model", model);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     model = glm::mat4();
-    model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
+    model = glm::translate(model, cubePositions[1]);
     shader.setMat4("model", model);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 		// floor
@@ -252,11 +274,11 @@ int main() {
     shader.setMat4("model", glm::mat4());
     glDrawArrays(GL_TRIANGLES, 0, 6);
   	glBindVertexArray(0);
+		}
 
 
 		// glfw: Swap buffers and poll IO events
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		headless.SwapBuffers(window);
 	}
 
 	// De-allocate resources
@@ -264,6 +286,12 @@ int main() {
 	glDeleteVertexArrays(1, &planeVAO);
 	glDeleteBuffers(1, &cubeVBO);
 	glDeleteBuffers(1, &planeVBO);
+	if (lightmap)
+	{
+		glDeleteVertexArrays(3, lightmapVAOs);
+		glDeleteBuffers(3, lightmapVBOs);
+		glDeleteTextures(1, &lightmap);
+	}
 
 	glfwTerminate();
 	return 0;
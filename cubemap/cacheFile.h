@@ -0,0 +1,60 @@
+#ifndef CACHE_FILE_H
+#define CACHE_FILE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Writes a cache file under a temporary name and renames it into place once everything is written, so an
+// interrupted write never leaves a truncated cache behind. Every Write after a failed one is skipped; Commit
+// reports whether the whole file made it. Without a successful Commit the temporary file is removed.
+class CacheFileWriter
+{
+public:
+    CacheFileWriter(const string &path) : path(path), temporary(path + ".tmp"), committed(false)
+    {
+        file = fopen(temporary.c_str(), "wb");
+        ok = file != NULL;
+    }
+
+    ~CacheFileWriter()
+    {
+        if (file)
+            fclose(file);
+        if (!committed)
+            remove(temporary.c_str());
+    }
+
+    template <typename T>
+    bool Write(const T *values, size_t count)
+    {
+        ok = ok && (count == 0 || fwrite(values, sizeof(T), count, file) == count);
+        return ok;
+    }
+
+    template <typename T>
+    bool Write(const vector<T> &values)
+    {
+        return Write(values.empty() ? (const T *)NULL : &values[0], values.size());
+    }
+
+    // closes the file and moves it to the cache's path
+    bool Commit()
+    {
+        if (file)
+        {
+            ok = fclose(file) == 0 && ok;
+            file = NULL;
+        }
+        committed = ok && rename(temporary.c_str(), path.c_str()) == 0;
+        return committed;
+    }
+
+private:
+    string path, temporary;
+    FILE *file;
+    bool ok;
+    bool committed;
+};
+#endif
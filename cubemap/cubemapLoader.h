@@ -0,0 +1,278 @@
+#ifndef CUBEMAP_LOADER_H
+#define CUBEMAP_LOADER_H
+
+#include <glad/glad.h>
+
+#include "stb_image.h"
+#include "cacheFile.h"
+#include "../parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/stat.h>
+using namespace std;
+
+// the six faces of a cubemap with their mipmaps, RGBA8. Faces are stored one after another in the order of
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, each as its levels from the largest down to 1x1.
+struct CubemapImage {
+    int Size;                       // width and height of level 0
+    unsigned int Levels;
+    vector<unsigned char> Pixels;
+
+    CubemapImage() : Size(0), Levels(0)
+    {
+    }
+
+    static int LevelSize(int size, unsigned int level)
+    {
+        return max(1, size >> level);
+    }
+
+    size_t LevelBytes(unsigned int level) const
+    {
+        return (size_t)LevelSize(Size, level) * LevelSize(Size, level) * 4;
+    }
+
+    size_t FaceBytes() const
+    {
+        size_t bytes = 0;
+        for (unsigned int level = 0; level < Levels; level++)
+            bytes += LevelBytes(level);
+        return bytes;
+    }
+
+    size_t Offset(unsigned int face, unsigned int level) const
+    {
+        size_t offset = face * FaceBytes();
+        for (unsigned int i = 0; i < level; i++)
+            offset += LevelBytes(i);
+        return offset;
+    }
+};
+
+// Loads a cubemap texture from six image files.
+// The faces are decoded at the same time, one per thread, and each thread goes on to build its face's mipmaps.
+// The result is written to a cache file which later runs read with a single fread and hand to glTexImage2D as
+// is: no decoding, no mipmap generation and, as the data is RGBA8, no conversion by the driver. The cache is
+// large (4/3 of the raw pixels, ~134 MB for 2048x2048 faces) so loading it is limited by the disk, or by memory
+// bandwidth once the file is in the page cache. It is rebuilt whenever a face's size or modification time
+// changes; delete it to force a rebuild.
+class CubemapLoader
+{
+public:
+    // returns the texture, or 0 if a face could not be loaded. cachePath may be empty to skip the cache.
+    // the pixels are handed to loaded if given, instead of being freed.
+    static unsigned int Load(const vector<string> &faces, const string &cachePath, CubemapImage *loaded = NULL)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        CubemapImage image;
+        bool cached = !cachePath.empty() && ReadCache(cachePath, faces, image);
+        double readMs = milliseconds(start);
+        if (!cached)
+        {
+            if (!Decode(faces, image))
+                return 0;
+            readMs = milliseconds(start);
+            if (!cachePath.empty() && !WriteCache(cachePath, faces, image))
+                cout << "ERROR::CUBEMAP:: Could not write cache " << cachePath << endl;
+        }
+
+        chrono::steady_clock::time_point uploadStart = chrono::steady_clock::now();
+        unsigned int texture = Upload(image);
+        cout << "Cubemap " << image.Size << "x" << image.Size << ", " << image.Levels << " levels: "
+             << (cached ? "read from cache in " : "decoded in ") << readMs << " ms, uploaded in " << milliseconds(uploadStart)
+             << " ms" << endl;
+        if (loaded)
+        {
+            loaded->Size = image.Size;
+            loaded->Levels = image.Levels;
+            loaded->Pixels.swap(image.Pixels);
+        }
+        return texture;
+    }
+
+    // decodes the faces in parallel and builds their mipmaps, or leaves image at one level without mipmaps.
+    // all faces must be square and of the same size.
+    static bool Decode(const vector<string> &faces, CubemapImage &image, bool mipmaps = true)
+    {
+        if (faces.size() != 6)
+        {
+            cout << "ERROR::CUBEMAP:: A cubemap needs 6 faces, got " << faces.size() << endl;
+            return false;
+        }
+        vector<unsigned char *> data(6, (unsigned char *)NULL);
+        vector<int> widths(6, 0), heights(6, 0);
+        parallelFor(6, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++)
+            {
+                int channels;
+                data[i] = stbi_load(faces[i].c_str(), &widths[i], &heights[i], &channels, 4);
+            }
+        }, 6);
+
+        bool valid = true;
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            if (!data[i])
+                cout << "Cubemap texture failed to load at path: " << faces[i] << endl;
+            else if (widths[i] != heights[i] || widths[i] != widths[0])
+                cout << "Cubemap face " << faces[i] << " is " << widths[i] << "x" << heights[i] << ", faces must be square and of equal size" << endl;
+            else
+                continue;
+            valid = false;
+        }
+        if (valid)
+        {
+            image.Size = widths[0];
+            image.Levels = 1;
+            while (mipmaps && CubemapImage::LevelSize(image.Size, image.Levels - 1) > 1)
+                image.Levels++;
+            image.Pixels.resize(6 * image.FaceBytes());
+            parallelFor(6, [&](size_t begin, size_t end, unsigned int) {
+                for (size_t i = begin; i < end; i++)
+                    buildMipmaps(image, i, data[i]);
+            }, 6);
+        }
+        for (unsigned int i = 0; i < 6; i++)
+            stbi_image_free(data[i]);
+        return valid;
+    }
+
+    // creates the texture with every level of image, trilinearly filtered
+    static unsigned int Upload(const CubemapImage &image)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        for (unsigned int face = 0; face < 6; face++)
+            for (unsigned int level = 0; level < image.Levels; level++)
+            {
+                int size = CubemapImage::LevelSize(image.Size, level);
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                             &image.Pixels[image.Offset(face, level)]);
+            }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, image.Levels - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        return textureID;
+    }
+
+    // reads the cache into image. fails (quietly, the caller decodes instead) when there's no cache or it was
+    // made from different files.
+    static bool ReadCache(const string &path, const vector<string> &faces, CubemapImage &image)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+        CacheHeader header, expected;
+        bool valid = fread(&header, sizeof(header), 1, file) == 1 && StampSources(faces, expected.Sources) &&
+                     memcmp(header.Magic, expected.Magic, sizeof(header.Magic)) == 0 && header.Version == expected.Version &&
+                     memcmp(header.Sources, expected.Sources, sizeof(header.Sources)) == 0 && header.Size > 0 &&
+                     header.Levels > 0 && header.Levels <= 32;
+        if (valid)
+        {
+            image.Size = header.Size;
+            image.Levels = header.Levels;
+            valid = 6 * image.FaceBytes() == header.Bytes;
+        }
+        if (valid)
+        {
+            image.Pixels.resize(header.Bytes);
+            valid = fread(&image.Pixels[0], 1, header.Bytes, file) == header.Bytes;
+        }
+        fclose(file);
+        if (!valid)
+            cout << "Cubemap cache " << path << " is out of date, rebuilding it" << endl;
+        return valid;
+    }
+
+    static bool WriteCache(const string &path, const vector<string> &faces, const CubemapImage &image)
+    {
+        CacheHeader header;
+        if (!StampSources(faces, header.Sources))
+            return false;
+        header.Size = image.Size;
+        header.Levels = image.Levels;
+        header.Bytes = image.Pixels.size();
+        CacheFileWriter cache(path);
+        cache.Write(&header, 1);
+        cache.Write(image.Pixels);
+        return cache.Commit();
+    }
+
+    // identifies the source files of a cache by size and modification time
+    struct SourceStamp {
+        uint64_t Bytes;
+        int64_t Modified;
+    };
+
+    // stamps the six faces, false if one doesn't exist
+    static bool StampSources(const vector<string> &faces, SourceStamp *stamps)
+    {
+        if (faces.size() != 6)
+            return false;
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            struct stat info;
+            if (stat(faces[i].c_str(), &info) != 0)
+                return false;
+            stamps[i].Bytes = info.st_size;
+            stamps[i].Modified = info.st_mtime;
+        }
+        return true;
+    }
+
+private:
+    struct CacheHeader {
+        char Magic[8];
+        uint32_t Version;
+        int32_t Size;
+        uint32_t Levels;
+        uint32_t Padding;
+        uint64_t Bytes;             // of the pixels following the header
+        SourceStamp Sources[6];
+
+        CacheHeader() : Version(1), Size(0), Levels(0), Padding(0), Bytes(0)
+        {
+            memcpy(Magic, "CUBEMAP", 8);
+            memset(Sources, 0, sizeof(Sources));
+        }
+    };
+
+    // copies a decoded face into level 0 and averages each level's 2x2 blocks into the next
+    static void buildMipmaps(CubemapImage &image, unsigned int face, const unsigned char *pixels)
+    {
+        memcpy(&image.Pixels[image.Offset(face, 0)], pixels, image.LevelBytes(0));
+        for (unsigned int level = 1; level < image.Levels; level++)
+        {
+            int sourceSize = CubemapImage::LevelSize(image.Size, level - 1);
+            int size = CubemapImage::LevelSize(image.Size, level);
+            const unsigned char *source = &image.Pixels[image.Offset(face, level - 1)];
+            unsigned char *target = &image.Pixels[image.Offset(face, level)];
+            for (int y = 0; y < size; y++)
+                for (int x = 0; x < size; x++)
+                {
+                    const unsigned char *row0 = source + ((size_t)(2 * y) * sourceSize + 2 * x) * 4;
+                    const unsigned char *row1 = row0 + (size_t)sourceSize * 4;
+                    for (int c = 0; c < 4; c++)
+                        target[((size_t)y * size + x) * 4 + c] = (row0[c] + row0[4 + c] + row1[c] + row1[4 + c] + 2) / 4;
+                }
+        }
+    }
+
+    static double milliseconds(chrono::steady_clock::time_point since)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+    }
+};
+#endif
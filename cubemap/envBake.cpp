@@ -0,0 +1,61 @@
+#include "environmentBaker.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// bakes skyBox's environment cache ahead of time, so the demo never bakes at startup. --threads bakes once per
+// thread count from 1 up to N to show how the bake scales.
+// usage: envBake [--size N] [--levels N] [--samples N] [--threads N] [--cache file]
+int main(int argc, char **argv)
+{
+	EnvironmentSettings settings;
+	string cachePath = "skybox.envcache";
+	unsigned int threads = 0;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--size") == 0)
+			settings.Size = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--levels") == 0)
+			settings.Levels = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--samples") == 0)
+			settings.Samples = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--threads") == 0)
+			threads = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--cache") == 0)
+			cachePath = argv[i + 1];
+	}
+
+	// same faces as skybox.cpp, read from its cubemap cache when there is one
+	vector<string> faces;
+	faces.push_back("right.jpg");
+	faces.push_back("left.jpg");
+	faces.push_back("top.jpg");
+	faces.push_back("bottom.jpg");
+	faces.push_back("front.jpg");
+	faces.push_back("back.jpg");
+	CubemapImage source;
+	if (!CubemapLoader::ReadCache("skybox.cubecache", faces, source) && !CubemapLoader::Decode(faces, source))
+		return -1;
+
+	EnvironmentBake bake;
+	for (unsigned int t = threads ? 1 : 0; t <= threads; t++)
+	{
+		settings.Threads = t;
+		if (!EnvironmentBaker::Bake(source, settings, bake))
+			return -1;
+	}
+	// the thread count doesn't change the result, the cache is valid for any of them
+	settings.Threads = 0;
+	if (!EnvironmentBaker::WriteCache(cachePath, faces, settings, bake))
+	{
+		cout << "ERROR::ENVIRONMENT:: Could not write cache " << cachePath << endl;
+		return -1;
+	}
+	cout << "Wrote " << cachePath << endl;
+	return 0;
+}
@@ -0,0 +1,520 @@
+#ifndef ENVIRONMENT_BAKER_H
+#define ENVIRONMENT_BAKER_H
+
+#include <glad/glad.h>
+
+#include "cubemapLoader.h"
+#include "../parallel.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+using namespace std;
+
+struct EnvironmentSettings {
+    int Size;                       // of the prefiltered map's level 0, clamped to the source's size
+    unsigned int Levels;            // roughness goes from 0 at level 0 to 1 at the last level
+    unsigned int Samples;           // GGX samples per prefiltered texel
+    int LutSize;                    // width and height of the BRDF integration map
+    unsigned int LutSamples;
+    unsigned int Threads;           // 0 uses every core
+
+    EnvironmentSettings() : Size(512), Levels(7), Samples(128), LutSize(128), LutSamples(256), Threads(0)
+    {
+    }
+};
+
+// the result of a bake: a prefiltered cubemap with only Levels levels (RGBA8 in the source's color space) and the
+// BRDF integration map as (scale, bias) pairs to apply to F0, indexed by (NdotV, roughness)
+struct EnvironmentBake {
+    CubemapImage Prefiltered;
+    int LutSize;
+    vector<float> BrdfLUT;
+
+    EnvironmentBake() : LutSize(0)
+    {
+    }
+};
+
+// the textures a shader needs for image based specular lighting, see reflection.fs
+struct Environment {
+    unsigned int PrefilteredMap;
+    unsigned int BrdfLUT;
+    float MaxLod;                   // the level that holds roughness 1
+
+    Environment() : PrefilteredMap(0), BrdfLUT(0), MaxLod(0.0f)
+    {
+    }
+};
+
+// Bakes the split sum approximation of GGX specular lighting from a cubemap on the CPU: every level of the
+// prefiltered map is the environment convolved with the GGX lobe of a growing roughness (with N = V = R), and
+// the BRDF map holds the rest of the integral. At runtime a reflection costs a single textureLod and a texture
+// lookup instead of the hundreds of samples the integral needs.
+// The bake importance samples the GGX distribution. The sample directions depend on the roughness only, so
+// they are computed once per level in tangent space along with the source mipmap each one reads (a sample
+// stands for a solid angle of 1 / (pdf * samples), which is read from the level whose texels are about as
+// large; this removes the fireflies of a few samples hitting the sun). Texels are spread over all cores by
+// rows and each tap filters the four channels of a texel at once with SSE. The result is cached next to the
+// cubemap's cache and rebuilt whenever the faces or the settings change.
+class EnvironmentBaker
+{
+public:
+    // returns the textures, baked or read from cachePath. The source is decoded from the faces when it's not
+    // given and there's no valid cache.
+    static Environment Load(const vector<string> &faces, const string &cachePath,
+                            const EnvironmentSettings &settings = EnvironmentSettings(), const CubemapImage *source = NULL)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        EnvironmentBake bake;
+        bool cached = !cachePath.empty() && ReadCache(cachePath, faces, settings, bake);
+        if (!cached)
+        {
+            CubemapImage decoded;
+            if (!source || source->Pixels.empty())
+            {
+                if (!CubemapLoader::Decode(faces, decoded))
+                    return Environment();
+                source = &decoded;
+            }
+            if (!Bake(*source, settings, bake))
+                return Environment();
+            if (!cachePath.empty() && !WriteCache(cachePath, faces, settings, bake))
+                cout << "ERROR::ENVIRONMENT:: Could not write cache " << cachePath << endl;
+        }
+        else
+            cout << "Environment map read from cache in " << milliseconds(start) << " ms" << endl;
+        return Upload(bake);
+    }
+
+    // bakes the prefiltered map and the BRDF map on the CPU, no GL calls are made
+    static bool Bake(const CubemapImage &source, const EnvironmentSettings &settings, EnvironmentBake &bake)
+    {
+        if (source.Pixels.empty() || settings.Levels == 0 || settings.Samples == 0 || settings.LutSize <= 0 ||
+            settings.LutSamples == 0)
+        {
+            cout << "ERROR::ENVIRONMENT:: Nothing to bake" << endl;
+            return false;
+        }
+        // the source level the prefiltered map starts from, and the linear copies of it and the levels below
+        unsigned int baseLevel = 0;
+        while (baseLevel + 1 < source.Levels && CubemapImage::LevelSize(source.Size, baseLevel) > settings.Size)
+            baseLevel++;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        vector<SourceLevel> levels;
+        for (unsigned int level = baseLevel; level < source.Levels; level++)
+            levels.push_back(linearLevel(source, level, settings.Threads));
+        double convertMs = milliseconds(start);
+
+        CubemapImage &target = bake.Prefiltered;
+        target.Size = levels[0].Size;
+        target.Levels = 1;
+        while (target.Levels < settings.Levels && CubemapImage::LevelSize(target.Size, target.Levels) > 1 &&
+               target.Levels < levels.size())
+            target.Levels++;
+        target.Pixels.resize(6 * target.FaceBytes());
+
+        // roughness 0 is a mirror, its level is the source as is
+        for (unsigned int face = 0; face < 6; face++)
+            memcpy(&target.Pixels[target.Offset(face, 0)], &source.Pixels[source.Offset(face, baseLevel)], target.LevelBytes(0));
+
+        // the solid angle of a texel of the largest source level, which the sample footprints are compared to
+        float texelSolidAngle = 4.0f * (float)M_PI / (6.0f * levels[0].Size * levels[0].Size);
+        chrono::steady_clock::time_point filterStart = chrono::steady_clock::now();
+        for (unsigned int level = 1; level < target.Levels; level++)
+        {
+            float roughness = (float)level / (float)(target.Levels - 1);
+            vector<LobeSample> lobe = ggxLobe(roughness, settings.Samples, texelSolidAngle, (float)(levels.size() - 1));
+            int size = CubemapImage::LevelSize(target.Size, level);
+            parallelFor(6 * size, [&](size_t begin, size_t end, unsigned int) {
+                for (size_t row = begin; row < end; row++)
+                    prefilterRow(levels, lobe, target, level, row / size, row % size);
+            }, settings.Threads);
+        }
+        double filterMs = milliseconds(filterStart);
+
+        chrono::steady_clock::time_point lutStart = chrono::steady_clock::now();
+        bake.LutSize = settings.LutSize;
+        bake.BrdfLUT.resize((size_t)settings.LutSize * settings.LutSize * 2);
+        parallelFor(settings.LutSize, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t y = begin; y < end; y++)
+                integrateBrdfRow(bake, y, settings.LutSamples);
+        }, settings.Threads);
+
+        cout << "Environment map " << target.Size << "x" << target.Size << ", " << target.Levels << " levels, "
+             << settings.Samples << " samples: converted in " << convertMs << " ms, prefiltered in " << filterMs
+             << " ms, BRDF map in " << milliseconds(lutStart) << " ms on "
+             << (settings.Threads ? settings.Threads : defaultThreadCount()) << " threads" << endl;
+        return true;
+    }
+
+    static Environment Upload(const EnvironmentBake &bake)
+    {
+        Environment environment;
+        environment.PrefilteredMap = CubemapLoader::Upload(bake.Prefiltered);
+        environment.MaxLod = (float)(bake.Prefiltered.Levels - 1);
+
+        glGenTextures(1, &environment.BrdfLUT);
+        glBindTexture(GL_TEXTURE_2D, environment.BrdfLUT);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, bake.LutSize, bake.LutSize, 0, GL_RG, GL_FLOAT, &bake.BrdfLUT[0]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return environment;
+    }
+
+    // reads the cache into bake. fails quietly when there's no cache, and when it was made from different
+    // files or with different settings.
+    static bool ReadCache(const string &path, const vector<string> &faces, const EnvironmentSettings &settings,
+                          EnvironmentBake &bake)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+        CacheHeader header, expected(settings);
+        bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                     CubemapLoader::StampSources(faces, expected.Sources) &&
+                     memcmp(&header, &expected, offsetof(CacheHeader, PrefilteredSize)) == 0 &&
+                     memcmp(header.Sources, expected.Sources, sizeof(header.Sources)) == 0 &&
+                     header.PrefilteredSize > 0 && header.PrefilteredLevels > 0 && header.PrefilteredLevels <= 32;
+        if (valid)
+        {
+            bake.Prefiltered.Size = header.PrefilteredSize;
+            bake.Prefiltered.Levels = header.PrefilteredLevels;
+            bake.Prefiltered.Pixels.resize(6 * bake.Prefiltered.FaceBytes());
+            bake.LutSize = settings.LutSize;
+            bake.BrdfLUT.resize((size_t)bake.LutSize * bake.LutSize * 2);
+            valid = fread(&bake.Prefiltered.Pixels[0], 1, bake.Prefiltered.Pixels.size(), file) == bake.Prefiltered.Pixels.size() &&
+                    fread(&bake.BrdfLUT[0], sizeof(float), bake.BrdfLUT.size(), file) == bake.BrdfLUT.size();
+        }
+        fclose(file);
+        if (!valid)
+            cout << "Environment cache " << path << " is out of date, rebaking it" << endl;
+        return valid;
+    }
+
+    static bool WriteCache(const string &path, const vector<string> &faces, const EnvironmentSettings &settings,
+                           const EnvironmentBake &bake)
+    {
+        CacheHeader header(settings);
+        if (!CubemapLoader::StampSources(faces, header.Sources))
+            return false;
+        header.PrefilteredSize = bake.Prefiltered.Size;
+        header.PrefilteredLevels = bake.Prefiltered.Levels;
+        CacheFileWriter cache(path);
+        cache.Write(&header, 1);
+        cache.Write(bake.Prefiltered.Pixels);
+        cache.Write(bake.BrdfLUT);
+        return cache.Commit();
+    }
+
+private:
+    // a source level in linear color, RGBA floats, the six faces one after another
+    struct SourceLevel {
+        int Size;
+        vector<float> Texels;
+    };
+
+    // a GGX sample around N = (0, 0, 1): the light direction, its NdotL weight and the source level to read
+    struct LobeSample {
+        float L[3];
+        float Weight;
+        float Lod;
+    };
+
+    struct CacheHeader {
+        char Magic[8];
+        uint32_t Version;
+        int32_t Size;
+        uint32_t Levels;
+        uint32_t Samples;
+        int32_t LutSize;
+        uint32_t LutSamples;
+        // the header is compared with the expected one up to here
+        int32_t PrefilteredSize;
+        uint32_t PrefilteredLevels;
+        CubemapLoader::SourceStamp Sources[6];
+
+        CacheHeader(const EnvironmentSettings &settings = EnvironmentSettings())
+        {
+            memset(this, 0, sizeof(*this));
+            memcpy(Magic, "ENVMAP", 7);
+            Version = 1;
+            Size = settings.Size;
+            Levels = settings.Levels;
+            Samples = settings.Samples;
+            LutSize = settings.LutSize;
+            LutSamples = settings.LutSamples;
+        }
+    };
+
+    // four channels of a texel, added and scaled together
+#ifdef __SSE__
+    typedef __m128 Texel;
+    static inline Texel texelZero() { return _mm_setzero_ps(); }
+    static inline Texel texelLoad(const float *p) { return _mm_loadu_ps(p); }
+    static inline void texelStore(float *p, Texel t) { _mm_storeu_ps(p, t); }
+    static inline Texel texelMulAdd(Texel sum, Texel t, float w) { return _mm_add_ps(sum, _mm_mul_ps(t, _mm_set1_ps(w))); }
+    static inline Texel texelLerp(Texel a, Texel b, float w) { return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(w))); }
+#else
+    struct Texel {
+        float V[4];
+    };
+    static inline Texel texelZero() { Texel t = {{0.0f, 0.0f, 0.0f, 0.0f}}; return t; }
+    static inline Texel texelLoad(const float *p) { Texel t = {{p[0], p[1], p[2], p[3]}}; return t; }
+    static inline void texelStore(float *p, Texel t) { memcpy(p, t.V, sizeof(t.V)); }
+    static inline Texel texelMulAdd(Texel sum, Texel t, float w)
+    {
+        for (int c = 0; c < 4; c++)
+            sum.V[c] += t.V[c] * w;
+        return sum;
+    }
+    static inline Texel texelLerp(Texel a, Texel b, float w)
+    {
+        for (int c = 0; c < 4; c++)
+            a.V[c] += (b.V[c] - a.V[c]) * w;
+        return a;
+    }
+#endif
+
+    static float srgbToLinear(float c)
+    {
+        return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    static unsigned char linearToSrgb(float c)
+    {
+        c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+        return (unsigned char)(min(max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    // the colors are filtered in linear space, alpha is linear already
+    static SourceLevel linearLevel(const CubemapImage &source, unsigned int level, unsigned int threads)
+    {
+        float decode[256];
+        for (int i = 0; i < 256; i++)
+            decode[i] = srgbToLinear(i / 255.0f);
+        SourceLevel result;
+        result.Size = CubemapImage::LevelSize(source.Size, level);
+        size_t texels = (size_t)result.Size * result.Size;
+        result.Texels.resize(6 * texels * 4);
+        parallelFor(6, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t face = begin; face < end; face++)
+            {
+                const unsigned char *pixels = &source.Pixels[source.Offset(face, level)];
+                float *target = &result.Texels[face * texels * 4];
+                for (size_t i = 0; i < texels * 4; i += 4)
+                {
+                    target[i] = decode[pixels[i]];
+                    target[i + 1] = decode[pixels[i + 1]];
+                    target[i + 2] = decode[pixels[i + 2]];
+                    target[i + 3] = pixels[i + 3] / 255.0f;
+                }
+            }
+        }, threads);
+        return result;
+    }
+
+    // the i-th of count points of the Hammersley set
+    static void hammersley(unsigned int i, unsigned int count, float &x, float &y)
+    {
+        uint32_t bits = i;
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        x = (float)i / (float)count;
+        y = (float)bits * 2.3283064365386963e-10f;
+    }
+
+    // importance samples the GGX half vectors for roughness, reflects N = V around them and drops the samples
+    // below the horizon
+    static vector<LobeSample> ggxLobe(float roughness, unsigned int count, float texelSolidAngle, float maxLod)
+    {
+        float a = roughness * roughness;
+        vector<LobeSample> lobe;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            float x, y;
+            hammersley(i, count, x, y);
+            float phi = 2.0f * (float)M_PI * x;
+            float cosTheta = sqrtf((1.0f - y) / (1.0f + (a * a - 1.0f) * y));
+            float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+            float h[3] = {cosf(phi) * sinTheta, sinf(phi) * sinTheta, cosTheta};
+
+            LobeSample sample;
+            sample.L[0] = 2.0f * cosTheta * h[0];
+            sample.L[1] = 2.0f * cosTheta * h[1];
+            sample.L[2] = 2.0f * cosTheta * h[2] - 1.0f;
+            sample.Weight = sample.L[2];
+            if (sample.Weight <= 0.0f)
+                continue;
+            // with N = V the pdf of L is D / 4
+            float d = a * a / ((float)M_PI * powf(cosTheta * cosTheta * (a * a - 1.0f) + 1.0f, 2.0f));
+            float sampleSolidAngle = 1.0f / (count * d * 0.25f + 0.0001f);
+            sample.Lod = min(max(0.5f * log2f(sampleSolidAngle / texelSolidAngle), 0.0f), maxLod);
+            lobe.push_back(sample);
+        }
+        return lobe;
+    }
+
+    // the direction through the center of a texel, following the face layout of the GL spec
+    static void texelDirection(unsigned int face, int size, int x, int y, float *direction)
+    {
+        float s = 2.0f * (x + 0.5f) / size - 1.0f;
+        float t = 2.0f * (y + 0.5f) / size - 1.0f;
+        float faceDirections[6][3] = {
+            {1.0f, -t, -s}, {-1.0f, -t, s}, {s, 1.0f, t}, {s, -1.0f, -t}, {s, -t, 1.0f}, {-s, -t, -1.0f}
+        };
+        float length = sqrtf(1.0f + s * s + t * t);
+        for (int i = 0; i < 3; i++)
+            direction[i] = faceDirections[face][i] / length;
+    }
+
+    // bilinear lookup of one level, clamped to the face's edges
+    static Texel tap(const SourceLevel &level, unsigned int face, float u, float v)
+    {
+        int size = level.Size;
+        float x = min(max(u * size - 0.5f, 0.0f), (float)(size - 1));
+        float y = min(max(v * size - 0.5f, 0.0f), (float)(size - 1));
+        int x0 = (int)x, y0 = (int)y;
+        int x1 = min(x0 + 1, size - 1), y1 = min(y0 + 1, size - 1);
+        const float *texels = &level.Texels[(size_t)face * size * size * 4];
+        Texel top = texelLerp(texelLoad(texels + ((size_t)y0 * size + x0) * 4), texelLoad(texels + ((size_t)y0 * size + x1) * 4), x - x0);
+        Texel bottom = texelLerp(texelLoad(texels + ((size_t)y1 * size + x0) * 4), texelLoad(texels + ((size_t)y1 * size + x1) * 4), x - x0);
+        return texelLerp(top, bottom, y - y0);
+    }
+
+    // trilinear lookup in direction, picking the face the way GL does
+    static Texel sample(const vector<SourceLevel> &levels, const float *direction, float lod)
+    {
+        float ax = fabsf(direction[0]), ay = fabsf(direction[1]), az = fabsf(direction[2]);
+        unsigned int face;
+        float s, t, major;
+        if (ax >= ay && ax >= az)
+        {
+            face = direction[0] > 0.0f ? 0 : 1;
+            s = direction[0] > 0.0f ? -direction[2] : direction[2];
+            t = -direction[1];
+            major = ax;
+        }
+        else if (ay >= az)
+        {
+            face = direction[1] > 0.0f ? 2 : 3;
+            s = direction[0];
+            t = direction[1] > 0.0f ? direction[2] : -direction[2];
+            major = ay;
+        }
+        else
+        {
+            face = direction[2] > 0.0f ? 4 : 5;
+            s = direction[2] > 0.0f ? direction[0] : -direction[0];
+            t = -direction[1];
+            major = az;
+        }
+        float u = 0.5f * (s / major + 1.0f);
+        float v = 0.5f * (t / major + 1.0f);
+        unsigned int level = (unsigned int)lod;
+        float blend = lod - level;
+        Texel color = tap(levels[level], face, u, v);
+        if (blend > 0.0f && level + 1 < levels.size())
+            color = texelLerp(color, tap(levels[level + 1], face, u, v), blend);
+        return color;
+    }
+
+    static void prefilterRow(const vector<SourceLevel> &levels, const vector<LobeSample> &lobe, CubemapImage &target,
+                             unsigned int level, unsigned int face, int y)
+    {
+        int size = CubemapImage::LevelSize(target.Size, level);
+        unsigned char *pixels = &target.Pixels[target.Offset(face, level) + (size_t)y * size * 4];
+        for (int x = 0; x < size; x++)
+        {
+            float n[3];
+            texelDirection(face, size, x, y, n);
+            // tangent space to world space, around N
+            float up[3] = {0.0f, 0.0f, 1.0f};
+            if (fabsf(n[2]) > 0.999f)
+            {
+                up[0] = 1.0f;
+                up[2] = 0.0f;
+            }
+            float tangent[3] = {up[1] * n[2] - up[2] * n[1], up[2] * n[0] - up[0] * n[2], up[0] * n[1] - up[1] * n[0]};
+            float length = sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+            for (int i = 0; i < 3; i++)
+                tangent[i] /= length;
+            float bitangent[3] = {n[1] * tangent[2] - n[2] * tangent[1], n[2] * tangent[0] - n[0] * tangent[2],
+                                  n[0] * tangent[1] - n[1] * tangent[0]};
+
+            Texel sum = texelZero();
+            float weight = 0.0f;
+            for (size_t i = 0; i < lobe.size(); i++)
+            {
+                const LobeSample &l = lobe[i];
+                float direction[3];
+                for (int c = 0; c < 3; c++)
+                    direction[c] = tangent[c] * l.L[0] + bitangent[c] * l.L[1] + n[c] * l.L[2];
+                sum = texelMulAdd(sum, sample(levels, direction, l.Lod), l.Weight);
+                weight += l.Weight;
+            }
+            float color[4];
+            texelStore(color, sum);
+            for (int c = 0; c < 3; c++)
+                pixels[x * 4 + c] = linearToSrgb(color[c] / weight);
+            pixels[x * 4 + 3] = (unsigned char)(min(max(color[3] / weight, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    }
+
+    // the scale and bias to F0 of the specular integral for a row of roughness, over NdotV from 0 to 1
+    static void integrateBrdfRow(EnvironmentBake &bake, int y, unsigned int count)
+    {
+        float roughness = (y + 0.5f) / bake.LutSize;
+        float a = roughness * roughness;
+        float k = a / 2.0f;
+        for (int x = 0; x < bake.LutSize; x++)
+        {
+            float NdotV = (x + 0.5f) / bake.LutSize;
+            float v[3] = {sqrtf(1.0f - NdotV * NdotV), 0.0f, NdotV};
+            float scale = 0.0f, bias = 0.0f;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                float hx, hy;
+                hammersley(i, count, hx, hy);
+                float phi = 2.0f * (float)M_PI * hx;
+                float cosTheta = sqrtf((1.0f - hy) / (1.0f + (a * a - 1.0f) * hy));
+                float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+                float h[3] = {cosf(phi) * sinTheta, sinf(phi) * sinTheta, cosTheta};
+                float VdotH = v[0] * h[0] + v[1] * h[1] + v[2] * h[2];
+                float NdotL = 2.0f * VdotH * h[2] - v[2];
+                if (NdotL <= 0.0f)
+                    continue;
+                float NdotH = max(h[2], 0.0f);
+                VdotH = max(VdotH, 0.0f);
+                float G = NdotV / (NdotV * (1.0f - k) + k) * NdotL / (NdotL * (1.0f - k) + k);
+                float visibility = G * VdotH / (NdotH * NdotV);
+                float fresnel = powf(1.0f - VdotH, 5.0f);
+                scale += (1.0f - fresnel) * visibility;
+                bias += fresnel * visibility;
+            }
+            bake.BrdfLUT[((size_t)y * bake.LutSize + x) * 2] = scale / count;
+            bake.BrdfLUT[((size_t)y * bake.LutSize + x) * 2 + 1] = bias / count;
+        }
+    }
+
+    static double milliseconds(chrono::steady_clock::time_point since)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+    }
+};
+#endif
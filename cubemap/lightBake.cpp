@@ -0,0 +1,49 @@
+#include "basicScene.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// bakes basicScene's lightmap ahead of time, so the demo never bakes at startup. --threads bakes once per thread
+// count from 1 up to N to show how the bake scales.
+// usage: lightBake [--density N] [--samples N] [--bounces N] [--threads N] [--cache file]
+int main(int argc, char **argv)
+{
+	LightmapSettings settings;
+	string cachePath = "basicScene.lightcache";
+	unsigned int threads = 0;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--density") == 0)
+			settings.Density = (float)atof(argv[i + 1]);
+		else if (strcmp(argv[i], "--samples") == 0)
+			settings.Samples = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--bounces") == 0)
+			settings.Bounces = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--threads") == 0)
+			threads = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--cache") == 0)
+			cachePath = argv[i + 1];
+	}
+
+	LightmapScene scene = basicLightmapScene();
+	LightmapBake bake;
+	for (unsigned int t = threads ? 1 : 0; t <= threads; t++)
+	{
+		settings.Threads = t;
+		if (!LightmapBaker::Bake(scene, settings, bake))
+			return -1;
+	}
+	// the thread count doesn't change the result, the cache is valid for any of them
+	settings.Threads = 0;
+	if (!LightmapBaker::WriteCache(cachePath, scene, settings, bake))
+	{
+		cout << "ERROR::LIGHTMAP:: Could not write cache " << cachePath << endl;
+		return -1;
+	}
+	cout << "Wrote " << cachePath << endl;
+	return 0;
+}
@@ -0,0 +1,922 @@
+#ifndef LIGHTMAP_BAKER_H
+#define LIGHTMAP_BAKER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "cacheFile.h"
+#include "../meshBvh.h"
+#include "../parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+using namespace std;
+
+// A mesh as the baker sees it. A Model's Mesh maps straight onto it: the vertices' Position and Normal, and
+// its indices.
+struct LightmapMesh {
+    vector<glm::vec3> Positions;
+    vector<glm::vec3> Normals;
+    vector<unsigned int> Indices;   // three per triangle, empty when the vertices are a plain triangle list
+};
+
+// a mesh placed in the scene; every instance gets its own part of the lightmap
+struct LightmapInstance {
+    unsigned int Mesh;
+    glm::mat4 Model;
+    glm::vec3 Albedo;               // the diffuse color bounced light picks up, the average of the texture will do
+
+    LightmapInstance(unsigned int mesh = 0, glm::mat4 model = glm::mat4(), glm::vec3 albedo = glm::vec3(0.5f))
+        : Mesh(mesh), Model(model), Albedo(albedo)
+    {
+    }
+};
+
+// a static light, attenuated like the lights of the lighting chapters
+struct LightmapLight {
+    bool Directional;
+    glm::vec3 Position;             // point lights
+    glm::vec3 Direction;            // directional lights, the direction the light travels in
+    glm::vec3 Color;
+    float Size;                     // a point light's radius, or a directional light's angular radius in radians;
+                                    // it softens the shadows
+    float Constant;
+    float Linear;
+    float Quadratic;
+
+    static LightmapLight Sun(glm::vec3 direction, glm::vec3 color, float angle = 0.02f)
+    {
+        LightmapLight light = LightmapLight();
+        light.Directional = true;
+        light.Direction = glm::normalize(direction);
+        light.Color = color;
+        light.Size = angle;
+        light.Constant = 1.0f;
+        return light;
+    }
+
+    static LightmapLight Point(glm::vec3 position, glm::vec3 color, float radius = 0.1f, float constant = 1.0f,
+                               float linear = 0.09f, float quadratic = 0.032f)
+    {
+        LightmapLight light = LightmapLight();
+        light.Position = position;
+        light.Color = color;
+        light.Size = radius;
+        light.Constant = constant;
+        light.Linear = linear;
+        light.Quadratic = quadratic;
+        return light;
+    }
+};
+
+struct LightmapScene {
+    vector<LightmapMesh> Meshes;
+    vector<LightmapInstance> Instances;
+    vector<LightmapLight> Lights;
+    glm::vec3 Sky;                  // the light of rays that leave the scene
+};
+
+struct LightmapSettings {
+    float Density;                  // lightmap texels per unit
+    int Padding;                    // texels around each chart, filled from its edge
+    unsigned int Samples;           // paths per texel
+    unsigned int Bounces;           // surfaces a path bounces off, 0 bakes direct light and the sky only
+    float OcclusionDistance;        // a surface closer than this along a path's first ray occludes it
+    unsigned int Threads;           // 0 uses every core
+
+    LightmapSettings() : Density(16.0f), Padding(2), Samples(128), Bounces(2), OcclusionDistance(1.0f), Threads(0)
+    {
+    }
+};
+
+// the result of a bake: the lightmap as RGBA floats, the light reaching each texel in rgb and the ambient
+// occlusion in alpha, and each instance's lightmap coordinates, one per triangle corner in the order of the
+// mesh's triangles
+struct LightmapBake {
+    int Width, Height;
+    vector<float> Texels;
+    vector<vector<glm::vec2> > Coords;
+
+    LightmapBake() : Width(0), Height(0)
+    {
+    }
+};
+
+// Bakes the static lighting of a scene into one lightmap on the CPU, so drawing a static surface costs a single
+// texture lookup however many lights reach it.
+//  - Charts: every instance's triangles are grouped into charts, the connected triangles that face along the
+//    same major axis, and each chart is projected onto that axis' plane at Density texels per unit. The charts
+//    are packed into the atlas in shelves, tallest first, with Padding texels between them so bilinear
+//    filtering never reads a neighbour.
+//  - Texels: the triangles are rasterized in lightmap space; a texel gets the surface point under its center,
+//    or the nearest point of a triangle it overlaps at the edges.
+//  - Lighting: Samples paths start at each texel along cosine weighted directions. Every surface a path meets
+//    adds the direct light of all lights, with a shadow ray each (jittered over the light's size for soft
+//    shadows), and paths that leave the scene add the sky. The first ray of each path also gives the ambient
+//    occlusion. The results are in the units of the shaders: a surface's color is its albedo times the light.
+//  - Rays are traced through the 4-wide MeshBvh of ../meshBvh.h, the one model picking uses. Texels are spread
+//    over all cores, each with its own random sequence, so the result doesn't depend on the thread count.
+// Empty texels around the charts are filled from their neighbours last, and the lightmap is cached like the
+// environment map, rebuilt whenever the scene or the settings change.
+class LightmapBaker
+{
+public:
+    // returns the lightmap texture, baked or read from cachePath, and leaves the lightmap coordinates in bake
+    static unsigned int Load(const LightmapScene &scene, const string &cachePath, LightmapBake &bake,
+                             const LightmapSettings &settings = LightmapSettings())
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        bool cached = !cachePath.empty() && ReadCache(cachePath, scene, settings, bake);
+        if (!cached)
+        {
+            if (!Bake(scene, settings, bake))
+                return 0;
+            if (!cachePath.empty() && !WriteCache(cachePath, scene, settings, bake))
+                cout << "ERROR::LIGHTMAP:: Could not write cache " << cachePath << endl;
+        }
+        else
+            cout << "Lightmap read from cache in " << milliseconds(start) << " ms" << endl;
+        return Upload(bake);
+    }
+
+    // bakes the lightmap on the CPU, no GL calls are made
+    static bool Bake(const LightmapScene &scene, const LightmapSettings &settings, LightmapBake &bake)
+    {
+        if (scene.Instances.empty() || settings.Density <= 0.0f || settings.Samples == 0)
+        {
+            cout << "ERROR::LIGHTMAP:: Nothing to bake" << endl;
+            return false;
+        }
+        for (size_t i = 0; i < scene.Instances.size(); i++)
+        {
+            if (scene.Instances[i].Mesh >= scene.Meshes.size())
+            {
+                cout << "ERROR::LIGHTMAP:: Instance " << i << " uses a mesh that doesn't exist" << endl;
+                return false;
+            }
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        vector<Triangle> triangles;
+        vector<TriangleShading> shading;
+        vector<glm::vec3> positions;
+        worldTriangles(scene, triangles, shading, positions);
+        vector<Chart> charts;
+        if (!packCharts(scene, triangles, shading, settings, charts, bake))
+            return false;
+        vector<TexelSample> samples;
+        vector<unsigned char> coverage;
+        rasterize(triangles, shading, charts, bake, samples, coverage);
+        double chartMs = milliseconds(start);
+
+        chrono::steady_clock::time_point buildStart = chrono::steady_clock::now();
+        // every triangle's corners one after another, one mesh in the order of shading
+        vector<unsigned int> indices(positions.size());
+        for (size_t i = 0; i < indices.size(); i++)
+            indices[i] = (unsigned int)i;
+        MeshBvh4 bvh;
+        bvh.AddMesh(positions, indices);
+        bvh.Build(settings.Threads);
+        double buildMs = milliseconds(buildStart);
+
+        // the texels go out in a shuffled order, so every thread's share holds as many costly texels as cheap ones
+        uint32_t state = 0x9E3779B9u;
+        for (size_t i = samples.size(); i > 1; i--)
+            swap(samples[i - 1], samples[nextRandom(state) % i]);
+
+        chrono::steady_clock::time_point traceStart = chrono::steady_clock::now();
+        bake.Texels.assign((size_t)bake.Width * bake.Height * 4, 0.0f);
+        unsigned int threads = settings.Threads ? settings.Threads : defaultThreadCount();
+        vector<uint64_t> rays(threads, 0);
+        parallelFor(samples.size(), [&](size_t begin, size_t end, unsigned int thread) {
+            Tracer tracer(bvh, shading, scene, settings);
+            for (size_t i = begin; i < end; i++)
+                tracer.Texel(samples[i], &bake.Texels[(size_t)samples[i].Texel * 4]);
+            rays[thread] = tracer.Rays;
+        }, threads);
+        double traceMs = milliseconds(traceStart);
+        uint64_t totalRays = 0;
+        for (size_t i = 0; i < rays.size(); i++)
+            totalRays += rays[i];
+
+        dilate(bake, coverage, settings.Padding);
+        cout << "Lightmap " << bake.Width << "x" << bake.Height << ", " << charts.size() << " charts, "
+             << samples.size() << " texels, " << triangles.size() << " triangles, " << settings.Samples
+             << " samples: charts in " << chartMs << " ms, BVH in " << buildMs << " ms, traced in " << traceMs
+             << " ms (" << totalRays / 1000000.0 / max(traceMs / 1000.0, 1e-6) << " Mrays/s) on " << threads
+             << " threads" << endl;
+        return true;
+    }
+
+    static unsigned int Upload(const LightmapBake &bake)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, bake.Width, bake.Height, 0, GL_RGBA, GL_FLOAT, &bake.Texels[0]);
+        // no mipmaps, the smaller levels would mix neighbouring charts
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+    // reads the cache into bake. fails quietly when there's no cache, and when it was baked from another scene
+    // or with different settings.
+    static bool ReadCache(const string &path, const LightmapScene &scene, const LightmapSettings &settings,
+                          LightmapBake &bake)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+        CacheHeader header, expected(scene, settings);
+        bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                     memcmp(&header, &expected, offsetof(CacheHeader, Width)) == 0 &&
+                     header.Width > 0 && header.Height > 0 && header.Width <= MAX_SIZE && header.Height <= MAX_SIZE;
+        if (valid)
+        {
+            bake.Width = header.Width;
+            bake.Height = header.Height;
+            bake.Coords.resize(scene.Instances.size());
+            for (size_t i = 0; i < bake.Coords.size() && valid; i++)
+            {
+                bake.Coords[i].resize(cornerCount(scene.Meshes[scene.Instances[i].Mesh]));
+                valid = bake.Coords[i].empty() ||
+                        fread(&bake.Coords[i][0], sizeof(glm::vec2), bake.Coords[i].size(), file) == bake.Coords[i].size();
+            }
+            bake.Texels.resize((size_t)bake.Width * bake.Height * 4);
+            valid = valid && fread(&bake.Texels[0], sizeof(float), bake.Texels.size(), file) == bake.Texels.size();
+        }
+        fclose(file);
+        if (!valid)
+            cout << "Lightmap cache " << path << " is out of date, rebaking it" << endl;
+        return valid;
+    }
+
+    static bool WriteCache(const string &path, const LightmapScene &scene, const LightmapSettings &settings,
+                           const LightmapBake &bake)
+    {
+        CacheHeader header(scene, settings);
+        header.Width = bake.Width;
+        header.Height = bake.Height;
+        CacheFileWriter cache(path);
+        cache.Write(&header, 1);
+        for (size_t i = 0; i < bake.Coords.size(); i++)
+            cache.Write(bake.Coords[i]);
+        cache.Write(bake.Texels);
+        return cache.Commit();
+    }
+
+private:
+    static const int MAX_SIZE = 8192;
+
+    // a world space triangle as the intersection test wants it: a corner and the two edges from it
+    struct Triangle {
+        glm::vec3 V0, E1, E2;
+    };
+
+    // what a hit needs besides the distance
+    struct TriangleShading {
+        glm::vec3 N0, N1, N2;
+        glm::vec3 Albedo;
+        unsigned int Instance;
+        unsigned int Index;         // the triangle's index within its instance's mesh
+    };
+
+    // a texel to bake and the surface point it stands for
+    struct TexelSample {
+        glm::vec3 Position;
+        glm::vec3 Normal;
+        unsigned int Texel;
+    };
+
+    // the connected triangles of an instance facing along the same axis, and where they went in the atlas
+    struct Chart {
+        unsigned int Instance;
+        int Axis;                   // the axis the chart is projected along
+        vector<unsigned int> Triangles;
+        glm::vec2 Min;              // of the projected triangles, in texels
+        int Width, Height;          // in texels, padding included
+        int X, Y;                   // the corner in the atlas
+
+        Chart() : Instance(0), Axis(0), Min(1e30f), Width(0), Height(0), X(0), Y(0)
+        {
+        }
+    };
+
+    struct CacheHeader {
+        char Magic[8];
+        uint32_t Version;
+        float Density;
+        int32_t Padding;
+        uint32_t Samples;
+        uint32_t Bounces;
+        float OcclusionDistance;
+        uint64_t Scene;             // a hash of everything in the scene
+        // the header is compared with the expected one up to here
+        int32_t Width;
+        int32_t Height;
+
+        CacheHeader()
+        {
+            memset(this, 0, sizeof(*this));
+        }
+
+        CacheHeader(const LightmapScene &scene, const LightmapSettings &settings)
+        {
+            memset(this, 0, sizeof(*this));
+            memcpy(Magic, "LIGHTMAP", 8);
+            Version = 1;
+            Density = settings.Density;
+            Padding = settings.Padding;
+            Samples = settings.Samples;
+            Bounces = settings.Bounces;
+            OcclusionDistance = settings.OcclusionDistance;
+            Scene = sceneHash(scene);
+        }
+    };
+
+    // traces the paths of one thread's texels
+    class Tracer
+    {
+    public:
+        uint64_t Rays;
+
+        Tracer(const MeshBvh4 &bvh, const vector<TriangleShading> &shading, const LightmapScene &scene,
+               const LightmapSettings &settings)
+            : Rays(0), bvh(bvh), shading(shading), scene(scene), settings(settings)
+        {
+        }
+
+        // writes the light and the occlusion of a texel
+        void Texel(const TexelSample &sample, float *texel)
+        {
+            // each texel has its own sequence, and its paths start along a randomly shifted Hammersley set
+            uint32_t state = hash(sample.Texel + 1);
+            float shiftX = randomFloat(state), shiftY = randomFloat(state);
+            glm::vec3 light(0.0f);
+            unsigned int open = 0;
+            for (unsigned int s = 0; s < settings.Samples; s++)
+            {
+                light += direct(sample.Position, sample.Normal, state);
+                float x, y;
+                hammersley(s, settings.Samples, x, y);
+                x = fmodf(x + shiftX, 1.0f);
+                y = fmodf(y + shiftY, 1.0f);
+                float firstHit;
+                light += path(sample.Position, sample.Normal, cosineDirection(sample.Normal, x, y), state, firstHit);
+                if (firstHit >= settings.OcclusionDistance)
+                    open++;
+            }
+            light /= (float)settings.Samples;
+            texel[0] = light.x;
+            texel[1] = light.y;
+            texel[2] = light.z;
+            texel[3] = (float)open / (float)settings.Samples;
+        }
+
+    private:
+        static constexpr float RAY_OFFSET = 1e-3f;
+        const MeshBvh4 &bvh;
+        const vector<TriangleShading> &shading;
+        const LightmapScene &scene;
+        const LightmapSettings &settings;
+
+        // the light a path brings back from the direction it starts in, and how far its first ray went
+        glm::vec3 path(glm::vec3 position, glm::vec3 normal, glm::vec3 direction, uint32_t &state, float &firstHit)
+        {
+            glm::vec3 light(0.0f), throughput(1.0f);
+            firstHit = 1e30f;
+            for (unsigned int bounce = 0; ; bounce++)
+            {
+                BvhRay ray(position + normal * RAY_OFFSET, direction);
+                BvhHit hit;
+                Rays++;
+                if (!bvh.Intersect(ray, hit))
+                {
+                    light += throughput * scene.Sky;
+                    break;
+                }
+                if (bounce == 0)
+                    firstHit = hit.Distance;
+                if (bounce == settings.Bounces)
+                    break;
+                const TriangleShading &surface = shading[hit.Triangle];
+                position = ray.Origin + direction * hit.Distance;
+                normal = glm::normalize(surface.N0 * (1.0f - hit.U - hit.V) + surface.N1 * hit.U + surface.N2 * hit.V);
+                // the back of a surface bounces light as well, it's just never seen
+                if (glm::dot(normal, direction) > 0.0f)
+                    normal = -normal;
+                throughput *= surface.Albedo;
+                light += throughput * direct(position, normal, state);
+                direction = cosineDirection(normal, randomFloat(state), randomFloat(state));
+            }
+            return light;
+        }
+
+        // the light of every light reaching a surface point, one shadow ray each
+        glm::vec3 direct(const glm::vec3 &position, const glm::vec3 &normal, uint32_t &state)
+        {
+            glm::vec3 light(0.0f);
+            glm::vec3 origin = position + normal * RAY_OFFSET;
+            for (size_t i = 0; i < scene.Lights.size(); i++)
+            {
+                const LightmapLight &l = scene.Lights[i];
+                BvhRay ray;
+                ray.Origin = origin;
+                float attenuation = 1.0f;
+                if (l.Directional)
+                {
+                    ray.Direction = glm::normalize(-l.Direction + randomInSphere(state) * tanf(l.Size));
+                    ray.Far = 1e30f;
+                }
+                else
+                {
+                    glm::vec3 offset = l.Position + randomInSphere(state) * l.Size - origin;
+                    float distance = glm::length(offset);
+                    if (distance <= 0.0f)
+                        continue;
+                    ray.Direction = offset / distance;
+                    ray.Far = distance;
+                    attenuation = 1.0f / (l.Constant + l.Linear * distance + l.Quadratic * distance * distance);
+                }
+                float diffuse = glm::dot(normal, ray.Direction);
+                if (diffuse <= 0.0f)
+                    continue;
+                Rays++;
+                if (!bvh.Occluded(ray))
+                    light += l.Color * diffuse * attenuation;
+            }
+            return light;
+        }
+
+        // a direction around normal, more of them closer to it, following the cosine
+        static glm::vec3 cosineDirection(const glm::vec3 &normal, float x, float y)
+        {
+            float phi = 2.0f * (float)M_PI * x;
+            float r = sqrtf(y);
+            glm::vec3 tangent = fabsf(normal.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+            tangent = glm::normalize(glm::cross(tangent, normal));
+            glm::vec3 bitangent = glm::cross(normal, tangent);
+            return glm::normalize(tangent * (r * cosf(phi)) + bitangent * (r * sinf(phi)) + normal * sqrtf(max(0.0f, 1.0f - y)));
+        }
+
+        static glm::vec3 randomInSphere(uint32_t &state)
+        {
+            for (;;)
+            {
+                glm::vec3 p(randomFloat(state) * 2.0f - 1.0f, randomFloat(state) * 2.0f - 1.0f, randomFloat(state) * 2.0f - 1.0f);
+                if (glm::dot(p, p) <= 1.0f)
+                    return p;
+            }
+        }
+    };
+
+    static double milliseconds(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // xorshift, enough for sampling
+    static uint32_t nextRandom(uint32_t &state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    static float randomFloat(uint32_t &state)
+    {
+        return (nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+    }
+
+    static uint32_t hash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7FEB352Du;
+        x ^= x >> 15;
+        x *= 0x846CA68Bu;
+        x ^= x >> 16;
+        return x ? x : 1u;
+    }
+
+    // the i-th of count points of the Hammersley set
+    static void hammersley(unsigned int i, unsigned int count, float &x, float &y)
+    {
+        uint32_t bits = i;
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        x = (float)i / (float)count;
+        y = (float)bits * 2.3283064365386963e-10f;
+    }
+
+    static size_t cornerCount(const LightmapMesh &mesh)
+    {
+        return (mesh.Indices.empty() ? mesh.Positions.size() : mesh.Indices.size()) / 3 * 3;
+    }
+
+    static unsigned int corner(const LightmapMesh &mesh, size_t i)
+    {
+        return mesh.Indices.empty() ? (unsigned int)i : mesh.Indices[i];
+    }
+
+    // FNV-1a over the bytes of everything that changes the bake
+    static void hashBytes(uint64_t &h, const void *data, size_t size)
+    {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            h ^= bytes[i];
+            h *= 1099511628211ull;
+        }
+    }
+
+    static uint64_t sceneHash(const LightmapScene &scene)
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < scene.Meshes.size(); i++)
+        {
+            const LightmapMesh &mesh = scene.Meshes[i];
+            if (!mesh.Positions.empty())
+                hashBytes(h, &mesh.Positions[0], mesh.Positions.size() * sizeof(glm::vec3));
+            if (!mesh.Normals.empty())
+                hashBytes(h, &mesh.Normals[0], mesh.Normals.size() * sizeof(glm::vec3));
+            if (!mesh.Indices.empty())
+                hashBytes(h, &mesh.Indices[0], mesh.Indices.size() * sizeof(unsigned int));
+        }
+        for (size_t i = 0; i < scene.Instances.size(); i++)
+        {
+            const LightmapInstance &instance = scene.Instances[i];
+            hashBytes(h, &instance.Mesh, sizeof(instance.Mesh));
+            hashBytes(h, &instance.Model[0][0], sizeof(float) * 16);
+            hashBytes(h, &instance.Albedo[0], sizeof(float) * 3);
+        }
+        for (size_t i = 0; i < scene.Lights.size(); i++)
+        {
+            const LightmapLight &l = scene.Lights[i];
+            float values[15] = {l.Directional ? 1.0f : 0.0f, l.Position.x, l.Position.y, l.Position.z, l.Direction.x,
+                                l.Direction.y, l.Direction.z, l.Color.x, l.Color.y, l.Color.z, l.Size, l.Constant,
+                                l.Linear, l.Quadratic, 0.0f};
+            hashBytes(h, values, sizeof(values));
+        }
+        hashBytes(h, &scene.Sky[0], sizeof(float) * 3);
+        return h;
+    }
+
+    // every instance's triangles in world space, in the order of the instances and their meshes' triangles, with
+    // their corners one after another in positions
+    static void worldTriangles(const LightmapScene &scene, vector<Triangle> &triangles, vector<TriangleShading> &shading,
+                               vector<glm::vec3> &positions)
+    {
+        for (size_t i = 0; i < scene.Instances.size(); i++)
+        {
+            const LightmapInstance &instance = scene.Instances[i];
+            const LightmapMesh &mesh = scene.Meshes[instance.Mesh];
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(instance.Model)));
+            size_t corners = cornerCount(mesh);
+            for (size_t c = 0; c < corners; c += 3)
+            {
+                glm::vec3 p[3], n[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int v = corner(mesh, c + k);
+                    p[k] = glm::vec3(instance.Model * glm::vec4(mesh.Positions[v], 1.0f));
+                    n[k] = v < mesh.Normals.size() ? glm::normalize(normalMatrix * mesh.Normals[v]) : glm::vec3(0.0f);
+                }
+                // without normals the faces are flat, facing the way they wind
+                glm::vec3 face = glm::cross(p[1] - p[0], p[2] - p[0]);
+                if (glm::dot(face, face) > 0.0f)
+                    face = glm::normalize(face);
+                for (int k = 0; k < 3; k++)
+                    if (glm::dot(n[k], n[k]) == 0.0f)
+                        n[k] = face;
+
+                Triangle t = {p[0], p[1] - p[0], p[2] - p[0]};
+                TriangleShading s = {n[0], n[1], n[2], instance.Albedo, (unsigned int)i, (unsigned int)(c / 3)};
+                triangles.push_back(t);
+                shading.push_back(s);
+                positions.insert(positions.end(), p, p + 3);
+            }
+        }
+    }
+
+    // the axis a triangle is projected along, from its normal: 0 to 2 for +x, +y, +z and 3 to 5 for -x, -y, -z
+    static int majorAxis(const Triangle &t, const TriangleShading &s)
+    {
+        glm::vec3 n = glm::cross(t.E1, t.E2);
+        if (glm::dot(n, n) == 0.0f)
+            n = s.N0 + s.N1 + s.N2;
+        // a flipped winding shouldn't put a triangle on the other side from its normals
+        if (glm::dot(n, s.N0 + s.N1 + s.N2) < 0.0f)
+            n = -n;
+        glm::vec3 a = glm::abs(n);
+        int axis = a.x >= a.y && a.x >= a.z ? 0 : (a.y >= a.z ? 1 : 2);
+        return n[axis] < 0.0f ? axis + 3 : axis;
+    }
+
+    // a corner position rounded to a grid, to find the triangles that share an edge
+    struct GridPoint {
+        int32_t X, Y, Z;
+
+        bool operator<(const GridPoint &o) const
+        {
+            return X != o.X ? X < o.X : (Y != o.Y ? Y < o.Y : Z < o.Z);
+        }
+    };
+
+    static GridPoint gridPoint(const glm::vec3 &p)
+    {
+        GridPoint g = {(int32_t)floorf(p.x * 4096.0f + 0.5f), (int32_t)floorf(p.y * 4096.0f + 0.5f),
+                       (int32_t)floorf(p.z * 4096.0f + 0.5f)};
+        return g;
+    }
+
+    static unsigned int findRoot(vector<unsigned int> &parents, unsigned int i)
+    {
+        while (parents[i] != i)
+        {
+            parents[i] = parents[parents[i]];
+            i = parents[i];
+        }
+        return i;
+    }
+
+    // the position of a triangle's corner in its chart, in texels from the chart's corner
+    static glm::vec2 project(const glm::vec3 &p, int axis, float density)
+    {
+        int a = axis % 3;
+        return glm::vec2(p[(a + 1) % 3], p[(a + 2) % 3]) * density;
+    }
+
+    static glm::vec3 corner(const Triangle &t, int k)
+    {
+        return k == 0 ? t.V0 : (k == 1 ? t.V0 + t.E1 : t.V0 + t.E2);
+    }
+
+    // builds the charts, packs them and writes the lightmap coordinates
+    static bool packCharts(const LightmapScene &scene, const vector<Triangle> &triangles,
+                           const vector<TriangleShading> &shading, const LightmapSettings &settings,
+                           vector<Chart> &charts, LightmapBake &bake)
+    {
+        // the triangles of each instance were added one after another, join the neighbours facing the same way
+        vector<int> axes(triangles.size());
+        vector<unsigned int> parents(triangles.size());
+        vector<unsigned int> firstOf(scene.Instances.size() + 1, 0);
+        for (size_t i = 0; i < scene.Instances.size(); i++)
+            firstOf[i + 1] = firstOf[i] + (unsigned int)(cornerCount(scene.Meshes[scene.Instances[i].Mesh]) / 3);
+        for (size_t i = 0; i < triangles.size(); i++)
+        {
+            axes[i] = majorAxis(triangles[i], shading[i]);
+            parents[i] = (unsigned int)i;
+        }
+        for (size_t i = 0; i < scene.Instances.size(); i++)
+        {
+            map<pair<GridPoint, GridPoint>, unsigned int> edges;
+            for (unsigned int t = firstOf[i]; t < firstOf[i + 1]; t++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    GridPoint a = gridPoint(corner(triangles[t], k)), b = gridPoint(corner(triangles[t], (k + 1) % 3));
+                    pair<GridPoint, GridPoint> key = b < a ? make_pair(b, a) : make_pair(a, b);
+                    map<pair<GridPoint, GridPoint>, unsigned int>::iterator found = edges.find(key);
+                    if (found == edges.end())
+                        edges[key] = t;
+                    else if (axes[found->second] == axes[t])
+                        parents[findRoot(parents, t)] = findRoot(parents, found->second);
+                }
+            }
+        }
+
+        map<unsigned int, unsigned int> chartOf;
+        for (unsigned int t = 0; t < triangles.size(); t++)
+        {
+            unsigned int root = findRoot(parents, t);
+            map<unsigned int, unsigned int>::iterator found = chartOf.find(root);
+            if (found == chartOf.end())
+            {
+                found = chartOf.insert(make_pair(root, (unsigned int)charts.size())).first;
+                Chart chart;
+                chart.Instance = shading[t].Instance;
+                chart.Axis = axes[t];
+                charts.push_back(chart);
+            }
+            charts[found->second].Triangles.push_back(t);
+        }
+
+        // each chart's size in texels, then shelves of charts, tallest first, in the smallest square atlas they fit
+        size_t area = 0;
+        for (size_t c = 0; c < charts.size(); c++)
+        {
+            Chart &chart = charts[c];
+            glm::vec2 maxCorner(-1e30f);
+            for (size_t i = 0; i < chart.Triangles.size(); i++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    glm::vec2 p = project(corner(triangles[chart.Triangles[i]], k), chart.Axis, settings.Density);
+                    chart.Min = glm::min(chart.Min, p);
+                    maxCorner = glm::max(maxCorner, p);
+                }
+            }
+            chart.Width = (int)ceilf(maxCorner.x - chart.Min.x) + 1 + 2 * settings.Padding;
+            chart.Height = (int)ceilf(maxCorner.y - chart.Min.y) + 1 + 2 * settings.Padding;
+            area += (size_t)chart.Width * chart.Height;
+        }
+        vector<unsigned int> order(charts.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = (unsigned int)i;
+        sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+            return charts[a].Height != charts[b].Height ? charts[a].Height > charts[b].Height : a < b;
+        });
+        int size = 64;
+        while ((size_t)size * size < area && size < MAX_SIZE)
+            size *= 2;
+        for (;;)
+        {
+            int x = 0, y = 0, shelf = 0;
+            bool fits = true;
+            for (size_t i = 0; i < order.size() && fits; i++)
+            {
+                Chart &chart = charts[order[i]];
+                if (x + chart.Width > size)
+                {
+                    x = 0;
+                    y += shelf;
+                    shelf = 0;
+                }
+                chart.X = x;
+                chart.Y = y;
+                x += chart.Width;
+                shelf = max(shelf, chart.Height);
+                fits = chart.Width <= size && y + chart.Height <= size;
+            }
+            if (fits)
+                break;
+            if (size >= MAX_SIZE)
+            {
+                cout << "ERROR::LIGHTMAP:: The charts don't fit into " << MAX_SIZE << "x" << MAX_SIZE
+                     << " texels, lower the density" << endl;
+                return false;
+            }
+            size *= 2;
+        }
+        bake.Width = bake.Height = size;
+
+        bake.Coords.assign(scene.Instances.size(), vector<glm::vec2>());
+        for (size_t i = 0; i < scene.Instances.size(); i++)
+            bake.Coords[i].resize((firstOf[i + 1] - firstOf[i]) * 3);
+        for (size_t c = 0; c < charts.size(); c++)
+        {
+            const Chart &chart = charts[c];
+            for (size_t i = 0; i < chart.Triangles.size(); i++)
+            {
+                unsigned int t = chart.Triangles[i];
+                for (int k = 0; k < 3; k++)
+                {
+                    glm::vec2 texel = chartTexel(chart, corner(triangles[t], k), settings);
+                    bake.Coords[chart.Instance][shading[t].Index * 3 + k] =
+                        texel / glm::vec2((float)bake.Width, (float)bake.Height);
+                }
+            }
+        }
+        return true;
+    }
+
+    // a world position's place in the atlas, in texels
+    static glm::vec2 chartTexel(const Chart &chart, const glm::vec3 &p, const LightmapSettings &settings)
+    {
+        return project(p, chart.Axis, settings.Density) - chart.Min +
+               glm::vec2((float)(chart.X + settings.Padding) + 0.5f, (float)(chart.Y + settings.Padding) + 0.5f);
+    }
+
+    // finds the surface point of every texel the charts cover. coverage is 2 for texels whose center lies on a
+    // triangle, 1 for texels that only overlap one and 0 for empty texels.
+    static void rasterize(const vector<Triangle> &triangles, const vector<TriangleShading> &shading,
+                          const vector<Chart> &charts, const LightmapBake &bake, vector<TexelSample> &samples,
+                          vector<unsigned char> &coverage)
+    {
+        coverage.assign((size_t)bake.Width * bake.Height, 0);
+        vector<int> sampleOf((size_t)bake.Width * bake.Height, -1);
+        for (size_t c = 0; c < charts.size(); c++)
+        {
+            const Chart &chart = charts[c];
+            for (size_t i = 0; i < chart.Triangles.size(); i++)
+            {
+                unsigned int t = chart.Triangles[i];
+                glm::vec2 p[3];
+                for (int k = 0; k < 3; k++)
+                    p[k] = bake.Coords[chart.Instance][shading[t].Index * 3 + k] *
+                           glm::vec2((float)bake.Width, (float)bake.Height);
+                float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+                if (fabsf(area) < 1e-12f)
+                    continue;
+                int x0 = max(0, (int)floorf(min(p[0].x, min(p[1].x, p[2].x))) - 1);
+                int y0 = max(0, (int)floorf(min(p[0].y, min(p[1].y, p[2].y))) - 1);
+                int x1 = min(bake.Width - 1, (int)ceilf(max(p[0].x, max(p[1].x, p[2].x))) + 1);
+                int y1 = min(bake.Height - 1, (int)ceilf(max(p[0].y, max(p[1].y, p[2].y))) + 1);
+                for (int y = y0; y <= y1; y++)
+                {
+                    for (int x = x0; x <= x1; x++)
+                    {
+                        glm::vec2 center(x + 0.5f, y + 0.5f);
+                        float b1 = ((center.x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (center.y - p[0].y)) / area;
+                        float b2 = ((p[1].x - p[0].x) * (center.y - p[0].y) - (center.x - p[0].x) * (p[1].y - p[0].y)) / area;
+                        float b0 = 1.0f - b1 - b2;
+                        unsigned char covered = 2;
+                        if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f)
+                        {
+                            // outside: take the triangle's point nearest the center, if it lies within the texel
+                            b0 = max(b0, 0.0f);
+                            b1 = max(b1, 0.0f);
+                            b2 = max(b2, 0.0f);
+                            float sum = b0 + b1 + b2;
+                            b0 /= sum;
+                            b1 /= sum;
+                            b2 /= sum;
+                            glm::vec2 nearest = p[0] * b0 + p[1] * b1 + p[2] * b2;
+                            if (fabsf(nearest.x - center.x) > 0.5f || fabsf(nearest.y - center.y) > 0.5f)
+                                continue;
+                            covered = 1;
+                        }
+                        size_t index = (size_t)y * bake.Width + x;
+                        if (coverage[index] >= covered)
+                            continue;
+                        coverage[index] = covered;
+
+                        const Triangle &tri = triangles[t];
+                        const TriangleShading &s = shading[t];
+                        TexelSample sample;
+                        sample.Position = tri.V0 + tri.E1 * b1 + tri.E2 * b2;
+                        sample.Normal = glm::normalize(s.N0 * b0 + s.N1 * b1 + s.N2 * b2);
+                        sample.Texel = (unsigned int)index;
+                        if (sampleOf[index] < 0)
+                        {
+                            sampleOf[index] = (int)samples.size();
+                            samples.push_back(sample);
+                        }
+                        else
+                            samples[sampleOf[index]] = sample;
+                    }
+                }
+            }
+        }
+    }
+
+    // fills the empty texels next to covered ones with the average of their covered neighbours, passes times
+    static void dilate(LightmapBake &bake, vector<unsigned char> &coverage, int passes)
+    {
+        vector<unsigned char> next;
+        for (int pass = 0; pass < passes; pass++)
+        {
+            next = coverage;
+            for (int y = 0; y < bake.Height; y++)
+            {
+                for (int x = 0; x < bake.Width; x++)
+                {
+                    size_t index = (size_t)y * bake.Width + x;
+                    if (coverage[index])
+                        continue;
+                    float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                    int count = 0;
+                    for (int dy = -1; dy <= 1; dy++)
+                    {
+                        for (int dx = -1; dx <= 1; dx++)
+                        {
+                            int nx = x + dx, ny = y + dy;
+                            if (nx < 0 || ny < 0 || nx >= bake.Width || ny >= bake.Height)
+                                continue;
+                            size_t neighbour = (size_t)ny * bake.Width + nx;
+                            if (!coverage[neighbour])
+                                continue;
+                            for (int c = 0; c < 4; c++)
+                                sum[c] += bake.Texels[neighbour * 4 + c];
+                            count++;
+                        }
+                    }
+                    if (count == 0)
+                        continue;
+                    for (int c = 0; c < 4; c++)
+                        bake.Texels[index * 4 + c] = sum[c] / count;
+                    next[index] = 1;
+                }
+            }
+            coverage.swap(next);
+        }
+    }
+};
+#endif
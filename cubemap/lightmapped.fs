@@ -0,0 +1,18 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec2 LightmapCoords;
+
+uniform sampler2D texture1;
+// the baked light in rgb and the ambient occlusion in alpha, see lightmapBaker.h
+uniform sampler2D lightmap;
+// light that isn't baked, like the light of moving objects, only reaches into the corners as far as the AO lets it
+uniform float ambient;
+
+void main()
+{
+    vec4 baked = texture(lightmap, LightmapCoords);
+    vec3 albedo = texture(texture1, TexCoords).rgb;
+    FragColor = vec4(albedo * (baked.rgb + ambient * baked.a), 1.0);
+}
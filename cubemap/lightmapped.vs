@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in vec2 aLightmapCoords;
+
+out vec2 TexCoords;
+out vec2 LightmapCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    LightmapCoords = aLightmapCoords;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
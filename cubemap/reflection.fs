@@ -5,12 +5,23 @@ in vec3 Normal;
 in vec3 Position;
 
 uniform vec3 cameraPos;
-uniform samplerCube skybox;
+// baked by environmentBaker.h: the skybox convolved with GGX lobes of increasing roughness, one per level,
+// and the BRDF's scale and bias to F0 by (NdotV, roughness)
+uniform samplerCube prefilteredMap;
+uniform sampler2D brdfLUT;
+uniform float roughness;
+uniform float maxLod;
+
+// reflectance of polished silver at normal incidence
+const vec3 F0 = vec3(0.95, 0.93, 0.88);
 
 void main()
 {
-	vec3 I = normalize(Position - cameraPos);
-	vec3 R = reflect(I, normalize(Normal));
-	FragColor = vec4(texture(skybox, R).rgb, 1.0);
+	vec3 N = normalize(Normal);
+	vec3 V = normalize(cameraPos - Position);
+	vec3 R = reflect(-V, N);
+	vec3 prefiltered = textureLod(prefilteredMap, R, roughness * maxLod).rgb;
+	vec2 brdf = texture(brdfLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
+	FragColor = vec4(prefiltered * (F0 * brdf.x + brdf.y), 1.0);
 
 }
@@ -8,9 +8,14 @@
 
 #include "camera.h"
 #include "shader_m.h"
+#include "cubemapLoader.h"
+#include "environmentBaker.h"
 
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include "../headless.h"
 
 using namespace std;
 
@@ -19,7 +24,6 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 unsigned int loadTexture(string path);
-unsigned int loadCubemap(vector<string> faces);
 
 // settings
 const unsigned int SCR_WIDTH = 1280;
@@ -35,47 +39,66 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
+// roughness of the reflecting cube, UP and DOWN change it
+float roughness = 0.3f;
+
+int main(int argc, char **argv)
 {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
-#endif
-
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
+    // --headless renders offscreen instead, see headless.h
+    Headless headless(argc, argv);
+    for (int i = 1; i + 1 < argc; i++)
+        if (strcmp(argv[i], "--roughness") == 0)
+            roughness = (float)atof(argv[i + 1]);
+    GLFWwindow* window = NULL;
+    if (headless.Enabled)
     {
-        cout << "Failed to create GLFW window" << endl;
-        glfwTerminate();
-        return -1;
+        if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+    else
+    {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    #ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
+    #endif
+
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL)
+        {
+            cout << "Failed to create GLFW window" << endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
 
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        cout << "Failed to initialize GLAD" << endl;
-        return -1;
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            cout << "Failed to initialize GLAD" << endl;
+            return -1;
+        }
     }
 
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
+    // filter across cubemap face edges, the smaller mipmaps would show seams otherwise
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
     // build and compile shaders
     // -------------------------
@@ -195,6 +218,7 @@ int main()
 
     // load textures
     // -------------
+    // cubemap faces, in the order +X (right), -X (left), +Y (top), -Y (bottom), +Z (front), -Z (back)
   vector<string> faces;
         faces.push_back("right.jpg");
         faces.push_back("left.jpg");
@@ -203,29 +227,39 @@ int main()
         faces.push_back("front.jpg");
         faces.push_back("back.jpg");
 
-    unsigned int cubemapTexture = loadCubemap(faces);
+    // faces are decoded in parallel the first time, later runs load the decoded faces and mipmaps from the cache
+    CubemapImage source;
+    unsigned int cubemapTexture = CubemapLoader::Load(faces, "skybox.cubecache", &source);
+    // the reflections are prefiltered from the same faces, baked once and cached as well (or ahead of time by envBake)
+    Environment environment = EnvironmentBaker::Load(faces, "skybox.envcache", EnvironmentSettings(), &source);
+    source = CubemapImage();
 
     // shader configuration
     // --------------------
     shader.use();
-    shader.setInt("texture1", 0);
+    shader.setInt("prefilteredMap", 0);
+    shader.setInt("brdfLUT", 1);
+    shader.setFloat("maxLod", environment.MaxLod);
 
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window))
+    while (headless.Running(window))
     {
         // per-frame time logic
         // --------------------
-        float currentFrame = glfwGetTime();
+        float currentFrame = headless.Time();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         // input
         // -----
-        processInput(window);
+        if (headless.Enabled)
+            headless.MoveCamera(camera);
+        else
+            processInput(window);
 
         // render
         // ------
@@ -237,15 +271,18 @@ int main()
         glm::mat4 model = glm::mat4();
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	model = glm::rotate(model, (float)glfwGetTime(), glm::vec3(1.0, 1.0, 1.0));
+	model = glm::rotate(model, (float)headless.Time(), glm::vec3(1.0, 1.0, 1.0));
         shader.setMat4("model", model);
         shader.setMat4("view", view);
         shader.setMat4("projection", projection);
         shader.setVec3("cameraPos", camera.Position);
+        shader.setFloat("roughness", roughness);
         // cubes
         glBindVertexArray(cubeVAO);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, environment.PrefilteredMap);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, environment.BrdfLUT);
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
 
@@ -265,8 +302,7 @@ int main()
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        headless.SwapBuffers(window);
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
@@ -275,6 +311,8 @@ int main()
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &cubeVBO);
     glDeleteBuffers(1, &skyboxVAO);
+    glDeleteTextures(1, &environment.PrefilteredMap);
+    glDeleteTextures(1, &environment.BrdfLUT);
 
     glfwTerminate();
     return 0;
@@ -295,6 +333,11 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+        roughness = min(roughness + deltaTime * 0.5f, 1.0f);
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+        roughness = max(roughness - deltaTime * 0.5f, 0.0f);
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -372,41 +415,3 @@ unsigned int loadTexture(string path)
     return textureID;
 }
 
-// loads a cubemap texture from 6 individual texture faces
-// order:
-// +X (right)
-// -X (left)
-// +Y (top)
-// -Y (bottom)
-// +Z (front)
-// -Z (back)
-// -------------------------------------------------------
-unsigned int loadCubemap(vector<string> faces)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            cout << "Cubemap texture failed to load at path: " << faces[i] << endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}
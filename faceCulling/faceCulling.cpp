@@ -10,6 +10,7 @@
 #include "shader_m.h"
 
 #include <iostream>
+#include "../headless.h"
 
 using namespace std;
 
@@ -33,37 +34,48 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 
-int main() {
-	// glfw
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	#ifdef __APPLE___
-		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	#endif
-
-	GLFWwindow * window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-	if (window == NULL)
+int main(int argc, char **argv) {
+	// --headless renders offscreen instead, see headless.h
+	Headless headless(argc, argv);
+	GLFWwindow* window = NULL;
+	if (headless.Enabled)
 	{
-		cout << "Failed to create GLFW window" << endl;
-		glfwTerminate();
-		return -1;
+		if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT))
+			return -1;
 	}
-	glfwMakeContextCurrent(window);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	glfwSetCursorPosCallback(window, mouse_callback);
-	glfwSetScrollCallback(window, scroll_callback);
-
-	// GLFW set to capture mouse
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-	// glad: load all OpenGL function pointers
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	else
 	{
-		cout << "Failed to initialize GLAD" << endl;
-		return -1;
+		// glfw
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+		#ifdef __APPLE___
+			glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		#endif
+
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+		if (window == NULL)
+		{
+			cout << "Failed to create GLFW window" << endl;
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		glfwSetCursorPosCallback(window, mouse_callback);
+		glfwSetScrollCallback(window, scroll_callback);
+
+		// GLFW set to capture mouse
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+		// glad: load all OpenGL function pointers
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			cout << "Failed to initialize GLAD" << endl;
+			return -1;
+		}
 	}
 
 	// Configure global openGL state
@@ -168,15 +180,18 @@ float cubeVertices[] = {
 	shader.setInt("texture1", 0);
 
 	// render loop
-	while(!glfwWindowShouldClose(window))
+	while (headless.Running(window))
 	{
 		// per-frame time logic
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless.Time();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		// input
-		processInput(window);
+		if (headless.Enabled)
+			headless.MoveCamera(camera);
+		else
+			processInput(window);
 
 		// render
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -202,8 +217,7 @@ float cubeVertices[] = {
     glDrawArrays(GL_TRIANGLES, 0, 36);
 
 		// glfw: Swap buffers and poll IO events
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		headless.SwapBuffers(window);
 	}
 
 	// De-allocate resources
@@ -0,0 +1,130 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// Picks the internal render resolution (as a fraction of the window size) that keeps the GPU time of a frame
+// close to a target. Each frame's GPU work is timed with a GL_TIME_ELAPSED query from a small ring; results are
+// collected a few frames later, only once available, so the CPU never waits for the GPU.
+// The controller assumes the cost grows with the pixel count, i.e. with Scale squared: it scales the measured
+// time to the current scale, smooths it, and picks the scale whose predicted time fits the budget. Over budget
+// it drops right away, under budget it climbs one step at a time. Scales are quantized so the render targets
+// (which are reallocated for every new size) don't change every frame, and after a change it waits until frames
+// rendered at the new scale have been measured.
+class DynamicResolution
+{
+public:
+    float Scale;            // current internal resolution, relative to the window
+    float MinScale, MaxScale;
+    float Step;             // scales are multiples of Step
+    float TargetMs;         // GPU time budget per frame
+    float GpuMs;            // last measured GPU frame time
+    bool Enabled;           // when off, Scale stays at MaxScale (frames are still timed)
+
+    DynamicResolution(float targetMs, float minScale = 0.5f, float maxScale = 1.0f)
+        : Scale(maxScale), MinScale(minScale), MaxScale(maxScale), Step(0.05f), TargetMs(targetMs), GpuMs(0.0f),
+          Enabled(true), next(0), timing(false), smoothedMs(-1.0f), settleFrames(0)
+    {
+        glGenQueries(QUERY_COUNT, queries);
+        for (unsigned int i = 0; i < QUERY_COUNT; i++)
+            pending[i] = false;
+    }
+
+    ~DynamicResolution()
+    {
+        glDeleteQueries(QUERY_COUNT, queries);
+    }
+
+    // call before rendering a frame: collects finished measurements, adjusts Scale and starts timing the frame
+    void BeginFrame()
+    {
+        collect();
+        if (!Enabled)
+            Scale = MaxScale;
+        // all queries still in flight: this frame is not timed
+        timing = !pending[next];
+        if (timing)
+        {
+            glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+            queryScale[next] = Scale;
+        }
+    }
+
+    // call after the frame's last draw call
+    void EndFrame()
+    {
+        if (!timing)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[next] = true;
+        next = (next + 1) % QUERY_COUNT;
+        timing = false;
+    }
+
+private:
+    static const unsigned int QUERY_COUNT = 4;
+
+    unsigned int queries[QUERY_COUNT];
+    bool pending[QUERY_COUNT];
+    float queryScale[QUERY_COUNT];      // scale the timed frame was rendered at
+    unsigned int next;                  // slot of the next query, also the oldest one in flight
+    bool timing;
+    float smoothedMs;                   // GPU time predicted at the current scale
+    unsigned int settleFrames;          // measurements to skip after a scale change
+
+    // reads the finished queries, oldest first, and stops at the first one that isn't ready
+    void collect()
+    {
+        for (unsigned int i = 0; i < QUERY_COUNT; i++)
+        {
+            unsigned int slot = (next + i) % QUERY_COUNT;
+            if (!pending[slot])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+            pending[slot] = false;
+            GpuMs = elapsed / 1e6f;
+            adjust(GpuMs, queryScale[slot]);
+        }
+    }
+
+    void adjust(float ms, float measuredScale)
+    {
+        // the same frame at the current scale
+        float ratio = Scale / measuredScale;
+        float predicted = ms * ratio * ratio;
+        smoothedMs = smoothedMs < 0.0f ? predicted : smoothedMs + (predicted - smoothedMs) * 0.25f;
+        if (settleFrames > 0)
+        {
+            settleFrames--;
+            return;
+        }
+        if (!Enabled)
+            return;
+
+        // largest scale that fits 90% of the budget, leaving some room for noise
+        float fitting = Scale * sqrt(TargetMs * 0.9f / max(smoothedMs, 0.01f));
+        float scale = Scale;
+        if (smoothedMs > TargetMs)
+            scale = floor(fitting / Step) * Step;
+        else if (fitting >= Scale + Step)
+            scale = Scale + Step;
+        scale = min(MaxScale, max(MinScale, scale));
+        if (fabs(scale - Scale) < Step * 0.5f)
+            return;
+
+        float changed = scale / Scale;
+        smoothedMs *= changed * changed;
+        Scale = scale;
+        settleFrames = QUERY_COUNT;
+    }
+};
+#endif
@@ -0,0 +1,398 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+enum CaptureFormat {
+    CAPTURE_PNG,    // one numbered PNG per frame
+    CAPTURE_RAW     // all frames appended to one raw RGBA file, top row first (e.g. for ffmpeg -f rawvideo)
+};
+
+// Writes 8 bit RGBA images as PNG. The image data is stored uncompressed (deflate "stored" blocks): files are
+// large, but encoding is a straight copy plus the checksums, fast enough to keep up with capture.
+class PngWriter
+{
+public:
+    // rows are given bottom row first, as glReadPixels returns them
+    static bool Write(const string &path, const unsigned char *pixels, int width, int height)
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+        vector<unsigned char> png;
+        const unsigned char signature[] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+        png.insert(png.end(), signature, signature + 8);
+
+        unsigned char header[13];
+        putBigEndian(header, width);
+        putBigEndian(header + 4, height);
+        header[8] = 8;      // bits per channel
+        header[9] = 6;      // RGBA
+        header[10] = header[11] = header[12] = 0;
+        addChunk(png, "IHDR", header, 13);
+
+        // zlib stream: every scanline is a filter byte (none) and the row, split into stored blocks of at most 65535 bytes
+        size_t rowBytes = (size_t)width * 4;
+        size_t rawSize = (rowBytes + 1) * height;
+        vector<unsigned char> zlib;
+        zlib.reserve(rawSize + rawSize / 65535 * 5 + 16);
+        zlib.push_back(0x78);
+        zlib.push_back(0x01);
+        size_t blockLeft = 0;
+        uint32_t adlerA = 1, adlerB = 0;
+        size_t remaining = rawSize;
+        for (int y = 0; y < height; y++)
+        {
+            const unsigned char *row = pixels + (size_t)(height - 1 - y) * rowBytes;
+            for (size_t i = 0; i <= rowBytes; )
+            {
+                if (blockLeft == 0)
+                {
+                    blockLeft = remaining < 65535 ? remaining : 65535;
+                    remaining -= blockLeft;
+                    zlib.push_back(remaining == 0 ? 1 : 0);
+                    zlib.push_back(blockLeft & 0xFF);
+                    zlib.push_back(blockLeft >> 8);
+                    zlib.push_back(~blockLeft & 0xFF);
+                    zlib.push_back((~blockLeft >> 8) & 0xFF);
+                }
+                if (i == 0)
+                {
+                    // filter type byte
+                    zlib.push_back(0);
+                    adlerB = (adlerB + adlerA) % 65521;
+                    blockLeft--;
+                    i++;
+                    continue;
+                }
+                size_t count = rowBytes + 1 - i < blockLeft ? rowBytes + 1 - i : blockLeft;
+                const unsigned char *data = row + i - 1;
+                zlib.insert(zlib.end(), data, data + count);
+                adler(data, count, adlerA, adlerB);
+                blockLeft -= count;
+                i += count;
+            }
+        }
+        unsigned char checksum[4];
+        putBigEndian(checksum, (adlerB << 16) | adlerA);
+        zlib.insert(zlib.end(), checksum, checksum + 4);
+        addChunk(png, "IDAT", &zlib[0], zlib.size());
+        addChunk(png, "IEND", NULL, 0);
+
+        bool written = fwrite(&png[0], 1, png.size(), file) == png.size();
+        fclose(file);
+        return written;
+    }
+
+private:
+    static void putBigEndian(unsigned char *out, uint32_t value)
+    {
+        out[0] = value >> 24;
+        out[1] = (value >> 16) & 0xFF;
+        out[2] = (value >> 8) & 0xFF;
+        out[3] = value & 0xFF;
+    }
+
+    static void adler(const unsigned char *data, size_t count, uint32_t &a, uint32_t &b)
+    {
+        // sums stay below 2^32 for 5552 bytes before they have to be reduced
+        while (count > 0)
+        {
+            size_t n = count < 5552 ? count : 5552;
+            for (size_t i = 0; i < n; i++)
+            {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += n;
+            count -= n;
+        }
+    }
+
+    static uint32_t crc(const unsigned char *data, size_t count, uint32_t crc)
+    {
+        static uint32_t table[256];
+        static bool initialized = false;
+        if (!initialized)
+        {
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+            initialized = true;
+        }
+        for (size_t i = 0; i < count; i++)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return crc;
+    }
+
+    static void addChunk(vector<unsigned char> &png, const char *type, const unsigned char *data, size_t size)
+    {
+        unsigned char length[4];
+        putBigEndian(length, size);
+        png.insert(png.end(), length, length + 4);
+        size_t typeStart = png.size();
+        png.insert(png.end(), type, type + 4);
+        if (size > 0)
+            png.insert(png.end(), data, data + size);
+        unsigned char checksum[4];
+        putBigEndian(checksum, crc(&png[typeStart], size + 4, 0xFFFFFFFFu) ^ 0xFFFFFFFFu);
+        png.insert(png.end(), checksum, checksum + 4);
+    }
+};
+
+// Captures rendered frames without stalling the render thread.
+// Capture() starts an asynchronous glReadPixels into the next pixel buffer object of a ring and puts a fence
+// after it. Poll() (called by Capture, or once a frame) checks the fences without waiting; a finished buffer
+// is mapped and its pointer handed to a worker thread, which encodes straight from the mapped memory. Once the
+// worker is done the buffer is unmapped and reused. The render thread so only issues the read, tests fences and
+// maps/unmaps: no copies and no waiting. If every buffer is still busy the frame is dropped rather than waited for.
+// PNG encoding (PngWriter) of a 1280x720 frame takes a few milliseconds on the worker; raw video only writes.
+class FrameCapture
+{
+public:
+    atomic<unsigned int> Captured;      // frames written
+    atomic<unsigned int> Dropped;       // frames skipped because the ring was full (or the size changed in raw mode)
+    double RenderThreadMs;              // time spent in Capture and Poll since the last ResetStats
+
+    // prefix is the start of the file names: prefix_00001.png ..., or prefix.rgba for raw video
+    FrameCapture(const string &prefix, CaptureFormat format, unsigned int ringSize = 4)
+        : Captured(0), Dropped(0), RenderThreadMs(0.0), prefix(prefix), format(format), slots(ringSize),
+          next(0), frameNumber(0), rawFile(NULL), rawWidth(0), rawHeight(0), stopping(false)
+    {
+        for (unsigned int i = 0; i < slots.size(); i++)
+            glGenBuffers(1, &slots[i].PBO);
+        worker = thread(&FrameCapture::encodeFrames, this);
+    }
+
+    // finishes every frame in flight, then stops the worker
+    ~FrameCapture()
+    {
+        for (unsigned int i = 0; i < slots.size(); i++)
+        {
+            unsigned int slot = (next + i) % slots.size();
+            if (slots[slot].State == SLOT_READING)
+                glClientWaitSync(slots[slot].Fence, GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)10000000000ull);
+        }
+        poll();
+        {
+            unique_lock<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueChanged.notify_all();
+        worker.join();
+        poll();
+        for (unsigned int i = 0; i < slots.size(); i++)
+        {
+            if (slots[i].Fence)
+                glDeleteSync(slots[i].Fence);
+            glDeleteBuffers(1, &slots[i].PBO);
+        }
+        if (rawFile)
+            fclose(rawFile);
+    }
+
+    // queues a read of the color buffer of framebuffer (0 for the window's back buffer), call after rendering
+    void Capture(unsigned int framebuffer, int width, int height)
+    {
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        poll();
+        Slot &slot = slots[next];
+        frameNumber++;
+        if (slot.State != SLOT_FREE)
+            Dropped++;
+        else
+        {
+            size_t size = (size_t)width * height * 4;
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+            glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+            if (size != slot.Size)
+            {
+                glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+                slot.Size = size;
+            }
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            slot.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            slot.Width = width;
+            slot.Height = height;
+            slot.Frame = frameNumber;
+            slot.State = SLOT_READING;
+            next = (next + 1) % slots.size();
+        }
+        RenderThreadMs += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // hands finished reads to the worker and recycles encoded buffers; Capture calls this too
+    void Poll()
+    {
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        poll();
+        RenderThreadMs += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void ResetStats()
+    {
+        Captured = Dropped = 0;
+        RenderThreadMs = 0.0;
+    }
+
+private:
+    enum SlotState { SLOT_FREE, SLOT_READING, SLOT_ENCODING };
+
+    struct Slot {
+        unsigned int PBO;
+        GLsync Fence;
+        size_t Size;
+        int Width, Height;
+        unsigned int Frame;
+        SlotState State;
+        atomic<bool> Encoded;       // set by the worker, the render thread unmaps
+
+        Slot() : PBO(0), Fence(0), Size(0), Width(0), Height(0), Frame(0), State(SLOT_FREE), Encoded(false)
+        {
+        }
+    };
+
+    struct Job {
+        unsigned int Slot;
+        const unsigned char *Pixels;
+    };
+
+    string prefix;
+    CaptureFormat format;
+    vector<Slot> slots;
+    unsigned int next;              // slot of the next capture; slots are used, and finish, in ring order
+    unsigned int frameNumber;
+    FILE *rawFile;
+    int rawWidth, rawHeight;
+
+    thread worker;
+    mutex queueMutex;
+    condition_variable queueChanged;
+    deque<Job> jobs;
+    bool stopping;
+
+    void poll()
+    {
+        for (unsigned int i = 0; i < slots.size(); i++)
+        {
+            Slot &slot = slots[i];
+            if (slot.State == SLOT_ENCODING && slot.Encoded)
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                slot.State = SLOT_FREE;
+            }
+        }
+        // reads complete in the order they were issued, so only the oldest ones need checking
+        for (unsigned int i = 0; i < slots.size(); i++)
+        {
+            unsigned int index = (next + i) % slots.size();
+            Slot &slot = slots[index];
+            if (slot.State != SLOT_READING)
+                continue;
+            GLenum status = glClientWaitSync(slot.Fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(slot.Fence);
+            slot.Fence = 0;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+            Job job;
+            job.Slot = index;
+            job.Pixels = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.Size, GL_MAP_READ_BIT);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.Encoded = false;
+            slot.State = SLOT_ENCODING;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                jobs.push_back(job);
+            }
+            queueChanged.notify_one();
+        }
+    }
+
+    // worker thread: encodes jobs in capture order until the capture is destroyed and the queue is empty
+    void encodeFrames()
+    {
+        for (;;)
+        {
+            Job job;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                while (jobs.empty() && !stopping)
+                    queueChanged.wait(lock);
+                if (jobs.empty())
+                    return;
+                job = jobs.front();
+                jobs.pop_front();
+            }
+            Slot &slot = slots[job.Slot];
+            if (job.Pixels)
+                encode(job.Pixels, slot.Width, slot.Height, slot.Frame);
+            slot.Encoded = true;
+        }
+    }
+
+    void encode(const unsigned char *pixels, int width, int height, unsigned int frame)
+    {
+        if (format == CAPTURE_PNG)
+        {
+            char number[16];
+            snprintf(number, sizeof(number), "_%05u.png", frame);
+            if (PngWriter::Write(prefix + number, pixels, width, height))
+                Captured++;
+            else
+                cout << "ERROR::CAPTURE:: Could not write " << prefix + number << endl;
+            return;
+        }
+
+        if (!rawFile)
+        {
+            rawFile = fopen((prefix + ".rgba").c_str(), "wb");
+            rawWidth = width;
+            rawHeight = height;
+            if (!rawFile)
+            {
+                cout << "ERROR::CAPTURE:: Could not open " << prefix << ".rgba" << endl;
+                return;
+            }
+            cout << "capturing raw video, convert with: ffmpeg -f rawvideo -pixel_format rgba -video_size "
+                 << width << "x" << height << " -i " << prefix << ".rgba " << prefix << ".mp4" << endl;
+        }
+        // a video can't change size, frames of another size are skipped
+        if (width != rawWidth || height != rawHeight)
+        {
+            Dropped++;
+            return;
+        }
+        size_t rowBytes = (size_t)width * 4;
+        for (int y = height - 1; y >= 0; y--)
+            fwrite(pixels + y * rowBytes, 1, rowBytes, rawFile);
+        Captured++;
+    }
+};
+#endif
@@ -8,8 +8,15 @@
 
 #include "camera.h"
 #include "shader_m.h"
+#include "renderGraph.h"
+#include "postProcessor.h"
+#include "dynamicResolution.h"
+#include "frameCapture.h"
 
 #include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include "../headless.h"
 
 using namespace std;
 
@@ -32,38 +39,83 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// window framebuffer size, the render graph follows it
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
-int main() {
-	// glfw
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// post-processing effect chain, picked with the number keys 1-6
+int effect = 3;
+bool effectChanged = true;
 
-	#ifdef __APPLE___
-		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	#endif
+// R toggles dynamic resolution
+bool dynamicResolutionEnabled = true;
+bool dynamicResolutionKeyPressed = false;
 
-	GLFWwindow * window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-	if (window == NULL)
+// C starts and stops capturing the frames to disk
+bool capturing = false;
+bool captureKeyPressed = false;
+
+
+// usage: framebuffers [--target-ms MS] [--cubes N] [--capture png|raw]
+int main(int argc, char **argv) {
+	// command line options
+	float targetMs = 16.0f;			// GPU time budget per frame for dynamic resolution
+	unsigned int extraCubes = 0;	// additional cubes to make the scene heavier
+	CaptureFormat captureFormat = CAPTURE_PNG;	// what C records, --capture also starts recording right away
+	for (int i = 1; i + 1 < argc; i += 2)
 	{
-		cout << "Failed to create GLFW window" << endl;
-		glfwTerminate();
-		return -1;
+		if (strcmp(argv[i], "--target-ms") == 0)
+			targetMs = (float)atof(argv[i + 1]);
+		else if (strcmp(argv[i], "--cubes") == 0)
+			extraCubes = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+		else if (strcmp(argv[i], "--capture") == 0)
+		{
+			captureFormat = strcmp(argv[i + 1], "raw") == 0 ? CAPTURE_RAW : CAPTURE_PNG;
+			capturing = true;
+		}
 	}
-	glfwMakeContextCurrent(window);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	glfwSetCursorPosCallback(window, mouse_callback);
-	glfwSetScrollCallback(window, scroll_callback);
 
-	// GLFW set to capture mouse
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-	// glad: load all OpenGL function pointers
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	// --headless renders offscreen instead, see headless.h
+	Headless headless(argc, argv);
+	GLFWwindow* window = NULL;
+	if (headless.Enabled)
 	{
-		cout << "Failed to initialize GLAD" << endl;
-		return -1;
+		if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT))
+			return -1;
+	}
+	else
+	{
+		// glfw
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+		#ifdef __APPLE___
+			glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		#endif
+
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+		if (window == NULL)
+		{
+			cout << "Failed to create GLFW window" << endl;
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		glfwSetCursorPosCallback(window, mouse_callback);
+		glfwSetScrollCallback(window, scroll_callback);
+
+		// GLFW set to capture mouse
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+		// glad: load all OpenGL function pointers
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			cout << "Failed to initialize GLAD" << endl;
+			return -1;
+		}
 	}
 
 	// Configure global openGL state
@@ -72,6 +124,7 @@ int main() {
 	// Build and compile shader program
 	Shader shader("basicScene.vs", "basicScene.fs");
 	Shader screenShader("framebuffers.vs", "framebuffers.fs");
+	Shader presentShader("framebuffers.vs", "screen.fs");
 
 	// set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -167,16 +220,16 @@ float quadVertices[] = { // vertex attributes for a quad that fills the entire s
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 	glBindVertexArray(0);
 	// screen quad VAO
-    	unsigned int quadVAO, quadVBO;
-    	glGenVertexArrays(1, &quadVAO);
-    	glGenBuffers(1, &quadVBO);
-    	glBindVertexArray(quadVAO);
-    	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-    	glEnableVertexAttribArray(0);
-    	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    	glEnableVertexAttribArray(1);
-    	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+	unsigned int quadVAO, quadVBO;
+	glGenVertexArrays(1, &quadVAO);
+	glGenBuffers(1, &quadVBO);
+	glBindVertexArray(quadVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 	glBindVertexArray(0);
 	// Load Textures
 	// Load cubeTexture
@@ -208,132 +261,206 @@ float quadVertices[] = { // vertex attributes for a quad that fills the entire s
 
 	// Plane texture
 	unsigned int planeTexture;
-        glGenTextures(1, &planeTexture);
-        // Bind texture
-        glBindTexture(GL_TEXTURE_2D, planeTexture);
-        // Set texture wrapping / filtering options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // Set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // Load data from image and generate texture
-        data = stbi_load("metal.png", &width, &height, &nrChannels, 0);
-        if (data) {
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-                glGenerateMipmap(GL_TEXTURE_2D);
-
-        	// Free data
-        	stbi_image_free(data);
-        }
-        else
-        {
-                cout << "Failed to load texture" << endl;
-		return -1;
-        }
-	
-	// create framebuffer object and bind 
-	unsigned int framebuffer;
-	glGenFramebuffers(1, &framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-	// generate texture image 
-	unsigned int texColorBuffer;
-	glGenTextures(1, &texColorBuffer);
-	glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	glGenTextures(1, &planeTexture);
+	// Bind texture
+	glBindTexture(GL_TEXTURE_2D, planeTexture);
+	// Set texture wrapping / filtering options
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// Set texture filtering parameters
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	
-	// Attach to currently bound frambuffer object 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0);
-	
-	// Create renderbuffer object for depth and stencil attachment 
-	unsigned int rbo;
-	glGenRenderbuffers(1, &rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-	// Attach renderbuffer object
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-	
-	// Check if framebuffer is complete 
-	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		cout << "ERROR::FRAMEBUFFER:: Framebuffer not complete!" << endl;
+	// Load data from image and generate texture
+	data = stbi_load("metal.png", &width, &height, &nrChannels, 0);
+	if (data) {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		// Free data
+		stbi_image_free(data);
+	}
+	else
+	{
+		cout << "Failed to load texture" << endl;
 		return -1;
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// shader configuration
-	shader.use();
-	shader.setInt("texture1", 0);
-	screenShader.use();
-	screenShader.setInt("screenTexture", 0);
-
-	// render loop
-	while(!glfwWindowShouldClose(window))
+	
+	// the render graph's pool, the timer queries and the capture ring are released at the end of this block,
+	// while the context is still current
 	{
-		// per-frame time logic
-		float currentFrame = glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
-
-		// input
-		processInput(window);
-
-		// render
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glEnable(GL_DEPTH_TEST);
-
-    shader.use();
-    glm::mat4 model;
-    glm::mat4 view = camera.GetViewMatrix();
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    shader.setMat4("view", view);
-    shader.setMat4("projection", projection);
-
-		// cubes
-		glBindVertexArray(cubeVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture);
-    model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-    shader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    model = glm::mat4();
-    model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-    shader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-		// floor
-		glBindVertexArray(planeVAO);
-    glBindTexture(GL_TEXTURE_2D, planeTexture);
-    shader.setMat4("model", glm::mat4());
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-  	glBindVertexArray(0);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0); // back to default 
-		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		screenShader.use();
-		glBindVertexArray(quadVAO);
-		glDisable(GL_DEPTH_TEST);
-		glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-		glDrawArrays(GL_TRIANGLES, 0, 6); 
+		// Offscreen targets come from the render graph's pool and are rebuilt when the window is resized
+		headless.GetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		RenderGraph graph(framebufferWidth, framebufferHeight);
+		PostProcessor postProcessor(screenShader, quadVAO);
+		// The scene and the effects render at a fraction of the window size that keeps the GPU time on budget
+		DynamicResolution dynamicResolution(targetMs);
+		// Finished frames are read back from the window through a ring of pixel buffers and written by a worker thread
+		FrameCapture frameCapture("capture", captureFormat);
+		unsigned int reportFrames = 0;
+		double lastReport = headless.Time();
+
+		// extra cubes scattered in front of the camera
+		vector<glm::vec3> cubePositions;
+		srand(1);
+		for (unsigned int i = 0; i < extraCubes; i++)
+			cubePositions.push_back(glm::vec3((rand() % 2000) / 100.0f - 10.0f, (rand() % 600) / 100.0f - 0.5f, -(rand() % 2000) / 100.0f));
+
+		// kernels for the effects
+		const float sharpen[] = {
+			-1, -1, -1,
+			-1,  9, -1,
+			-1, -1, -1
+		};
+		const float blur[] = {
+			1.0f / 16, 2.0f / 16, 1.0f / 16,
+			2.0f / 16, 4.0f / 16, 2.0f / 16,
+			1.0f / 16, 2.0f / 16, 1.0f / 16
+		};
+		const float edgeDetection[] = {
+			1,  1, 1,
+			1, -8, 1,
+			1,  1, 1
+		};
+
+		// shader configuration
+		shader.use();
+		shader.setInt("texture1", 0);
+		presentShader.use();
+		presentShader.setInt("screenTexture", 0);
+
+		// render loop
+		while (headless.Running(window))
+		{
+			// per-frame time logic
+			float currentFrame = headless.Time();
+			deltaTime = currentFrame - lastFrame;
+			lastFrame = currentFrame;
+
+			// input
+			if (headless.Enabled)
+				headless.MoveCamera(camera);
+			else
+				processInput(window);
+
+			// effects, rebuilt when another one is picked
+			if (effectChanged)
+			{
+				const char *names[] = { "", "none", "sharpen", "edge detection", "3x3 blur", "Gaussian blur (sigma 12)", "Gaussian blur (sigma 4) + edge detection" };
+				postProcessor.Clear();
+				if (effect == 2)
+					postProcessor.AddKernel(Kernel(3, 3, sharpen));
+				else if (effect == 3)
+					postProcessor.AddKernel(Kernel(3, 3, edgeDetection));
+				else if (effect == 4)
+					postProcessor.AddKernel(Kernel(3, 3, blur));
+				else if (effect == 5)
+					postProcessor.AddGaussianBlur(12.0f);
+				else if (effect == 6)
+				{
+					postProcessor.AddGaussianBlur(4.0f);
+					postProcessor.AddKernel(Kernel(3, 3, edgeDetection));
+				}
+				cout << "effect: " << names[effect] << ", " << postProcessor.PassCount() << " passes, "
+				     << postProcessor.TapCount() << " texture fetches per pixel" << endl;
+				effectChanged = false;
+			}
+
+			// render: scene -> effects -> window, declared again every frame
+			dynamicResolution.Enabled = dynamicResolutionEnabled;
+			dynamicResolution.BeginFrame();
+			float renderScale = dynamicResolution.Scale;
+			graph.SetBackbufferSize(framebufferWidth, framebufferHeight);
+			RenderResource sceneColor;
+
+			graph.AddPass("scene", [&](RenderPassBuilder &builder) {
+				sceneColor = builder.Create("scene color", RenderTargetDesc(GL_RGB8, renderScale));
+				builder.Create("scene depth", RenderTargetDesc(GL_DEPTH24_STENCIL8, renderScale));
+			}, [&](const RenderPassResources &) {
+				glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glEnable(GL_DEPTH_TEST);
+
+				shader.use();
+				glm::mat4 model;
+				glm::mat4 view = camera.GetViewMatrix();
+				glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)framebufferWidth / (float)framebufferHeight, 0.1f, 100.0f);
+				shader.setMat4("view", view);
+				shader.setMat4("projection", projection);
+
+				// cubes
+				glBindVertexArray(cubeVAO);
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, cubeTexture);
+				model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
+				shader.setMat4("model", model);
+				glDrawArrays(GL_TRIANGLES, 0, 36);
+				model = glm::mat4();
+				model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
+				shader.setMat4("model", model);
+				glDrawArrays(GL_TRIANGLES, 0, 36);
+				for (unsigned int i = 0; i < cubePositions.size(); i++)
+				{
+					shader.setMat4("model", glm::translate(glm::mat4(), cubePositions[i]));
+					glDrawArrays(GL_TRIANGLES, 0, 36);
+				}
+				// floor
+				glBindVertexArray(planeVAO);
+				glBindTexture(GL_TEXTURE_2D, planeTexture);
+				shader.setMat4("model", glm::mat4());
+				glDrawArrays(GL_TRIANGLES, 0, 6);
+				glBindVertexArray(0);
+			});
+
+			// the last effect renders straight into the window and upscales on the way, only without effects the
+			// scene is copied (and upscaled) there
+			postProcessor.AddPasses(graph, sceneColor, true, renderScale);
+			if (postProcessor.Empty())
+			{
+				graph.AddPass("present", [&](RenderPassBuilder &builder) {
+					builder.Read(sceneColor);
+					builder.WriteBackbuffer();
+				}, [&](const RenderPassResources &resources) {
+					glDisable(GL_DEPTH_TEST);
+					presentShader.use();
+					glBindVertexArray(quadVAO);
+					glBindTexture(GL_TEXTURE_2D, resources.Texture(sceneColor));
+					glDrawArrays(GL_TRIANGLES, 0, 6);
+				});
+			}
+
+			graph.Execute();
+			dynamicResolution.EndFrame();
+			// the back buffer holds the finished frame until the swap
+			if (capturing)
+				frameCapture.Capture(0, framebufferWidth, framebufferHeight);
+			else
+				frameCapture.Poll();
+			reportFrames++;
+			if (currentFrame - lastReport >= 1.0)
+			{
+				graph.PrintStats();
+				cout << "dynamic resolution " << (dynamicResolution.Enabled ? "on" : "off") << ": scale " << renderScale
+				     << " (" << (int)(framebufferWidth * renderScale + 0.5f) << "x" << (int)(framebufferHeight * renderScale + 0.5f)
+				     << "), GPU " << dynamicResolution.GpuMs << " ms, target " << dynamicResolution.TargetMs << " ms" << endl;
+				if (capturing)
+					cout << "capture: " << frameCapture.Captured << " frames written, " << frameCapture.Dropped << " dropped, "
+					     << frameCapture.RenderThreadMs / reportFrames << " ms per frame on the render thread" << endl;
+				frameCapture.ResetStats();
+				reportFrames = 0;
+				lastReport = currentFrame;
+			}
 	
-		// glfw: Swap buffers and poll IO events
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+			// glfw: Swap buffers and poll IO events
+			headless.SwapBuffers(window);
+		}
+
+		// De-allocate resources
+		glDeleteVertexArrays(1, &cubeVAO);
+		glDeleteVertexArrays(1, &planeVAO);
+		glDeleteBuffers(1, &cubeVBO);
+		glDeleteBuffers(1, &planeVBO);
 	}
 
-	// De-allocate resources
-	glDeleteVertexArrays(1, &cubeVAO);
-	glDeleteVertexArrays(1, &planeVAO);
-	glDeleteBuffers(1, &cubeVBO);
-	glDeleteBuffers(1, &planeVBO);
-
 	glfwTerminate();
 	return 0;
 }
@@ -343,6 +470,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
@@ -381,4 +510,21 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    for (int i = 1; i <= 6; i++)
+        if (glfwGetKey(window, GLFW_KEY_0 + i) == GLFW_PRESS && effect != i)
+        {
+            effect = i;
+            effectChanged = true;
+        }
+
+    bool dynamicResolutionKey = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (dynamicResolutionKey && !dynamicResolutionKeyPressed)
+        dynamicResolutionEnabled = !dynamicResolutionEnabled;
+    dynamicResolutionKeyPressed = dynamicResolutionKey;
+
+    bool captureKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (captureKey && !captureKeyPressed)
+        capturing = !capturing;
+    captureKeyPressed = captureKey;
 }
@@ -0,0 +1,331 @@
+#ifndef POST_PROCESSOR_H
+#define POST_PROCESSOR_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader_m.h"
+#include "renderGraph.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// a 2D convolution kernel, weights row by row with the top row first (as kernels are usually written down)
+struct Kernel {
+    int Width, Height;
+    vector<float> Weights;
+
+    Kernel(int width, int height, const float *weights) : Width(width), Height(height), Weights(weights, weights + width * height)
+    {
+    }
+
+    float At(int x, int y) const
+    {
+        return Weights[y * Width + x];
+    }
+};
+
+// one texture fetch of a convolution pass: offset in source texels and weight
+struct KernelTap {
+    glm::vec2 Offset;
+    float Weight;
+};
+
+// Runs a chain of convolution effects after the scene, as passes of a RenderGraph.
+// Kernels are given from C++ and compiled into lists of texture fetches when they are added:
+//  - a kernel that is the product of a column and a row (rank one) is split into a horizontal and a vertical pass,
+//    an n x n kernel then costs 2n fetches instead of n * n;
+//  - neighbouring 1D taps whose weights have the same sign are merged into one bilinear fetch between them,
+//    which roughly halves the fetches again;
+//  - wide Gaussian blurs are computed on a half or quarter resolution copy and scaled back up, which shrinks
+//    both the kernel and the number of pixels it runs on.
+// Each pass reads the previous pass's output directly and the last one can render straight into the window,
+// so chaining effects adds no copies. Intermediate targets come from the graph's pool.
+class PostProcessor
+{
+public:
+    static const int MAX_TAPS = 64;     // must match framebuffers.fs
+    GLenum Format;                      // of the intermediate targets
+
+    // quadVAO draws a full screen quad (6 vertices) for framebuffers.vs
+    PostProcessor(Shader &convolutionShader, unsigned int quadVAO) : Format(GL_RGB8), shader(convolutionShader), quadVAO(quadVAO), scale(1.0f)
+    {
+    }
+
+    void Clear()
+    {
+        steps.clear();
+        scale = 1.0f;
+    }
+
+    bool Empty() const
+    {
+        return steps.empty();
+    }
+
+    // appends a convolution with kernel, centered on the middle (or just below/right of it for even sizes)
+    void AddKernel(const Kernel &kernel)
+    {
+        if (kernel.Height == 1 || kernel.Width == 1)
+        {
+            glm::vec2 direction = kernel.Height == 1 ? glm::vec2(1.0f, 0.0f) : glm::vec2(0.0f, -1.0f);
+            addStep(MergeLinearTaps(kernel.Weights, direction), scale);
+            return;
+        }
+
+        vector<float> column, row;
+        if (Separate(kernel, column, row))
+        {
+            addStep(MergeLinearTaps(row, glm::vec2(1.0f, 0.0f)), scale);
+            addStep(MergeLinearTaps(column, glm::vec2(0.0f, -1.0f)), scale);  // first kernel row is the top
+            return;
+        }
+
+        vector<KernelTap> taps;
+        for (int y = 0; y < kernel.Height; y++)
+            for (int x = 0; x < kernel.Width; x++)
+                if (kernel.At(x, y) != 0.0f)
+                {
+                    KernelTap tap;
+                    tap.Offset = glm::vec2(x - kernel.Width / 2, kernel.Height / 2 - y);
+                    tap.Weight = kernel.At(x, y);
+                    taps.push_back(tap);
+                }
+        addStep(taps, scale);
+    }
+
+    // appends a Gaussian blur with the given standard deviation in window pixels, also when AddPasses runs the
+    // effects at a lower resolution. from a sigma of 3 on it runs at half, from 6 on at quarter resolution of
+    // the chain; the result is scaled back up.
+    void AddGaussianBlur(float sigma)
+    {
+        float blurScale = sigma >= 6.0f ? 0.25f : (sigma >= 3.0f ? 0.5f : 1.0f);
+        float previousScale = scale;
+        // every halving copy averages 2x2 texels with a single bilinear fetch
+        while (scale > blurScale)
+        {
+            scale *= 0.5f;
+            addStep(copyTaps(), scale);
+        }
+        addBlurStep(sigma, glm::vec2(1.0f, 0.0f));
+        addBlurStep(sigma, glm::vec2(0.0f, 1.0f));
+        if (scale != previousScale)
+        {
+            scale = previousScale;
+            addStep(copyTaps(), scale);
+        }
+    }
+
+    // adds the passes to graph and returns the final target; with toBackbuffer the last pass renders into the
+    // window instead and -1 is returned. input is returned unchanged when there are no effects.
+    // the effects must not change before the graph has been executed. with a resolutionScale below one the
+    // effects run at that fraction of the window size; a final pass into the window upscales on the way. Blurs keep
+    // their size in window pixels, their weights are recomputed for the resolution they actually run at.
+    RenderResource AddPasses(RenderGraph &graph, RenderResource input, bool toBackbuffer, float resolutionScale = 1.0f)
+    {
+        for (unsigned int i = 0; i < steps.size(); i++)
+            if (steps[i].BlurSigma > 0.0f)
+                steps[i].Taps = blurTaps(steps[i], resolutionScale);
+
+        RenderResource current = input;
+        for (unsigned int i = 0; i < steps.size(); i++)
+        {
+            const PostStep *step = &steps[i];
+            bool last = i + 1 == steps.size();
+            RenderResource source = current, output = -1;
+            graph.AddPass("post process", [&](RenderPassBuilder &builder) {
+                builder.Read(source);
+                if (last && toBackbuffer)
+                    builder.WriteBackbuffer();
+                else
+                    output = builder.Create("post process target", RenderTargetDesc(Format, step->Scale * resolutionScale));
+            }, [this, step, source](const RenderPassResources &resources) {
+                run(*step, resources.Texture(source));
+            });
+            current = output;
+        }
+        return current;
+    }
+
+    unsigned int PassCount() const
+    {
+        return steps.size();
+    }
+
+    // at full resolution, a lower resolutionScale in AddPasses needs fewer fetches for the blurs
+    unsigned int TapCount() const
+    {
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < steps.size(); i++)
+            count += steps[i].Taps.size();
+        return count;
+    }
+
+    // splits kernel into column * row if it has rank one (up to rounding)
+    static bool Separate(const Kernel &kernel, vector<float> &column, vector<float> &row)
+    {
+        // the largest weight fixes the pivot row and column
+        int pivotX = 0, pivotY = 0;
+        for (int y = 0; y < kernel.Height; y++)
+            for (int x = 0; x < kernel.Width; x++)
+                if (fabs(kernel.At(x, y)) > fabs(kernel.At(pivotX, pivotY)))
+                {
+                    pivotX = x;
+                    pivotY = y;
+                }
+        float pivot = kernel.At(pivotX, pivotY);
+        if (pivot == 0.0f)
+            return false;
+
+        column.resize(kernel.Height);
+        row.resize(kernel.Width);
+        for (int y = 0; y < kernel.Height; y++)
+            column[y] = kernel.At(pivotX, y);
+        for (int x = 0; x < kernel.Width; x++)
+            row[x] = kernel.At(x, pivotY) / pivot;
+
+        float tolerance = fabs(pivot) * 1e-4f;
+        for (int y = 0; y < kernel.Height; y++)
+            for (int x = 0; x < kernel.Width; x++)
+                if (fabs(column[y] * row[x] - kernel.At(x, y)) > tolerance)
+                    return false;
+        return true;
+    }
+
+    // turns 1D weights (centered like AddKernel's) into fetches along direction. going out from the center,
+    // neighbours with weights of the same sign share one fetch placed between them in proportion to the weights,
+    // so the bilinear filter returns exactly their weighted sum.
+    static vector<KernelTap> MergeLinearTaps(const vector<float> &weights, const glm::vec2 &direction)
+    {
+        vector<KernelTap> taps;
+        int center = weights.size() / 2;
+        addTap(taps, direction * 0.0f, weights[center]);
+        for (int side = -1; side <= 1; side += 2)
+        {
+            int i = center + side;
+            while (i >= 0 && i < (int)weights.size())
+            {
+                float w1 = weights[i];
+                int next = i + side;
+                bool hasNext = next >= 0 && next < (int)weights.size();
+                if (hasNext && w1 * weights[next] > 0.0f)
+                {
+                    float w2 = weights[next];
+                    float offset = (i - center) + side * w2 / (w1 + w2);
+                    addTap(taps, direction * offset, w1 + w2);
+                    i = next + side;
+                }
+                else
+                {
+                    addTap(taps, direction * (float)(i - center), w1);
+                    i = next;
+                }
+            }
+        }
+        return taps;
+    }
+
+    // normalized Gaussian out to three standard deviations
+    static vector<float> GaussianWeights(float sigma)
+    {
+        int radius = max(1, (int)ceil(sigma * 3.0f));
+        vector<float> weights(2 * radius + 1);
+        float sum = 0.0f;
+        for (int i = -radius; i <= radius; i++)
+        {
+            weights[i + radius] = exp(-(i * i) / (2.0f * sigma * sigma));
+            sum += weights[i + radius];
+        }
+        for (unsigned int i = 0; i < weights.size(); i++)
+            weights[i] /= sum;
+        return weights;
+    }
+
+private:
+    struct PostStep {
+        vector<KernelTap> Taps;
+        float Scale;            // output resolution relative to the window
+        float BlurSigma;        // in window pixels for the passes of a Gaussian blur, 0 for fixed taps
+        glm::vec2 BlurDirection;
+    };
+
+    Shader &shader;
+    unsigned int quadVAO;
+    vector<PostStep> steps;
+    float scale;                // resolution the chain is at after the steps so far
+
+    static void addTap(vector<KernelTap> &taps, const glm::vec2 &offset, float weight)
+    {
+        if (weight == 0.0f)
+            return;
+        KernelTap tap;
+        tap.Offset = offset;
+        tap.Weight = weight;
+        taps.push_back(tap);
+    }
+
+    static vector<KernelTap> copyTaps()
+    {
+        vector<KernelTap> taps;
+        addTap(taps, glm::vec2(0.0f), 1.0f);
+        return taps;
+    }
+
+    void addStep(const vector<KernelTap> &taps, float stepScale)
+    {
+        if (taps.size() > (size_t)MAX_TAPS)
+        {
+            cout << "ERROR::POST_PROCESSOR:: Kernel needs " << taps.size() << " fetches, at most " << MAX_TAPS << " are supported" << endl;
+            return;
+        }
+        PostStep step;
+        step.Taps = taps;
+        step.Scale = stepScale;
+        step.BlurSigma = 0.0f;
+        steps.push_back(step);
+    }
+
+    // one direction of a Gaussian blur at the current scale, its taps are the full resolution ones until AddPasses
+    void addBlurStep(float sigma, const glm::vec2 &direction)
+    {
+        PostStep step;
+        step.Scale = scale;
+        step.BlurSigma = sigma;
+        step.BlurDirection = direction;
+        step.Taps = blurTaps(step, 1.0f);
+        if (step.Taps.size() > (size_t)MAX_TAPS)
+        {
+            cout << "ERROR::POST_PROCESSOR:: Kernel needs " << step.Taps.size() << " fetches, at most " << MAX_TAPS << " are supported" << endl;
+            return;
+        }
+        steps.push_back(step);
+    }
+
+    // the blur's sigma in the texels of the target it is computed in; never more taps than at full resolution
+    static vector<KernelTap> blurTaps(const PostStep &step, float resolutionScale)
+    {
+        float sigma = step.BlurSigma * step.Scale * (resolutionScale < 1.0f ? resolutionScale : 1.0f);
+        return MergeLinearTaps(GaussianWeights(sigma), step.BlurDirection);
+    }
+
+    void run(const PostStep &step, unsigned int source)
+    {
+        glm::vec3 taps[MAX_TAPS];
+        for (unsigned int i = 0; i < step.Taps.size(); i++)
+            taps[i] = glm::vec3(step.Taps[i].Offset, step.Taps[i].Weight);
+        glDisable(GL_DEPTH_TEST);
+        shader.use();
+        shader.setInt("screenTexture", 0);
+        shader.setInt("tapCount", step.Taps.size());
+        glUniform3fv(glGetUniformLocation(shader.ID, "taps"), step.Taps.size(), &taps[0][0]);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, source);
+        glBindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(0);
+    }
+};
+#endif
@@ -0,0 +1,523 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// handle of a render target inside one frame's graph, -1 for none
+typedef int RenderResource;
+
+// size and format of a transient render target. by default the size follows the backbuffer (times Scale),
+// Fixed() targets keep their size when the window is resized.
+struct RenderTargetDesc {
+    GLenum InternalFormat;
+    float Scale;
+    int Width, Height;
+
+    RenderTargetDesc(GLenum internalFormat = GL_RGBA8, float scale = 1.0f)
+        : InternalFormat(internalFormat), Scale(scale), Width(0), Height(0)
+    {
+    }
+
+    static RenderTargetDesc Fixed(GLenum internalFormat, int width, int height)
+    {
+        RenderTargetDesc desc(internalFormat);
+        desc.Width = width;
+        desc.Height = height;
+        return desc;
+    }
+};
+
+// what the last Execute did, and how much GPU memory the graph holds
+struct RenderGraphStats {
+    unsigned int Passes;
+    unsigned int CulledPasses;
+    unsigned int Resources;         // transient targets used by the passes that ran
+    unsigned int Textures;          // textures in the pool
+    size_t RequestedBytes;          // what those targets would take with a texture each
+    size_t PoolBytes;               // what the pool actually holds
+};
+
+class RenderGraph;
+
+// handed to a pass's setup function to declare the targets it creates, reads and writes
+class RenderPassBuilder
+{
+public:
+    // a new transient target, written by this pass
+    RenderResource Create(const string &name, const RenderTargetDesc &desc);
+    // the pass samples resource as a texture
+    RenderResource Read(RenderResource resource);
+    // the pass renders into resource (created by an earlier pass) as well
+    RenderResource Write(RenderResource resource);
+    // the pass renders into the default framebuffer; such passes are never culled
+    void WriteBackbuffer();
+
+private:
+    friend class RenderGraph;
+    RenderGraph &graph;
+    unsigned int pass;
+
+    RenderPassBuilder(RenderGraph &graph, unsigned int pass) : graph(graph), pass(pass)
+    {
+    }
+};
+
+// handed to a pass's execute function. the pass's framebuffer is already bound and the viewport set.
+class RenderPassResources
+{
+public:
+    int Width, Height;      // size of the targets the pass renders into
+
+    // GL texture behind a resource the pass reads
+    unsigned int Texture(RenderResource resource) const;
+
+private:
+    friend class RenderGraph;
+    const RenderGraph &graph;
+
+    RenderPassResources(const RenderGraph &graph) : Width(0), Height(0), graph(graph)
+    {
+    }
+};
+
+// A frame graph over OpenGL framebuffers. Every frame the passes are added again, each declaring in its setup
+// function which render targets it creates, reads and writes. Execute then
+//  - culls passes whose results nobody reads (only backbuffer passes and what they depend on run); a pass that
+//    declares no output at all has nothing anyone could read and is always culled,
+//  - works out the first and last pass using each target,
+//  - gives every target a texture from a pool just before its first pass and returns it right after its last, so
+//    targets with the same size and format whose lifetimes don't overlap share one texture,
+//  - binds a framebuffer with the written targets and runs the passes in the order they were added.
+// Textures and framebuffers stay in the pool across frames. Targets sized relative to the backbuffer are
+// reallocated once when SetBackbufferSize sees a new size, and pool textures unused for a while are freed.
+class RenderGraph
+{
+public:
+    RenderGraphStats Stats;
+
+    RenderGraph(int width, int height) : backbufferWidth(width), backbufferHeight(height), frame(0)
+    {
+        Stats = RenderGraphStats();
+    }
+
+    ~RenderGraph()
+    {
+        releasePool();
+    }
+
+    // call when the window size changes: the whole pool is dropped and reallocated at the new size
+    void SetBackbufferSize(int width, int height)
+    {
+        if (width == backbufferWidth && height == backbufferHeight)
+            return;
+        backbufferWidth = width;
+        backbufferHeight = height;
+        releasePool();
+    }
+
+    void AddPass(const string &name, function<void(RenderPassBuilder &)> setup, function<void(const RenderPassResources &)> execute)
+    {
+        RenderPass pass;
+        pass.Name = name;
+        pass.Execute = execute;
+        pass.Backbuffer = false;
+        passes.push_back(pass);
+        RenderPassBuilder builder(*this, passes.size() - 1);
+        setup(builder);
+    }
+
+    // runs the passes added since the last call, then clears them for the next frame
+    void Execute()
+    {
+        frame++;
+        compile();
+
+        Stats = RenderGraphStats();
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            RenderPass &pass = passes[i];
+            if (pass.Culled)
+            {
+                Stats.CulledPasses++;
+                continue;
+            }
+            Stats.Passes++;
+            for (unsigned int r = 0; r < resources.size(); r++)
+                if (resources[r].First == (int)i)
+                    acquire(resources[r]);
+
+            RenderPassResources context(*this);
+            bindTargets(pass, context);
+            pass.Execute(context);
+
+            for (unsigned int r = 0; r < resources.size(); r++)
+                if (resources[r].Last == (int)i)
+                    pool[resources[r].Texture].InUse = false;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        for (unsigned int r = 0; r < resources.size(); r++)
+            if (resources[r].First >= 0)
+            {
+                Stats.Resources++;
+                Stats.RequestedBytes += pool[resources[r].Texture].Bytes;
+            }
+        trimPool();
+        for (unsigned int t = 0; t < pool.size(); t++)
+        {
+            Stats.Textures++;
+            Stats.PoolBytes += pool[t].Bytes;
+        }
+        passes.clear();
+        resources.clear();
+    }
+
+    void PrintStats() const
+    {
+        cout << "render graph: " << Stats.Passes << " passes (" << Stats.CulledPasses << " culled), "
+             << Stats.Resources << " targets in " << Stats.Textures << " textures, "
+             << Stats.PoolBytes / (1024.0 * 1024.0) << " MB (" << Stats.RequestedBytes / (1024.0 * 1024.0)
+             << " MB without aliasing)" << endl;
+    }
+
+private:
+    friend class RenderPassBuilder;
+    friend class RenderPassResources;
+
+    struct RenderPass {
+        string Name;
+        function<void(const RenderPassResources &)> Execute;
+        vector<RenderResource> Reads, Writes;
+        bool Backbuffer;
+        bool Culled;
+        int RefCount;
+    };
+
+    struct TransientResource {
+        string Name;
+        RenderTargetDesc Desc;
+        vector<unsigned int> Writers;
+        int RefCount;
+        int First, Last;            // first and last pass using the target, -1 if every user was culled
+        unsigned int Texture;       // index into the pool while the target is alive
+    };
+
+    struct PooledTexture {
+        unsigned int ID;
+        GLenum InternalFormat;
+        int Width, Height;
+        size_t Bytes;
+        bool InUse;
+        unsigned int LastUsedFrame;
+    };
+
+    // pool textures not handed out for this many frames are deleted
+    static const unsigned int MAX_UNUSED_FRAMES = 120;
+
+    vector<RenderPass> passes;
+    vector<TransientResource> resources;
+    vector<PooledTexture> pool;
+    map<vector<unsigned int>, unsigned int> framebuffers;   // attached texture IDs -> framebuffer object
+    int backbufferWidth, backbufferHeight;
+    unsigned int frame;
+
+    // reference counting from the outputs back: a pass survives if something it writes is read by a surviving
+    // pass, or if it renders to the backbuffer
+    void compile()
+    {
+        for (unsigned int r = 0; r < resources.size(); r++)
+        {
+            resources[r].RefCount = 0;
+            resources[r].First = resources[r].Last = -1;
+        }
+        for (unsigned int p = 0; p < passes.size(); p++)
+        {
+            passes[p].Culled = false;
+            passes[p].RefCount = passes[p].Writes.size() + (passes[p].Backbuffer ? 1 : 0);
+            for (unsigned int i = 0; i < passes[p].Reads.size(); i++)
+                resources[passes[p].Reads[i]].RefCount++;
+        }
+
+        vector<RenderResource> unreferenced;
+        for (unsigned int r = 0; r < resources.size(); r++)
+            if (resources[r].RefCount == 0)
+                unreferenced.push_back(r);
+        for (unsigned int p = 0; p < passes.size(); p++)
+            if (passes[p].RefCount == 0)
+                cull(passes[p], unreferenced);
+        while (!unreferenced.empty())
+        {
+            TransientResource &resource = resources[unreferenced.back()];
+            unreferenced.pop_back();
+            for (unsigned int w = 0; w < resource.Writers.size(); w++)
+            {
+                RenderPass &writer = passes[resource.Writers[w]];
+                if (--writer.RefCount == 0)
+                    cull(writer, unreferenced);
+            }
+        }
+
+        for (unsigned int p = 0; p < passes.size(); p++)
+        {
+            if (passes[p].Culled)
+                continue;
+            for (unsigned int i = 0; i < passes[p].Reads.size(); i++)
+                extendLifetime(resources[passes[p].Reads[i]], p);
+            for (unsigned int i = 0; i < passes[p].Writes.size(); i++)
+                extendLifetime(resources[passes[p].Writes[i]], p);
+        }
+    }
+
+    // culls pass, and queues the targets it read that no one else reads now
+    void cull(RenderPass &pass, vector<RenderResource> &unreferenced)
+    {
+        pass.Culled = true;
+        for (unsigned int i = 0; i < pass.Reads.size(); i++)
+            if (--resources[pass.Reads[i]].RefCount == 0)
+                unreferenced.push_back(pass.Reads[i]);
+    }
+
+    static void extendLifetime(TransientResource &resource, unsigned int pass)
+    {
+        if (resource.First < 0)
+            resource.First = pass;
+        resource.Last = pass;
+    }
+
+    void resolveSize(const RenderTargetDesc &desc, int &width, int &height) const
+    {
+        if (desc.Width > 0)
+        {
+            width = desc.Width;
+            height = desc.Height;
+            return;
+        }
+        width = max(1, (int)(backbufferWidth * desc.Scale + 0.5f));
+        height = max(1, (int)(backbufferHeight * desc.Scale + 0.5f));
+    }
+
+    // finds a free pool texture of the right size and format, or makes one. a new texture takes the place of a
+    // texture of the same format that hasn't been used this frame: when target sizes change (a resize, dynamic
+    // resolution) the old sizes are dropped right away instead of piling up until they are trimmed.
+    void acquire(TransientResource &resource)
+    {
+        int width, height;
+        resolveSize(resource.Desc, width, height);
+        int stale = -1;
+        for (unsigned int t = 0; t < pool.size(); t++)
+        {
+            PooledTexture &texture = pool[t];
+            if (texture.InUse || texture.InternalFormat != resource.Desc.InternalFormat)
+                continue;
+            if (texture.Width == width && texture.Height == height)
+            {
+                texture.InUse = true;
+                texture.LastUsedFrame = frame;
+                resource.Texture = t;
+                return;
+            }
+            if (stale < 0 && texture.LastUsedFrame != frame)
+                stale = t;
+        }
+
+        PooledTexture texture;
+        GLenum format, type;
+        unsigned int bytesPerPixel;
+        formatInfo(resource.Desc.InternalFormat, format, type, bytesPerPixel);
+        glGenTextures(1, &texture.ID);
+        glBindTexture(GL_TEXTURE_2D, texture.ID);
+        glTexImage2D(GL_TEXTURE_2D, 0, resource.Desc.InternalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        texture.InternalFormat = resource.Desc.InternalFormat;
+        texture.Width = width;
+        texture.Height = height;
+        texture.Bytes = (size_t)width * height * bytesPerPixel;
+        texture.InUse = true;
+        texture.LastUsedFrame = frame;
+        if (stale >= 0)
+        {
+            // pool indices of live targets stay valid, only framebuffers may refer to the old texture
+            glDeleteTextures(1, &pool[stale].ID);
+            releaseFramebuffers();
+            pool[stale] = texture;
+            resource.Texture = stale;
+        }
+        else
+        {
+            pool.push_back(texture);
+            resource.Texture = pool.size() - 1;
+        }
+    }
+
+    // binds (and if needed creates) the framebuffer with every target the pass writes
+    void bindTargets(const RenderPass &pass, RenderPassResources &context)
+    {
+        if (pass.Backbuffer)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            context.Width = backbufferWidth;
+            context.Height = backbufferHeight;
+            glViewport(0, 0, context.Width, context.Height);
+            return;
+        }
+
+        vector<unsigned int> key;
+        for (unsigned int i = 0; i < pass.Writes.size(); i++)
+            key.push_back(pool[resources[pass.Writes[i]].Texture].ID);
+        map<vector<unsigned int>, unsigned int>::iterator found = framebuffers.find(key);
+        if (found != framebuffers.end())
+            glBindFramebuffer(GL_FRAMEBUFFER, found->second);
+        else
+        {
+            unsigned int fbo;
+            glGenFramebuffers(1, &fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            vector<GLenum> drawBuffers;
+            for (unsigned int i = 0; i < pass.Writes.size(); i++)
+            {
+                const PooledTexture &texture = pool[resources[pass.Writes[i]].Texture];
+                GLenum attachment = depthAttachment(texture.InternalFormat);
+                if (attachment == GL_NONE)
+                {
+                    attachment = GL_COLOR_ATTACHMENT0 + drawBuffers.size();
+                    drawBuffers.push_back(attachment);
+                }
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture.ID, 0);
+            }
+            if (drawBuffers.empty())
+                glDrawBuffer(GL_NONE);
+            else
+                glDrawBuffers(drawBuffers.size(), &drawBuffers[0]);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                cout << "ERROR::FRAMEBUFFER:: Framebuffer of pass " << pass.Name << " not complete!" << endl;
+            framebuffers[key] = fbo;
+        }
+        const PooledTexture &first = pool[resources[pass.Writes[0]].Texture];
+        context.Width = first.Width;
+        context.Height = first.Height;
+        glViewport(0, 0, context.Width, context.Height);
+    }
+
+    // deletes pool textures that haven't been needed for a while, along with the framebuffers using them
+    void trimPool()
+    {
+        bool trimmed = false;
+        for (unsigned int t = 0; t < pool.size();)
+        {
+            if (frame - pool[t].LastUsedFrame > MAX_UNUSED_FRAMES)
+            {
+                glDeleteTextures(1, &pool[t].ID);
+                pool.erase(pool.begin() + t);
+                trimmed = true;
+            }
+            else
+                t++;
+        }
+        if (trimmed)
+            releaseFramebuffers();
+    }
+
+    void releaseFramebuffers()
+    {
+        for (map<vector<unsigned int>, unsigned int>::iterator it = framebuffers.begin(); it != framebuffers.end(); ++it)
+            glDeleteFramebuffers(1, &it->second);
+        framebuffers.clear();
+    }
+
+    void releasePool()
+    {
+        releaseFramebuffers();
+        for (unsigned int t = 0; t < pool.size(); t++)
+            glDeleteTextures(1, &pool[t].ID);
+        pool.clear();
+    }
+
+    static GLenum depthAttachment(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_DEPTH24_STENCIL8:
+        case GL_DEPTH32F_STENCIL8:
+            return GL_DEPTH_STENCIL_ATTACHMENT;
+        case GL_DEPTH_COMPONENT16:
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F:
+            return GL_DEPTH_ATTACHMENT;
+        default:
+            return GL_NONE;
+        }
+    }
+
+    // upload format and type for allocating a texture, and its (estimated) size per pixel in video memory;
+    // three component formats are counted as padded to four
+    static void formatInfo(GLenum internalFormat, GLenum &format, GLenum &type, unsigned int &bytesPerPixel)
+    {
+        format = GL_RGBA;
+        type = GL_UNSIGNED_BYTE;
+        bytesPerPixel = 4;
+        switch (internalFormat)
+        {
+        case GL_R8:                 format = GL_RED; bytesPerPixel = 1; break;
+        case GL_RG8:                format = GL_RG; bytesPerPixel = 2; break;
+        case GL_RGB8:               format = GL_RGB; break;
+        case GL_R16F:               format = GL_RED; type = GL_HALF_FLOAT; bytesPerPixel = 2; break;
+        case GL_RG16F:              format = GL_RG; type = GL_HALF_FLOAT; break;
+        case GL_RGB16F:             format = GL_RGB; type = GL_HALF_FLOAT; bytesPerPixel = 8; break;
+        case GL_RGBA16F:            type = GL_HALF_FLOAT; bytesPerPixel = 8; break;
+        case GL_R11F_G11F_B10F:     format = GL_RGB; type = GL_HALF_FLOAT; break;
+        case GL_R32F:               format = GL_RED; type = GL_FLOAT; break;
+        case GL_RGBA32F:            type = GL_FLOAT; bytesPerPixel = 16; break;
+        case GL_DEPTH24_STENCIL8:   format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; break;
+        case GL_DEPTH32F_STENCIL8:  format = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; bytesPerPixel = 8; break;
+        case GL_DEPTH_COMPONENT16:  format = GL_DEPTH_COMPONENT; type = GL_UNSIGNED_SHORT; bytesPerPixel = 2; break;
+        case GL_DEPTH_COMPONENT24:  format = GL_DEPTH_COMPONENT; type = GL_UNSIGNED_INT; break;
+        case GL_DEPTH_COMPONENT32F: format = GL_DEPTH_COMPONENT; type = GL_FLOAT; break;
+        default: break;
+        }
+    }
+};
+
+inline RenderResource RenderPassBuilder::Create(const string &name, const RenderTargetDesc &desc)
+{
+    RenderGraph::TransientResource resource;
+    resource.Name = name;
+    resource.Desc = desc;
+    resource.Texture = 0;
+    graph.resources.push_back(resource);
+    return Write(graph.resources.size() - 1);
+}
+
+inline RenderResource RenderPassBuilder::Read(RenderResource resource)
+{
+    graph.passes[pass].Reads.push_back(resource);
+    return resource;
+}
+
+inline RenderResource RenderPassBuilder::Write(RenderResource resource)
+{
+    graph.passes[pass].Writes.push_back(resource);
+    graph.resources[resource].Writers.push_back(pass);
+    return resource;
+}
+
+inline void RenderPassBuilder::WriteBackbuffer()
+{
+    graph.passes[pass].Backbuffer = true;
+}
+
+inline unsigned int RenderPassResources::Texture(RenderResource resource) const
+{
+    return graph.pool[graph.resources[resource].Texture].ID;
+}
+#endif
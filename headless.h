@@ -0,0 +1,540 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <dlfcn.h>
+using namespace std;
+
+// Runs a demo without a window, for benchmarking on machines without a display or a GPU (Mesa's llvmpipe works).
+//
+//   demo --headless [FRAMES] [--warmup FRAMES] [--report FILE]
+//
+// renders FRAMES frames (DEFAULT_FRAMES when the count is left out) offscreen and prints (or writes to FILE) a
+// JSON report with the CPU frame times, the GPU times, and the draw calls and triangles per frame. The first
+// warmup frames (10 by default) are left out.
+//
+// The OpenGL context comes from EGL on Mesa's surfaceless platform, which needs neither a display nor a window
+// system; libEGL is opened at run time so the demos link exactly as before. The context has no default
+// framebuffer, so the "window" is a framebuffer object: binding framebuffer 0 binds it instead, and GL_BACK as a
+// draw or read buffer means its color attachment. Draw calls are counted by swapping glad's function pointers for
+// small wrappers, the GPU time of each frame is measured with a pair of GL_TIMESTAMP queries (which, unlike
+// GL_TIME_ELAPSED, can't clash with a demo's own timers). Time() advances a fixed 1/60 s per frame and MoveCamera
+// flies the camera once around what it looks at, so every run renders the same frames.
+//
+// A demo uses it like this:
+//
+//   Headless headless(argc, argv);
+//   if (headless.Enabled) { if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT)) return -1; }
+//   else { ...create the window and load glad as usual... }
+//   while (headless.Running(window)) {
+//       float currentFrame = headless.Time();
+//       if (headless.Enabled) headless.MoveCamera(camera); else processInput(window);
+//       ...render...
+//       headless.SwapBuffers(window);
+//   }
+class Headless
+{
+public:
+    static const unsigned int DEFAULT_FRAMES = 600;
+
+    bool Enabled;               // --headless was given
+    unsigned int Frames;        // frames to render
+    unsigned int WarmupFrames;  // frames left out of the report
+    string ReportPath;          // empty: print the report
+    string Name;                // of the demo, from argv[0]
+    int Width, Height;          // of the offscreen framebuffer
+
+    Headless(int argc, char **argv)
+        : Enabled(false), Frames(0), WarmupFrames(10), Width(0), Height(0), frame(0), frameStart(0.0),
+          egl(NULL), display(NULL), context(NULL), framebuffer(0), colorBuffer(0), depthBuffer(0), pathSet(false)
+    {
+        Name = argc > 0 ? argv[0] : "demo";
+        size_t slash = Name.find_last_of('/');
+        if (slash != string::npos)
+            Name = Name.substr(slash + 1);
+        // the demos' own options are skipped
+        for (int i = 1; i < argc; i++)
+        {
+            bool hasValue = i + 1 < argc;
+            if (strcmp(argv[i], "--headless") == 0)
+            {
+                Enabled = true;
+                Frames = DEFAULT_FRAMES;
+                if (hasValue && isdigit((unsigned char)argv[i + 1][0]))
+                    Frames = (unsigned int)strtoul(argv[++i], NULL, 10);
+            }
+            else if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+                WarmupFrames = (unsigned int)strtoul(argv[++i], NULL, 10);
+            else if (strcmp(argv[i], "--report") == 0 && hasValue)
+                ReportPath = argv[++i];
+        }
+    }
+
+    ~Headless()
+    {
+        if (instance() == this)
+            instance() = NULL;
+        if (framebuffer)
+        {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+            glDeleteQueries(2 * QUERY_COUNT, &queries[0][0]);
+            for (unsigned int i = 0; i < QUERY_COUNT; i++)
+                if (fences[i])
+                    glDeleteSync(fences[i]);
+        }
+        if (context)
+        {
+            eglMakeCurrent(display, NULL, NULL, NULL);
+            eglDestroyContext(display, context);
+        }
+        if (display)
+            eglTerminate(display);
+        if (egl)
+            dlclose(egl);
+    }
+
+    // creates an OpenGL 3.3 core context and a width x height framebuffer (RGBA8, depth and stencil) standing in
+    // for the window, and loads glad. prints what went wrong and returns false on failure.
+    bool CreateContext(int width, int height)
+    {
+        egl = dlopen("libEGL.so.1", RTLD_NOW | RTLD_LOCAL);
+        if (!egl)
+        {
+            cout << "ERROR::HEADLESS:: Could not load libEGL.so.1: " << dlerror() << endl;
+            return false;
+        }
+        eglGetProcAddress = (GetProcAddressProc)dlsym(egl, "eglGetProcAddress");
+        eglInitialize = (InitializeProc)dlsym(egl, "eglInitialize");
+        eglBindAPI = (BindAPIProc)dlsym(egl, "eglBindAPI");
+        eglCreateContext = (CreateContextProc)dlsym(egl, "eglCreateContext");
+        eglMakeCurrent = (MakeCurrentProc)dlsym(egl, "eglMakeCurrent");
+        eglDestroyContext = (DestroyContextProc)dlsym(egl, "eglDestroyContext");
+        eglTerminate = (TerminateProc)dlsym(egl, "eglTerminate");
+        GetPlatformDisplayProc eglGetPlatformDisplay = eglGetProcAddress ?
+            (GetPlatformDisplayProc)eglGetProcAddress("eglGetPlatformDisplayEXT") : NULL;
+        if (!eglGetPlatformDisplay || !eglInitialize || !eglBindAPI || !eglCreateContext || !eglMakeCurrent ||
+            !eglDestroyContext || !eglTerminate)
+        {
+            cout << "ERROR::HEADLESS:: libEGL lacks the functions needed" << endl;
+            return false;
+        }
+
+        display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, NULL, NULL);
+        if (!display || !eglInitialize(display, NULL, NULL))
+        {
+            cout << "ERROR::HEADLESS:: No surfaceless EGL display (this needs Mesa)" << endl;
+            return false;
+        }
+        const int attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        if (eglBindAPI(EGL_OPENGL_API))
+            context = eglCreateContext(display, NULL, NULL, attributes);
+        if (!context || !eglMakeCurrent(display, NULL, NULL, context))
+        {
+            cout << "ERROR::HEADLESS:: Could not create an OpenGL 3.3 core context" << endl;
+            return false;
+        }
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        {
+            cout << "Failed to initialize GLAD" << endl;
+            return false;
+        }
+
+        Width = width;
+        Height = height;
+        glGenQueries(2 * QUERY_COUNT, &queries[0][0]);
+        for (unsigned int i = 0; i < QUERY_COUNT; i++)
+            fences[i] = NULL;
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            cout << "ERROR::HEADLESS:: Framebuffer is not complete" << endl;
+            return false;
+        }
+        // a window's context starts with a viewport covering the window, a surfaceless one with an empty one
+        glViewport(0, 0, width, height);
+
+        instance() = this;
+        hook();
+        return true;
+    }
+
+    // the condition of the render loop: with a window until it is closed, headless until all frames are rendered
+    // (then the report is written). starts timing the next frame.
+    bool Running(GLFWwindow *window)
+    {
+        if (!Enabled)
+            return !glfwWindowShouldClose(window);
+        if (frame >= Frames)
+        {
+            if (frame == Frames)
+            {
+                finish();
+                frame++;
+            }
+            return false;
+        }
+        drawCalls = 0;
+        triangles = 0;
+        frameStart = now();
+        glQueryCounter(queries[frame % QUERY_COUNT][0], GL_TIMESTAMP);
+        return true;
+    }
+
+    // ends the frame: swaps the window's buffers and polls its events, or headless, ends the frame's GPU timing
+    // and lets the GPU fall at most two frames behind, as a swap chain would
+    void SwapBuffers(GLFWwindow *window)
+    {
+        if (!Enabled)
+        {
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            return;
+        }
+        unsigned int slot = frame % QUERY_COUNT;
+        glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        if (frame >= LATENCY)
+            collect(frame - LATENCY);
+
+        cpuMs.push_back((now() - frameStart) * 1000.0);
+        drawCallCounts.push_back(drawCalls);
+        triangleCounts.push_back(triangles);
+        frame++;
+    }
+
+    // seconds since the start, advancing 1/60 s per frame when headless
+    double Time() const
+    {
+        return Enabled ? frame / 60.0 : glfwGetTime();
+    }
+
+    // wall clock seconds, for measuring how long something took
+    double Clock() const
+    {
+        return Enabled ? now() : glfwGetTime();
+    }
+
+    void GetFramebufferSize(GLFWwindow *window, int *width, int *height) const
+    {
+        if (!Enabled)
+            glfwGetFramebufferSize(window, width, height);
+        else
+        {
+            *width = Width;
+            *height = Height;
+        }
+    }
+
+    // moves a Camera (camera.h) along the path
+    template <typename CameraType>
+    void MoveCamera(CameraType &camera)
+    {
+        glm::vec3 front = camera.Front;
+        MoveCamera(camera.Position, front);
+        camera.Yaw = glm::degrees(atan2(front.z, front.x));
+        camera.Pitch = glm::degrees(asin(front.y));
+        camera.ProcessMouseMovement(0.0f, 0.0f);
+    }
+
+    // the camera path: one turn around the point the camera first looks at, at the distance of the origin (so
+    // a camera looking at the scene's center circles it), rising and falling a little on the way
+    void MoveCamera(glm::vec3 &position, glm::vec3 &front)
+    {
+        if (!pathSet)
+        {
+            float distance = glm::length(position) > 0.0f ? glm::length(position) : 3.0f;
+            pathCenter = position + glm::normalize(front) * distance;
+            pathStart = position - pathCenter;
+            pathSet = true;
+        }
+        float angle = 2.0f * glm::pi<float>() * frame / max(Frames, 1u);
+        glm::vec3 offset(pathStart.x * cos(angle) - pathStart.z * sin(angle),
+                         pathStart.y + glm::length(pathStart) * 0.2f * sin(2.0f * angle),
+                         pathStart.x * sin(angle) + pathStart.z * cos(angle));
+        position = pathCenter + offset;
+        front = glm::normalize(-offset);
+    }
+
+private:
+    // the few EGL declarations needed, so EGL's headers aren't required either
+    typedef void *(*GetProcAddressProc)(const char *name);
+    typedef void *(*GetPlatformDisplayProc)(unsigned int platform, void *nativeDisplay, const int *attributes);
+    typedef unsigned int (*InitializeProc)(void *display, int *major, int *minor);
+    typedef unsigned int (*BindAPIProc)(unsigned int api);
+    typedef void *(*CreateContextProc)(void *display, void *config, void *shareContext, const int *attributes);
+    typedef unsigned int (*MakeCurrentProc)(void *display, void *draw, void *read, void *context);
+    typedef unsigned int (*DestroyContextProc)(void *display, void *context);
+    typedef unsigned int (*TerminateProc)(void *display);
+    enum {
+        EGL_NONE = 0x3038,
+        EGL_OPENGL_API = 0x30A2,
+        EGL_CONTEXT_MAJOR_VERSION = 0x3098,
+        EGL_CONTEXT_MINOR_VERSION = 0x30FB,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK = 0x30FD,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT = 0x1,
+        EGL_PLATFORM_SURFACELESS_MESA = 0x31DD
+    };
+
+    static const unsigned int QUERY_COUNT = 4;
+    static const unsigned int LATENCY = 2;         // frames the GPU may lag behind
+
+    unsigned int frame;
+    double frameStart;
+    unsigned long long drawCalls, triangles;       // of the current frame
+    vector<double> cpuMs, gpuMs;
+    vector<unsigned long long> drawCallCounts, triangleCounts;
+
+    void *egl;
+    void *display, *context;
+    GetProcAddressProc eglGetProcAddress;
+    InitializeProc eglInitialize;
+    BindAPIProc eglBindAPI;
+    CreateContextProc eglCreateContext;
+    MakeCurrentProc eglMakeCurrent;
+    DestroyContextProc eglDestroyContext;
+    TerminateProc eglTerminate;
+
+    unsigned int framebuffer, colorBuffer, depthBuffer;
+    unsigned int queries[QUERY_COUNT][2];    // start and end of a frame
+    GLsync fences[QUERY_COUNT];
+
+    bool pathSet;
+    glm::vec3 pathCenter, pathStart;
+
+    // glad's original functions, called by the wrappers
+    PFNGLDRAWARRAYSPROC drawArrays;
+    PFNGLDRAWELEMENTSPROC drawElements;
+    PFNGLDRAWARRAYSINSTANCEDPROC drawArraysInstanced;
+    PFNGLDRAWELEMENTSINSTANCEDPROC drawElementsInstanced;
+    PFNGLBINDFRAMEBUFFERPROC bindFramebuffer;
+    PFNGLDRAWBUFFERPROC drawBuffer;
+    PFNGLDRAWBUFFERSPROC drawBuffers;
+    PFNGLREADBUFFERPROC readBuffer;
+
+    static double now()
+    {
+        return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // the wrappers are plain functions, they find the object through this
+    static Headless *&instance()
+    {
+        static Headless *headless = NULL;
+        return headless;
+    }
+
+    void hook()
+    {
+        drawArrays = glad_glDrawArrays;
+        drawElements = glad_glDrawElements;
+        drawArraysInstanced = glad_glDrawArraysInstanced;
+        drawElementsInstanced = glad_glDrawElementsInstanced;
+        bindFramebuffer = glad_glBindFramebuffer;
+        drawBuffer = glad_glDrawBuffer;
+        drawBuffers = glad_glDrawBuffers;
+        readBuffer = glad_glReadBuffer;
+        glad_glDrawArrays = hookedDrawArrays;
+        glad_glDrawElements = hookedDrawElements;
+        glad_glDrawArraysInstanced = hookedDrawArraysInstanced;
+        glad_glDrawElementsInstanced = hookedDrawElementsInstanced;
+        glad_glBindFramebuffer = hookedBindFramebuffer;
+        glad_glDrawBuffer = hookedDrawBuffer;
+        glad_glDrawBuffers = hookedDrawBuffers;
+        glad_glReadBuffer = hookedReadBuffer;
+    }
+
+    static unsigned long long triangleCount(GLenum mode, GLsizei count)
+    {
+        switch (mode)
+        {
+        case GL_TRIANGLES:
+            return count / 3;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:
+            return count > 2 ? count - 2 : 0;
+        case GL_TRIANGLES_ADJACENCY:
+            return count / 6;
+        case GL_TRIANGLE_STRIP_ADJACENCY:
+            return count >= 6 ? (count - 4) / 2 : 0;
+        default:
+            return 0;
+        }
+    }
+
+    static void count(GLenum mode, GLsizei count, GLsizei instances)
+    {
+        Headless *headless = instance();
+        headless->drawCalls++;
+        headless->triangles += triangleCount(mode, count) * instances;
+    }
+
+    static void APIENTRY hookedDrawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        Headless::count(mode, count, 1);
+        instance()->drawArrays(mode, first, count);
+    }
+
+    static void APIENTRY hookedDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+    {
+        Headless::count(mode, count, 1);
+        instance()->drawElements(mode, count, type, indices);
+    }
+
+    static void APIENTRY hookedDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+    {
+        Headless::count(mode, count, instances);
+        instance()->drawArraysInstanced(mode, first, count, instances);
+    }
+
+    static void APIENTRY hookedDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instances)
+    {
+        Headless::count(mode, count, instances);
+        instance()->drawElementsInstanced(mode, count, type, indices, instances);
+    }
+
+    // framebuffer 0 and its buffers are the offscreen framebuffer
+    static void APIENTRY hookedBindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        instance()->bindFramebuffer(target, framebuffer == 0 ? instance()->framebuffer : framebuffer);
+    }
+
+    static GLenum windowBuffer(GLenum buffer)
+    {
+        bool window = buffer == GL_BACK || buffer == GL_FRONT || buffer == GL_BACK_LEFT || buffer == GL_FRONT_LEFT;
+        return window ? GL_COLOR_ATTACHMENT0 : buffer;
+    }
+
+    static void APIENTRY hookedDrawBuffer(GLenum buffer)
+    {
+        instance()->drawBuffer(windowBuffer(buffer));
+    }
+
+    static void APIENTRY hookedDrawBuffers(GLsizei count, const GLenum *buffers)
+    {
+        vector<GLenum> mapped(buffers, buffers + max(count, 0));
+        for (unsigned int i = 0; i < mapped.size(); i++)
+            mapped[i] = windowBuffer(mapped[i]);
+        instance()->drawBuffers(count, mapped.empty() ? buffers : &mapped[0]);
+    }
+
+    static void APIENTRY hookedReadBuffer(GLenum buffer)
+    {
+        instance()->readBuffer(windowBuffer(buffer));
+    }
+
+    // waits for frame's fence and reads its GPU time
+    void collect(unsigned int collected)
+    {
+        unsigned int slot = collected % QUERY_COUNT;
+        glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        glDeleteSync(fences[slot]);
+        fences[slot] = NULL;
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+        gpuMs.push_back((end - start) / 1e6);
+    }
+
+    void finish()
+    {
+        for (unsigned int i = Frames > LATENCY ? Frames - LATENCY : 0; i < Frames; i++)
+            collect(i);
+        unsigned int skipped = min(WarmupFrames, Frames / 2);
+
+        string json = "{\n";
+        char line[256];
+        const char *renderer = (const char *)glGetString(GL_RENDERER);
+        json += "  \"demo\": " + jsonString(Name) + ",\n  \"renderer\": " + jsonString(renderer ? renderer : "") + ",\n";
+        snprintf(line, sizeof(line), "  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %u,\n  \"warmup_frames\": %u,\n",
+                 Width, Height, Frames - skipped, skipped);
+        json += line;
+        json += summary("cpu_ms", vector<double>(cpuMs.begin() + skipped, cpuMs.end())) + ",\n";
+        json += summary("gpu_ms", vector<double>(gpuMs.begin() + skipped, gpuMs.end())) + ",\n";
+        json += summary("draw_calls", vector<double>(drawCallCounts.begin() + skipped, drawCallCounts.end())) + ",\n";
+        json += summary("triangles", vector<double>(triangleCounts.begin() + skipped, triangleCounts.end())) + "\n}\n";
+
+        if (ReportPath.empty())
+        {
+            cout << json;
+            return;
+        }
+        FILE *file = fopen(ReportPath.c_str(), "w");
+        if (!file || fputs(json.c_str(), file) < 0)
+            cout << "ERROR::HEADLESS:: Could not write " << ReportPath << endl;
+        if (file)
+            fclose(file);
+    }
+
+    // text as a quoted JSON string
+    static string jsonString(const string &text)
+    {
+        string quoted = "\"";
+        for (unsigned int i = 0; i < text.size(); i++)
+        {
+            unsigned char c = text[i];
+            if (c == '"' || c == '\\')
+                quoted += string("\\") + (char)c;
+            else if (c < 0x20)
+            {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                quoted += escape;
+            }
+            else
+                quoted += (char)c;
+        }
+        return quoted + "\"";
+    }
+
+    static string summary(const char *name, vector<double> values)
+    {
+        char text[256];
+        if (values.empty())
+        {
+            snprintf(text, sizeof(text), "  \"%s\": null", name);
+            return text;
+        }
+        double sum = 0.0;
+        for (unsigned int i = 0; i < values.size(); i++)
+            sum += values[i];
+        sort(values.begin(), values.end());
+        snprintf(text, sizeof(text), "  \"%s\": { \"mean\": %.3f, \"min\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"max\": %.3f }",
+                 name, sum / values.size(), values.front(), values[values.size() / 2],
+                 values[min(values.size() - 1, (size_t)(values.size() * 0.95))], values.back());
+        return text;
+    }
+};
+#endif
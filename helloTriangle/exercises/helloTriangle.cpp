@@ -1,6 +1,7 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include "../../headless.h"
 
 using namespace std; 
 
@@ -39,35 +40,46 @@ const char *fragShaderSourceTwo = "#version 330 core\n" // Declare version
 	"	FragColor = vec4(1.0f, 1.0f, 0.0f, 1.0f);\n"
 	"}\0";
 // Main 
-int main()
+int main(int argc, char **argv)
 {
-	// Initialize GLFW 
-	glfwInit();
-	// Configure GLFW 
-	// First argument defines option to configure 
-	// Second argument sets the value of option 
-	// Define version of OpenGL in use 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
-	// Define Core_Profile mode 
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	
-	// Create window object 
-	GLFWwindow* window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
-	if (window == NULL){ 
-		cout << "Failed to create GLFW window" << endl;
-		return -1;
+	// --headless renders offscreen instead, see headless.h
+	Headless headless(argc, argv);
+	GLFWwindow* window = NULL;
+	if (headless.Enabled)
+	{
+		if (!headless.CreateContext(800, 600))
+			return -1;
 	}
-	// Make the context of window the main context for current thread
-	glfwMakeContextCurrent(window);
-	// callback function for resizing window 
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); 
-
-	// Initialize glad 
-	if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) 
+	else
 	{
-		cout << "Failed to initialize GLAD" << endl;
-		return -1; 
+		// Initialize GLFW 
+		glfwInit();
+		// Configure GLFW 
+		// First argument defines option to configure 
+		// Second argument sets the value of option 
+		// Define version of OpenGL in use 
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
+		// Define Core_Profile mode 
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		
+		// Create window object 
+		window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
+		if (window == NULL){ 
+			cout << "Failed to create GLFW window" << endl;
+			return -1;
+		}
+		// Make the context of window the main context for current thread
+		glfwMakeContextCurrent(window);
+		// callback function for resizing window 
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); 
+
+		// Initialize glad 
+		if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) 
+		{
+			cout << "Failed to initialize GLAD" << endl;
+			return -1; 
+		}
 	}
 
 	// Build and Compile Shader Program 
@@ -204,10 +216,11 @@ int main()
  
 	// Set-up render loop
 	// Check if GLFW has been instructed to close
-	while(!glfwWindowShouldClose(window))
+	while (headless.Running(window))
 	{
 		//Catch inputs 
-		processInput(window); 
+		if (!headless.Enabled)
+			processInput(window);
 		
 		// Rendering commands here: 
 		// Clear screen with color of choice 
@@ -236,9 +249,7 @@ int main()
 
 		// Swap color buffer that has been used to draw in
 		// during this iteration and show as output onto screen
-		glfwSwapBuffers(window);
-		// Check if any events are triggered 
-		glfwPollEvents();
+		headless.SwapBuffers(window);
 	
 	}	
 	// Terminate after exiting render loop
@@ -8,10 +8,18 @@
 #include "camera.h"
 #include "shader_m.h"
 #include "model.h"
+#include "instanceGenerator.h"
+#include "impostor.h"
+#include "spatialGrid.h"
+#include "broadphase.h"
+#include "../pickBuffer.h"
 
 #include <iostream>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <experimental/filesystem>
+#include "../headless.h"
 
 using namespace std;
 
@@ -19,6 +27,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
+glm::vec4 boundingSphere(const glm::mat4 &model, const glm::vec3 &center, float radius);
+void pickPosition(GLFWwindow *window, int width, int height, int &x, int &y);
 
 // settings
 const unsigned int SCR_WIDTH = 1280;
@@ -34,166 +44,308 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
-{
-	glfwInit();
-  	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	#ifdef __APPLE__
-    		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
-	#endif
-
-	// glfw window creation
-   	// --------------------
-    	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    	if (window == NULL)
-    	{
-        	cout << "Failed to create GLFW window" << endl;
-        	glfwTerminate();
-        	return -1;
-    	}
-    	glfwMakeContextCurrent(window);
-    	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    	glfwSetCursorPosCallback(window, mouse_callback);
-    	glfwSetScrollCallback(window, scroll_callback);
-
-    	// tell GLFW to capture our mouse
-   	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-	// glad: load all OpenGL function pointers
-    	// ---------------------------------------
-    	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    	{
-        	cout << "Failed to initialize GLAD" << endl;
-        	return -1;
-    	}
+// impostors
+bool impostorsEnabled = true;
+bool impostorKeyPressed = false;
 
-	// Configure global opengl state
- 	glEnable(GL_DEPTH_TEST);
-	
-	// Shaders 
-	Shader instanceShader("asteroidFieldInstance.vs", "asteroidField.fs");
-	Shader shader("asteroidField.vs", "asteroidField.fs");
+// picking: C frees the cursor to point at things, while it's captured the center of the window is picked
+bool cursorFree = false;
+bool cursorKeyPressed = false;
+const unsigned int PICK_PLANET = 1;
+const unsigned int PICK_ROCK = 2;
 
-	// Load models 
-	Model rockModel("rock/rock.obj");
-	Model planetModel("planet/planet.obj");
-	
-	// Generate positions 
+// usage: asteroidField [--seed N] [--amount N] [--impostor-distance D] [--blend-range B] [--orbit] [--pick]
+int main(int argc, char **argv)
+{
+	// command line options
+	uint32_t seed = 1;
 	unsigned int amount = 2000;
-	glm::mat4 *modelMatrices;
-	modelMatrices = new glm::mat4[amount];
-	// Initialize random seed 
-	srand(glfwGetTime());
-	float radius = 50.0;
-	float offset = 5.0f;
-	for (unsigned int i = 0; i < amount; i++) 
+	float impostorDistance = 60.0f;	// rocks farther away than this are drawn as impostors
+	float blendRange = 5.0f;	// width of the band in which mesh and impostor are cross-faded, 0 switches instantly
+	bool orbit = false;		// let the rocks orbit the planet and find the pairs whose bounding boxes overlap every frame
+	bool pick = false;		// report the rock (by index) or planet mesh under the cursor whenever it changes
+	for (int i = 1; i < argc; i++)
 	{
-		glm::mat4 model;
-		// translation: displace along circle with radius in range [-offset, offset]
-		float angle = (float) i / (float) amount * 360.0f;
-		float displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-		float x = sin(angle) * radius + displacement;
-		displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-		float y = displacement * 0.4f; // Keep height of field smaller compared to width of x and z 
-		displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset; 
-		float z = cos(angle) * radius + displacement; 
-		model = glm::translate(model, glm::vec3(x, y, z));
-		
-		// scale 
-		float scale = (rand() % 20) / 100.0 + 0.05;
-		model = glm::scale(model, glm::vec3(scale));
-
-		// rotation: add random rotation around semi-randomly picked rotation axis
-		float rotAngle = (rand() % 360);
-		model = glm::scale(model, glm::vec3(scale));
+		if (strcmp(argv[i], "--orbit") == 0)
+			orbit = true;
+		else if (strcmp(argv[i], "--pick") == 0)
+			pick = true;
+		else if (i + 1 >= argc)
+			break;
+		else if (strcmp(argv[i], "--seed") == 0)
+			seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--amount") == 0)
+			amount = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--impostor-distance") == 0)
+			impostorDistance = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--blend-range") == 0)
+			blendRange = (float)atof(argv[++i]);
+	}
 
-		// Add to list of matrices 
-		modelMatrices[i] = model;
+	// --headless renders offscreen instead, see headless.h
+	Headless headless(argc, argv);
+	GLFWwindow* window = NULL;
+	if (headless.Enabled)
+	{
+		if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT))
+			return -1;
 	}
+	else
+	{
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+		#ifdef __APPLE__
+			glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
+		#endif
+
+		// glfw window creation
+		// --------------------
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+		if (window == NULL)
+		{
+			cout << "Failed to create GLFW window" << endl;
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		glfwSetCursorPosCallback(window, mouse_callback);
+		glfwSetScrollCallback(window, scroll_callback);
+
+		// tell GLFW to capture our mouse
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+		// glad: load all OpenGL function pointers
+		// ---------------------------------------
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			cout << "Failed to initialize GLAD" << endl;
+			return -1;
+		}
+	}
+
+	// Configure global opengl state
+	glEnable(GL_DEPTH_TEST);
 	
-	// vertex buffer object 
-	unsigned int buffer;
-	glGenBuffers(1, &buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
-	glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-	
-	for(unsigned int i = 0; i < rockModel.meshes.size(); i++)
+	// the impostor's and the rocks' instance buffers and the pick buffer delete their GL objects when they go out
+	// of scope, which has to happen while the context still exists, before glfwTerminate
 	{
-    		unsigned int VAO = rockModel.meshes[i].VAO;
-   		glBindVertexArray(VAO);
-    		// vertex Attributes
-    		GLsizei vec4Size = sizeof(glm::vec4);
-    		glEnableVertexAttribArray(3); 
-    		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)0);
-    		glEnableVertexAttribArray(4); 
-    		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(vec4Size));
-    		glEnableVertexAttribArray(5); 
-    		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(2 * vec4Size));
-    		glEnableVertexAttribArray(6); 
-    		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(3 * vec4Size));
-
-    		glVertexAttribDivisor(3, 1);
-    		glVertexAttribDivisor(4, 1);
-    		glVertexAttribDivisor(5, 1);
-    		glVertexAttribDivisor(6, 1);
-
-   		glBindVertexArray(0);
-	} 
+		// Shaders 
+		Shader instanceShader("asteroidFieldInstance.vs", "asteroidFieldInstance.fs");
+		Shader shader("asteroidField.vs", "asteroidField.fs");
+		Shader impostorShader("impostor.vs", "impostor.fs");
+		Shader pickShader("pick.vs", "pick.fs");
+		Shader pickInstanceShader("pickInstance.vs", "pick.fs");
+
+		// Load models 
+		Model rockModel("rock/rock.obj");
+		Model planetModel("planet/planet.obj");
+
+		// Bake the rock's impostor atlas offscreen, with the plain model shader 
+		Impostor rockImpostor(rockModel, shader);
+		unsigned int rockTriangles = 0;
+		for (unsigned int i = 0; i < rockModel.meshes.size(); i++)
+			rockTriangles += rockModel.meshes[i].indices.size() / 3;
+	
+		// Generate positions 
+		// every rock is derived from its index and the seed only, so a given seed always reproduces the same field
+		glm::mat4 *modelMatrices;
+		modelMatrices = new glm::mat4[amount];
+		AsteroidFieldGenerator generator(seed);
+		double generateStart = headless.Clock();
+		generator.Generate(modelMatrices, amount);
+		cout << "Generated " << amount << " asteroids (seed " << seed << ") in " << (headless.Clock() - generateStart) * 1000.0 << " ms" << endl;
+	
+		// file the rocks' bounding spheres in a spatial hash grid so culling doesn't have to look at every rock
+		vector<glm::vec4> rockSpheres(amount);
+		for (unsigned int i = 0; i < amount; i++)
+			rockSpheres[i] = boundingSphere(modelMatrices[i], rockImpostor.Center, rockImpostor.Radius);
+		SpatialHashGrid rockGrid(2.0f);
+		rockGrid.Build(rockSpheres.data(), amount);
+		vector<unsigned int> visibleRocks;
+		vector<glm::mat4> visibleMatrices;
+
+		// orbits: inner rocks move faster (Kepler's third law), one revolution per minute at the ring's radius
+		vector<glm::mat4> initialMatrices(modelMatrices, modelMatrices + amount);
+		vector<float> orbitSpeeds(amount);
+		for (unsigned int i = 0; i < amount; i++)
+		{
+			float r = glm::max(glm::length(glm::vec2(modelMatrices[i][3].x, modelMatrices[i][3].z)), 1.0f);
+			orbitSpeeds[i] = glm::radians(6.0f) * pow(generator.Radius / r, 1.5f);
+		}
+		SweepAndPrune broadphase;
+
+		// per-instance data: a model matrix per rock, placed after the mesh's own vertex attributes (location 5 onwards)
+		InstanceLayout rockLayout;
+		rockLayout.Add("instanceMatrix", 16);
+		InstanceBuffer rockInstances(rockLayout);
+		vector<glm::mat4> meshInstances, impostorInstances;
+
+		// the picking pass draws the rocks under the cursor as meshes, with their index in a second instance buffer
+		PickBuffer pickBuffer(SCR_WIDTH, SCR_HEIGHT);
+		PickResult picked;
+		InstanceLayout pickIndexLayout;
+		pickIndexLayout.Add("instanceIndex", 1, GL_UNSIGNED_INT);
+		InstanceBuffer pickMatrixBuffer(rockLayout), pickIndexBuffer(pickIndexLayout);
+		vector<const InstanceBuffer*> pickBuffers;
+		pickBuffers.push_back(&pickMatrixBuffer);
+		pickBuffers.push_back(&pickIndexBuffer);
+		vector<unsigned int> pickRocks;
+		vector<glm::mat4> pickMatrices;
+		double lastReport = headless.Time();
  
-	// Render loop
-	while (!glfwWindowShouldClose(window))
-	{
-        	// per-frame time logic
-        	// --------------------
-        	float currentFrame = glfwGetTime();
-        	deltaTime = currentFrame - lastFrame;
-        	lastFrame = currentFrame;
-
-        	// input
-        	// -----
-        	processInput(window);
-
-        	// render
-        	// ------
-        	glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-        	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// Render loop
+		while (headless.Running(window))
+		{
+			// per-frame time logic
+			// --------------------
+			float currentFrame = headless.Time();
+			deltaTime = currentFrame - lastFrame;
+			lastFrame = currentFrame;
+
+			// input
+			// -----
+			if (headless.Enabled)
+				headless.MoveCamera(camera);
+			else
+				processInput(window);
+
+			// render
+			// ------
+			glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		
-		// configure transformation matrices 
-		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
-		glm::mat4 view = camera.GetViewMatrix();
-		shader.use();
-		shader.setMat4("projection", projection);
-		shader.setMat4("view", view);
-		instanceShader.use();
-		instanceShader.setMat4("projection", projection);
-		instanceShader.setMat4("view", view);
-
-		// Draw planet 
-		shader.use();
-		glm::mat4 model;
-		model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
-		shader.setMat4("model", model);
-		planetModel.Draw(shader);
+			// configure transformation matrices 
+			glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+			glm::mat4 view = camera.GetViewMatrix();
+			shader.use();
+			shader.setMat4("projection", projection);
+			shader.setMat4("view", view);
+			instanceShader.use();
+			instanceShader.setMat4("projection", projection);
+			instanceShader.setMat4("view", view);
+			instanceShader.setVec3("viewPos", camera.Position);
+			instanceShader.setFloat("impostorDistance", impostorsEnabled ? impostorDistance : 1e30f);
+			instanceShader.setFloat("blendRange", blendRange);
+			impostorShader.use();
+			impostorShader.setMat4("projection", projection);
+			impostorShader.setMat4("view", view);
+			impostorShader.setVec3("viewPos", camera.Position);
+			impostorShader.setFloat("impostorDistance", impostorDistance);
+			impostorShader.setFloat("blendRange", blendRange);
+
+			// Draw planet 
+			shader.use();
+			glm::mat4 model;
+			model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
+			model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
+			shader.setMat4("model", model);
+			planetModel.Draw(shader);
 		
 		
-		// draw meteorites
-		instanceShader.use();
-		for(unsigned int i = 0; i < rockModel.meshes.size(); i++)
-		{
-    			glBindVertexArray(rockModel.meshes[i].VAO);
-    			glDrawElementsInstanced(
-        			GL_TRIANGLES, rockModel.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, amount
-    			);
-		}  
-
-		// glfw: swap buffers and poll IO events
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-
+			// move the meteorites along their orbits, then refresh the grid and find the candidate pairs for collision tests
+			if (orbit)
+			{
+				parallelFor(amount, [&](size_t begin, size_t end, unsigned int) {
+					for (size_t i = begin; i < end; i++)
+					{
+						modelMatrices[i] = glm::rotate(glm::mat4(), orbitSpeeds[i] * currentFrame, glm::vec3(0.0f, 1.0f, 0.0f)) * initialMatrices[i];
+						rockSpheres[i] = boundingSphere(modelMatrices[i], rockImpostor.Center, rockImpostor.Radius);
+					}
+				});
+				rockGrid.Update(rockSpheres.data());
+				broadphase.FindPairs(rockSpheres.data(), amount);
+			}
+
+			// frustum cull the meteorites, then split the visible ones into full meshes and impostors by distance to the camera 
+			rockGrid.QueryFrustum(projection * view, visibleRocks);
+			visibleMatrices.resize(visibleRocks.size());
+			for (unsigned int i = 0; i < visibleRocks.size(); i++)
+				visibleMatrices[i] = modelMatrices[visibleRocks[i]];
+			if (impostorsEnabled)
+			{
+				Impostor::SplitByDistance(visibleMatrices.data(), visibleMatrices.size(), camera.Position, impostorDistance, blendRange, meshInstances, impostorInstances);
+			}
+			else
+			{
+				meshInstances = visibleMatrices;
+				impostorInstances.clear();
+			}
+			rockInstances.Upload(meshInstances.empty() ? NULL : &meshInstances[0], meshInstances.size());
+			rockImpostor.Instances.Upload(impostorInstances.empty() ? NULL : &impostorInstances[0], impostorInstances.size());
+
+			// draw meteorites
+			rockModel.DrawInstanced(instanceShader, rockInstances, meshInstances.size());
+			rockImpostor.Draw(impostorShader, impostorInstances.size());
+
+			// report how many triangles the impostors saved this frame, once a second
+			unsigned long long trianglesSaved = (unsigned long long)(visibleMatrices.size() - meshInstances.size()) * rockTriangles - impostorInstances.size() * 2ull;
+			if (currentFrame - lastReport >= 1.0)
+			{
+				cout << "visible: " << visibleRocks.size() << "/" << amount << "  meshes: " << meshInstances.size() << "  impostors: " << impostorInstances.size() << "  triangles saved: " << trianglesSaved;
+				if (orbit)
+					cout << "  candidate pairs: " << broadphase.Pairs.size();
+				cout << endl;
+				lastReport = currentFrame;
+			}
+
+			// picking: take the pick of the frame before if it's done, then draw this frame's ID pixel
+			if (pick)
+			{
+				PickResult result;
+				if (pickBuffer.Read(result) && result != picked)
+				{
+					picked = result;
+					if (picked.Object == PICK_ROCK)
+						cout << "picked: rock " << picked.Instance << endl;
+					else if (picked.Object == PICK_PLANET)
+						cout << "picked: planet, mesh " << picked.Instance << endl;
+					else
+						cout << "picked: nothing" << endl;
+				}
+
+				int width, height;
+				headless.GetFramebufferSize(window, &width, &height);
+				int x, y;
+				pickPosition(window, width, height, x, y);
+				pickBuffer.Resize(width, height);
+				pickBuffer.Begin(x, y);
+
+				// the planet mesh by mesh, so the pick tells them apart
+				pickShader.use();
+				pickShader.setMat4("projection", projection);
+				pickShader.setMat4("view", view);
+				pickShader.setMat4("model", model);
+				pickShader.setInt("object", PICK_PLANET);
+				for (unsigned int i = 0; i < planetModel.meshes.size(); i++)
+				{
+					pickShader.setInt("instance", i);
+					planetModel.meshes[i].Draw(pickShader);
+				}
+
+				// only the rocks whose spheres reach into the pixel, impostor or not
+				rockGrid.QueryFrustum(PickBuffer::PickProjection(projection, x, y, width, height) * view, pickRocks);
+				pickMatrices.resize(pickRocks.size());
+				for (unsigned int i = 0; i < pickRocks.size(); i++)
+					pickMatrices[i] = modelMatrices[pickRocks[i]];
+				pickMatrixBuffer.Upload(pickMatrices.empty() ? NULL : &pickMatrices[0], pickMatrices.size());
+				pickIndexBuffer.Upload(pickRocks.empty() ? NULL : &pickRocks[0], pickRocks.size());
+				pickInstanceShader.use();
+				pickInstanceShader.setMat4("projection", projection);
+				pickInstanceShader.setMat4("view", view);
+				pickInstanceShader.setInt("object", PICK_ROCK);
+				if (!pickRocks.empty())
+					rockModel.DrawInstanced(pickInstanceShader, pickBuffers, pickRocks.size());
+				pickBuffer.End();
+			}
+
+			// glfw: swap buffers and poll IO events
+			headless.SwapBuffers(window);
+
+		}
 	}
 
 	glfwTerminate();
@@ -207,6 +359,23 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    // I toggles the impostors so both paths can be compared
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS && !impostorKeyPressed)
+    {
+        impostorsEnabled = !impostorsEnabled;
+        cout << "impostors " << (impostorsEnabled ? "on" : "off") << endl;
+    }
+    impostorKeyPressed = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+
+    // C switches between mouse look and a free cursor for picking
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !cursorKeyPressed)
+    {
+        cursorFree = !cursorFree;
+        glfwSetInputMode(window, GLFW_CURSOR, cursorFree ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
+        firstMouse = true;
+    }
+    cursorKeyPressed = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -217,6 +386,33 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(RIGHT, deltaTime);
 }
 
+// bounding sphere of a rock instance, from the sphere around the rock model
+// ---------------------------------------------------------------------------------------------------------
+glm::vec4 boundingSphere(const glm::mat4 &model, const glm::vec3 &center, float radius)
+{
+    float scale = glm::length(glm::vec3(model[0]));
+    return glm::vec4(glm::vec3(model * glm::vec4(center, 1.0f)), radius * scale);
+}
+
+// the framebuffer pixel to pick, origin at the bottom left: the one under a free cursor, otherwise the center
+// ---------------------------------------------------------------------------------------------------------
+void pickPosition(GLFWwindow *window, int width, int height, int &x, int &y)
+{
+    x = width / 2;
+    y = height / 2;
+    if (!window || !cursorFree)
+        return;
+    // the cursor is in screen coordinates, which differ from framebuffer pixels on retina displays
+    double cursorX, cursorY;
+    int windowWidth, windowHeight;
+    glfwGetCursorPos(window, &cursorX, &cursorY);
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+    if (windowWidth <= 0 || windowHeight <= 0)
+        return;
+    x = (int)(cursorX * width / windowWidth);
+    y = height - 1 - (int)(cursorY * height / windowHeight);
+}
+
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -236,6 +432,9 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
         lastY = ypos;
         firstMouse = false;
     }
+    // a free cursor is for picking, not looking around
+    if (cursorFree)
+        return;
 
     float xoffset = xpos - lastX;
     float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
@@ -0,0 +1,20 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+flat in float Fade;
+
+uniform sampler2D texture_diffuse1;
+
+// interleaved gradient noise; the impostor keeps exactly the pixels the mesh drops
+float ditherNoise()
+{
+	return fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+}
+
+void main()
+{
+	if (ditherNoise() < Fade)
+		discard;
+	FragColor = texture(texture_diffuse1, TexCoords);
+}
@@ -1,15 +1,24 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in mat4 instanceMatrix; 
+layout (location = 5) in mat4 instanceMatrix; // first location after the Vertex attributes, see Mesh::DrawInstanced
 
 out vec2 TexCoords;
+flat out float Fade;
 
 uniform mat4 projection;
 uniform mat4 view;
+uniform vec3 viewPos;
+
+uniform float impostorDistance;
+uniform float blendRange;
 
 void main()
 {
 	TexCoords = aTexCoords;
 	gl_Position = projection * view * instanceMatrix * vec4(aPos, 1.0f);
+
+	// 0 = full mesh, 1 = impostor only; same rule as in impostor.vs
+	float dist = length(viewPos - vec3(instanceMatrix[3]));
+	Fade = blendRange > 0.0 ? clamp((dist - (impostorDistance - blendRange)) / blendRange, 0.0, 1.0) : step(impostorDistance, dist);
 }
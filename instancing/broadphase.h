@@ -0,0 +1,214 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <glm/glm.hpp>
+
+#include "../parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+// two instances whose bounding boxes overlap, a < b
+struct CollisionPair {
+    unsigned int a;
+    unsigned int b;
+};
+
+// Sweep-and-prune broadphase over instance bounding spheres (xyz = center, w = radius).
+// Every call sorts the boxes along the axis the centers are spread out most on (in parallel), then sweeps the sorted
+// list: each box is only compared with the boxes that start before it ends on that axis. The other two axes are
+// tested four boxes at a time with SSE2. The result is every pair whose axis aligned bounding boxes overlap.
+class SweepAndPrune
+{
+public:
+    vector<CollisionPair> Pairs;
+    int Axis;   // sweep axis chosen by the last call
+
+    SweepAndPrune() : Axis(0)
+    {
+    }
+
+    const vector<CollisionPair> &FindPairs(const glm::vec4 *spheres, size_t count, unsigned int threads = 0)
+    {
+        if (threads == 0)
+            threads = defaultThreadCount();
+        Pairs.clear();
+        if (count < 2)
+            return Pairs;
+
+        Axis = dominantAxis(spheres, count, threads);
+        sortAlongAxis(spheres, count, threads);
+        gatherSorted(spheres, count, threads);
+        sweep(count, threads);
+        return Pairs;
+    }
+
+private:
+    static const unsigned int SWEEP_BLOCK = 1024;
+    static const unsigned int PADDING = 4;
+
+    vector<pair<float, unsigned int> > keys, scratch;
+    // sorted boxes as structure of arrays: the sweep axis (A) and the two others (B, C), padded at the end
+    vector<float> minA, maxA, minB, maxB, minC, maxC;
+    vector<unsigned int> ids;
+
+    // axis along which the centers have the largest variance
+    int dominantAxis(const glm::vec4 *spheres, size_t count, unsigned int threads)
+    {
+        vector<glm::vec3> sum(threads, glm::vec3(0.0f)), sumSquares(threads, glm::vec3(0.0f));
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int t) {
+            glm::vec3 s(0.0f), s2(0.0f);
+            for (size_t i = begin; i < end; i++)
+            {
+                glm::vec3 c(spheres[i]);
+                s += c;
+                s2 += c * c;
+            }
+            sum[t] = s;
+            sumSquares[t] = s2;
+        }, threads);
+        glm::vec3 s(0.0f), s2(0.0f);
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            s += sum[t];
+            s2 += sumSquares[t];
+        }
+        glm::vec3 mean = s / (float)count;
+        glm::vec3 variance = s2 / (float)count - mean * mean;
+        return variance.x >= variance.y ? (variance.x >= variance.z ? 0 : 2) : (variance.y >= variance.z ? 1 : 2);
+    }
+
+    // sorts (box start, index) keys: every thread sorts its own chunk, then chunks are merged pairwise in parallel
+    void sortAlongAxis(const glm::vec4 *spheres, size_t count, unsigned int threads)
+    {
+        keys.resize(count);
+        scratch.resize(count);
+        const int axis = Axis;
+        size_t chunks = std::min<size_t>(threads, count);
+        size_t chunkSize = (count + chunks - 1) / chunks;
+        parallelFor(chunks, [&](size_t firstChunk, size_t lastChunk, unsigned int) {
+            for (size_t c = firstChunk; c < lastChunk; c++)
+            {
+                size_t begin = c * chunkSize, end = std::min(count, begin + chunkSize);
+                for (size_t i = begin; i < end; i++)
+                    keys[i] = make_pair(spheres[i][axis] - spheres[i].w, (unsigned int)i);
+                std::sort(keys.begin() + begin, keys.begin() + end);
+            }
+        }, threads);
+
+        for (size_t width = chunkSize; width < count; width *= 2)
+        {
+            size_t merges = (count + 2 * width - 1) / (2 * width);
+            parallelFor(merges, [&](size_t firstMerge, size_t lastMerge, unsigned int) {
+                for (size_t m = firstMerge; m < lastMerge; m++)
+                {
+                    size_t begin = m * 2 * width;
+                    size_t middle = std::min(count, begin + width);
+                    size_t end = std::min(count, begin + 2 * width);
+                    std::merge(keys.begin() + begin, keys.begin() + middle, keys.begin() + middle, keys.begin() + end, scratch.begin() + begin);
+                }
+            }, threads);
+            keys.swap(scratch);
+        }
+    }
+
+    void gatherSorted(const glm::vec4 *spheres, size_t count, unsigned int threads)
+    {
+        size_t padded = count + PADDING;
+        minA.resize(padded); maxA.resize(padded);
+        minB.resize(padded); maxB.resize(padded);
+        minC.resize(padded); maxC.resize(padded);
+        ids.resize(padded);
+        const int axisB = (Axis + 1) % 3, axisC = (Axis + 2) % 3;
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t k = begin; k < end; k++)
+            {
+                const glm::vec4 &s = spheres[keys[k].second];
+                minA[k] = s[Axis] - s.w;  maxA[k] = s[Axis] + s.w;
+                minB[k] = s[axisB] - s.w; maxB[k] = s[axisB] + s.w;
+                minC[k] = s[axisC] - s.w; maxC[k] = s[axisC] + s.w;
+                ids[k] = keys[k].second;
+            }
+        }, threads);
+        // sentinels that start after everything, so the sweep never has to check for the end of the arrays
+        for (size_t k = count; k < padded; k++)
+        {
+            minA[k] = maxA[k] = numeric_limits<float>::infinity();
+            minB[k] = minC[k] = numeric_limits<float>::infinity();
+            maxB[k] = maxC[k] = -numeric_limits<float>::infinity();
+            ids[k] = 0;
+        }
+    }
+
+    // threads grab blocks of SWEEP_BLOCK boxes, dense regions of the belt are so spread over all threads.
+    // pairs are collected per block and concatenated in block order, so the output doesn't depend on timing.
+    void sweep(size_t count, unsigned int threads)
+    {
+        size_t blocks = (count + SWEEP_BLOCK - 1) / SWEEP_BLOCK;
+        vector<vector<CollisionPair> > blockPairs(blocks);
+        atomic<size_t> nextBlock(0);
+        parallelFor(threads, [&](size_t, size_t, unsigned int) {
+            for (size_t block = nextBlock++; block < blocks; block = nextBlock++)
+            {
+                size_t end = std::min(count, (block + 1) * SWEEP_BLOCK);
+                for (size_t i = block * SWEEP_BLOCK; i < end; i++)
+                    sweepBox(i, blockPairs[block]);
+            }
+        }, threads);
+
+        size_t total = 0;
+        for (size_t b = 0; b < blocks; b++)
+            total += blockPairs[b].size();
+        Pairs.reserve(total);
+        for (size_t b = 0; b < blocks; b++)
+            Pairs.insert(Pairs.end(), blockPairs[b].begin(), blockPairs[b].end());
+    }
+
+    void addPair(size_t i, size_t j, vector<CollisionPair> &pairs) const
+    {
+        CollisionPair p;
+        p.a = std::min(ids[i], ids[j]);
+        p.b = std::max(ids[i], ids[j]);
+        pairs.push_back(p);
+    }
+
+    // compares box i with every following box that starts before box i ends on the sweep axis
+    void sweepBox(size_t i, vector<CollisionPair> &pairs) const
+    {
+        size_t j = i + 1;
+#ifdef __SSE2__
+        const __m128 endA = _mm_set1_ps(maxA[i]);
+        const __m128 lowB = _mm_set1_ps(minB[i]), highB = _mm_set1_ps(maxB[i]);
+        const __m128 lowC = _mm_set1_ps(minC[i]), highC = _mm_set1_ps(maxC[i]);
+        for (;; j += 4)
+        {
+            // boxes are sorted by their start, so once one lane starts too late all following boxes do as well
+            int active = _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(&minA[j]), endA));
+            __m128 overlapB = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&minB[j]), highB), _mm_cmpge_ps(_mm_loadu_ps(&maxB[j]), lowB));
+            __m128 overlapC = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&minC[j]), highC), _mm_cmpge_ps(_mm_loadu_ps(&maxC[j]), lowC));
+            int hits = active & _mm_movemask_ps(_mm_and_ps(overlapB, overlapC));
+            while (hits)
+            {
+                int lane = __builtin_ctz(hits);
+                addPair(i, j + lane, pairs);
+                hits &= hits - 1;
+            }
+            if (active != 0xF)
+                break;
+        }
+#else
+        for (; minA[j] <= maxA[i]; j++)
+            if (minB[j] <= maxB[i] && maxB[j] >= minB[i] && minC[j] <= maxC[i] && maxC[j] >= minC[i])
+                addPair(i, j, pairs);
+#endif
+    }
+};
+#endif
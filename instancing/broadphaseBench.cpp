@@ -0,0 +1,89 @@
+#include <glm/glm.hpp>
+
+#include "instanceGenerator.h"
+#include "broadphase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// bounding spheres of an asteroid belt with the same density as asteroidField's 2000 rocks
+vector<glm::vec4> generateBelt(size_t amount, uint32_t seed)
+{
+	AsteroidFieldGenerator generator(seed, 50.0f * amount / 2000.0f);
+	vector<glm::mat4> matrices(amount);
+	generator.Generate(matrices.data(), amount);
+	vector<glm::vec4> spheres(amount);
+	for (size_t i = 0; i < amount; i++)
+		spheres[i] = glm::vec4(glm::vec3(matrices[i][3]), glm::length(glm::vec3(matrices[i][0])) * 2.0f);
+	return spheres;
+}
+
+// O(n^2) reference, only run for the small sizes; the pairs come out sorted
+vector<pair<unsigned int, unsigned int> > bruteForcePairs(const vector<glm::vec4> &spheres)
+{
+	vector<pair<unsigned int, unsigned int> > pairs;
+	for (size_t i = 0; i < spheres.size(); i++)
+		for (size_t j = i + 1; j < spheres.size(); j++)
+		{
+			glm::vec3 d = glm::abs(glm::vec3(spheres[i]) - glm::vec3(spheres[j]));
+			float r = spheres[i].w + spheres[j].w;
+			if (d.x <= r && d.y <= r && d.z <= r)
+				pairs.push_back(make_pair((unsigned int)i, (unsigned int)j));
+		}
+	return pairs;
+}
+
+// usage: broadphaseBench [--seed N] [--threads N]
+// exits with 1 if the sweep finds other pairs than the brute force reference
+int main(int argc, char **argv)
+{
+	uint32_t seed = 1;
+	unsigned int threads = defaultThreadCount();
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--seed") == 0)
+			seed = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+		else if (strcmp(argv[i], "--threads") == 0)
+			threads = (unsigned int)atoi(argv[i + 1]);
+	}
+
+	size_t sizes[] = { 10000, 30000, 100000, 300000, 1000000 };
+	SweepAndPrune broadphase;
+	bool failed = false;
+	for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		vector<glm::vec4> spheres = generateBelt(sizes[s], seed);
+		broadphase.FindPairs(spheres.data(), spheres.size(), threads); // warm up
+
+		const int runs = 5;
+		auto start = chrono::high_resolution_clock::now();
+		for (int r = 0; r < runs; r++)
+			broadphase.FindPairs(spheres.data(), spheres.size(), threads);
+		auto end = chrono::high_resolution_clock::now();
+		double ms = chrono::duration<double, milli>(end - start).count() / runs;
+
+		cout << "bodies: " << sizes[s] << "  threads: " << threads << "  axis: " << broadphase.Axis
+		     << "  pairs: " << broadphase.Pairs.size() << "  time: " << ms << " ms";
+		if (sizes[s] <= 30000)
+		{
+			vector<pair<unsigned int, unsigned int> > expected = bruteForcePairs(spheres);
+			vector<pair<unsigned int, unsigned int> > found(broadphase.Pairs.size());
+			for (size_t p = 0; p < found.size(); p++)
+				found[p] = make_pair(broadphase.Pairs[p].a, broadphase.Pairs[p].b);
+			sort(found.begin(), found.end());
+			bool match = found == expected;
+			cout << "  brute force pairs: " << expected.size() << (match ? " (same)" : " MISMATCH");
+			failed = failed || !match;
+		}
+		cout << endl;
+	}
+	if (failed)
+		cout << "ERROR::BROADPHASE:: sweep and prune disagrees with the brute force pairs" << endl;
+	return failed ? 1 : 0;
+}
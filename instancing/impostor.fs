@@ -0,0 +1,22 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 TexCoords;
+flat in float Fade;
+
+uniform sampler2DArray atlas;
+
+// interleaved gradient noise, used to cross-fade with the mesh without having to sort anything
+float ditherNoise()
+{
+	return fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+}
+
+void main()
+{
+	vec4 color = texture(atlas, TexCoords);
+	if (color.a < 0.5 || ditherNoise() >= Fade)
+		discard;
+	// the atlas was cleared to transparent black, so dividing by alpha removes the dark fringe mipmapping adds
+	FragColor = vec4(color.rgb / color.a, 1.0);
+}
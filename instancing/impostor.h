@@ -0,0 +1,211 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "model.h"
+#include "shader_m.h"
+#include "../parallel.h"
+#include "instanceBuffer.h"
+
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// Octahedral mapping between unit directions and [0, 1]^2 (y is the pole axis). The impostor atlas stores one
+// baked view of the model per grid cell of this square, the same mapping is used in impostor.vs to pick a cell.
+inline glm::vec2 octahedralEncode(glm::vec3 d)
+{
+    d /= (std::fabs(d.x) + std::fabs(d.y) + std::fabs(d.z));
+    glm::vec2 p(d.x, d.z);
+    if (d.y < 0.0f)
+        p = glm::vec2((1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+    return p * 0.5f + glm::vec2(0.5f);
+}
+
+inline glm::vec3 octahedralDecode(glm::vec2 uv)
+{
+    glm::vec2 p = uv * 2.0f - glm::vec2(1.0f);
+    glm::vec3 d(p.x, 1.0f - std::fabs(p.x) - std::fabs(p.y), p.y);
+    if (d.y < 0.0f)
+    {
+        float x = (1.0f - std::fabs(d.z)) * (d.x >= 0.0f ? 1.0f : -1.0f);
+        float z = (1.0f - std::fabs(d.x)) * (d.z >= 0.0f ? 1.0f : -1.0f);
+        d.x = x;
+        d.z = z;
+    }
+    return glm::normalize(d);
+}
+
+// up vector used to orient a view looking along -dir; must match the one in impostor.vs
+inline glm::vec3 impostorUp(const glm::vec3 &dir)
+{
+    return std::fabs(dir.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+// A camera-facing billboard stand-in for a model. At load time the model is rendered offscreen from
+// GridSize * GridSize directions spread over the sphere; every view is stored as one layer of a texture array.
+// Distant instances are then drawn as a single quad that samples the view closest to the camera direction.
+class Impostor
+{
+public:
+    /*  Impostor Data  */
+    unsigned int AtlasTexture;
+    unsigned int GridSize;
+    unsigned int Resolution;
+    glm::vec3 Center;   // bounding sphere of the model, in model space
+    float Radius;
+    unsigned int VAO;
+    InstanceBuffer Instances;   // model matrices of the rocks drawn as impostors
+
+    /*  Functions  */
+    // bakes the atlas; bakeShader is a plain (non-instanced) shader with model/view/projection uniforms
+    Impostor(Model &model, Shader &bakeShader, unsigned int gridSize = 8, unsigned int resolution = 128)
+        : GridSize(gridSize), Resolution(resolution), Instances(InstanceLayout().Add("instanceMatrix", 16))
+    {
+        computeBounds(model);
+        bake(model, bakeShader);
+        setupQuad();
+    }
+
+    // draws count impostors whose model matrices were uploaded to Instances
+    void Draw(Shader &shader, unsigned int count)
+    {
+        shader.use();
+        shader.setVec3("center", Center);
+        shader.setFloat("radius", Radius);
+        shader.setInt("gridSize", GridSize);
+        shader.setInt("atlas", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, AtlasTexture);
+        glBindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+        glBindVertexArray(0);
+    }
+
+    // splits instances by distance between their origin and viewPos: rocks closer than distance keep the full mesh,
+    // rocks farther than distance - blendRange get an impostor. Rocks inside the blend band end up in both lists
+    // and are cross-faded by the shaders.
+    static void SplitByDistance(const glm::mat4 *matrices, size_t amount, const glm::vec3 &viewPos, float distance, float blendRange,
+                                vector<glm::mat4> &meshInstances, vector<glm::mat4> &impostorInstances)
+    {
+        unsigned int threads = defaultThreadCount();
+        vector<vector<glm::mat4> > nearLists(threads), farLists(threads);
+        float nearLimit = distance * distance;
+        float farStart = glm::max(distance - blendRange, 0.0f);
+        float farLimit = farStart * farStart;
+        parallelFor(amount, [&](size_t begin, size_t end, unsigned int t) {
+            for (size_t i = begin; i < end; i++)
+            {
+                glm::vec3 offset = glm::vec3(matrices[i][3]) - viewPos;
+                float dist2 = glm::dot(offset, offset);
+                if (dist2 < nearLimit)
+                    nearLists[t].push_back(matrices[i]);
+                if (dist2 >= farLimit)
+                    farLists[t].push_back(matrices[i]);
+            }
+        }, threads);
+
+        meshInstances.clear();
+        impostorInstances.clear();
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            meshInstances.insert(meshInstances.end(), nearLists[t].begin(), nearLists[t].end());
+            impostorInstances.insert(impostorInstances.end(), farLists[t].begin(), farLists[t].end());
+        }
+    }
+
+private:
+    // bounding sphere around the center of the model's axis aligned bounding box
+    void computeBounds(Model &model)
+    {
+        glm::vec3 minimum(1e30f), maximum(-1e30f);
+        for (unsigned int i = 0; i < model.meshes.size(); i++)
+            for (unsigned int j = 0; j < model.meshes[i].vertices.size(); j++)
+            {
+                minimum = glm::min(minimum, model.meshes[i].vertices[j].Position);
+                maximum = glm::max(maximum, model.meshes[i].vertices[j].Position);
+            }
+        Center = (minimum + maximum) * 0.5f;
+        Radius = 0.0f;
+        for (unsigned int i = 0; i < model.meshes.size(); i++)
+            for (unsigned int j = 0; j < model.meshes[i].vertices.size(); j++)
+                Radius = glm::max(Radius, glm::length(model.meshes[i].vertices[j].Position - Center));
+    }
+
+    // renders the model once per atlas cell into its own texture array layer with an orthographic camera
+    void bake(Model &model, Shader &bakeShader)
+    {
+        GLint previousViewport[4];
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+        glGenTextures(1, &AtlasTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, AtlasTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, Resolution, Resolution, GridSize * GridSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        unsigned int fbo, depthRbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glGenRenderbuffers(1, &depthRbo);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRbo);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, Resolution, Resolution);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRbo);
+
+        glm::mat4 projection = glm::ortho(-Radius, Radius, -Radius, Radius, 0.5f * Radius, 3.5f * Radius);
+        bakeShader.use();
+        bakeShader.setMat4("projection", projection);
+        bakeShader.setMat4("model", glm::mat4());
+        glViewport(0, 0, Resolution, Resolution);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        for (unsigned int y = 0; y < GridSize; y++)
+            for (unsigned int x = 0; x < GridSize; x++)
+            {
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, AtlasTexture, 0, y * GridSize + x);
+                if (x == 0 && y == 0 && glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                    cout << "ERROR::IMPOSTOR:: Framebuffer is not complete!" << endl;
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                glm::vec3 dir = octahedralDecode(glm::vec2((x + 0.5f) / GridSize, (y + 0.5f) / GridSize));
+                glm::mat4 view = glm::lookAt(Center + dir * 2.0f * Radius, Center, impostorUp(dir));
+                bakeShader.setMat4("view", view);
+                model.Draw(bakeShader);
+            }
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, AtlasTexture);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(1, &depthRbo);
+        glDeleteFramebuffers(1, &fbo);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    }
+
+    // unit quad corners in location 0, per-instance model matrix in locations 1-4
+    void setupQuad()
+    {
+        float corners[] = {
+            -1.0f, -1.0f,
+             1.0f, -1.0f,
+            -1.0f,  1.0f,
+             1.0f,  1.0f
+        };
+        unsigned int quadVBO;
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        Instances.Attach(1);
+        glBindVertexArray(0);
+    }
+};
+#endif
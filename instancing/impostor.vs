@@ -0,0 +1,49 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in mat4 instanceMatrix;
+
+out vec3 TexCoords; // xy: position inside the atlas cell, z: atlas layer
+flat out float Fade;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 viewPos;
+
+uniform vec3 center; // bounding sphere of the baked model in model space
+uniform float radius;
+uniform int gridSize;
+
+uniform float impostorDistance;
+uniform float blendRange;
+
+// octahedral direction -> [0, 1]^2 mapping, must match octahedralEncode in impostor.h
+vec2 octahedralEncode(vec3 d)
+{
+	d /= abs(d.x) + abs(d.y) + abs(d.z);
+	vec2 p = d.xz;
+	if (d.y < 0.0)
+		p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+	return p * 0.5 + 0.5;
+}
+
+void main()
+{
+	vec3 worldCenter = vec3(instanceMatrix * vec4(center, 1.0));
+
+	// direction towards the camera in the rock's own space, so its rotation selects the matching baked view
+	vec3 dir = normalize(inverse(mat3(instanceMatrix)) * (viewPos - worldCenter));
+	ivec2 cell = clamp(ivec2(octahedralEncode(dir) * float(gridSize)), ivec2(0), ivec2(gridSize - 1));
+
+	// quad facing the camera, oriented like the views were during baking
+	vec3 up = abs(dir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+	vec3 right = normalize(cross(up, dir));
+	up = cross(dir, right);
+	vec3 position = center + (aCorner.x * right + aCorner.y * up) * radius;
+
+	TexCoords = vec3(aCorner * 0.5 + 0.5, float(cell.y * gridSize + cell.x));
+	gl_Position = projection * view * instanceMatrix * vec4(position, 1.0);
+
+	// 0 = full mesh, 1 = impostor only
+	float dist = length(viewPos - vec3(instanceMatrix[3]));
+	Fade = blendRange > 0.0 ? clamp((dist - (impostorDistance - blendRange)) / blendRange, 0.0, 1.0) : step(impostorDistance, dist);
+}
@@ -0,0 +1,60 @@
+#include <glm/glm.hpp>
+
+#include "instanceGenerator.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// FNV-1a over the raw bytes of the generated matrices, used to check that every run reproduces the same field
+uint64_t hashMatrices(const vector<glm::mat4> &matrices)
+{
+	const unsigned char *bytes = (const unsigned char*)matrices.data();
+	size_t size = matrices.size() * sizeof(glm::mat4);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// usage: instanceBench [--seed N] [--amount N] [--threads N]
+int main(int argc, char **argv)
+{
+	uint32_t seed = 1;
+	size_t amount = 10000000;
+	unsigned int threads = defaultThreadCount();
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--seed") == 0)
+			seed = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+		else if (strcmp(argv[i], "--amount") == 0)
+			amount = (size_t)strtoull(argv[i + 1], NULL, 10);
+		else if (strcmp(argv[i], "--threads") == 0)
+			threads = (unsigned int)atoi(argv[i + 1]);
+	}
+
+	AsteroidFieldGenerator generator(seed);
+	vector<glm::mat4> matrices(amount);
+
+	// first touch the memory so page faults don't end up in the timings
+	generator.Generate(matrices.data(), amount, threads);
+
+	unsigned int threadCounts[] = { 1, threads };
+	for (unsigned int t = 0; t < 2; t++)
+	{
+		auto start = chrono::high_resolution_clock::now();
+		generator.Generate(matrices.data(), amount, threadCounts[t]);
+		auto end = chrono::high_resolution_clock::now();
+		double ms = chrono::duration<double, milli>(end - start).count();
+		cout << "instances: " << amount << "  threads: " << threadCounts[t] << "  time: " << ms << " ms  ("
+		     << amount / (ms * 1000.0) << " M/s)  hash: " << hex << hashMatrices(matrices) << dec << endl;
+	}
+	return 0;
+}
@@ -0,0 +1,127 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// One per-instance vertex attribute. components is 1-4 for scalars/vectors, 16 for a mat4 (which takes four
+// consecutive attribute locations). Integer types (GL_INT, GL_UNSIGNED_INT) reach the shader as ints, not floats.
+struct InstanceAttribute {
+    string name;
+    GLint components;
+    GLenum type;
+    unsigned int offset;
+};
+
+// Declares how one instance is laid out inside an InstanceBuffer. Attributes are packed in the order they are added.
+class InstanceLayout
+{
+public:
+    vector<InstanceAttribute> Attributes;
+    unsigned int Stride;
+
+    InstanceLayout() : Stride(0)
+    {
+    }
+
+    InstanceLayout &Add(const string &name, GLint components, GLenum type = GL_FLOAT)
+    {
+        InstanceAttribute attribute;
+        attribute.name = name;
+        attribute.components = components;
+        attribute.type = type;
+        attribute.offset = Stride;
+        Attributes.push_back(attribute);
+        Stride += components * 4; // every supported type is 4 bytes wide
+        return *this;
+    }
+
+    // number of vertex attribute locations the layout occupies
+    unsigned int LocationCount() const
+    {
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < Attributes.size(); i++)
+            count += (Attributes[i].components + 3) / 4;
+        return count;
+    }
+};
+
+// A vertex buffer holding per-instance data described by an InstanceLayout. The same buffer can be attached to any
+// number of vertex array objects (see Mesh::DrawInstanced and Model::DrawInstanced).
+class InstanceBuffer
+{
+public:
+    unsigned int ID;
+    InstanceLayout Layout;
+    unsigned int Count;     // instances currently stored
+
+    InstanceBuffer(const InstanceLayout &layout) : Layout(layout), Count(0), capacity(0)
+    {
+        glGenBuffers(1, &ID);
+    }
+
+    ~InstanceBuffer()
+    {
+        glDeleteBuffers(1, &ID);
+    }
+
+    // the buffer belongs to one object, a copy would delete it a second time
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    // replaces the buffer contents with count instances; storage only grows, so steady-state uploads don't reallocate
+    void Upload(const void *data, unsigned int count)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        if (count > capacity)
+        {
+            capacity = count;
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * Layout.Stride, data, GL_DYNAMIC_DRAW);
+        }
+        else
+        {
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * Layout.Stride, NULL, GL_DYNAMIC_DRAW); // orphan the old storage
+            if (count > 0)
+                glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)count * Layout.Stride, data);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        Count = count;
+    }
+
+    // points the attribute locations starting at firstLocation of the currently bound VAO at this buffer.
+    // returns the first location after the ones used, so several buffers can be attached one after the other.
+    unsigned int Attach(unsigned int firstLocation) const
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        unsigned int location = firstLocation;
+        for (unsigned int i = 0; i < Layout.Attributes.size(); i++)
+        {
+            const InstanceAttribute &attribute = Layout.Attributes[i];
+            unsigned int columns = (attribute.components + 3) / 4;
+            GLint size = attribute.components > 4 ? 4 : attribute.components;
+            for (unsigned int c = 0; c < columns; c++)
+            {
+                size_t offset = attribute.offset + c * size * 4;
+                glEnableVertexAttribArray(location);
+                if (attribute.type == GL_FLOAT)
+                    glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, Layout.Stride, (void*)offset);
+                else
+                    glVertexAttribIPointer(location, size, attribute.type, Layout.Stride, (void*)offset);
+                glVertexAttribDivisor(location, 1);
+                location++;
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return location;
+    }
+
+private:
+    unsigned int capacity;
+};
+#endif
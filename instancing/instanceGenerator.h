@@ -0,0 +1,248 @@
+#ifndef INSTANCE_GENERATOR_H
+#define INSTANCE_GENERATOR_H
+
+#include <glm/glm.hpp>
+
+#include "../parallel.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Philox4x32-10 counter-based random number generator (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+// The output is a pure function of (counter, key), so instance i always receives the same random numbers no matter
+// which thread generates it or in which order. No state is carried from one instance to the next.
+inline void philox4x32(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t k0, uint32_t k1, uint32_t out[4])
+{
+    for (int round = 0; round < 10; round++)
+    {
+        uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+        uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c0 = n0;
+        c1 = (uint32_t)p1;
+        c2 = n2;
+        c3 = (uint32_t)p0;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+#ifdef __SSE2__
+// the high and low 32 bits of the products of four 32 bit lanes with a constant. _mm_mul_epu32 only multiplies
+// lanes 0 and 2, so the odd lanes are shifted down and multiplied separately, then both are interleaved back.
+inline void mulHiLo4(__m128i a, __m128i multiplier, __m128i &hi, __m128i &lo)
+{
+    __m128i even = _mm_mul_epu32(a, multiplier);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), multiplier);
+    lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 3, 1)));
+}
+
+// philox4x32 for four counters at once, one in each lane; c[i] holds word i of all four
+inline void philox4x32x4(__m128i c[4], uint32_t k0, uint32_t k1)
+{
+    const __m128i m0 = _mm_set1_epi32((int)0xD2511F53u), m1 = _mm_set1_epi32((int)0xCD9E8D57u);
+    for (int round = 0; round < 10; round++)
+    {
+        __m128i hi0, lo0, hi1, lo1;
+        mulHiLo4(c[0], m0, hi0, lo0);
+        mulHiLo4(c[2], m1, hi1, lo1);
+        c[0] = _mm_xor_si128(_mm_xor_si128(hi1, c[1]), _mm_set1_epi32((int)k0));
+        c[2] = _mm_xor_si128(_mm_xor_si128(hi0, c[3]), _mm_set1_epi32((int)k1));
+        c[1] = lo1;
+        c[3] = lo0;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+}
+#endif
+
+#ifdef __AVX2__
+// the same for eight lanes; the shuffles and unpacks work within each half, so the steps are those of mulHiLo4
+inline void mulHiLo8(__m256i a, __m256i multiplier, __m256i &hi, __m256i &lo)
+{
+    __m256i even = _mm256_mul_epu32(a, multiplier);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), multiplier);
+    lo = _mm256_unpacklo_epi32(_mm256_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm256_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    hi = _mm256_unpacklo_epi32(_mm256_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)), _mm256_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 3, 1)));
+}
+
+inline void philox4x32x8(__m256i c[4], uint32_t k0, uint32_t k1)
+{
+    const __m256i m0 = _mm256_set1_epi32((int)0xD2511F53u), m1 = _mm256_set1_epi32((int)0xCD9E8D57u);
+    for (int round = 0; round < 10; round++)
+    {
+        __m256i hi0, lo0, hi1, lo1;
+        mulHiLo8(c[0], m0, hi0, lo0);
+        mulHiLo8(c[2], m1, hi1, lo1);
+        c[0] = _mm256_xor_si256(_mm256_xor_si256(hi1, c[1]), _mm256_set1_epi32((int)k0));
+        c[2] = _mm256_xor_si256(_mm256_xor_si256(hi0, c[3]), _mm256_set1_epi32((int)k1));
+        c[1] = lo1;
+        c[3] = lo0;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+}
+#endif
+
+// maps the upper 24 bits of a random integer to a float in [0, 1); exact for every value, so results are bit-identical everywhere
+inline float unitFloat24(uint32_t bits)
+{
+    return (float)(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+// maps 16 random bits to a float in [0, 1)
+inline float unitFloat16(uint32_t bits)
+{
+    return (float)(bits & 0xFFFFu) * (1.0f / 65536.0f);
+}
+
+// Generates the model matrices of a ring of asteroids. Every rock is keyed by its index and the seed only,
+// so the same seed always reproduces exactly the same field, regardless of the number of threads used.
+class AsteroidFieldGenerator
+{
+public:
+    // Field settings
+    uint32_t Seed;
+    float Radius;
+    float Offset;
+    float HeightScale;
+    float MinScale;
+    float MaxScale;
+    glm::vec3 RotationAxis;
+
+    AsteroidFieldGenerator(uint32_t seed = 1, float radius = 50.0f, float offset = 5.0f)
+        : Seed(seed), Radius(radius), Offset(offset), HeightScale(0.4f), MinScale(0.05f), MaxScale(0.25f), RotationAxis(0.4f, 0.6f, 0.8f)
+    {
+    }
+
+    // fills matrices[0 .. amount) in parallel
+    void Generate(glm::mat4 *matrices, size_t amount, unsigned int threads = 0) const
+    {
+        parallelFor(amount, [&](size_t begin, size_t end, unsigned int) {
+            generateRange(matrices, begin, end, amount);
+        }, threads);
+    }
+
+private:
+    static const unsigned int BLOCK_SIZE = 256;
+
+    // works on blocks of instances: the random numbers of a whole block are first produced into structure-of-arrays
+    // scratch buffers, four instances at a time with SSE2 (eight with AVX2), then the matrices are assembled from them.
+    void generateRange(glm::mat4 *matrices, size_t begin, size_t end, size_t amount) const
+    {
+        float dx[BLOCK_SIZE], dy[BLOCK_SIZE], dz[BLOCK_SIZE], scale[BLOCK_SIZE], rotAngle[BLOCK_SIZE];
+        const float scaleRange = MaxScale - MinScale;
+        const float twoPi = 6.28318530717958647692f;
+        const glm::vec3 axis = glm::normalize(RotationAxis);
+
+        for (size_t first = begin; first < end; first += BLOCK_SIZE)
+        {
+            unsigned int count = (unsigned int)std::min<size_t>(BLOCK_SIZE, end - first);
+
+            // 1. random numbers: one Philox call per instance gives the three displacements (24 bits each)
+            //    plus scale and rotation angle (16 bits each)
+            unsigned int j = 0;
+#ifdef __AVX2__
+            const __m256 toUnit24x8 = _mm256_set1_ps(1.0f / 16777216.0f), toUnit16x8 = _mm256_set1_ps(1.0f / 65536.0f);
+            const __m256 onex8 = _mm256_set1_ps(1.0f), twox8 = _mm256_set1_ps(2.0f);
+            const __m256 offsetx8 = _mm256_set1_ps(Offset), heightScalex8 = _mm256_set1_ps(HeightScale);
+            const __m256 minScalex8 = _mm256_set1_ps(MinScale), rangex8 = _mm256_set1_ps(scaleRange), turnx8 = _mm256_set1_ps(twoPi);
+            const __m256i low16x8 = _mm256_set1_epi32(0xFFFF);
+            for (; j + 8 <= count; j += 8)
+            {
+                uint64_t index = first + j;
+                __m256i c[4];
+                c[0] = _mm256_add_epi32(_mm256_set1_epi32((int)(uint32_t)index), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+                int high[8];
+                for (int k = 0; k < 8; k++)
+                    high[k] = (int)(uint32_t)((index + k) >> 32);
+                c[1] = _mm256_loadu_si256((const __m256i *)high);
+                c[2] = c[3] = _mm256_setzero_si256();
+                philox4x32x8(c, Seed, 0x5EEDu);
+                __m256 x = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c[0], 8)), toUnit24x8);
+                __m256 y = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c[1], 8)), toUnit24x8);
+                __m256 z = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c[2], 8)), toUnit24x8);
+                __m256 s = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(c[3], low16x8)), toUnit16x8);
+                __m256 a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c[3], 16)), toUnit16x8);
+                _mm256_storeu_ps(&dx[j], _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(x, twox8), onex8), offsetx8));
+                _mm256_storeu_ps(&dy[j], _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(y, twox8), onex8), offsetx8), heightScalex8));
+                _mm256_storeu_ps(&dz[j], _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(z, twox8), onex8), offsetx8));
+                _mm256_storeu_ps(&scale[j], _mm256_add_ps(minScalex8, _mm256_mul_ps(s, rangex8)));
+                _mm256_storeu_ps(&rotAngle[j], _mm256_mul_ps(a, turnx8));
+            }
+#endif
+#ifdef __SSE2__
+            const __m128 toUnit24 = _mm_set1_ps(1.0f / 16777216.0f), toUnit16 = _mm_set1_ps(1.0f / 65536.0f);
+            const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+            const __m128 offset = _mm_set1_ps(Offset), heightScale = _mm_set1_ps(HeightScale);
+            const __m128 minScale = _mm_set1_ps(MinScale), range = _mm_set1_ps(scaleRange), turn = _mm_set1_ps(twoPi);
+            const __m128i low16 = _mm_set1_epi32(0xFFFF);
+            for (; j + 4 <= count; j += 4)
+            {
+                uint64_t index = first + j;
+                __m128i c[4];
+                // the low words of four consecutive indices; the high word is shared unless they straddle 2^32
+                c[0] = _mm_add_epi32(_mm_set1_epi32((int)(uint32_t)index), _mm_set_epi32(3, 2, 1, 0));
+                c[1] = _mm_set_epi32((int)(uint32_t)((index + 3) >> 32), (int)(uint32_t)((index + 2) >> 32),
+                                     (int)(uint32_t)((index + 1) >> 32), (int)(uint32_t)(index >> 32));
+                c[2] = c[3] = _mm_setzero_si128();
+                philox4x32x4(c, Seed, 0x5EEDu);
+                // the same operations in the same order as unitFloat24 and unitFloat16 below, so the results match bit for bit
+                __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c[0], 8)), toUnit24);
+                __m128 y = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c[1], 8)), toUnit24);
+                __m128 z = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c[2], 8)), toUnit24);
+                __m128 s = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(c[3], low16)), toUnit16);
+                __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c[3], 16)), toUnit16);
+                _mm_storeu_ps(&dx[j], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(x, two), one), offset));
+                _mm_storeu_ps(&dy[j], _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(y, two), one), offset), heightScale));
+                _mm_storeu_ps(&dz[j], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(z, two), one), offset));
+                _mm_storeu_ps(&scale[j], _mm_add_ps(minScale, _mm_mul_ps(s, range)));
+                _mm_storeu_ps(&rotAngle[j], _mm_mul_ps(a, turn));
+            }
+#endif
+            // the rest of the block, or all of it without SSE2
+            for (; j < count; j++)
+            {
+                uint64_t index = first + j;
+                uint32_t r[4];
+                philox4x32((uint32_t)index, (uint32_t)(index >> 32), 0u, 0u, Seed, 0x5EEDu, r);
+                dx[j] = (unitFloat24(r[0]) * 2.0f - 1.0f) * Offset;
+                dy[j] = (unitFloat24(r[1]) * 2.0f - 1.0f) * Offset * HeightScale; // keep height of field smaller compared to width of x and z
+                dz[j] = (unitFloat24(r[2]) * 2.0f - 1.0f) * Offset;
+                scale[j] = MinScale + unitFloat16(r[3]) * scaleRange;
+                rotAngle[j] = unitFloat16(r[3] >> 16) * twoPi;
+            }
+
+            // 2. matrices: translation * scale * rotation around the shared axis, written out column by column
+            for (j = 0; j < count; j++)
+            {
+                size_t index = first + j;
+                float angle = (float)index / (float)amount * twoPi;
+                float c = std::cos(rotAngle[j]);
+                float s = std::sin(rotAngle[j]);
+                glm::vec3 t = axis * (1.0f - c);
+
+                glm::mat4 &model = matrices[index];
+                model[0] = glm::vec4(c + t.x * axis.x, t.x * axis.y + s * axis.z, t.x * axis.z - s * axis.y, 0.0f) * scale[j];
+                model[1] = glm::vec4(t.y * axis.x - s * axis.z, c + t.y * axis.y, t.y * axis.z + s * axis.x, 0.0f) * scale[j];
+                model[2] = glm::vec4(t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x, c + t.z * axis.z, 0.0f) * scale[j];
+                model[3] = glm::vec4(std::sin(angle) * Radius + dx[j], dy[j], std::cos(angle) * Radius + dz[j], 1.0f);
+            }
+        }
+    }
+};
+#endif
@@ -11,6 +11,7 @@
 #include <iostream>
 #include <stdio.h>
 #include <experimental/filesystem>
+#include "../headless.h"
 
 using namespace std;
 
@@ -33,40 +34,51 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
+int main(int argc, char **argv)
 {
-	glfwInit();
-  	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	#ifdef __APPLE__
-    		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
-	#endif
-
-	// glfw window creation
-   	// --------------------
-    	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    	if (window == NULL)
+    	// --headless renders offscreen instead, see headless.h
+    	Headless headless(argc, argv);
+    	GLFWwindow* window = NULL;
+    	if (headless.Enabled)
     	{
-        	cout << "Failed to create GLFW window" << endl;
-        	glfwTerminate();
-        	return -1;
+    	    	if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT))
+    	    	    	return -1;
     	}
-    	glfwMakeContextCurrent(window);
-    	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    	glfwSetCursorPosCallback(window, mouse_callback);
-    	glfwSetScrollCallback(window, scroll_callback);
-
-    	// tell GLFW to capture our mouse
-   	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-	// glad: load all OpenGL function pointers
-    	// ---------------------------------------
-    	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    	else
     	{
-        	cout << "Failed to initialize GLAD" << endl;
-        	return -1;
+    		glfwInit();
+    	  	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    	    	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    	    	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    		#ifdef __APPLE__
+    	    		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
+    		#endif
+
+    		// glfw window creation
+    	   	// --------------------
+    	    	window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    	    	if (window == NULL)
+    	    	{
+    	        	cout << "Failed to create GLFW window" << endl;
+    	        	glfwTerminate();
+    	        	return -1;
+    	    	}
+    	    	glfwMakeContextCurrent(window);
+    	    	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    	    	glfwSetCursorPosCallback(window, mouse_callback);
+    	    	glfwSetScrollCallback(window, scroll_callback);
+
+    	    	// tell GLFW to capture our mouse
+    	   	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    		// glad: load all OpenGL function pointers
+    	    	// ---------------------------------------
+    	    	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    	    	{
+    	        	cout << "Failed to initialize GLAD" << endl;
+    	        	return -1;
+    	    	}
     	}
 	
 	// Shaders 
@@ -125,17 +137,20 @@ int main()
 	glVertexAttribDivisor(2, 1);
  
 	// Render loop
-	while (!glfwWindowShouldClose(window))
+	while (headless.Running(window))
 	{
         	// per-frame time logic
         	// --------------------
-        	float currentFrame = glfwGetTime();
+        	float currentFrame = headless.Time();
         	deltaTime = currentFrame - lastFrame;
         	lastFrame = currentFrame;
 
         	// input
         	// -----
-        	processInput(window);
+        	if (headless.Enabled)
+        	    	headless.MoveCamera(camera);
+        	else
+        	    	processInput(window);
 
         	// render
         	// ------
@@ -149,8 +164,7 @@ int main()
 		glBindVertexArray(0);
 
 		// glfw: swap buffers and poll IO events
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		headless.SwapBuffers(window);
 
 	}
 
@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader_m.h"
+#include "instanceBuffer.h"
 
 #include <string>
 #include <fstream>
@@ -27,6 +28,9 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// Vertex occupies attribute locations 0-4; per-instance attributes start right after it
+const unsigned int MESH_ATTRIBUTE_COUNT = 5;
+
 struct Texture {
     unsigned int id;
     string type;
@@ -56,7 +60,48 @@ public:
     // render the mesh
     void Draw(Shader shader) 
     {
-        // bind appropriate textures
+        bindTextures(shader);
+        
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render count instances of the mesh. The per-instance attributes of the buffers are placed in the free locations
+    // after the vertex attributes: the first buffer starts at MESH_ATTRIBUTE_COUNT, every further buffer continues
+    // where the previous one ended, so shaders declare e.g. 'layout (location = 5) in mat4 instanceMatrix;'.
+    void DrawInstanced(Shader shader, const vector<const InstanceBuffer*> &buffers, unsigned int count)
+    {
+        bindTextures(shader);
+
+        glBindVertexArray(instanceVAO(buffers));
+        glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, count);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    /*  Render data  */
+    unsigned int VBO, EBO;
+
+    // a vertex array object with the mesh's vertex attributes and the instance attributes of one set of buffers
+    struct InstanceVAO {
+        vector<unsigned int> BufferIDs;     // in location order
+        unsigned int VAO;
+    };
+    // one for every set of buffers the mesh was drawn with, so alternating between sets (the draw and the pick
+    // pass of asteroidField) only switches VAOs instead of pointing the attributes somewhere else every time
+    vector<InstanceVAO> instanceVAOs;
+
+    /*  Functions    */
+    // binds the mesh's textures to the texture_diffuseN/texture_specularN/... samplers of the shader
+    void bindTextures(Shader &shader)
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
@@ -81,21 +126,42 @@ public:
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // the VAO drawing with the given buffers, set up the first time they are used together
+    unsigned int instanceVAO(const vector<const InstanceBuffer*> &buffers)
+    {
+        vector<unsigned int> ids;
+        for (unsigned int i = 0; i < buffers.size(); i++)
+            ids.push_back(buffers[i]->ID);
+        for (unsigned int i = 0; i < instanceVAOs.size(); i++)
+            if (instanceVAOs[i].BufferIDs == ids)
+                return instanceVAOs[i].VAO;
+
+        InstanceVAO set;
+        set.BufferIDs = ids;
+        glGenVertexArrays(1, &set.VAO);
+        glBindVertexArray(set.VAO);
+        setupVertexAttributes();
+        unsigned int location = MESH_ATTRIBUTE_COUNT;
+        for (unsigned int i = 0; i < buffers.size(); i++)
+            location = buffers[i]->Attach(location);
+        if (location > maxVertexAttributes())
+            cout << "ERROR::MESH:: instance attributes need " << location << " attribute locations, only " << maxVertexAttributes() << " available" << endl;
+        glBindVertexArray(0);
+        instanceVAOs.push_back(set);
+        return set.VAO;
     }
 
-private:
-    /*  Render data  */
-    unsigned int VBO, EBO;
+    // the limit is the same for the whole program, it's asked for once
+    static unsigned int maxVertexAttributes()
+    {
+        static GLint maxAttributes = 0;
+        if (maxAttributes == 0)
+            glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxAttributes);
+        return (unsigned int)maxAttributes;
+    }
 
-    /*  Functions    */
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
@@ -115,6 +181,15 @@ private:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
+        setupVertexAttributes();
+        glBindVertexArray(0);
+    }
+
+    // points the vertex attributes of the bound VAO at the mesh's buffers
+    void setupVertexAttributes()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         // set the vertex attribute pointers
         // vertex Positions
         glEnableVertexAttribArray(0);	
@@ -131,8 +206,6 @@ private:
         // vertex bitangent
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
     }
 };
 #endif
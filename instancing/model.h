@@ -14,6 +14,7 @@
 
 #include "mesh.h"
 #include "shader_m.h"
+#include "instanceBuffer.h"
 
 #include <string>
 #include <fstream>
@@ -47,6 +48,20 @@ public:
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // draws count instances of the model with per-instance attributes from instanceBuffer (see Mesh::DrawInstanced)
+    void DrawInstanced(Shader shader, const InstanceBuffer &instanceBuffer, unsigned int count)
+    {
+        vector<const InstanceBuffer*> buffers(1, &instanceBuffer);
+        DrawInstanced(shader, buffers, count);
+    }
+
+    // same, with the attributes of several instance buffers, attached in the given order
+    void DrawInstanced(Shader shader, const vector<const InstanceBuffer*> &instanceBuffers, unsigned int count)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instanceBuffers, count);
+    }
     
 private:
     /*  Functions   */
@@ -0,0 +1,12 @@
+#version 330 core
+// written to the RG32UI attachment of a PickBuffer
+out uvec2 PickId;
+
+flat in uint Instance;
+
+uniform int object; // 0 is left for nothing
+
+void main()
+{
+	PickId = uvec2(uint(object), Instance);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+flat out uint Instance;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+uniform int instance; // the mesh's index, when a Model is drawn mesh by mesh
+
+void main()
+{
+	Instance = uint(instance);
+	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 instanceMatrix; // first location after the Vertex attributes, see Mesh::DrawInstanced
+layout (location = 9) in uint instanceIndex;  // from a second instance buffer, the instance's index in the whole set
+
+flat out uint Instance;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+void main()
+{
+	Instance = instanceIndex;
+	gl_Position = projection * view * instanceMatrix * vec4(aPos, 1.0f);
+}
@@ -0,0 +1,411 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <glm/glm.hpp>
+
+#include "../parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Uniform grid over instance bounding spheres (xyz = center, w = radius). Space is cut into cubic cells of CellSize
+// and every instance is stored in the cell holding its center; cells are hashed into a fixed number of buckets,
+// so memory only depends on the number of instances, not on how far apart they are. Queries only visit the cells
+// they overlap. Works best when CellSize is a few times the typical instance radius.
+class SpatialHashGrid
+{
+public:
+    float CellSize;
+    unsigned int BucketCount;   // power of two
+    float MaxRadius;            // largest instance radius, queries are widened by it
+    vector<glm::vec4> Spheres;
+
+    SpatialHashGrid(float cellSize, unsigned int bucketCount = 1 << 16) : CellSize(cellSize), MaxRadius(0.0f)
+    {
+        BucketCount = 1;
+        while (BucketCount < bucketCount)
+            BucketCount <<= 1;
+    }
+
+    // (re)builds the grid from scratch with a counting sort: every thread computes the cells of its part of the
+    // instances and counts them per bucket, the counts are summed up into where each thread's instances go in every
+    // bucket, then every thread places its part. Instances end up in index order within a bucket, no locking needed.
+    void Build(const glm::vec4 *spheres, size_t count, unsigned int threads = 0)
+    {
+        if (threads == 0)
+            threads = defaultThreadCount();
+        Spheres.assign(spheres, spheres + count);
+        cells.resize(count);
+        bucketOf.resize(count);
+        slots.resize(count);
+        buckets.resize(BucketCount);
+
+        vector<float> maxRadius(threads, 0.0f);
+        vector<glm::ivec3> minCell(threads, glm::ivec3(INT32_MAX)), maxCell(threads, glm::ivec3(INT32_MIN));
+        vector<unsigned int> offsets((size_t)threads * BucketCount, 0);
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int t) {
+            unsigned int *counts = &offsets[(size_t)t * BucketCount];
+            for (size_t i = begin; i < end; i++)
+            {
+                cells[i] = cellOf(glm::vec3(Spheres[i]));
+                bucketOf[i] = hashCell(cells[i]);
+                counts[bucketOf[i]]++;
+                maxRadius[t] = std::max(maxRadius[t], Spheres[i].w);
+                minCell[t] = glm::min(minCell[t], cells[i]);
+                maxCell[t] = glm::max(maxCell[t], cells[i]);
+            }
+        }, threads);
+
+        MaxRadius = 0.0f;
+        minOccupied = glm::ivec3(INT32_MAX);
+        maxOccupied = glm::ivec3(INT32_MIN);
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            MaxRadius = std::max(MaxRadius, maxRadius[t]);
+            minOccupied = glm::min(minOccupied, minCell[t]);
+            maxOccupied = glm::max(maxOccupied, maxCell[t]);
+        }
+
+        // a bucket holds the instances of thread 0's part first, then thread 1's, ...
+        parallelFor(BucketCount, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t b = begin; b < end; b++)
+            {
+                unsigned int total = 0;
+                for (unsigned int t = 0; t < threads; t++)
+                {
+                    unsigned int n = offsets[(size_t)t * BucketCount + b];
+                    offsets[(size_t)t * BucketCount + b] = total;
+                    total += n;
+                }
+                buckets[b].resize(total);
+            }
+        }, threads);
+
+        // the same count and threads give the same parts as the counting pass
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int t) {
+            unsigned int *next = &offsets[(size_t)t * BucketCount];
+            for (size_t i = begin; i < end; i++)
+            {
+                slots[i] = next[bucketOf[i]]++;
+                buckets[bucketOf[i]][slots[i]] = (unsigned int)i;
+            }
+        }, threads);
+    }
+
+    // moves a single instance; only touches the grid when the instance changes cell. The occupied range only grows
+    // here, the next Build or bulk Update shrinks it again.
+    void Update(unsigned int index, const glm::vec4 &sphere)
+    {
+        Spheres[index] = sphere;
+        MaxRadius = std::max(MaxRadius, sphere.w);
+        glm::ivec3 cell = cellOf(glm::vec3(sphere));
+        if (cell == cells[index])
+            return;
+        moveToCell(index, cell);
+    }
+
+    // updates all instances at once: new cells are computed in parallel, then only the instances that crossed
+    // a cell border are moved between buckets. The occupied range is recomputed, so it follows instances that leave.
+    void Update(const glm::vec4 *spheres, unsigned int threads = 0)
+    {
+        if (threads == 0)
+            threads = defaultThreadCount();
+        size_t count = Spheres.size();
+        vector<vector<unsigned int> > moved(threads);
+        vector<glm::ivec3> newCells(count);
+        vector<float> maxRadius(threads, 0.0f);
+        vector<glm::ivec3> minCell(threads, glm::ivec3(INT32_MAX)), maxCell(threads, glm::ivec3(INT32_MIN));
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int t) {
+            for (size_t i = begin; i < end; i++)
+            {
+                Spheres[i] = spheres[i];
+                maxRadius[t] = std::max(maxRadius[t], spheres[i].w);
+                newCells[i] = cellOf(glm::vec3(spheres[i]));
+                minCell[t] = glm::min(minCell[t], newCells[i]);
+                maxCell[t] = glm::max(maxCell[t], newCells[i]);
+                if (newCells[i] != cells[i])
+                    moved[t].push_back((unsigned int)i);
+            }
+        }, threads);
+        MaxRadius = 0.0f;
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            MaxRadius = std::max(MaxRadius, maxRadius[t]);
+            for (unsigned int j = 0; j < moved[t].size(); j++)
+                moveToCell(moved[t][j], newCells[moved[t][j]]);
+        }
+        minOccupied = glm::ivec3(INT32_MAX);
+        maxOccupied = glm::ivec3(INT32_MIN);
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            minOccupied = glm::min(minOccupied, minCell[t]);
+            maxOccupied = glm::max(maxOccupied, maxCell[t]);
+        }
+    }
+
+    // all instances whose sphere overlaps the given sphere
+    void QuerySphere(const glm::vec3 &center, float radius, vector<unsigned int> &result) const
+    {
+        result.clear();
+        glm::vec3 reach(radius + MaxRadius);
+        glm::ivec3 first = glm::max(cellOf(center - reach), minOccupied);
+        glm::ivec3 last = glm::min(cellOf(center + reach), maxOccupied);
+        for (int z = first.z; z <= last.z; z++)
+            for (int y = first.y; y <= last.y; y++)
+                for (int x = first.x; x <= last.x; x++)
+                    forEachInCell(glm::ivec3(x, y, z), [&](unsigned int i) {
+                        glm::vec3 offset = glm::vec3(Spheres[i]) - center;
+                        float limit = radius + Spheres[i].w;
+                        if (glm::dot(offset, offset) <= limit * limit)
+                            result.push_back(i);
+                    });
+    }
+
+    // all instances whose sphere is at least partly inside the frustum of a projection * view matrix.
+    // blocks of cells are tested against the frustum first and split only where they straddle its border.
+    void QueryFrustum(const glm::mat4 &viewProjection, vector<unsigned int> &result) const
+    {
+        result.clear();
+        if (Spheres.empty())
+            return;
+        glm::vec4 planes[6];
+        for (int i = 0; i < 3; i++)
+        {
+            glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+            glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+            planes[i * 2] = w + row;
+            planes[i * 2 + 1] = w - row;
+        }
+        for (int i = 0; i < 6; i++)
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+        queryFrustumBlock(planes, minOccupied, maxOccupied, result);
+    }
+
+    // closest instance hit by the ray origin + t * direction (direction normalized) with t in [0, maxDistance].
+    // walks the cells along the ray (Amanatides & Woo) and returns -1 when nothing is hit.
+    int Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, float &hitDistance) const
+    {
+        int hit = -1;
+        hitDistance = maxDistance;
+        if (Spheres.empty())
+            return hit;
+
+        // instances are filed by their center, so look at the neighbouring cells their radius can reach into
+        int reach = (int)std::ceil(MaxRadius / CellSize);
+        glm::ivec3 cell = cellOf(origin);
+        glm::ivec3 step;
+        glm::vec3 tMax, tDelta;
+        for (int a = 0; a < 3; a++)
+        {
+            step[a] = direction[a] > 0.0f ? 1 : (direction[a] < 0.0f ? -1 : 0);
+            float boundary = (cell[a] + (step[a] > 0 ? 1 : 0)) * CellSize;
+            tMax[a] = step[a] != 0 ? (boundary - origin[a]) / direction[a] : 1e30f;
+            tDelta[a] = step[a] != 0 ? CellSize / std::fabs(direction[a]) : 1e30f;
+        }
+
+        // a sphere entered at t is found while visiting the cell the ray is in at t, so walking
+        // can stop once the cells start beyond the closest hit so far
+        float tEnter = 0.0f;
+        while (tEnter <= hitDistance)
+        {
+            for (int z = cell.z - reach; z <= cell.z + reach; z++)
+                for (int y = cell.y - reach; y <= cell.y + reach; y++)
+                    for (int x = cell.x - reach; x <= cell.x + reach; x++)
+                        forEachInCell(glm::ivec3(x, y, z), [&](unsigned int i) {
+                            float t;
+                            if (raySphere(origin, direction, Spheres[i], t) && t < hitDistance)
+                            {
+                                hitDistance = t;
+                                hit = (int)i;
+                            }
+                        });
+
+            // leave the occupied region: nothing more can be hit
+            if (!rayCanReachOccupied(cell, step, reach))
+                break;
+
+            int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+            tEnter = tMax[axis];
+            cell[axis] += step[axis];
+            tMax[axis] += tDelta[axis];
+        }
+        return hit;
+    }
+
+    // the k instances whose centers are closest to point, nearest first. Searches shells of cells around the
+    // point's cell and stops as soon as no unvisited cell can hold anything closer than the current k-th result.
+    void KNearest(const glm::vec3 &point, unsigned int k, vector<unsigned int> &result) const
+    {
+        result.clear();
+        if (k == 0 || Spheres.empty())
+            return;
+        priority_queue<pair<float, unsigned int> > best; // max-heap on squared distance
+        glm::ivec3 center = cellOf(point);
+        int maxRing = 0;
+        for (int a = 0; a < 3; a++)
+            maxRing = std::max(maxRing, std::max(std::abs(center[a] - minOccupied[a]), std::abs(maxOccupied[a] - center[a])));
+        for (int ring = 0; ring <= maxRing; ring++)
+        {
+            // every cell of this ring is at least (ring - 1) * CellSize away from point
+            if (best.size() == k)
+            {
+                float bound = (ring - 1) * CellSize;
+                if (bound > 0.0f && bound * bound > best.top().first)
+                    break;
+            }
+            for (int z = center.z - ring; z <= center.z + ring; z++)
+                for (int y = center.y - ring; y <= center.y + ring; y++)
+                {
+                    bool onShell = std::abs(z - center.z) == ring || std::abs(y - center.y) == ring;
+                    int stepX = onShell ? 1 : 2 * ring;
+                    for (int x = center.x - ring; x <= center.x + ring; x += std::max(stepX, 1))
+                        forEachInCell(glm::ivec3(x, y, z), [&](unsigned int i) {
+                            glm::vec3 offset = glm::vec3(Spheres[i]) - point;
+                            float dist2 = glm::dot(offset, offset);
+                            if (best.size() < k)
+                                best.push(make_pair(dist2, i));
+                            else if (dist2 < best.top().first)
+                            {
+                                best.pop();
+                                best.push(make_pair(dist2, i));
+                            }
+                        });
+                }
+        }
+        result.resize(best.size());
+        for (int i = (int)best.size() - 1; i >= 0; i--)
+        {
+            result[i] = best.top().second;
+            best.pop();
+        }
+    }
+
+private:
+    vector<vector<unsigned int> > buckets;
+    vector<glm::ivec3> cells;          // cell of every instance
+    vector<unsigned int> bucketOf;     // bucket of every instance
+    vector<unsigned int> slots;        // position of every instance inside its bucket
+    glm::ivec3 minOccupied, maxOccupied;
+
+    glm::ivec3 cellOf(const glm::vec3 &position) const
+    {
+        glm::vec3 c = glm::floor(position / CellSize);
+        return glm::ivec3((int)c.x, (int)c.y, (int)c.z);
+    }
+
+    unsigned int hashCell(const glm::ivec3 &cell) const
+    {
+        uint32_t h = (uint32_t)cell.x * 73856093u ^ (uint32_t)cell.y * 19349663u ^ (uint32_t)cell.z * 83492791u;
+        return h & (BucketCount - 1);
+    }
+
+    // calls func for every instance whose center lies in the cell (buckets are shared by several cells)
+    template<typename Func>
+    void forEachInCell(const glm::ivec3 &cell, Func func) const
+    {
+        const vector<unsigned int> &bucket = buckets[hashCell(cell)];
+        for (unsigned int j = 0; j < bucket.size(); j++)
+            if (cells[bucket[j]] == cell)
+                func(bucket[j]);
+    }
+
+    void moveToCell(unsigned int index, const glm::ivec3 &cell)
+    {
+        // swap-remove from the old bucket, fixing the slot of the instance that took its place
+        vector<unsigned int> &oldBucket = buckets[bucketOf[index]];
+        unsigned int last = oldBucket.back();
+        oldBucket[slots[index]] = last;
+        slots[last] = slots[index];
+        oldBucket.pop_back();
+
+        cells[index] = cell;
+        bucketOf[index] = hashCell(cell);
+        slots[index] = buckets[bucketOf[index]].size();
+        buckets[bucketOf[index]].push_back(index);
+        minOccupied = glm::min(minOccupied, cell);
+        maxOccupied = glm::max(maxOccupied, cell);
+    }
+
+    void queryFrustumBlock(const glm::vec4 *planes, glm::ivec3 first, glm::ivec3 last, vector<unsigned int> &result) const
+    {
+        // block bounds, widened by the largest radius since instances only have their center inside
+        glm::vec3 boxMin = glm::vec3(first) * CellSize - glm::vec3(MaxRadius);
+        glm::vec3 boxMax = glm::vec3(last + glm::ivec3(1)) * CellSize + glm::vec3(MaxRadius);
+        bool inside = true;
+        for (int p = 0; p < 6; p++)
+        {
+            glm::vec3 n(planes[p]);
+            glm::vec3 positive(n.x >= 0.0f ? boxMax.x : boxMin.x, n.y >= 0.0f ? boxMax.y : boxMin.y, n.z >= 0.0f ? boxMax.z : boxMin.z);
+            glm::vec3 negative(n.x >= 0.0f ? boxMin.x : boxMax.x, n.y >= 0.0f ? boxMin.y : boxMax.y, n.z >= 0.0f ? boxMin.z : boxMax.z);
+            if (glm::dot(n, positive) + planes[p].w < 0.0f)
+                return;
+            if (glm::dot(n, negative) + planes[p].w < 0.0f)
+                inside = false;
+        }
+
+        glm::ivec3 size = last - first + glm::ivec3(1);
+        if (inside || (size.x == 1 && size.y == 1 && size.z == 1))
+        {
+            for (int z = first.z; z <= last.z; z++)
+                for (int y = first.y; y <= last.y; y++)
+                    for (int x = first.x; x <= last.x; x++)
+                        forEachInCell(glm::ivec3(x, y, z), [&](unsigned int i) {
+                            if (inside || sphereInFrustum(planes, Spheres[i]))
+                                result.push_back(i);
+                        });
+            return;
+        }
+
+        // split the block in half along its longest side
+        int axis = size.x >= size.y ? (size.x >= size.z ? 0 : 2) : (size.y >= size.z ? 1 : 2);
+        glm::ivec3 middleLast = last, middleFirst = first;
+        middleLast[axis] = first[axis] + size[axis] / 2 - 1;
+        middleFirst[axis] = middleLast[axis] + 1;
+        queryFrustumBlock(planes, first, middleLast, result);
+        queryFrustumBlock(planes, middleFirst, last, result);
+    }
+
+    static bool sphereInFrustum(const glm::vec4 *planes, const glm::vec4 &sphere)
+    {
+        for (int p = 0; p < 6; p++)
+            if (glm::dot(glm::vec3(planes[p]), glm::vec3(sphere)) + planes[p].w < -sphere.w)
+                return false;
+        return true;
+    }
+
+    static bool raySphere(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec4 &sphere, float &t)
+    {
+        glm::vec3 offset = origin - glm::vec3(sphere);
+        float b = glm::dot(offset, direction);
+        float c = glm::dot(offset, offset) - sphere.w * sphere.w;
+        float discriminant = b * b - c;
+        if (discriminant < 0.0f)
+            return false;
+        float root = std::sqrt(discriminant);
+        t = -b - root;
+        if (t < 0.0f)
+            t = -b + root; // origin inside the sphere
+        return t >= 0.0f;
+    }
+
+    // false once the ray has left the occupied cell range (plus reach) on an axis it is moving away on
+    bool rayCanReachOccupied(const glm::ivec3 &cell, const glm::ivec3 &step, int reach) const
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            if (step[a] > 0 && cell[a] - reach > maxOccupied[a])
+                return false;
+            if (step[a] < 0 && cell[a] + reach < minOccupied[a])
+                return false;
+            if (step[a] == 0 && (cell[a] + reach < minOccupied[a] || cell[a] - reach > maxOccupied[a]))
+                return false;
+        }
+        return true;
+    }
+};
+#endif
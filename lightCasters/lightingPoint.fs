@@ -15,11 +15,19 @@ struct Light {
 	float constant;
 	float linear;
 	float quadratic;
+	// where the attenuation has brought the light below the threshold, it fades out to nothing there 
+	float range;
 };
 
 uniform Material material; 
 uniform Light light; 
+// whether the light reaches the cube being drawn at all 
+uniform bool lightReaches;
 uniform vec3 viewPos; 
+// the light's cube shadow map, six layers one per face in cube map order, and the faces' near and far plane 
+// (see pointShadows.h) 
+uniform sampler2DArrayShadow pointShadowMaps;
+uniform vec2 pointShadowPlanes;
 
 in vec3 Normal; 
 in vec3 FragPos; 
@@ -27,7 +35,15 @@ in vec2 TexCoords;
 
 out vec4 FragColor;
 
+// Function to look up the cube shadow map, 1 where nothing is between the fragment and the light 
+float CalcShadow(vec3 fragPos, vec3 normal);
+
 void main() {
+	// Culled on the CPU, beyond its range the light adds nothing 
+	if (!lightReaches) {
+		FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
 
 	// Determine ambient light 
 	// Set equal to diffuse material's color 
@@ -51,12 +67,52 @@ void main() {
 	// Factor in attenuation 
 	float distance = length(light.position - FragPos);
 	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	float falloff = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+	attenuation *= falloff * falloff;
 	ambient *= attenuation;
 	diffuse *= attenuation;
 	specular *= attenuation;
+	
+	// Shadow, the ambient light gets around it 
+	float shadow = CalcShadow(FragPos, norm);
+	diffuse *= shadow;
+	specular *= shadow;
 
 	
 	// Calculate result
 	vec3 result = ambient + diffuse + specular;
 	FragColor = vec4(result, 1.0);
 }
+
+// Function to look up the cube shadow map, 1 where nothing is between the fragment and the light 
+const vec3 cubeForward[6] = vec3[](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), 
+                                   vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+const vec3 cubeUp[6] = vec3[](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), 
+                              vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
+float CalcShadow(vec3 fragPos, vec3 normal) {
+	float near = pointShadowPlanes.x;
+	float far = pointShadowPlanes.y;
+	// the face is the one of the largest axis 
+	vec3 toFrag = fragPos - light.position;
+	vec3 a = abs(toFrag);
+	int face = a.x >= a.y && a.x >= a.z ? (toFrag.x > 0.0 ? 0 : 1) : (a.y >= a.z ? (toFrag.y > 0.0 ? 2 : 3) : (toFrag.z > 0.0 ? 4 : 5));
+	// looked up a couple of texels out along the normal, a texel being 2 * distance / resolution wide 
+	vec2 texel = 1.0 / vec2(textureSize(pointShadowMaps, 0).xy);
+	toFrag += normal * (4.0 * max(a.x, max(a.y, a.z)) * texel.x);
+	// projected like the face was drawn, glm::lookAt and a 90 degree perspective 
+	vec3 forward = cubeForward[face];
+	vec3 side = cross(forward, cubeUp[face]);
+	vec3 up = cross(side, forward);
+	float w = dot(forward, toFrag);
+	if (w >= far)
+		return 1.0;
+	vec2 position = vec2(dot(side, toFrag), dot(up, toFrag)) / w * 0.5 + 0.5;
+	float depth = ((far + near) / (far - near) - 2.0 * far * near / ((far - near) * w)) * 0.5 + 0.5;
+	// four lookups, each comparing and blending four texels, kept inside the face 
+	float lit = 0.0;
+	for (int i = 0; i < 4; i++) {
+		vec2 offset = vec2((i & 1) != 0 ? 0.5 : -0.5, (i & 2) != 0 ? 0.5 : -0.5) * texel;
+		lit += texture(pointShadowMaps, vec4(clamp(position + offset, 0.5 * texel, 1.0 - 0.5 * texel), float(face), depth));
+	}
+	return lit * 0.25;
+}
@@ -8,13 +8,21 @@
 #include "shader_m.h"
 #include "camera.h"
 #include "stb_image.h"
+#include "../pointShadows.h"
+#include "../lightManager.h"
 
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <vector>
+#include "../headless.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
+bool sphereInFrustum(const glm::mat4 &viewProjection, glm::vec3 center, float radius);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -33,43 +41,65 @@ float lastFrame = 0.0f;
 // lighting 
 float radiusOfLight = 2.0f; 
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
+// radius of the cubes' bounding spheres: half the diagonal of a unit cube
+const float CUBE_RADIUS = sqrtf(3.0f) / 2.0f;
+// the first cube turns when spin is set, so the light's shadow map is drawn every frame 
+bool spin = false;
 
-int main()
+int main(int argc, char **argv)
 {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
-#endif
-
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
+    // --headless renders offscreen instead, see headless.h
+    Headless headless(argc, argv);
+    // --light-threshold T ends the light's range where it falls below T instead of 5/256
+    float lightThreshold = Light::DEFAULT_THRESHOLD;
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--spin") == 0)
+            spin = true;
+        else if (strcmp(argv[i], "--light-threshold") == 0 && i + 1 < argc)
+            lightThreshold = (float)atof(argv[i + 1]);
+    GLFWwindow* window = NULL;
+    if (headless.Enabled)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    else
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    #ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
+    #endif
+
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
     }
 
     // configure global opengl state
@@ -218,23 +248,64 @@ int main()
 	cout << "Failed to load texture" << endl;
     }
     stbi_image_free(data); 
+
+    // the light's shadows, a cube shadow map drawn in one pass; the cubes are the casters
+    PointShadowSettings shadowSettings;
+    shadowSettings.Slots = 1;
+    PointShadows pointShadows(shadowSettings);
+    pointShadows.Add(0);
+    // the light's range from its attenuation, as LightManager works it out
+    Light light = Light::Point(lightPos, glm::vec3(0.5f), glm::vec3(1.0f), 1.0f, 0.09f, 0.032f);
+    float lightRange = light.Radius(lightThreshold);
+    pointShadows.SetLight(0, lightPos, lightRange);
+    vector<ShadowCaster> casters;
+    glm::mat4 cubeModels[10];
+    for (unsigned int i = 0; i < 10; i++)
+    {
+        cubeModels[i] = glm::translate(cubeModels[i], cubePositions[i]);
+        cubeModels[i] = glm::rotate(cubeModels[i], glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
+        casters.push_back(ShadowCaster(cubePositions[i], CUBE_RADIUS, spin && i == 0));
+    }
+    lightingShader.use();
+    lightingShader.setInt("pointShadowMaps", 2);
+    lightingShader.setVec2("pointShadowPlanes", shadowSettings.Near, pointShadows.Far(lightRange));
+    lightingShader.setFloat("light.range", lightRange);
+    unsigned int reachedCubes = 0;
+    double lastReport = headless.Time();
 	
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window))
+    while (headless.Running(window))
     {
         // per-frame time logic
         // --------------------
-        float currentFrame = glfwGetTime();
+        float currentFrame = headless.Time();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         // input
         // -----
-        processInput(window);
+        if (headless.Enabled)
+            headless.MoveCamera(camera);
+        else
+            processInput(window);
 
         // render
         // ------
+	// the first cube turns in place 
+	if (spin) {
+		cubeModels[0] = glm::translate(glm::mat4(), cubePositions[0]);
+		cubeModels[0] = glm::rotate(cubeModels[0], headless.Time(), glm::vec3(1.0f, 0.3f, 0.5f));
+	}
+	// the shadow map is only drawn again when something moved within the light's reach 
+	pointShadows.Update(casters);
+	pointShadows.Render([&](Shader &shader, unsigned int i) {
+		shader.setMat4("model", cubeModels[i]);
+		glBindVertexArray(cubeVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 36);
+	});
+	pointShadows.Bind(2);
+
 	//  Clear screen 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -246,15 +317,14 @@ int main()
 	lightingShader.setVec3("light.position", lightPos);
 	lightingShader.setVec3("viewPos", camera.Position);
 
-	glm::vec3 diffuseColor = glm::vec3(0.5f);
 	glm::vec3 ambientColor = glm::vec3(0.2f); 
         lightingShader.setVec3("light.ambient",  ambientColor);
-	lightingShader.setVec3("light.diffuse", diffuseColor);
-	lightingShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
+	lightingShader.setVec3("light.diffuse", light.Diffuse);
+	lightingShader.setVec3("light.specular", light.Specular);
 
-	lightingShader.setFloat("light.constant", 1.0f);
-	lightingShader.setFloat("light.linear", 0.09f);
-	lightingShader.setFloat("light.quadratic", 0.032f);
+	lightingShader.setFloat("light.constant", light.Constant);
+	lightingShader.setFloat("light.linear", light.Linear);
+	lightingShader.setFloat("light.quadratic", light.Quadratic);
 
 	lightingShader.setVec3("material.ambient", 1.0f, 0.5f, 0.31f);
 	lightingShader.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
@@ -277,13 +347,14 @@ int main()
         lightingShader.setMat4("projection", projection);
         lightingShader.setMat4("view", view);
 
-        // draw cubes 
+        // draw cubes, the light is culled against the view and then against each cube's bounding sphere 
+	bool lightVisible = sphereInFrustum(projection * view, lightPos, lightRange);
+	reachedCubes = 0;
 	for (unsigned int i = 0; i < 10; i++) {
-		glm::mat4 model; 
-		model = glm::translate(model, cubePositions[i]);
-		float angle = 20.0f * i;
-		model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-		lightingShader.setMat4("model", model);
+		bool reaches = lightVisible && glm::length(cubePositions[i] - lightPos) <= lightRange + CUBE_RADIUS;
+		reachedCubes += reaches ? 1 : 0;
+		lightingShader.setBool("lightReaches", reaches);
+		lightingShader.setMat4("model", cubeModels[i]);
 		glBindVertexArray(cubeVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
 	}
@@ -301,10 +372,17 @@ int main()
 	glBindVertexArray(lampVAO);
 	glDrawArrays(GL_TRIANGLES, 0, 36);
 
+	// what the light reaches and what its shadow costs, once a second 
+	if (currentFrame - lastReport >= 1.0) {
+		cout << "light: range " << lightRange << ", reaches " << reachedCubes << " of 10 cubes" << endl;
+		cout << "shadow: " << pointShadows.Stats[0].GpuMs << " ms, " << pointShadows.Stats[0].Casters << " casters, "
+		     << pointShadows.Stats[0].Redraws << " redraws" << endl;
+		lastReport = currentFrame;
+	}
+
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        headless.SwapBuffers(window);
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
@@ -336,6 +414,22 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(RIGHT, deltaTime);
 }
 
+// whether a sphere reaches into the view frustum, tested against the frustum's planes (Gribb and Hartmann)
+// --------------------------------------------------------------------------------------------------------
+bool sphereInFrustum(const glm::mat4 &viewProjection, glm::vec3 center, float radius)
+{
+    glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+    for (int i = 0; i < 6; i++)
+    {
+        int axis = i / 2;
+        glm::vec4 row(viewProjection[0][axis], viewProjection[1][axis], viewProjection[2][axis], viewProjection[3][axis]);
+        glm::vec4 plane = i % 2 == 0 ? w + row : w - row;
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius * glm::length(glm::vec3(plane)))
+            return false;
+    }
+    return true;
+}
+
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -0,0 +1,39 @@
+#version 330 core
+// Copies each triangle into the faces of a point light's cube shadow map that it can be seen in (see pointShadows.h)
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+// from world space to each face's clip space, in cube map order 
+uniform mat4 faceMatrices[6];
+// the light's first layer in the atlas 
+uniform int layerBase;
+
+void main()
+{
+    for (int face = 0; face < 6; face++)
+    {
+        vec4 position[3];
+        for (int i = 0; i < 3; i++)
+            position[i] = faceMatrices[face] * gl_in[i].gl_Position;
+        // skipped when all three corners are outside the same side of the face's frustum 
+        bvec3 outside[6];
+        for (int i = 0; i < 3; i++)
+        {
+            outside[0][i] = position[i].x < -position[i].w;
+            outside[1][i] = position[i].x > position[i].w;
+            outside[2][i] = position[i].y < -position[i].w;
+            outside[3][i] = position[i].y > position[i].w;
+            outside[4][i] = position[i].z < -position[i].w;
+            outside[5][i] = position[i].z > position[i].w;
+        }
+        if (all(outside[0]) || all(outside[1]) || all(outside[2]) || all(outside[3]) || all(outside[4]) || all(outside[5]))
+            continue;
+        for (int i = 0; i < 3; i++)
+        {
+            gl_Position = position[i];
+            gl_Layer = layerBase + face;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
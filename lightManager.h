@@ -0,0 +1,276 @@
+#ifndef LIGHT_MANAGER_H
+#define LIGHT_MANAGER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// Shared by multLights and lightCasters' pointLights, like pointShadows.h. pointLights only needs Light::Radius.
+
+enum LightType {
+    LIGHT_DIRECTIONAL = 0,
+    LIGHT_POINT = 1,
+    LIGHT_SPOT = 2
+};
+
+// One light as the shaders read it: five RGBA32F texels of the light buffer, see FetchLight in lighting.fs.
+// Directional lights have no attenuation (constant 1, linear and quadratic 0) and point lights no cone, so every
+// light goes through the same code in the shader. The shader fades a light out towards its range, so a light
+// contributes nothing beyond it and culling by range changes nothing on screen.
+struct Light {
+    static constexpr float DEFAULT_THRESHOLD = 5.0f / 256.0f;
+
+    glm::vec3 Position;
+    float Type;
+    glm::vec3 Direction;
+    float Constant;
+    glm::vec3 Diffuse;
+    float Linear;
+    glm::vec3 Specular;
+    float Quadratic;
+    float CutOff;                   // cosines of the spot's inner and outer angle
+    float OuterCutOff;
+    float Range;                    // Radius() at the LightManager's threshold, kept up to date by it
+    float Shadow;                   // 0 for no shadows. a directional light casts them through the cascaded shadow maps,
+                                    // a point or spot light through its cube in the point shadow atlas, slot Shadow - 1
+
+    static Light Directional(glm::vec3 direction, glm::vec3 diffuse, glm::vec3 specular)
+    {
+        Light light = Light();
+        light.Type = LIGHT_DIRECTIONAL;
+        light.Direction = direction;
+        light.Diffuse = diffuse;
+        light.Specular = specular;
+        light.Constant = 1.0f;
+        light.CutOff = light.OuterCutOff = -1.0f;
+        return light;
+    }
+
+    static Light Point(glm::vec3 position, glm::vec3 diffuse, glm::vec3 specular, float constant, float linear, float quadratic)
+    {
+        Light light = Light();
+        light.Type = LIGHT_POINT;
+        light.Position = position;
+        light.Diffuse = diffuse;
+        light.Specular = specular;
+        light.Constant = constant;
+        light.Linear = linear;
+        light.Quadratic = quadratic;
+        light.CutOff = light.OuterCutOff = -1.0f;
+        return light;
+    }
+
+    static Light Spot(glm::vec3 position, glm::vec3 direction, glm::vec3 diffuse, glm::vec3 specular, float constant,
+                      float linear, float quadratic, float cutOff, float outerCutOff)
+    {
+        Light light = Point(position, diffuse, specular, constant, linear, quadratic);
+        light.Type = LIGHT_SPOT;
+        light.Direction = direction;
+        light.CutOff = cutOff;
+        light.OuterCutOff = outerCutOff;
+        return light;
+    }
+
+    // the distance at which the light's attenuation has brought it below threshold (by default 5/256, less
+    // than a step of an 8 bit color channel, counting the specular highlight's full strength), or a negative
+    // number for lights that reach everything: directional lights and lights without distance falloff
+    float Radius(float threshold = DEFAULT_THRESHOLD) const
+    {
+        float brightness = max(max(max(Diffuse.x, Diffuse.y), max(Diffuse.z, Specular.x)), max(Specular.y, Specular.z));
+        if (Type == LIGHT_DIRECTIONAL)
+            return -1.0f;
+        if (brightness <= 0.0f)
+            return 0.0f;
+        // solve constant + linear d + quadratic d^2 = brightness / threshold
+        float c = Constant - brightness / threshold;
+        if (c >= 0.0f)
+            return 0.0f;
+        if (Quadratic > 0.0f)
+            return (-Linear + sqrtf(Linear * Linear - 4.0f * Quadratic * c)) / (2.0f * Quadratic);
+        if (Linear > 0.0f)
+            return -c / Linear;
+        return -1.0f;
+    }
+};
+static_assert(sizeof(Light) == 5 * 4 * sizeof(float), "Light must match the 5 texels the shaders fetch");
+
+// Keeps every light of a scene in one texture buffer that the shaders loop over, so the light count is only
+// limited by GL_MAX_TEXTURE_BUFFER_SIZE (at least 65536 texels, 13107 lights) rather than a fixed array of
+// uniforms. Lights are changed on the CPU side and Upload sends only the ones that changed, as one
+// glBufferSubData per run of neighbouring lights; setting a light to what it already is costs nothing. The
+// light count lives in a small uniform block so no shader needs a uniform set per frame.
+class LightManager
+{
+public:
+    static const unsigned int TEXELS_PER_LIGHT = 5;
+    // binding point of the LightCount uniform block
+    static const unsigned int UNIFORM_BINDING = 1;
+
+    // bytes sent by the last Upload
+    size_t UploadedBytes;
+
+    LightManager(unsigned int capacity = 64) : UploadedBytes(0), capacity(max(capacity, 1u)), uploadedCount(~0u),
+                                               threshold(Light::DEFAULT_THRESHOLD)
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, this->capacity * sizeof(Light), NULL, GL_DYNAMIC_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+        glGenBuffers(1, &countBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, countBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, 4 * sizeof(int), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING, countBuffer, 0, 4 * sizeof(int));
+
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        maxLights = (unsigned int)maxTexels / TEXELS_PER_LIGHT;
+    }
+
+    ~LightManager()
+    {
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(1, &buffer);
+        glDeleteBuffers(1, &countBuffer);
+    }
+
+    // returns the new light's index, or -1 if the light buffer is full
+    int Add(Light light)
+    {
+        if (lights.size() >= maxLights)
+        {
+            cout << "ERROR::LIGHTS:: The light buffer holds at most " << maxLights << " lights" << endl;
+            return -1;
+        }
+        light.Range = light.Radius(threshold);
+        lights.push_back(light);
+        dirtyFlags.push_back(0);
+        markDirty(lights.size() - 1);
+        return (int)lights.size() - 1;
+    }
+
+    void Set(unsigned int index, Light light)
+    {
+        light.Range = light.Radius(threshold);
+        if (memcmp(&lights[index], &light, sizeof(Light)) == 0)
+            return;
+        lights[index] = light;
+        markDirty(index);
+    }
+
+    const Light &Get(unsigned int index) const
+    {
+        return lights[index];
+    }
+
+    unsigned int Count() const
+    {
+        return (unsigned int)lights.size();
+    }
+
+    // the smallest share of a light that still counts: its range ends where the attenuation brings it below
+    // this. A higher threshold gives shorter ranges and cheaper shading for a slightly earlier fade out.
+    void SetThreshold(float threshold)
+    {
+        if (threshold <= 0.0f || threshold == this->threshold)
+            return;
+        this->threshold = threshold;
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            lights[i].Range = lights[i].Radius(threshold);
+            markDirty(i);
+        }
+    }
+
+    float Threshold() const
+    {
+        return threshold;
+    }
+
+    // removes every light, the buffer keeps its size
+    void Clear()
+    {
+        lights.clear();
+        dirtyFlags.clear();
+        dirty.clear();
+    }
+
+    // sends the lights that changed since the last call
+    void Upload()
+    {
+        UploadedBytes = 0;
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        if (lights.size() > capacity)
+        {
+            // the whole buffer is specified again, so everything gets uploaded
+            while (capacity < lights.size())
+                capacity *= 2;
+            glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(Light), NULL, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, lights.size() * sizeof(Light), &lights[0]);
+            UploadedBytes = lights.size() * sizeof(Light);
+        }
+        else
+        {
+            sort(dirty.begin(), dirty.end());
+            for (size_t i = 0; i < dirty.size();)
+            {
+                size_t run = 1;
+                while (i + run < dirty.size() && dirty[i + run] == dirty[i] + run)
+                    run++;
+                glBufferSubData(GL_TEXTURE_BUFFER, dirty[i] * sizeof(Light), run * sizeof(Light), &lights[dirty[i]]);
+                UploadedBytes += run * sizeof(Light);
+                i += run;
+            }
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        for (size_t i = 0; i < dirty.size(); i++)
+            dirtyFlags[dirty[i]] = 0;
+        dirty.clear();
+
+        if (uploadedCount != lights.size())
+        {
+            int count[4] = {(int)lights.size(), 0, 0, 0};
+            glBindBuffer(GL_UNIFORM_BUFFER, countBuffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(count), count);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            uploadedCount = (unsigned int)lights.size();
+        }
+    }
+
+    // binds the light buffer to a texture unit for the shaders' samplerBuffer
+    void Bind(unsigned int textureUnit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + textureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+    }
+
+private:
+    vector<Light> lights;
+    vector<unsigned int> dirty;             // indices of the lights to upload, each once
+    vector<unsigned char> dirtyFlags;
+    unsigned int buffer, texture, countBuffer;
+    size_t capacity;
+    unsigned int maxLights;
+    unsigned int uploadedCount;
+    float threshold;
+
+    void markDirty(size_t index)
+    {
+        if (dirtyFlags[index])
+            return;
+        dirtyFlags[index] = 1;
+        dirty.push_back((unsigned int)index);
+    }
+};
+#endif
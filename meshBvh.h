@@ -0,0 +1,798 @@
+#ifndef MESH_BVH_H
+#define MESH_BVH_H
+
+#include <glm/glm.hpp>
+
+#include "parallel.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+using namespace std;
+
+// Shared by modelLoading's picking, bvhBench and cubemap's lightmap baker, like parallel.h.
+
+struct BvhRay {
+    glm::vec3 Origin;
+    glm::vec3 Direction;
+    float Far;                      // hits beyond this don't count
+
+    BvhRay(glm::vec3 origin = glm::vec3(0.0f), glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f), float far = 1e30f)
+        : Origin(origin), Direction(direction), Far(far)
+    {
+    }
+};
+
+struct BvhHit {
+    float Distance;
+    unsigned int Mesh;              // in the order the meshes were added
+    unsigned int Triangle;          // within its mesh, the index of its first index / 3
+    float U, V;                     // barycentric coordinates of the triangle's second and third corner
+
+    BvhHit() : Distance(0.0f), Mesh(0), Triangle(0), U(0.0f), V(0.0f)
+    {
+    }
+};
+
+struct BvhStats {
+    double BuildMs;
+    double RefitMs;
+    size_t Triangles;
+    size_t Nodes;
+    size_t Leaves;
+    unsigned int Depth;
+    float Cost;                     // SAH cost of the tree, relative to the root's surface area
+
+    BvhStats() : BuildMs(0.0), RefitMs(0.0), Triangles(0), Nodes(0), Leaves(0), Depth(0), Cost(0.0f)
+    {
+    }
+};
+
+// A bounding volume hierarchy over the triangles of Model meshes, for ray picking, baking, occlusion and
+// collision queries on the CPU.
+//  - Build: binned SAH. Every node's triangles are sorted into BINS bins along each axis by their centroid and
+//    the node is split at the bin boundary with the lowest surface area cost, or becomes a leaf when no split is
+//    cheaper. The build recurses in tasks: each task owns a share of the threads, bins with all of them while
+//    the node is large, and hands half of them to a new task for one of the children. The top of the tree, where
+//    a single node holds everything, is binned in parallel that way, and the rest is built by one task a thread.
+//  - Layout: the binary tree is collapsed into nodes of Width children, Width 4 or 8 for SIMD traversal (2 keeps
+//    the binary tree). A node stores its children's bounds as six arrays of Width floats side by side, so one
+//    SSE test checks a ray against four children. Nodes are stored parent first and a node's triangles are
+//    stored together, as a corner and two edges, in the order the leaves are visited.
+//  - Refit: for animated meshes whose vertices move but whose triangles stay the same, SetPositions and Refit
+//    update the bounds bottom up without rebuilding. The tree gets worse the further the vertices move away from
+//    where it was built, rebuild it now and then.
+// Meshes are added with AddMesh (anything with vertices[i].Position and indices, like a Mesh) or AddModel, then
+// Build is called. Everything is in the space of the model's vertices.
+template<unsigned int Width>
+class MeshBvh
+{
+public:
+    static const unsigned int BINS = 16;
+    static const unsigned int MAX_LEAF = 8;
+    // below this many triangles a node is built by a single thread
+    static const unsigned int TASK_MIN = 4096;
+
+    BvhStats Stats;
+
+    // adds a mesh's triangles and returns its index
+    template<typename MeshType>
+    unsigned int AddMesh(const MeshType &mesh)
+    {
+        vector<glm::vec3> positions(mesh.vertices.size());
+        for (size_t i = 0; i < positions.size(); i++)
+            positions[i] = mesh.vertices[i].Position;
+        return AddMesh(positions, mesh.indices);
+    }
+
+    unsigned int AddMesh(const vector<glm::vec3> &positions, const vector<unsigned int> &indices)
+    {
+        unsigned int firstVertex = (unsigned int)this->positions.size();
+        meshFirstVertex.push_back(firstVertex);
+        this->positions.insert(this->positions.end(), positions.begin(), positions.end());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            // triangles pointing past the vertices would be read out of bounds, they're dropped
+            if (indices[i] >= positions.size() || indices[i + 1] >= positions.size() || indices[i + 2] >= positions.size())
+                continue;
+            corners.push_back(glm::uvec3(indices[i], indices[i + 1], indices[i + 2]) + glm::uvec3(firstVertex));
+            triangleMesh.push_back((unsigned int)meshFirstVertex.size() - 1);
+            triangleIndex.push_back((unsigned int)(i / 3));
+        }
+        return (unsigned int)meshFirstVertex.size() - 1;
+    }
+
+    // adds every mesh of a Model
+    template<typename ModelType>
+    void AddModel(const ModelType &model)
+    {
+        for (size_t i = 0; i < model.meshes.size(); i++)
+            AddMesh(model.meshes[i]);
+    }
+
+    // moves a mesh's vertices, call Refit after the meshes changed
+    void SetPositions(unsigned int mesh, const vector<glm::vec3> &positions)
+    {
+        size_t end = mesh + 1 < meshFirstVertex.size() ? meshFirstVertex[mesh + 1] : this->positions.size();
+        size_t count = min(positions.size(), end - meshFirstVertex[mesh]);
+        copy(positions.begin(), positions.begin() + count, this->positions.begin() + meshFirstVertex[mesh]);
+    }
+
+    template<typename MeshType>
+    void SetPositions(unsigned int mesh, const MeshType &source)
+    {
+        vector<glm::vec3> moved(source.vertices.size());
+        for (size_t i = 0; i < moved.size(); i++)
+            moved[i] = source.vertices[i].Position;
+        SetPositions(mesh, moved);
+    }
+
+    // builds the tree over the meshes added so far, on threads threads (0 uses every core)
+    void Build(unsigned int threads = 0)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if (threads == 0)
+            threads = defaultThreadCount();
+        size_t count = corners.size();
+        bounds.resize(count);
+        centers.resize(count);
+        order.resize(count);
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++)
+            {
+                Box box;
+                box.Grow(positions[corners[i].x]);
+                box.Grow(positions[corners[i].y]);
+                box.Grow(positions[corners[i].z]);
+                bounds[i] = box;
+                centers[i] = (box.Min + box.Max) * 0.5f;
+                order[i] = (unsigned int)i;
+            }
+        }, threads);
+
+        // a binary tree has at most 2n - 1 nodes, the tasks take theirs from a shared counter
+        build.assign(max<size_t>(1, 2 * count), BuildNode());
+        nextNode = 1;
+        build[0].First = 0;
+        build[0].Count = (unsigned int)count;
+        if (count > 0)
+            buildTask(0, threads);
+
+        // collapse into the wide nodes, parent first
+        nodes.clear();
+        Stats = BvhStats();
+        Stats.Triangles = count;
+        if (count > 0)
+        {
+            nodes.push_back(Node());
+            Stats.Depth = collapse(0, 0, 1);
+        }
+        levels = Stats.Depth;
+        Stats.Nodes = nodes.size();
+        build.clear();
+        build.shrink_to_fit();
+
+        leafTriangles.resize(count);
+        updateTriangles(threads);
+        refitNodes();
+        Stats.Cost = cost();
+        Stats.BuildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // updates the bounds to the vertices' current positions, keeping the tree as built
+    void Refit(unsigned int threads = 0)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        updateTriangles(threads);
+        refitNodes();
+        Stats.RefitMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // the closest hit along the ray, if any
+    bool Intersect(const BvhRay &ray, BvhHit &hit) const
+    {
+        hit.Distance = ray.Far;
+        unsigned int triangle;
+        if (!traverse(ray, hit, triangle, false))
+            return false;
+        unsigned int id = order[triangle];
+        hit.Mesh = triangleMesh[id];
+        hit.Triangle = triangleIndex[id];
+        return true;
+    }
+
+    // whether anything lies along the ray before Far, stops at the first hit found
+    bool Occluded(const BvhRay &ray) const
+    {
+        BvhHit hit;
+        hit.Distance = ray.Far;
+        unsigned int triangle;
+        return traverse(ray, hit, triangle, true);
+    }
+
+    // the bounds of everything, empty (min above max) before a build
+    void Bounds(glm::vec3 &min, glm::vec3 &max) const
+    {
+        Box box = rootBox();
+        min = box.Min;
+        max = box.Max;
+    }
+
+private:
+    static const unsigned int STACK_SIZE = 64 * Width;
+
+    struct Box {
+        glm::vec3 Min, Max;
+
+        Box() : Min(1e30f), Max(-1e30f)
+        {
+        }
+
+        void Grow(const glm::vec3 &p)
+        {
+            Min = glm::min(Min, p);
+            Max = glm::max(Max, p);
+        }
+
+        void Grow(const Box &b)
+        {
+            Min = glm::min(Min, b.Min);
+            Max = glm::max(Max, b.Max);
+        }
+
+        float Area() const
+        {
+            glm::vec3 d = Max - Min;
+            return d.x < 0.0f ? 0.0f : 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+    };
+
+    // a node of the binary tree the wide one is collapsed from
+    struct BuildNode {
+        Box Bounds;
+        unsigned int Left;          // the right child follows the left one, 0 for a leaf
+        unsigned int First, Count;
+
+        BuildNode() : Left(0), First(0), Count(0)
+        {
+        }
+    };
+
+    // Width children: the bounds as six arrays (min x, y, z, max x, y, z), and for each child either a node
+    // (Count 0, Child its index), a leaf (Count triangles from Child) or nothing (Count 0, Child -1). An empty
+    // box with min above max would pass the slab test like a huge one, so nothing is a point far away instead.
+    struct Node {
+        float Bounds[6][Width];
+        int32_t Child[Width];
+        uint32_t Count[Width];
+
+        Node()
+        {
+            for (unsigned int i = 0; i < Width; i++)
+            {
+                for (int b = 0; b < 6; b++)
+                    Bounds[b][i] = 1e30f;
+                Child[i] = -1;
+                Count[i] = 0;
+            }
+        }
+    };
+
+    // a triangle as the intersection test wants it: a corner and the edges to the other two
+    struct PackedTriangle {
+        glm::vec3 V0, E1, E2;
+    };
+
+    struct Bin {
+        Box Bounds;
+        unsigned int Count;
+
+        Bin() : Count(0)
+        {
+        }
+    };
+
+    // a pending child on the traversal stack, with the distance the ray enters it at
+    struct StackEntry {
+        int32_t Child;
+        uint32_t Count;
+        float Near;
+    };
+
+    vector<glm::vec3> positions;
+    vector<glm::uvec3> corners;         // of every triangle, into positions
+    vector<unsigned int> triangleMesh, triangleIndex;
+    vector<unsigned int> meshFirstVertex;
+
+    vector<Box> bounds;                 // of every triangle, and their centers, while building
+    vector<glm::vec3> centers;
+    vector<BuildNode> build;
+    atomic<unsigned int> nextNode;
+
+    vector<unsigned int> order;         // the triangles in the order of the leaves
+    vector<PackedTriangle> leafTriangles;
+    vector<Node> nodes;
+    unsigned int levels;                // of wide nodes, the traversal stack is sized by it
+
+    // the bounds of a node's triangles and of their centers, with threads threads
+    void nodeBounds(unsigned int first, unsigned int count, unsigned int threads, Box &box, Box &centerBox) const
+    {
+        if (threads == 1)
+        {
+            for (unsigned int i = first; i < first + count; i++)
+            {
+                box.Grow(bounds[order[i]]);
+                centerBox.Grow(centers[order[i]]);
+            }
+            return;
+        }
+        vector<Box> boxes(threads), centerBoxes(threads);
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int t) {
+            for (size_t i = first + begin; i < first + end; i++)
+            {
+                boxes[t].Grow(bounds[order[i]]);
+                centerBoxes[t].Grow(centers[order[i]]);
+            }
+        }, threads);
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            box.Grow(boxes[t]);
+            centerBox.Grow(centerBoxes[t]);
+        }
+    }
+
+    static unsigned int binOf(const glm::vec3 &center, const Box &centerBox, const glm::vec3 &scale, int axis)
+    {
+        return min(BINS - 1, (unsigned int)((center[axis] - centerBox.Min[axis]) * scale[axis]));
+    }
+
+    // splits the node with the surface area heuristic and builds its children, the left one in a new task when
+    // there are threads to spare
+    void buildTask(unsigned int node, unsigned int threads)
+    {
+        for (;;)
+        {
+            BuildNode &n = build[node];
+            unsigned int first = n.First, count = n.Count;
+            if (count < TASK_MIN)
+                threads = 1;
+            Box centerBox;
+            nodeBounds(first, count, threads, n.Bounds, centerBox);
+            if (count <= 2)
+                return;
+
+            // every thread bins its part of the triangles along the three axes, then the bins are added up
+            glm::vec3 extent = centerBox.Max - centerBox.Min;
+            glm::vec3 scale;
+            for (int axis = 0; axis < 3; axis++)
+                scale[axis] = extent[axis] > 0.0f ? BINS / extent[axis] : 0.0f;
+            Bin local[3 * BINS];
+            vector<Bin> shared(threads > 1 ? threads * 3 * BINS : 0);
+            Bin *bins = threads > 1 ? &shared[0] : local;
+            parallelFor(count, [&](size_t begin, size_t end, unsigned int t) {
+                Bin *own = &bins[t * 3 * BINS];
+                for (size_t i = first + begin; i < first + end; i++)
+                {
+                    unsigned int triangle = order[i];
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        Bin &bin = own[axis * BINS + binOf(centers[triangle], centerBox, scale, axis)];
+                        bin.Bounds.Grow(bounds[triangle]);
+                        bin.Count++;
+                    }
+                }
+            }, threads);
+            for (unsigned int t = 1; t < threads; t++)
+            {
+                for (unsigned int b = 0; b < 3 * BINS; b++)
+                {
+                    bins[b].Bounds.Grow(bins[t * 3 * BINS + b].Bounds);
+                    bins[b].Count += bins[t * 3 * BINS + b].Count;
+                }
+            }
+
+            // sweep from both sides for the cost of every boundary: traversing the node plus intersecting each
+            // side's triangles, weighted by the chance of a ray through the node going through that side
+            float leafCost = (float)count;
+            float bestCost = 1e30f;
+            int bestAxis = -1;
+            unsigned int bestBin = 0;
+            float nodeArea = n.Bounds.Area();
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (extent[axis] <= 0.0f)
+                    continue;
+                const Bin *axisBins = &bins[axis * BINS];
+                float rightArea[BINS];
+                unsigned int rightCount[BINS];
+                Box right;
+                unsigned int inRight = 0;
+                for (unsigned int b = BINS - 1; b > 0; b--)
+                {
+                    right.Grow(axisBins[b].Bounds);
+                    inRight += axisBins[b].Count;
+                    rightArea[b] = right.Area();
+                    rightCount[b] = inRight;
+                }
+                Box left;
+                unsigned int inLeft = 0;
+                for (unsigned int b = 0; b + 1 < BINS; b++)
+                {
+                    left.Grow(axisBins[b].Bounds);
+                    inLeft += axisBins[b].Count;
+                    if (inLeft == 0 || rightCount[b + 1] == 0)
+                        continue;
+                    float cost = 1.0f + (inLeft * left.Area() + rightCount[b + 1] * rightArea[b + 1]) / nodeArea;
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = b;
+                    }
+                }
+            }
+
+            unsigned int leftCount;
+            if (bestAxis >= 0 && (bestCost < leafCost || count > MAX_LEAF))
+            {
+                leftCount = partitionNode(first, count, threads, [&](unsigned int t) {
+                    return binOf(centers[t], centerBox, scale, bestAxis) <= bestBin;
+                });
+            }
+            else if (count > MAX_LEAF)
+            {
+                // every center is in the same place: halve the triangles as they are
+                leftCount = count / 2;
+            }
+            else
+                return;
+
+            unsigned int left = nextNode.fetch_add(2);
+            n.Left = left;
+            build[left].First = first;
+            build[left].Count = leftCount;
+            build[left + 1].First = first + leftCount;
+            build[left + 1].Count = count - leftCount;
+            if (threads > 1)
+            {
+                unsigned int leftThreads = threads / 2;
+                thread task(&MeshBvh::buildTask, this, left, leftThreads);
+                buildTask(left + 1, threads - leftThreads);
+                task.join();
+                return;
+            }
+            // one thread: go on with the right child here, the left one recursively
+            buildTask(left, 1);
+            node = left + 1;
+        }
+    }
+
+    // moves the triangles of the node that go left to its front and returns how many did. With more than one
+    // thread every thread counts its part's triangles for each side, then copies them to where its part of each
+    // side starts; the sides keep the order the triangles had.
+    template<typename Predicate>
+    unsigned int partitionNode(unsigned int first, unsigned int count, unsigned int threads, Predicate goesLeft)
+    {
+        if (threads == 1)
+            return (unsigned int)(partition(&order[first], &order[first] + count, goesLeft) - &order[first]);
+        vector<unsigned int> sizes(threads, 0), lefts(threads, 0);
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int t) {
+            unsigned int left = 0;
+            for (size_t i = first + begin; i < first + end; i++)
+                if (goesLeft(order[i]))
+                    left++;
+            sizes[t] = (unsigned int)(end - begin);
+            lefts[t] = left;
+        }, threads);
+        unsigned int leftCount = 0;
+        for (unsigned int t = 0; t < threads; t++)
+            leftCount += lefts[t];
+        vector<unsigned int> leftStart(threads), rightStart(threads);
+        unsigned int left = 0, right = leftCount;
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            leftStart[t] = left;
+            rightStart[t] = right;
+            left += lefts[t];
+            right += sizes[t] - lefts[t];
+        }
+        vector<unsigned int> sorted(count);
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int t) {
+            unsigned int l = leftStart[t], r = rightStart[t];
+            for (size_t i = first + begin; i < first + end; i++)
+                sorted[goesLeft(order[i]) ? l++ : r++] = order[i];
+        }, threads);
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int) {
+            copy(sorted.begin() + begin, sorted.begin() + end, order.begin() + first + begin);
+        }, threads);
+        return leftCount;
+    }
+
+    // fills nodes[target] with the up to Width nodes below the binary node: its children, with the largest inner
+    // ones replaced by their children until there are Width. Returns the depth of the wide tree below.
+    unsigned int collapse(unsigned int node, unsigned int target, unsigned int depth)
+    {
+        unsigned int children[Width];
+        unsigned int count = 0;
+        if (build[node].Left == 0)
+            children[count++] = node;
+        else
+        {
+            children[count++] = build[node].Left;
+            children[count++] = build[node].Left + 1;
+        }
+        while (count < Width)
+        {
+            int open = -1;
+            for (unsigned int i = 0; i < count; i++)
+                if (build[children[i]].Left != 0 &&
+                    (open < 0 || build[children[i]].Bounds.Area() > build[children[open]].Bounds.Area()))
+                    open = (int)i;
+            if (open < 0)
+                break;
+            unsigned int opened = children[open];
+            children[open] = build[opened].Left;
+            children[count++] = build[opened].Left + 1;
+        }
+
+        unsigned int deepest = depth;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const BuildNode &child = build[children[i]];
+            if (child.Left == 0)
+            {
+                nodes[target].Child[i] = (int32_t)child.First;
+                nodes[target].Count[i] = child.Count;
+                Stats.Leaves++;
+                continue;
+            }
+            // nodes grows, so no reference into it is held across the call
+            unsigned int index = (unsigned int)nodes.size();
+            nodes.push_back(Node());
+            nodes[target].Child[i] = (int32_t)index;
+            nodes[target].Count[i] = 0;
+            deepest = max(deepest, collapse(children[i], index, depth + 1));
+        }
+        return deepest;
+    }
+
+    void updateTriangles(unsigned int threads)
+    {
+        parallelFor(order.size(), [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++)
+            {
+                const glm::uvec3 &c = corners[order[i]];
+                PackedTriangle &t = leafTriangles[i];
+                t.V0 = positions[c.x];
+                t.E1 = positions[c.y] - t.V0;
+                t.E2 = positions[c.z] - t.V0;
+            }
+        }, threads);
+    }
+
+    // children are stored after their parents, so going backwards every child is done before its parent
+    void refitNodes()
+    {
+        for (size_t n = nodes.size(); n-- > 0;)
+        {
+            Node &node = nodes[n];
+            for (unsigned int i = 0; i < Width; i++)
+            {
+                Box box;
+                if (node.Count[i] > 0)
+                {
+                    for (unsigned int t = node.Child[i]; t < node.Child[i] + node.Count[i]; t++)
+                    {
+                        const PackedTriangle &p = leafTriangles[t];
+                        box.Grow(p.V0);
+                        box.Grow(p.V0 + p.E1);
+                        box.Grow(p.V0 + p.E2);
+                    }
+                }
+                else if (node.Child[i] >= 0)
+                    box = nodeBox(nodes[node.Child[i]]);
+                else
+                    continue;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    node.Bounds[axis][i] = box.Min[axis];
+                    node.Bounds[3 + axis][i] = box.Max[axis];
+                }
+            }
+        }
+    }
+
+    static Box nodeBox(const Node &node)
+    {
+        Box box;
+        for (unsigned int i = 0; i < Width; i++)
+        {
+            if (node.Count[i] == 0 && node.Child[i] < 0)
+                continue;
+            box.Grow(glm::vec3(node.Bounds[0][i], node.Bounds[1][i], node.Bounds[2][i]));
+            box.Grow(glm::vec3(node.Bounds[3][i], node.Bounds[4][i], node.Bounds[5][i]));
+        }
+        return box;
+    }
+
+    Box rootBox() const
+    {
+        return nodes.empty() ? Box() : nodeBox(nodes[0]);
+    }
+
+    // the SAH cost of the wide tree: every node visited costs 1 and every triangle tested 1, weighted by the
+    // chance of a ray through the root reaching them
+    float cost() const
+    {
+        float rootArea = rootBox().Area();
+        if (rootArea <= 0.0f)
+            return 0.0f;
+        float sum = 1.0f;
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            const Node &node = nodes[n];
+            for (unsigned int i = 0; i < Width; i++)
+            {
+                if (node.Count[i] == 0 && node.Child[i] < 0)
+                    continue;
+                Box box;
+                box.Grow(glm::vec3(node.Bounds[0][i], node.Bounds[1][i], node.Bounds[2][i]));
+                box.Grow(glm::vec3(node.Bounds[3][i], node.Bounds[4][i], node.Bounds[5][i]));
+                sum += (node.Count[i] > 0 ? (float)node.Count[i] : 1.0f) * box.Area() / rootArea;
+            }
+        }
+        return sum;
+    }
+
+    // Möller-Trumbore
+    bool intersect(const BvhRay &ray, unsigned int index, BvhHit &hit) const
+    {
+        const PackedTriangle &t = leafTriangles[index];
+        glm::vec3 p = glm::cross(ray.Direction, t.E2);
+        float det = glm::dot(t.E1, p);
+        if (fabsf(det) < 1e-12f)
+            return false;
+        float inverse = 1.0f / det;
+        glm::vec3 s = ray.Origin - t.V0;
+        float u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, t.E1);
+        float v = glm::dot(ray.Direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        float distance = glm::dot(t.E2, q) * inverse;
+        if (distance <= 0.0f || distance >= hit.Distance)
+            return false;
+        hit.Distance = distance;
+        hit.U = u;
+        hit.V = v;
+        return true;
+    }
+
+    bool traverse(const BvhRay &ray, BvhHit &hit, unsigned int &triangle, bool any) const
+    {
+        if (nodes.empty() || order.empty())
+            return false;
+        // a zero direction would make 0 * infinity in the slab test
+        glm::vec3 direction = ray.Direction;
+        for (int i = 0; i < 3; i++)
+            if (fabsf(direction[i]) < 1e-20f)
+                direction[i] = direction[i] < 0.0f ? -1e-20f : 1e-20f;
+        glm::vec3 inverse = 1.0f / direction;
+
+        // every level leaves at most Width - 1 siblings of the entry taken next on the stack. Trees deeper than
+        // the array holds, from degenerate meshes, get an allocated stack.
+        unsigned int capacity = (Width - 1) * levels + 1;
+        StackEntry local[STACK_SIZE];
+        vector<StackEntry> allocated;
+        StackEntry *stack = local;
+        if (capacity > STACK_SIZE)
+        {
+            allocated.resize(capacity);
+            stack = &allocated[0];
+        }
+
+        bool found = false;
+        unsigned int depth = 0;
+        StackEntry root = {0, 0, 0.0f};
+        stack[depth++] = root;
+        while (depth > 0)
+        {
+            StackEntry entry = stack[--depth];
+            // a closer hit was found since the entry was pushed
+            if (entry.Near > hit.Distance)
+                continue;
+            if (entry.Count > 0)
+            {
+                for (unsigned int t = entry.Child; t < entry.Child + entry.Count; t++)
+                {
+                    if (intersect(ray, t, hit))
+                    {
+                        found = true;
+                        triangle = t;
+                        if (any)
+                            return true;
+                    }
+                }
+                continue;
+            }
+
+            const Node &node = nodes[entry.Child];
+            float near[Width];
+            unsigned int mask = slabs(node, ray.Origin, inverse, hit.Distance, near);
+            // the children that were hit, farthest first so the nearest is taken off the stack first
+            unsigned int hits = 0;
+            StackEntry sorted[Width];
+            for (unsigned int i = 0; i < Width; i++)
+            {
+                if (!(mask & (1u << i)))
+                    continue;
+                StackEntry child = {node.Child[i], node.Count[i], near[i]};
+                unsigned int j = hits++;
+                while (j > 0 && sorted[j - 1].Near < child.Near)
+                {
+                    sorted[j] = sorted[j - 1];
+                    j--;
+                }
+                sorted[j] = child;
+            }
+            assert(depth + hits <= capacity);
+            for (unsigned int i = 0; i < hits; i++)
+                stack[depth++] = sorted[i];
+        }
+        return found;
+    }
+
+    // tests the ray against every child's box, returns a bit for each child the ray enters before far and the
+    // distance it enters at; four children at a time with SSE
+    static unsigned int slabs(const Node &node, const glm::vec3 &origin, const glm::vec3 &inverse, float far, float *near)
+    {
+        unsigned int mask = 0;
+        unsigned int i = 0;
+#ifdef __SSE__
+        __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+        __m128 ix = _mm_set1_ps(inverse.x), iy = _mm_set1_ps(inverse.y), iz = _mm_set1_ps(inverse.z);
+        __m128 zero = _mm_setzero_ps(), limit = _mm_set1_ps(far);
+        for (; i + 4 <= Width; i += 4)
+        {
+            __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.Bounds[0][i]), ox), ix);
+            __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.Bounds[1][i]), oy), iy);
+            __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.Bounds[2][i]), oz), iz);
+            __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.Bounds[3][i]), ox), ix);
+            __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.Bounds[4][i]), oy), iy);
+            __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.Bounds[5][i]), oz), iz);
+            __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), zero));
+            __m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), limit));
+            _mm_storeu_ps(&near[i], enter);
+            mask |= (unsigned int)_mm_movemask_ps(_mm_cmple_ps(enter, leave)) << i;
+        }
+#endif
+        for (; i < Width; i++)
+        {
+            float x0 = (node.Bounds[0][i] - origin.x) * inverse.x, x1 = (node.Bounds[3][i] - origin.x) * inverse.x;
+            float y0 = (node.Bounds[1][i] - origin.y) * inverse.y, y1 = (node.Bounds[4][i] - origin.y) * inverse.y;
+            float z0 = (node.Bounds[2][i] - origin.z) * inverse.z, z1 = (node.Bounds[5][i] - origin.z) * inverse.z;
+            float enter = max(max(min(x0, x1), min(y0, y1)), max(min(z0, z1), 0.0f));
+            float leave = min(min(max(x0, x1), max(y0, y1)), min(max(z0, z1), far));
+            near[i] = enter;
+            if (enter <= leave)
+                mask |= 1u << i;
+        }
+        return mask;
+    }
+};
+
+typedef MeshBvh<2> MeshBvh2;
+typedef MeshBvh<4> MeshBvh4;
+typedef MeshBvh<8> MeshBvh8;
+#endif
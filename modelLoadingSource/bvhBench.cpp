@@ -0,0 +1,387 @@
+#include <glm/glm.hpp>
+
+#include "../meshBvh.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// a model read from an OBJ file, laid out like Model and Mesh so MeshBvh::AddModel takes it the same way
+struct ObjVertex {
+	glm::vec3 Position;
+};
+
+struct ObjMesh {
+	vector<ObjVertex> vertices;
+	vector<unsigned int> indices;
+};
+
+struct ObjModel {
+	vector<ObjMesh> meshes;
+};
+
+// reads the v and f lines of an OBJ file; faces with more corners are split into fans and every o or g starts a
+// new mesh, like assimp does with aiProcess_Triangulate
+bool loadObj(const char *path, ObjModel &model)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+	{
+		cout << "ERROR::OBJ:: Could not open " << path << endl;
+		return false;
+	}
+	vector<glm::vec3> positions;
+	unordered_map<unsigned int, unsigned int> local;	// the current mesh's vertex for an OBJ vertex
+	model.meshes.push_back(ObjMesh());
+	char line[4096];
+	while (fgets(line, sizeof(line), file))
+	{
+		if (line[0] == 'v' && line[1] == ' ')
+		{
+			glm::vec3 p;
+			char *end = line + 2;
+			for (int i = 0; i < 3; i++)
+				p[i] = strtof(end, &end);
+			positions.push_back(p);
+		}
+		else if ((line[0] == 'o' || line[0] == 'g') && line[1] == ' ' && !model.meshes.back().indices.empty())
+		{
+			model.meshes.push_back(ObjMesh());
+			local.clear();
+		}
+		else if (line[0] == 'f' && line[1] == ' ')
+		{
+			ObjMesh &mesh = model.meshes.back();
+			unsigned int face[64];
+			unsigned int corners = 0;
+			char *p = line + 2;
+			while (corners < 64)
+			{
+				char *end;
+				long index = strtol(p, &end, 10);
+				if (end == p)
+					break;
+				// indices count from 1, negative ones from the end
+				index = index < 0 ? (long)positions.size() + index : index - 1;
+				p = end;
+				while (*p && *p != ' ' && *p != '\t')
+					p++;
+				if (index < 0 || index >= (long)positions.size())
+					continue;
+				unordered_map<unsigned int, unsigned int>::iterator found = local.find((unsigned int)index);
+				if (found == local.end())
+				{
+					found = local.insert(make_pair((unsigned int)index, (unsigned int)mesh.vertices.size())).first;
+					ObjVertex vertex = {positions[index]};
+					mesh.vertices.push_back(vertex);
+				}
+				face[corners++] = found->second;
+			}
+			for (unsigned int i = 2; i < corners; i++)
+			{
+				mesh.indices.push_back(face[0]);
+				mesh.indices.push_back(face[i - 1]);
+				mesh.indices.push_back(face[i]);
+			}
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+// a bumpy sphere of about the given number of triangles, for when no file is given
+ObjModel generateModel(size_t triangles)
+{
+	unsigned int rings = (unsigned int)sqrt(triangles / 4.0);
+	unsigned int segments = rings * 2;
+	ObjModel model;
+	model.meshes.push_back(ObjMesh());
+	ObjMesh &mesh = model.meshes.back();
+	for (unsigned int r = 0; r <= rings; r++)
+	{
+		float theta = (float)M_PI * r / rings;
+		for (unsigned int s = 0; s <= segments; s++)
+		{
+			float phi = 2.0f * (float)M_PI * s / segments;
+			glm::vec3 direction(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			float bumps = 1.0f + 0.05f * sinf(13.0f * phi) * sinf(11.0f * theta) + 0.02f * sinf(57.0f * phi + 31.0f * theta);
+			ObjVertex vertex = {direction * bumps};
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	for (unsigned int r = 0; r < rings; r++)
+	{
+		for (unsigned int s = 0; s < segments; s++)
+		{
+			unsigned int a = r * (segments + 1) + s, b = a + segments + 1;
+			unsigned int quad[6] = {a, b, a + 1, a + 1, b, b + 1};
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+	return model;
+}
+
+double milliseconds(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// camera rays through a size x size grid, looking at the model from the front and a little above
+vector<BvhRay> cameraRays(const glm::vec3 &min, const glm::vec3 &max, unsigned int size)
+{
+	glm::vec3 center = (min + max) * 0.5f;
+	float radius = glm::length(max - min) * 0.5f;
+	glm::vec3 eye = center + glm::normalize(glm::vec3(0.3f, 0.4f, 1.0f)) * radius * 2.2f;
+	glm::vec3 forward = glm::normalize(center - eye);
+	glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+	glm::vec3 up = glm::cross(right, forward);
+	float extent = tanf(glm::radians(25.0f));
+	vector<BvhRay> rays;
+	for (unsigned int y = 0; y < size; y++)
+		for (unsigned int x = 0; x < size; x++)
+		{
+			float u = (2.0f * (x + 0.5f) / size - 1.0f) * extent;
+			float v = (2.0f * (y + 0.5f) / size - 1.0f) * extent;
+			rays.push_back(BvhRay(eye, glm::normalize(forward + right * u + up * v)));
+		}
+	return rays;
+}
+
+// short rays around the hits' faces, as an ambient occlusion pass would cast them
+vector<BvhRay> occlusionRays(const vector<BvhRay> &camera, const vector<BvhHit> &hits, const vector<char> &hit,
+                             float distance)
+{
+	vector<BvhRay> rays;
+	uint32_t state = 1;
+	for (size_t i = 0; i < camera.size(); i++)
+	{
+		if (!hit[i])
+			continue;
+		glm::vec3 p = camera[i].Origin + camera[i].Direction * hits[i].Distance;
+		for (int k = 0; k < 4; k++)
+		{
+			glm::vec3 d;
+			do
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					state = state * 1664525u + 1013904223u;
+					d[c] = (state >> 8) / 8388608.0f - 1.0f;
+				}
+			} while (glm::dot(d, d) > 1.0f || glm::dot(d, d) < 1e-4f);
+			d = glm::normalize(d);
+			// towards the camera's side of the surface
+			if (glm::dot(d, camera[i].Direction) > 0.0f)
+				d = -d;
+			rays.push_back(BvhRay(p - camera[i].Direction * distance * 1e-3f, d, distance));
+		}
+	}
+	return rays;
+}
+
+template<unsigned int Width>
+double traceClosest(const MeshBvh<Width> &bvh, const vector<BvhRay> &rays, vector<BvhHit> &hits, vector<char> &hit,
+                    unsigned int threads)
+{
+	hits.assign(rays.size(), BvhHit());
+	hit.assign(rays.size(), 0);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	parallelFor(rays.size(), [&](size_t begin, size_t end, unsigned int) {
+		for (size_t i = begin; i < end; i++)
+			hit[i] = bvh.Intersect(rays[i], hits[i]) ? 1 : 0;
+	}, threads);
+	return milliseconds(start);
+}
+
+template<unsigned int Width>
+double traceOccluded(const MeshBvh<Width> &bvh, const vector<BvhRay> &rays, size_t &occluded, unsigned int threads)
+{
+	vector<char> blocked(rays.size(), 0);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	parallelFor(rays.size(), [&](size_t begin, size_t end, unsigned int) {
+		for (size_t i = begin; i < end; i++)
+			blocked[i] = bvh.Occluded(rays[i]) ? 1 : 0;
+	}, threads);
+	double ms = milliseconds(start);
+	occluded = 0;
+	for (size_t i = 0; i < blocked.size(); i++)
+		occluded += blocked[i];
+	return ms;
+}
+
+double mrays(size_t rays, double ms)
+{
+	return rays / 1000.0 / max(ms, 1e-6);
+}
+
+// builds the tree of one width, traces the rays and compares the hits with the reference ones
+template<unsigned int Width>
+void benchmark(const ObjModel &model, unsigned int threads, unsigned int size, vector<BvhHit> &reference,
+               vector<char> &referenceHit)
+{
+	MeshBvh<Width> bvh;
+	bvh.AddModel(model);
+	bvh.Build(threads);
+	// the build again, now that the memory is warm
+	bvh.Build(threads);
+	const BvhStats &stats = bvh.Stats;
+	glm::vec3 min, max;
+	bvh.Bounds(min, max);
+
+	vector<BvhRay> camera = cameraRays(min, max, size);
+	vector<BvhHit> hits;
+	vector<char> hit;
+	double closestMs = traceClosest(bvh, camera, hits, hit, threads);
+	vector<BvhRay> occlusion = occlusionRays(camera, hits, hit, glm::length(max - min) * 0.05f);
+	size_t occluded;
+	double occludedMs = traceOccluded(bvh, occlusion, occluded, threads);
+
+	size_t hitCount = 0, mismatches = 0;
+	for (size_t i = 0; i < hit.size(); i++)
+	{
+		hitCount += hit[i];
+		if (reference.empty())
+			continue;
+		if (hit[i] != referenceHit[i] || (hit[i] && fabsf(hits[i].Distance - reference[i].Distance) > 1e-4f * reference[i].Distance))
+			mismatches++;
+	}
+	if (reference.empty())
+	{
+		reference = hits;
+		referenceHit = hit;
+	}
+
+	cout << "BVH" << Width << ": built in " << stats.BuildMs << " ms on " << threads << " threads, " << stats.Nodes
+	     << " nodes, " << stats.Leaves << " leaves, depth " << stats.Depth << ", SAH cost " << stats.Cost << endl;
+	cout << "  camera rays: " << camera.size() << " (" << hitCount << " hits) in " << closestMs << " ms, "
+	     << mrays(camera.size(), closestMs) << " Mrays/s" << endl;
+	cout << "  occlusion rays: " << occlusion.size() << " (" << occluded << " occluded) in " << occludedMs << " ms, "
+	     << mrays(occlusion.size(), occludedMs) << " Mrays/s" << endl;
+	if (Width != 2)
+		cout << "  " << mismatches << " of the camera rays' hits differ from BVH2's" << endl;
+
+	// animate: every vertex moves along a wave, the tree is refit, then rebuilt for comparison
+	glm::vec3 center = (min + max) * 0.5f;
+	float scale = glm::length(max - min);
+	for (size_t m = 0; m < model.meshes.size(); m++)
+	{
+		vector<glm::vec3> moved(model.meshes[m].vertices.size());
+		for (size_t i = 0; i < moved.size(); i++)
+		{
+			glm::vec3 p = model.meshes[m].vertices[i].Position;
+			moved[i] = p + (p - center) * 0.1f * sinf(6.0f * p.y / scale * 6.2832f);
+		}
+		bvh.SetPositions((unsigned int)m, moved);
+	}
+	bvh.Refit(threads);
+	double refitMs = bvh.Stats.RefitMs;
+	double refitTraceMs = traceClosest(bvh, camera, hits, hit, threads);
+	bvh.Build(threads);
+	double rebuildTraceMs = traceClosest(bvh, camera, hits, hit, threads);
+	cout << "  animated: refit in " << refitMs << " ms, then " << mrays(camera.size(), refitTraceMs)
+	     << " Mrays/s; rebuilt in " << bvh.Stats.BuildMs << " ms, then " << mrays(camera.size(), rebuildTraceMs)
+	     << " Mrays/s" << endl;
+}
+
+// a few rays against every triangle, to check the trees against
+void bruteForceCheck(const ObjModel &model, const vector<BvhHit> &reference, const vector<char> &referenceHit,
+                     const vector<BvhRay> &camera)
+{
+	size_t checked = 0, mismatches = 0;
+	for (size_t r = 0; r < camera.size(); r += camera.size() / 97 + 1)
+	{
+		float best = 1e30f;
+		for (size_t m = 0; m < model.meshes.size(); m++)
+		{
+			const ObjMesh &mesh = model.meshes[m];
+			for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+			{
+				glm::vec3 v0 = mesh.vertices[mesh.indices[i]].Position;
+				glm::vec3 e1 = mesh.vertices[mesh.indices[i + 1]].Position - v0;
+				glm::vec3 e2 = mesh.vertices[mesh.indices[i + 2]].Position - v0;
+				glm::vec3 p = glm::cross(camera[r].Direction, e2);
+				float det = glm::dot(e1, p);
+				if (fabsf(det) < 1e-12f)
+					continue;
+				glm::vec3 s = camera[r].Origin - v0;
+				float u = glm::dot(s, p) / det;
+				glm::vec3 q = glm::cross(s, e1);
+				float v = glm::dot(camera[r].Direction, q) / det;
+				float t = glm::dot(e2, q) / det;
+				if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < best)
+					best = t;
+			}
+		}
+		bool found = best < 1e30f;
+		if (found != (referenceHit[r] != 0) || (found && fabsf(best - reference[r].Distance) > 1e-4f * best))
+			mismatches++;
+		checked++;
+	}
+	cout << "brute force check: " << checked << " rays, " << mismatches << " differ" << endl;
+}
+
+// usage: bvhBench [--threads N] [--size N] [--triangles N] [file.obj ...]
+// builds BVH2, BVH4 and BVH8 over the files' meshes (or a generated model) and traces size x size camera rays
+// and four short occlusion rays per hit through each; with more than one thread the BVH4 build is timed on 1 to N
+int main(int argc, char **argv)
+{
+	unsigned int threads = defaultThreadCount();
+	unsigned int size = 512;
+	size_t triangles = 1000000;
+	vector<string> files;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+			size = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--triangles") == 0 && i + 1 < argc)
+			triangles = (size_t)atol(argv[++i]);
+		else
+			files.push_back(argv[i]);
+	}
+	if (files.empty())
+		files.push_back("");
+
+	for (size_t f = 0; f < files.size(); f++)
+	{
+		ObjModel model;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		if (files[f].empty())
+			model = generateModel(triangles);
+		else if (!loadObj(files[f].c_str(), model))
+			continue;
+		size_t count = 0;
+		for (size_t m = 0; m < model.meshes.size(); m++)
+			count += model.meshes[m].indices.size() / 3;
+		cout << (files[f].empty() ? string("generated sphere") : files[f]) << ": " << model.meshes.size() << " meshes, "
+		     << count << " triangles, loaded in " << milliseconds(start) << " ms" << endl;
+
+		vector<BvhHit> reference;
+		vector<char> referenceHit;
+		benchmark<2>(model, threads, size, reference, referenceHit);
+		benchmark<4>(model, threads, size, reference, referenceHit);
+		benchmark<8>(model, threads, size, reference, referenceHit);
+
+		MeshBvh4 bvh;
+		bvh.AddModel(model);
+		for (unsigned int t = 1; threads > 1 && t <= threads; t *= 2)
+		{
+			bvh.Build(t);
+			cout << "BVH4 build on " << t << " threads: " << bvh.Stats.BuildMs << " ms" << endl;
+		}
+		glm::vec3 min, max;
+		bvh.Build(threads);
+		bvh.Bounds(min, max);
+		bruteForceCheck(model, reference, referenceHit, cameraRays(min, max, size));
+	}
+	return 0;
+}
@@ -12,8 +12,11 @@
 #include "shader_m.h"
 #include "camera.h"
 #include "model.h"
+#include "../meshBvh.h"
+#include "../pickBuffer.h"
 
 #include <experimental/filesystem>
+#include "../headless.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -34,40 +37,51 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f; 
 
-main()
+int main(int argc, char **argv)
 {
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
-#endif
-
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
+    // --headless renders offscreen instead, see headless.h
+    Headless headless(argc, argv);
+    GLFWwindow* window = NULL;
+    if (headless.Enabled)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+    else
+    {
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    #ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
+    #endif
 
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
     }
     
     // Configure global opengl state 
@@ -76,47 +90,117 @@ main()
     Shader ourShader("modelLoading.vs", "modelLoading.fs");
     // Load models 
     Model ourModel("NanosuitModel/nanosuit.obj");
-    
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(window))
+
+    // --bvh builds a ray tracing tree over the model and picks what the camera looks at with it,
+    // --pick reports the mesh at the center of the window whenever it changes, from an ID buffer
+    bool bvh = false;
+    bool pick = false;
+    for (int i = 1; i < argc; i++)
     {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        if (strcmp(argv[i], "--bvh") == 0)
+            bvh = true;
+        else if (strcmp(argv[i], "--pick") == 0)
+            pick = true;
+    }
+    if (bvh)
+    {
+        MeshBvh4 ourBvh;
+        ourBvh.AddModel(ourModel);
+        ourBvh.Build();
+        cout << "bvh: " << ourBvh.Stats.Triangles << " triangles, " << ourBvh.Stats.Nodes << " nodes, "
+             << ourBvh.Stats.Leaves << " leaves, depth " << ourBvh.Stats.Depth << ", SAH cost " << ourBvh.Stats.Cost
+             << ", built in " << ourBvh.Stats.BuildMs << " ms" << endl;
+        // the tree is in the model's space, the ray is taken there with the inverse of the model matrix below
+        glm::mat4 model;
+        model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
+        glm::mat4 toModel = glm::inverse(model);
+        BvhRay ray(glm::vec3(toModel * glm::vec4(camera.Position, 1.0f)), glm::normalize(glm::vec3(toModel * glm::vec4(camera.Front, 0.0f))));
+        BvhHit hit;
+        if (ourBvh.Intersect(ray, hit))
+            cout << "bvh: the camera looks at triangle " << hit.Triangle << " of mesh " << hit.Mesh << ", "
+                 << hit.Distance * 0.2f << " units away" << endl;
+        else
+            cout << "bvh: the camera looks past the model" << endl;
+    }
 
-        // input
-        // -----
-        processInput(window);
+    // PickBuffer's destructor deletes its GL objects, so it goes out of scope here, before glfwTerminate
+    {
+        Shader pickShader("pick.vs", "pick.fs");
+        PickBuffer pickBuffer(SCR_WIDTH, SCR_HEIGHT);
+        PickResult picked;
 
-        // render
-        // ------
-        glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // render loop
+        // -----------
+        while (headless.Running(window))
+        {
+            // per-frame time logic
+            // --------------------
+            float currentFrame = headless.Time();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
 
-        // don't forget to enable shader before setting uniforms
-        ourShader.use();
+            // input
+            // -----
+            if (headless.Enabled)
+                headless.MoveCamera(camera);
+            else
+                processInput(window);
 
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+            // render
+            // ------
+            glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // render the loaded model
-        glm::mat4 model;
-        model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f)); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));	// it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
+            // don't forget to enable shader before setting uniforms
+            ourShader.use();
+
+            // view/projection transformations
+            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+            glm::mat4 view = camera.GetViewMatrix();
+            ourShader.setMat4("projection", projection);
+            ourShader.setMat4("view", view);
+
+            // render the loaded model
+            glm::mat4 model;
+            model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f)); // translate it down so it's at the center of the scene
+            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));	// it's a bit too big for our scene, so scale it down
+            ourShader.setMat4("model", model);
+            ourModel.Draw(ourShader);
 
+            // picking: take the pick of the frame before if it's done, then draw the meshes' IDs into the center pixel
+            if (pick)
+            {
+                PickResult result;
+                if (pickBuffer.Read(result) && result != picked)
+                {
+                    picked = result;
+                    if (picked.Object != 0)
+                        cout << "picked: mesh " << picked.Instance << endl;
+                    else
+                        cout << "picked: nothing" << endl;
+                }
+                int width, height;
+                headless.GetFramebufferSize(window, &width, &height);
+                pickBuffer.Resize(width, height);
+                pickBuffer.Begin(width / 2, height / 2);
+                pickShader.use();
+                pickShader.setMat4("projection", projection);
+                pickShader.setMat4("view", view);
+                pickShader.setMat4("model", model);
+                pickShader.setInt("object", 1);
+                for (unsigned int i = 0; i < ourModel.meshes.size(); i++)
+                {
+                    pickShader.setInt("instance", i);
+                    ourModel.meshes[i].Draw(pickShader);
+                }
+                pickBuffer.End();
+            }
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // -------------------------------------------------------------------------------
+            headless.SwapBuffers(window);
+        }
     }
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -0,0 +1,332 @@
+#ifndef CASCADED_SHADOWS_H
+#define CASCADED_SHADOWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader_m.h"
+#include "../shadowCaster.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct CascadeSettings {
+    static const unsigned int MAX_CASCADES = 4;
+
+    unsigned int Count;             // cascades, 1 to MAX_CASCADES
+    int Resolution[MAX_CASCADES];   // of each cascade's shadow map
+    unsigned int UpdateInterval[MAX_CASCADES];  // each cascade is drawn every this many frames
+    float MaxDistance;              // from the camera, where the last cascade ends
+    float SplitLambda;              // 0 splits the distance evenly, 1 logarithmically
+    bool Layered;                   // all cascades in one pass through a geometry shader, or one pass each
+
+    CascadeSettings() : Count(4), MaxDistance(40.0f), SplitLambda(0.75f), Layered(true)
+    {
+        for (unsigned int i = 0; i < MAX_CASCADES; i++)
+        {
+            Resolution[i] = i < 2 ? 2048 : 1024;
+            UpdateInterval[i] = i < 2 ? 1 : 2 * (i - 1);
+        }
+    }
+};
+
+struct ShadowStats {
+    double UpdateMs;                // CPU time of the last Update
+    unsigned int Passes;            // geometry passes of the last Render
+    unsigned int Casters[CascadeSettings::MAX_CASCADES];    // drawn into each cascade by the last Render, 0 when it wasn't due
+
+    ShadowStats() : UpdateMs(0.0), Passes(0)
+    {
+        for (unsigned int i = 0; i < CascadeSettings::MAX_CASCADES; i++)
+            Casters[i] = 0;
+    }
+};
+
+// Cascaded shadow maps for a directional light. The camera's view up to MaxDistance is split into Count depth
+// ranges, nearer ones shorter (SplitLambda blends even and logarithmic splits), and each range gets a shadow map
+// of its own in a layer of one depth texture array:
+//  - a cascade covers the bounding sphere of its part of the view frustum, which doesn't change size as the camera
+//    turns, and its center is snapped to whole shadow map texels in light space, so the shadow's edges don't
+//    shimmer while the camera moves;
+//  - every cascade culls the casters against its own box and pulls its near plane back only as far as the casters
+//    it kept, which keeps the depth range (and so the depth precision) tight;
+//  - with Layered, one pass draws each caster once and a geometry shader copies its triangles into the layers of
+//    the cascades that kept it; otherwise every cascade is a pass of its own;
+//  - a cascade smaller than the texture uses its lower left corner, and is drawn every UpdateInterval frames,
+//    keeping the matrix it was drawn with in between.
+// The lighting shaders find a fragment's cascade from its view depth and read the Shadows uniform block: a
+// matrix per cascade from world space to (u, v, depth) in its layer, the split depths, the world size of a
+// texel (for offsetting the lookup along the normal) and how much of its layer each cascade uses.
+class CascadedShadows
+{
+public:
+    static const unsigned int MAX_CASCADES = CascadeSettings::MAX_CASCADES;
+    // binding point of the Shadows uniform block
+    static const unsigned int UNIFORM_BINDING = 3;
+
+    ShadowStats Stats;
+
+    CascadedShadows(const CascadeSettings &settings)
+        : settings(settings), depthShader("shadow.vs", "shadow.fs"), layeredShader("shadow.vs", "shadow.fs", "shadow.gs"), frame(0)
+    {
+        // MAX_CASCADES has no definition outside the class, min would take it by reference
+        unsigned int count = settings.Count < MAX_CASCADES ? settings.Count : MAX_CASCADES;
+        this->settings.Count = max(1u, count);
+        block = ShadowBlock();
+        size = 1;
+        for (unsigned int i = 0; i < this->settings.Count; i++)
+        {
+            size = max(size, settings.Resolution[i]);
+            this->settings.UpdateInterval[i] = max(1u, settings.UpdateInterval[i]);
+            drawn[i] = false;
+        }
+
+        glGenTextures(1, &shadowMap);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, this->settings.Count, 0, GL_DEPTH_COMPONENT,
+                     GL_UNSIGNED_INT, NULL);
+        // hardware depth comparison, with linear filtering it already averages four texels
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(1, &layeredBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, layeredBuffer);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::SHADOWS:: The layered shadow framebuffer is not complete" << endl;
+        // for passes (and clears) of single cascades, a layer at a time
+        glGenFramebuffers(1, &layerBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, layerBuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenBuffers(1, &uniformBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowBlock), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING, uniformBuffer, 0, sizeof(ShadowBlock));
+
+        // the geometry shader's arrays are uploaded whole every layered pass, their locations are looked up once
+        cascadeClipLocation = glGetUniformLocation(layeredShader.ID, "cascadeClip");
+        cascadeExtentLocation = glGetUniformLocation(layeredShader.ID, "cascadeExtent");
+    }
+
+    ~CascadedShadows()
+    {
+        glDeleteTextures(1, &shadowMap);
+        glDeleteFramebuffers(1, &layeredBuffer);
+        glDeleteFramebuffers(1, &layerBuffer);
+        glDeleteBuffers(1, &uniformBuffer);
+    }
+
+    const CascadeSettings &Settings() const
+    {
+        return settings;
+    }
+
+    // fits the cascades that are due this frame to the camera (view matrix, vertical field of view in radians,
+    // aspect ratio and near plane) and culls the casters for them. lightDirection points from the light.
+    void Update(const glm::mat4 &view, float fovY, float aspect, float zNear, glm::vec3 lightDirection,
+                const vector<ShadowCaster> &casters)
+    {
+        chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+        glm::mat4 cameraToWorld = glm::inverse(view);
+        lightDirection = glm::normalize(lightDirection);
+        glm::vec3 up = fabs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+        float tanY = tan(fovY * 0.5f), tanX = tanY * aspect;
+        float zFar = max(settings.MaxDistance, zNear * 2.0f);
+
+        masks.assign(casters.size(), 0);
+        for (unsigned int i = 0; i < settings.Count; i++)
+        {
+            // split depths: logarithmic near the camera, blended towards even further out
+            float t = (i + 1) / (float)settings.Count;
+            float split = settings.SplitLambda * zNear * pow(zFar / zNear, t) + (1.0f - settings.SplitLambda) * (zNear + (zFar - zNear) * t);
+            float previous = i == 0 ? zNear : block.Splits[i - 1];
+            block.Splits[i] = split;
+            due[i] = !drawn[i] || (frame % settings.UpdateInterval[i]) == (i % settings.UpdateInterval[i]);
+            if (!due[i])
+                continue;
+
+            // the bounding sphere of the frustum slice: centered on the view axis, so it is the same whichever
+            // way the camera looks. its center is where the slice's near and far corners are equally far away.
+            float nearCorner2 = (tanX * tanX + tanY * tanY) * previous * previous;
+            float farCorner2 = (tanX * tanX + tanY * tanY) * split * split;
+            float centerDepth = min((farCorner2 - nearCorner2 + split * split - previous * previous) / (2.0f * (split - previous)), split);
+            float radius = sqrt(farCorner2 + (split - centerDepth) * (split - centerDepth));
+            radius = ceil(radius * 16.0f) / 16.0f;
+            glm::vec3 center = glm::vec3(lightRotation * cameraToWorld * glm::vec4(0.0f, 0.0f, -centerDepth, 1.0f));
+
+            // moves in whole texels only
+            float texel = 2.0f * radius / settings.Resolution[i];
+            center.x = floor(center.x / texel) * texel;
+            center.y = floor(center.y / texel) * texel;
+
+            // casters inside the box around the sphere, or between it and the light, as seen along the light
+            float nearest = center.z + radius;
+            unsigned int kept = 0;
+            for (size_t c = 0; c < casters.size(); c++)
+            {
+                glm::vec3 p = glm::vec3(lightRotation * glm::vec4(casters[c].Center, 1.0f));
+                float r = casters[c].Radius;
+                if (fabs(p.x - center.x) > radius + r || fabs(p.y - center.y) > radius + r || p.z + r < center.z - radius)
+                    continue;
+                masks[c] |= 1 << i;
+                nearest = max(nearest, p.z + r);
+                kept++;
+            }
+            Stats.Casters[i] = kept;
+
+            glm::mat4 projection = glm::ortho(center.x - radius, center.x + radius, center.y - radius, center.y + radius,
+                                              -nearest, -(center.z - radius));
+            clip[i] = projection * lightRotation;
+            // from clip space to the cascade's corner of its layer
+            float extent = settings.Resolution[i] / (float)size;
+            glm::mat4 toTexture;
+            toTexture[0][0] = toTexture[1][1] = 0.5f * extent;
+            toTexture[2][2] = 0.5f;
+            toTexture[3] = glm::vec4(0.5f * extent, 0.5f * extent, 0.5f, 1.0f);
+            block.Matrices[i] = toTexture * clip[i];
+            block.TexelSize[i] = texel;
+            block.Extent[i] = extent;
+        }
+        block.Count[0] = settings.Count;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowBlock), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        Stats.UpdateMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // draws the casters into the cascades that are due. drawCaster(shader, index) draws caster index (the
+    // index into Update's casters) with shader, which is in use and only needs the caster's "model" matrix.
+    template <typename DrawCaster>
+    void Render(DrawCaster drawCaster)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glEnable(GL_DEPTH_TEST);
+        // a slope scaled bias against acne on surfaces at a grazing angle to the light
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.5f, 2.0f);
+
+        unsigned int dueMask = 0;
+        for (unsigned int i = 0; i < settings.Count; i++)
+        {
+            if (due[i])
+                dueMask |= 1 << i;
+            else
+                Stats.Casters[i] = 0;
+        }
+        Stats.Passes = 0;
+
+        if (settings.Layered && dueMask)
+        {
+            // a layered attachment is cleared all at once, so cascades that aren't due are kept by clearing
+            // the others a layer at a time
+            if (dueMask == (1u << settings.Count) - 1)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, layeredBuffer);
+                glClear(GL_DEPTH_BUFFER_BIT);
+            }
+            else
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, layerBuffer);
+                for (unsigned int i = 0; i < settings.Count; i++)
+                    if (due[i])
+                    {
+                        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0, i);
+                        glClear(GL_DEPTH_BUFFER_BIT);
+                    }
+                glBindFramebuffer(GL_FRAMEBUFFER, layeredBuffer);
+            }
+            glViewport(0, 0, size, size);
+            // the geometry shader squeezes smaller cascades into their corner and clips them to it
+            for (int plane = 0; plane < 4; plane++)
+                glEnable(GL_CLIP_DISTANCE0 + plane);
+            layeredShader.use();
+            layeredShader.setMat4("lightSpace", glm::mat4());
+            glUniformMatrix4fv(cascadeClipLocation, settings.Count, GL_FALSE, &clip[0][0][0]);
+            glUniform1fv(cascadeExtentLocation, settings.Count, block.Extent);
+            for (size_t c = 0; c < masks.size(); c++)
+                if (masks[c] & dueMask)
+                {
+                    layeredShader.setInt("cascadeMask", masks[c] & dueMask);
+                    drawCaster(layeredShader, (unsigned int)c);
+                }
+            for (int plane = 0; plane < 4; plane++)
+                glDisable(GL_CLIP_DISTANCE0 + plane);
+            Stats.Passes = 1;
+        }
+        else if (dueMask)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, layerBuffer);
+            depthShader.use();
+            for (unsigned int i = 0; i < settings.Count; i++)
+            {
+                if (!due[i])
+                    continue;
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0, i);
+                glViewport(0, 0, settings.Resolution[i], settings.Resolution[i]);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                depthShader.setMat4("lightSpace", clip[i]);
+                for (size_t c = 0; c < masks.size(); c++)
+                    if (masks[c] & (1 << i))
+                        drawCaster(depthShader, (unsigned int)c);
+                Stats.Passes++;
+            }
+        }
+
+        for (unsigned int i = 0; i < settings.Count; i++)
+            drawn[i] = drawn[i] || due[i];
+        frame++;
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // binds the shadow maps to a texture unit for the shaders' sampler2DArrayShadow
+    void Bind(unsigned int textureUnit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + textureUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap);
+    }
+
+private:
+    // the Shadows uniform block, std140
+    struct ShadowBlock {
+        glm::mat4 Matrices[MAX_CASCADES];
+        float Splits[MAX_CASCADES];
+        float TexelSize[MAX_CASCADES];
+        float Extent[MAX_CASCADES];
+        int Count[4];
+    };
+
+    CascadeSettings settings;
+    Shader depthShader, layeredShader;
+    unsigned int shadowMap, layeredBuffer, layerBuffer, uniformBuffer;
+    int size;                                   // of the texture array's layers
+    unsigned int frame;
+    ShadowBlock block;
+    glm::mat4 clip[MAX_CASCADES];               // world to clip space of each cascade
+    int cascadeClipLocation, cascadeExtentLocation;     // in layeredShader
+    bool due[MAX_CASCADES], drawn[MAX_CASCADES];
+    vector<unsigned int> masks;                 // the cascades each caster is drawn into
+};
+#endif
@@ -0,0 +1,66 @@
+#version 330 core
+// No vertex attributes: a quad of four vertices (a triangle strip) per instance, one instance per light.
+// The quad covers the screen rectangle the light's range projects to, at the depth of the range's back
+// (see deferredRenderer.h).
+
+uniform samplerBuffer lights;
+uniform bool ambientPass;
+uniform mat4 view;
+uniform mat4 projection; 
+uniform float zNear;
+uniform float zFar;
+
+flat out int LightIndex;
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 lower = vec2(-1.0);
+    vec2 upper = vec2(1.0);
+    float depth = 1.0;
+    LightIndex = gl_InstanceID;
+    if (!ambientPass)
+    {
+        vec3 position = texelFetch(lights, gl_InstanceID * 5).xyz;
+        float range = texelFetch(lights, gl_InstanceID * 5 + 4).z;
+        // a light that reaches nothing collapses to a point outside the view
+        if (range == 0.0)
+        {
+            gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+            return;
+        }
+        // lights with a range get the screen bounds of the box around their range, cut off at the near plane;
+        // lights without a range cover the whole screen
+        vec3 center = (view * vec4(position, 1.0)).xyz;
+        if (range > 0.0)
+        {
+            float front = min(center.z + range, -zNear);
+            float back = center.z - range;
+            // entirely on the camera's side of the near plane
+            if (back >= front)
+            {
+                gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+                return;
+            }
+            lower = vec2(1.0);
+            upper = vec2(-1.0);
+            for (int i = 0; i < 8; i++)
+            {
+                vec2 offset = vec2((i & 1) != 0 ? range : -range, (i & 2) != 0 ? range : -range);
+                vec4 clip = projection * vec4(center.xy + offset, (i & 4) != 0 ? front : back, 1.0);
+                lower = min(lower, clip.xy / clip.w);
+                upper = max(upper, clip.xy / clip.w);
+            }
+            lower = max(lower, vec2(-1.0));
+            upper = min(upper, vec2(1.0));
+            if (any(greaterThanEqual(lower, upper)))
+            {
+                gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+                return;
+            }
+            vec4 backClip = projection * vec4(0.0, 0.0, max(back, -zFar), 1.0);
+            depth = backClip.z / backClip.w;
+        }
+    }
+    gl_Position = vec4(mix(lower, upper, corner), depth, 1.0);
+}
@@ -0,0 +1,180 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <glad/glad.h>
+
+#include "shader_m.h"
+
+#include <iostream>
+using namespace std;
+
+// Deferred shading: the scene is drawn once into a G-buffer, then every light adds its share to the pixels it
+// can reach. Lighting then costs per lit pixel instead of per fragment drawn times lights.
+//
+// The G-buffer is kept small, 12 bytes per pixel:
+//  - RGBA8: albedo, and the specular map's intensity in alpha (the maps here are grey);
+//  - RGB10_A2: the normal, octahedron encoded into two 10 bit channels, and log2(shininess) / 11 in the third;
+//  - 24 bit depth, from which the lighting pass rebuilds the position with the inverse view projection.
+// Lights are drawn as one instanced draw of screen-space quads (see deferred.vs). A point or spot light's
+// quad only covers the rectangle its range projects to. It is drawn at the depth of the back of the range
+// against a copy of the scene's depth, so the depth test throws out the background and whatever lies behind
+// the light's range before the shader runs; the shader skips the rest of the pixels beyond the range.
+// Lights without a range get a full screen quad. The ambient light is one full screen pass that writes the
+// background where nothing was drawn, so the light target never needs clearing. With the lights binned into
+// clusters (lightClusters.h) that pass loops over each pixel's lights instead and reads the G-buffer only once.
+// The lights add up in an RGBA16F target, so many dim lights don't lose their sum to 8 bit rounding.
+class DeferredRenderer
+{
+public:
+    int Width, Height;
+
+    DeferredRenderer() : Width(0), Height(0), gBuffer(0), lightBuffer(0), depthBuffer(0)
+    {
+        glGenVertexArrays(1, &quadVAO);
+        for (int i = 0; i < 4; i++)
+            textures[i] = 0;
+    }
+
+    ~DeferredRenderer()
+    {
+        release();
+        glDeleteVertexArrays(1, &quadVAO);
+    }
+
+    // (re)creates the targets when the framebuffer's size changed
+    bool Resize(int width, int height)
+    {
+        if (width == Width && height == Height)
+            return true;
+        release();
+        Width = width;
+        Height = height;
+
+        glGenTextures(4, textures);
+        texture(textures[ALBEDO_SPECULAR], GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        texture(textures[NORMAL_SHININESS], GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV);
+        texture(textures[DEPTH], GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+        texture(textures[LIGHT], GL_RGBA16F, GL_RGBA, GL_FLOAT);
+
+        GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glGenFramebuffers(1, &gBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[ALBEDO_SPECULAR], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, textures[NORMAL_SHININESS], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[DEPTH], 0);
+        glDrawBuffers(2, drawBuffers);
+        bool complete = checkComplete("G-buffer");
+
+        // lighting samples the depth texture, so it can't be attached while the lights are drawn; the light
+        // buffer depth tests against a copy of it instead (the same format, so it can be blitted)
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, Width, Height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &lightBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, lightBuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[LIGHT], 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        complete = checkComplete("light buffer") && complete;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return complete;
+    }
+
+    // binds and clears the G-buffer, draw the scene with gbuffer.fs after this
+    void BeginGeometry()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // binds albedo and specular, normal and shininess, and depth to three texture units from firstUnit on
+    void BindTextures(unsigned int firstUnit) const
+    {
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+    }
+
+    // lights the G-buffer with deferred.vs and deferred.fs: the ambient pass, then lightCount lights read from
+    // the light buffer (none when the ambient pass does them clustered). Leaves the lit image bound together
+    // with the scene's depth, for drawing forward on top.
+    void ShadeLights(Shader &shader, unsigned int lightCount)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, lightBuffer);
+        glBlitFramebuffer(0, 0, Width, Height, 0, 0, Width, Height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, lightBuffer);
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        shader.use();
+        glBindVertexArray(quadVAO);
+
+        shader.setBool("ambientPass", true);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        if (lightCount > 0)
+        {
+            // a quad at the back of a light's range passes where the scene is in front of it
+            shader.setBool("ambientPass", false);
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_GEQUAL);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, lightCount);
+            glDisable(GL_BLEND);
+            glDepthFunc(GL_LESS);
+        }
+
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // copies the lit image into the window
+    void Present()
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, lightBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, Width, Height, 0, 0, Width, Height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+private:
+    enum { ALBEDO_SPECULAR, NORMAL_SHININESS, DEPTH, LIGHT };
+    unsigned int gBuffer, lightBuffer, depthBuffer;
+    unsigned int textures[4];
+    unsigned int quadVAO;               // no attributes, deferred.vs builds its quads from gl_VertexID
+
+    void texture(unsigned int id, GLint internalFormat, GLenum format, GLenum type)
+    {
+        glBindTexture(GL_TEXTURE_2D, id);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, Width, Height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    static bool checkComplete(const char *name)
+    {
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+            return true;
+        cout << "ERROR::DEFERRED:: The " << name << " framebuffer is not complete" << endl;
+        return false;
+    }
+
+    void release()
+    {
+        if (!gBuffer)
+            return;
+        glDeleteFramebuffers(1, &gBuffer);
+        glDeleteFramebuffers(1, &lightBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glDeleteTextures(4, textures);
+        gBuffer = lightBuffer = depthBuffer = 0;
+    }
+};
+#endif
@@ -0,0 +1,32 @@
+#version 330 core
+struct Material {
+	sampler2D diffuse;
+	sampler2D specular;
+	float shininess;
+};
+
+uniform Material material; 
+
+in vec3 Normal; 
+in vec3 FragPos; 
+in vec2 TexCoords; 
+
+// the G-buffer, see deferredRenderer.h 
+layout (location = 0) out vec4 AlbedoSpecular;
+layout (location = 1) out vec4 NormalShininess;
+
+// Function to fold a unit vector onto an octahedron, unfolded into the [0, 1] square 
+vec2 EncodeNormal(vec3 n);
+
+void main() {
+	AlbedoSpecular = vec4(texture(material.diffuse, TexCoords).rgb, texture(material.specular, TexCoords).r);
+	NormalShininess = vec4(EncodeNormal(normalize(Normal)), log2(material.shininess) / 11.0, 0.0);
+}
+
+// Function to fold a unit vector onto an octahedron, the lower half is folded out over the upper one's edges 
+vec2 EncodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signs;
+	return e * 0.5 + 0.5;
+}
@@ -1,9 +1,9 @@
 #version 330 core
 out vec4 FragColor;
 
-uniform vec3 lampColor;
+in vec3 LampColor;
 
 void main()
 {
-	FragColor = vec4(lampColor, 1.0); 
+	FragColor = vec4(LampColor, 1.0); 
 }
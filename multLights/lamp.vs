@@ -1,11 +1,23 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model; 
+// one instance per light, read from the light buffer (see lightManager.h)
+uniform samplerBuffer lights;
 uniform mat4 view;
 uniform mat4 projection; 
+uniform float lampSize;
+
+out vec3 LampColor;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec4 positionType = texelFetch(lights, gl_InstanceID * 5);
+    LampColor = texelFetch(lights, gl_InstanceID * 5 + 2).rgb;
+    // only point lights have a lamp, the others collapse to a point outside the view
+    if (int(positionType.w) != 1)
+    {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+    gl_Position = projection * view * vec4(positionType.xyz + aPos * lampSize, 1.0);
 }
@@ -0,0 +1,278 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../lightManager.h"
+#include "../parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+using namespace std;
+
+struct ClusterStats {
+    double BinMs;                   // CPU time of the last Build, uploads included
+    size_t Indices;                 // light indices over all clusters
+    unsigned int MaxPerCluster;
+    unsigned int GlobalLights;      // lights every fragment evaluates
+
+    ClusterStats() : BinMs(0.0), Indices(0), MaxPerCluster(0), GlobalLights(0)
+    {
+    }
+};
+
+// Clustered forward shading: the view frustum is cut into TILES_X x TILES_Y screen tiles and SLICES depth slices
+// (exponentially spaced, so clusters stay about as deep as they are wide) and every frame each cluster gets the
+// list of lights whose range reaches into it. A fragment finds its cluster from gl_FragCoord and its view depth
+// and only evaluates that cluster's lights. A light's range comes from its attenuation (Light::Radius), and as the
+// shader fades lights out at their range the result is the same as evaluating every light. Lights without a
+// range, like the directional light, go into a separate list that all fragments evaluate.
+// Binning runs on the CPU in three parallel passes: the lights' view space bounds, the per-cluster lists (one
+// slice per task, so no two threads append to the same list) and the flattening of the lists into a single
+// index buffer. The shaders read that buffer and an (offset, count) pair per cluster as buffer textures; the grid
+// dimensions are in the Clusters uniform block.
+class LightClusters
+{
+public:
+    static const int TILES_X = 16;
+    static const int TILES_Y = 12;
+    static const int SLICES = 24;
+    static const int CLUSTERS = TILES_X * TILES_Y * SLICES;
+    // binding point of the Clusters uniform block
+    static const unsigned int UNIFORM_BINDING = 2;
+
+    ClusterStats Stats;
+
+    LightClusters(unsigned int threads = 0) : threads(threads), width(0), height(0), zNear(0.0f), zFar(0.0f),
+                                              scaleX(0.0f), scaleY(0.0f), lists(CLUSTERS), ranges(2 * (CLUSTERS + 1))
+    {
+        glGenBuffers(2, buffers);
+        glGenTextures(2, textures);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[0]);
+        glBufferData(GL_TEXTURE_BUFFER, ranges.size() * sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[0]);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, buffers[0]);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[1]);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[1]);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, buffers[1]);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+        glGenBuffers(1, &uniformBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, 8 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING, uniformBuffer, 0, 8 * sizeof(float));
+    }
+
+    ~LightClusters()
+    {
+        glDeleteTextures(2, textures);
+        glDeleteBuffers(2, buffers);
+        glDeleteBuffers(1, &uniformBuffer);
+    }
+
+    // bins the lights for a camera. width and height are the framebuffer's, zNear and zFar the projection's.
+    void Build(const LightManager &lights, const glm::mat4 &view, const glm::mat4 &projection, float zNear, float zFar,
+               int width, int height)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        setProjection(projection, zNear, zFar, width, height);
+
+        // 1: every light's view space sphere and the range of clusters it may touch
+        unsigned int count = lights.Count();
+        bounds.resize(count);
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++)
+                bounds[i] = lightBounds(lights.Get(i), view);
+        }, threads);
+        globals.clear();
+        for (unsigned int i = 0; i < count; i++)
+            if (bounds[i].Global)
+                globals.push_back(i);
+
+        // 2: the lists of each slice's clusters, testing the light's sphere against each cluster's box
+        parallelFor(SLICES, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t slice = begin; slice < end; slice++)
+                binSlice(slice);
+        }, threads);
+
+        // 3: one index buffer, each cluster's list at its offset, then the global lights
+        Stats.MaxPerCluster = 0;
+        uint32_t offset = 0;
+        for (int cluster = 0; cluster < CLUSTERS; cluster++)
+        {
+            uint32_t size = (uint32_t)lists[cluster].size();
+            ranges[2 * cluster] = offset;
+            ranges[2 * cluster + 1] = size;
+            offset += size;
+            Stats.MaxPerCluster = max(Stats.MaxPerCluster, size);
+        }
+        ranges[2 * CLUSTERS] = offset;
+        ranges[2 * CLUSTERS + 1] = (uint32_t)globals.size();
+        indices.resize(max<size_t>(1, offset + globals.size()));
+        parallelFor(SLICES, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t cluster = begin * TILES_X * TILES_Y; cluster < end * TILES_X * TILES_Y; cluster++)
+                if (!lists[cluster].empty())
+                    copy(lists[cluster].begin(), lists[cluster].end(), indices.begin() + ranges[2 * cluster]);
+        }, threads);
+        if (!globals.empty())
+            copy(globals.begin(), globals.end(), indices.begin() + offset);
+
+        // the whole contents change every frame, so both buffers are orphaned and filled again
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[0]);
+        glBufferData(GL_TEXTURE_BUFFER, ranges.size() * sizeof(uint32_t), &ranges[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[1]);
+        glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(uint32_t), &indices[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        Stats.Indices = offset + globals.size();
+        Stats.GlobalLights = (unsigned int)globals.size();
+        Stats.BinMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // binds the (offset, count) pairs and the light indices for the shaders' usamplerBuffers
+    void Bind(unsigned int rangeUnit, unsigned int indexUnit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + rangeUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[0]);
+        glActiveTexture(GL_TEXTURE0 + indexUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[1]);
+    }
+
+private:
+    // the clusters a light's sphere overlaps, as ranges of tiles and slices
+    struct LightBounds {
+        glm::vec3 Center;           // in view space
+        float Radius;
+        bool Global;
+        bool Visible;
+        int MinX, MaxX, MinY, MaxY, MinSlice, MaxSlice;
+    };
+
+    struct Box {
+        glm::vec3 Min, Max;
+    };
+
+    unsigned int threads;
+    int width, height;
+    float zNear, zFar, scaleX, scaleY;
+    vector<Box> boxes;
+    vector<LightBounds> bounds;
+    vector<unsigned int> globals;
+    vector<vector<uint32_t> > lists;
+    vector<uint32_t> ranges, indices;
+    unsigned int buffers[2], textures[2], uniformBuffer;
+
+    // depth of the near side of a slice, from zNear for slice 0 to zFar for slice SLICES
+    float sliceDepth(int slice) const
+    {
+        return zNear * powf(zFar / zNear, (float)slice / SLICES);
+    }
+
+    // rebuilds the cluster boxes and the uniform block when the projection or the framebuffer change
+    void setProjection(const glm::mat4 &projection, float zNear, float zFar, int width, int height)
+    {
+        if (projection[0][0] == scaleX && projection[1][1] == scaleY && zNear == this->zNear && zFar == this->zFar &&
+            width == this->width && height == this->height)
+            return;
+        scaleX = projection[0][0];
+        scaleY = projection[1][1];
+        this->zNear = zNear;
+        this->zFar = zFar;
+        this->width = width;
+        this->height = height;
+
+        boxes.resize(CLUSTERS);
+        for (int slice = 0; slice < SLICES; slice++)
+        {
+            float near = sliceDepth(slice), far = sliceDepth(slice + 1);
+            for (int y = 0; y < TILES_Y; y++)
+                for (int x = 0; x < TILES_X; x++)
+                {
+                    // the tile's corners in NDC, then in view space at the slice's near and far depth
+                    float x0 = 2.0f * x / TILES_X - 1.0f, x1 = 2.0f * (x + 1) / TILES_X - 1.0f;
+                    float y0 = 2.0f * y / TILES_Y - 1.0f, y1 = 2.0f * (y + 1) / TILES_Y - 1.0f;
+                    Box &box = boxes[(slice * TILES_Y + y) * TILES_X + x];
+                    box.Min = glm::vec3(min(x0 * near, x0 * far) / scaleX, min(y0 * near, y0 * far) / scaleY, -far);
+                    box.Max = glm::vec3(max(x1 * near, x1 * far) / scaleX, max(y1 * near, y1 * far) / scaleY, -near);
+                }
+        }
+
+        // Clusters block: the grid size and the index of the global list, then the tile size in pixels and the
+        // scale and bias that turn log(depth) into a slice
+        float logRange = logf(zFar / zNear);
+        int32_t counts[4] = {TILES_X, TILES_Y, SLICES, CLUSTERS};
+        float params[4] = {(float)width / TILES_X, (float)height / TILES_Y, SLICES / logRange, SLICES * logf(zNear) / logRange};
+        glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(counts), counts);
+        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(counts), sizeof(params), params);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    LightBounds lightBounds(const Light &light, const glm::mat4 &view) const
+    {
+        LightBounds b;
+        b.Radius = light.Range;
+        b.Global = b.Radius < 0.0f;
+        b.Visible = false;
+        if (b.Global || b.Radius == 0.0f)
+            return b;
+        b.Center = glm::vec3(view * glm::vec4(light.Position, 1.0f));
+        // the sphere's depth range, clipped to the frustum's
+        float nearDepth = max(-b.Center.z - b.Radius, zNear);
+        float farDepth = min(-b.Center.z + b.Radius, zFar);
+        if (nearDepth > farDepth)
+            return b;
+        // its extent on screen: x / depth over the box around the sphere is largest at one of the box's corners
+        float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+        float depths[2] = {nearDepth, farDepth};
+        for (int i = 0; i < 2; i++)
+        {
+            float invDepth = 1.0f / depths[i];
+            minX = min(minX, (b.Center.x - b.Radius) * invDepth * scaleX);
+            maxX = max(maxX, (b.Center.x + b.Radius) * invDepth * scaleX);
+            minY = min(minY, (b.Center.y - b.Radius) * invDepth * scaleY);
+            maxY = max(maxY, (b.Center.y + b.Radius) * invDepth * scaleY);
+        }
+        if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+            return b;
+        b.Visible = true;
+        b.MinX = max(0, min(TILES_X - 1, (int)floorf((minX + 1.0f) * 0.5f * TILES_X)));
+        b.MaxX = max(0, min(TILES_X - 1, (int)floorf((maxX + 1.0f) * 0.5f * TILES_X)));
+        b.MinY = max(0, min(TILES_Y - 1, (int)floorf((minY + 1.0f) * 0.5f * TILES_Y)));
+        b.MaxY = max(0, min(TILES_Y - 1, (int)floorf((maxY + 1.0f) * 0.5f * TILES_Y)));
+        float logRange = logf(zFar / zNear);
+        b.MinSlice = max(0, min(SLICES - 1, (int)floorf(logf(nearDepth / zNear) / logRange * SLICES)));
+        b.MaxSlice = max(0, min(SLICES - 1, (int)floorf(logf(farDepth / zNear) / logRange * SLICES)));
+        return b;
+    }
+
+    void binSlice(int slice)
+    {
+        for (int cluster = slice * TILES_X * TILES_Y; cluster < (slice + 1) * TILES_X * TILES_Y; cluster++)
+            lists[cluster].clear();
+        for (size_t i = 0; i < bounds.size(); i++)
+        {
+            const LightBounds &b = bounds[i];
+            if (!b.Visible || slice < b.MinSlice || slice > b.MaxSlice)
+                continue;
+            for (int y = b.MinY; y <= b.MaxY; y++)
+                for (int x = b.MinX; x <= b.MaxX; x++)
+                {
+                    int cluster = (slice * TILES_Y + y) * TILES_X + x;
+                    // distance from the sphere's center to the cluster's box
+                    const Box &box = boxes[cluster];
+                    glm::vec3 d = glm::max(box.Min - b.Center, glm::max(glm::vec3(0.0f), b.Center - box.Max));
+                    if (glm::dot(d, d) <= b.Radius * b.Radius)
+                        lists[cluster].push_back((uint32_t)i);
+                }
+        }
+    }
+};
+#endif
@@ -0,0 +1,162 @@
+#ifndef LIGHT_CULLER_H
+#define LIGHT_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../lightManager.h"
+#include "../parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <stdint.h>
+using namespace std;
+
+struct LightCullStats {
+    double CullMs;                  // CPU time of the last Cull, the upload included
+    unsigned int VisibleLights;     // lights that reach into the view frustum, global ones included
+    size_t Indices;                 // light indices over all objects
+    unsigned int MaxPerObject;
+
+    LightCullStats() : CullMs(0.0), VisibleLights(0), Indices(0), MaxPerObject(0)
+    {
+    }
+};
+
+// Per object light lists for forward shading: every draw gets only the lights that reach it. A light's range
+// comes from its attenuation (Light::Radius, with the threshold set on the LightManager); the lights whose sphere
+// lies outside the view frustum are dropped first, then each object keeps the visible lights whose sphere
+// touches its bounding sphere. Lights without a range, like the directional light, reach every object. As the
+// shader fades a light out at its range, nothing on screen changes.
+// The lists are flattened into one index buffer that the shaders read as a buffer texture, and each draw sets
+// the (offset, count) of its object's list from Range. Both steps run in parallel, over lights and over objects.
+class LightCuller
+{
+public:
+    LightCullStats Stats;
+
+    LightCuller(unsigned int threads = 0) : threads(threads)
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    ~LightCuller()
+    {
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    // builds the lists for a camera's view projection matrix. objects holds each object's bounding sphere in
+    // world space, center in xyz and radius in w.
+    void Cull(const LightManager &lights, const glm::mat4 &viewProjection, const vector<glm::vec4> &objects)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        // the frustum's planes, pointing inwards (Gribb and Hartmann): a row of the matrix plus or minus the last
+        glm::vec4 planes[6];
+        for (int i = 0; i < 3; i++)
+        {
+            glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+            glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+            planes[2 * i] = w + row;
+            planes[2 * i + 1] = w - row;
+        }
+        for (int i = 0; i < 6; i++)
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+
+        // 1: the lights that reach into the frustum
+        unsigned int count = lights.Count();
+        visibleFlags.assign(count, 0);
+        parallelFor(count, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++)
+            {
+                const Light &light = lights.Get(i);
+                if (light.Range < 0.0f)
+                {
+                    visibleFlags[i] = 1;
+                    continue;
+                }
+                if (light.Range == 0.0f)
+                    continue;
+                bool inside = true;
+                for (int p = 0; p < 6 && inside; p++)
+                    inside = glm::dot(glm::vec3(planes[p]), light.Position) + planes[p].w >= -light.Range;
+                visibleFlags[i] = inside ? 1 : 0;
+            }
+        }, threads);
+        visible.clear();
+        for (unsigned int i = 0; i < count; i++)
+            if (visibleFlags[i])
+                visible.push_back(i);
+
+        // 2: each object's list, the visible lights whose sphere touches the object's
+        lists.resize(objects.size());
+        parallelFor(objects.size(), [&](size_t begin, size_t end, unsigned int) {
+            for (size_t o = begin; o < end; o++)
+            {
+                lists[o].clear();
+                glm::vec3 center(objects[o]);
+                for (size_t v = 0; v < visible.size(); v++)
+                {
+                    const Light &light = lights.Get(visible[v]);
+                    float reach = light.Range + objects[o].w;
+                    glm::vec3 offset = light.Position - center;
+                    if (light.Range < 0.0f || glm::dot(offset, offset) <= reach * reach)
+                        lists[o].push_back(visible[v]);
+                }
+            }
+        }, threads);
+
+        // 3: one index buffer, each object's list at its offset
+        ranges.resize(objects.size());
+        indices.clear();
+        Stats.MaxPerObject = 0;
+        for (size_t o = 0; o < objects.size(); o++)
+        {
+            ranges[o] = glm::uvec2((unsigned int)indices.size(), (unsigned int)lists[o].size());
+            indices.insert(indices.end(), lists[o].begin(), lists[o].end());
+            Stats.MaxPerObject = max(Stats.MaxPerObject, (unsigned int)lists[o].size());
+        }
+        Stats.Indices = indices.size();
+        if (indices.empty())
+            indices.push_back(0);
+        // the whole contents change every frame, so the buffer is orphaned and filled again
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(uint32_t), &indices[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        Stats.VisibleLights = (unsigned int)visible.size();
+        Stats.CullMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // the (offset, count) of an object's lights in the index buffer
+    glm::uvec2 Range(unsigned int object) const
+    {
+        return ranges[object];
+    }
+
+    // binds the light indices for the shaders' usamplerBuffer
+    void Bind(unsigned int textureUnit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + textureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+    }
+
+private:
+    unsigned int threads;
+    unsigned int buffer, texture;
+    vector<unsigned char> visibleFlags;
+    vector<unsigned int> visible;
+    vector<vector<uint32_t> > lists;
+    vector<glm::uvec2> ranges;
+    vector<uint32_t> indices;
+};
+#endif
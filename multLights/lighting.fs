@@ -5,100 +5,246 @@ struct Material {
 	float shininess;
 };
 
-// Directional Light struct 
-struct DirLight {
-	vec3 direction;
-	
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-}; 
-
-// Point Light struct
-struct PointLight {
+// Light struct, for directional, point and spot lights alike (see lightManager.h)
+#define LIGHT_DIRECTIONAL 0
+#define LIGHT_POINT 1
+#define LIGHT_SPOT 2
+struct Light {
 	vec3 position;
+	int type;
+	vec3 direction;
 	
 	float constant;
 	float linear;
 	float quadratic;
 	
-	vec3 ambient;
 	vec3 diffuse;
 	vec3 specular;
+	
+	float cutOff;
+	float outerCutOff;
+	float range;
+	int shadow;
 };
 
 uniform Material material; 
 uniform vec3 viewPos; 
-// Define singular directional light
-uniform DirLight dirLight; 
-// Define four point lights 
-#define NR_POINT_LIGHTS 4 
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform mat4 view;
+// Every light of the scene, 5 texels each, and how many there are 
+uniform samplerBuffer lights;
+layout (std140) uniform LightCount {
+	int lightCount;
+};
+// The lights reaching each cluster of the view frustum (see lightClusters.h): an offset and count per cluster 
+// into the light indices, and the grid's size, tile size and depth slicing 
+uniform bool clustered;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterLights;
+layout (std140) uniform Clusters {
+	ivec4 clusterCount;
+	vec4 clusterParams;
+};
+// Or the lights reaching the object being drawn (see lightCuller.h): its offset and count into the light indices 
+uniform bool objectCulled;
+uniform uvec2 objectLightRange;
+uniform usamplerBuffer objectLights;
+
+// the directional light's cascaded shadow maps: where a world position lands in each cascade's part of its layer, 
+// how far from the camera each cascade reaches, and a texel's size in the world (see cascadedShadows.h)
+uniform sampler2DArrayShadow shadowMap;
+layout (std140) uniform Shadows {
+	mat4 cascadeMatrices[4];
+	vec4 cascadeSplits;
+	vec4 cascadeTexelSize;
+	vec4 cascadeExtent;
+	ivec4 cascadeCount;
+};
+
+// the point lights' cube shadow maps, six layers per light from layer (shadow - 1) * 6 on, one per face in cube 
+// map order, and the faces' near plane and the farthest a shadow reaches (see pointShadows.h) 
+uniform sampler2DArrayShadow pointShadowMaps;
+uniform vec2 pointShadowPlanes;
+
+// ambient light from the skybox, as irradiance in spherical harmonics (see sphericalHarmonics.h)
+layout (std140) uniform Irradiance {
+	vec4 irradianceSH[9];
+};
+uniform float ambientStrength;
 
 in vec3 Normal; 
 in vec3 FragPos; 
 in vec2 TexCoords; 
+in float ViewDepth; 
 
 out vec4 FragColor;
 
-// Function to calculate directional light 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-// Function to calculate point lights 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+// Function to read a light from the light buffer 
+Light FetchLight(int index);
+// Function to calculate any light 
+vec3 CalcLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
+// Function to calculate the ambient light 
+vec3 CalcAmbient(vec3 normal);
+// Function to calculate the directional light's shadow 
+float CalcShadow(vec3 fragPos, vec3 normal);
+// Function to calculate a point or spot light's shadow 
+float CalcPointShadow(Light light, vec3 fragPos, vec3 normal);
 
 void main() {
 	// Properties 
 	vec3 norm = normalize(Normal);
 	vec3 viewDir = normalize(viewPos - FragPos);
 	
-	// Directional lighting
-	vec3 result = CalcDirLight(dirLight, norm, viewDir);
+	// Ambient lighting 
+	vec3 result = CalcAmbient(norm);
 	
-	// Point lights 
-	for(int i = 0; i < NR_POINT_LIGHTS; i++) {
-		result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+	// Directional, point and spot lights 
+	if (objectCulled) {
+		for(uint i = 0u; i < objectLightRange.y; i++) {
+			result += CalcLight(FetchLight(int(texelFetch(objectLights, int(objectLightRange.x + i)).r)), norm, FragPos, viewDir);
+		}
+	} else if (clustered) {
+		// the lights of this fragment's cluster, then the ones that reach every cluster 
+		int slice = clamp(int(log(ViewDepth) * clusterParams.z - clusterParams.w), 0, clusterCount.z - 1);
+		ivec2 tile = min(ivec2(gl_FragCoord.xy / clusterParams.xy), clusterCount.xy - 1);
+		int cluster = (slice * clusterCount.y + tile.y) * clusterCount.x + tile.x;
+		uvec2 range = texelFetch(clusterRanges, cluster).xy;
+		uvec2 globals = texelFetch(clusterRanges, clusterCount.w).xy;
+		for(uint i = 0u; i < range.y; i++) {
+			result += CalcLight(FetchLight(int(texelFetch(clusterLights, int(range.x + i)).r)), norm, FragPos, viewDir);
+		}
+		for(uint i = 0u; i < globals.y; i++) {
+			result += CalcLight(FetchLight(int(texelFetch(clusterLights, int(globals.x + i)).r)), norm, FragPos, viewDir);
+		}
+	} else {
+		for(int i = 0; i < lightCount; i++) {
+			result += CalcLight(FetchLight(i), norm, FragPos, viewDir);
+		}
 	}
-	// Spot lights 
-	// result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
 	
 	FragColor = vec4(result, 1.0);
 }
 
-// Function to calculate directional light
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
-	// Normalize input direction
-	vec3 lightDir = normalize(-light.direction);
-	// diffuse shading
-	float diff = max(dot(normal, lightDir), 0.0);
-	// specular shading
-	vec3 reflectDir = reflect(-lightDir, normal);
-	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-	// Combine results 
-	vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-	vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-	vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-	return (ambient + diffuse + specular);
+// Function to read a light from the light buffer 
+Light FetchLight(int index) {
+	vec4 t0 = texelFetch(lights, index * 5);
+	vec4 t1 = texelFetch(lights, index * 5 + 1);
+	vec4 t2 = texelFetch(lights, index * 5 + 2);
+	vec4 t3 = texelFetch(lights, index * 5 + 3);
+	vec4 t4 = texelFetch(lights, index * 5 + 4);
+	Light light;
+	light.position = t0.xyz;
+	light.type = int(t0.w);
+	light.direction = t1.xyz;
+	light.constant = t1.w;
+	light.diffuse = t2.rgb;
+	light.linear = t2.w;
+	light.specular = t3.rgb;
+	light.quadratic = t3.w;
+	light.cutOff = t4.x;
+	light.outerCutOff = t4.y;
+	light.range = t4.z;
+	light.shadow = int(t4.w);
+	return light;
 }
 
-// Function to calculate point lights 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
-	// Calculate light direction
-	vec3 lightDir = normalize(light.position - fragPos);
+// Function to calculate any light 
+vec3 CalcLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir) {
+	// Calculate light direction, directional lights have one for all fragments 
+	vec3 lightDir = light.type == LIGHT_DIRECTIONAL ? normalize(-light.direction) : normalize(light.position - fragPos);
 	// Diffuse shading
 	float diff = max(dot(normal, lightDir), 0.0);
 	// Specular shading 
 	vec3 reflectDir = reflect(-lightDir, normal);
 	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-	// attenuation
-	float distance = length(light.position - fragPos);
+	// attenuation, directional lights have constant 1 and linear and quadratic 0 
+	float distance = light.type == LIGHT_DIRECTIONAL ? 0.0 : length(light.position - fragPos);
 	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	// faded out to nothing at the light's range, lights with a negative range reach everything 
+	if (light.range > 0.0) {
+		float falloff = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+		attenuation *= falloff * falloff;
+	}
+	// spotlight intensity, soft edged
+	if (light.type == LIGHT_SPOT) {
+		float theta = dot(lightDir, normalize(-light.direction));
+		float epsilon = light.cutOff - light.outerCutOff;
+		attenuation *= clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+	}
+	// shadow 
+	if (light.shadow > 0)
+		attenuation *= light.type == LIGHT_DIRECTIONAL ? CalcShadow(fragPos, normal) : CalcPointShadow(light, fragPos, normal);
 	// combine results 
-	vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
 	vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
 	vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-	ambient *= attenuation;
 	diffuse *= attenuation;
 	specular *= attenuation;
 	
-	return (ambient + diffuse + specular);	
+	return (diffuse + specular);	
+}
+
+// Function to calculate the ambient light, the skybox's irradiance around the normal 
+vec3 CalcAmbient(vec3 n) {
+	vec3 irradiance = irradianceSH[0].rgb
+		+ irradianceSH[1].rgb * n.y + irradianceSH[2].rgb * n.z + irradianceSH[3].rgb * n.x
+		+ irradianceSH[4].rgb * n.x * n.y + irradianceSH[5].rgb * n.y * n.z
+		+ irradianceSH[6].rgb * (3.0 * n.z * n.z - 1.0) + irradianceSH[7].rgb * n.x * n.z
+		+ irradianceSH[8].rgb * (n.x * n.x - n.y * n.y);
+	return ambientStrength * max(irradiance, 0.0) * vec3(texture(material.diffuse, TexCoords));
+}
+
+// Function to look up the cascaded shadow maps, 1 where nothing is between the fragment and the directional light 
+float CalcShadow(vec3 fragPos, vec3 normal) {
+	// the first cascade that reaches as far as the fragment, beyond the last one everything is lit 
+	float depth = -(view * vec4(fragPos, 1.0)).z;
+	int cascade = 0;
+	while (cascade < cascadeCount.x && depth > cascadeSplits[cascade])
+		cascade++;
+	if (cascade == cascadeCount.x)
+		return 1.0;
+	// looked up a couple of texels out along the normal, so a surface doesn't shadow itself 
+	vec3 position = (cascadeMatrices[cascade] * vec4(fragPos + normal * (2.0 * cascadeTexelSize[cascade]), 1.0)).xyz;
+	// four lookups, each comparing and blending four texels, kept inside the cascade's part of the layer 
+	vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	vec2 lower = 0.5 * texel;
+	vec2 upper = vec2(cascadeExtent[cascade]) - 0.5 * texel;
+	float lit = 0.0;
+	for (int i = 0; i < 4; i++) {
+		vec2 offset = vec2((i & 1) != 0 ? 0.5 : -0.5, (i & 2) != 0 ? 0.5 : -0.5) * texel;
+		lit += texture(shadowMap, vec4(clamp(position.xy + offset, lower, upper), float(cascade), position.z));
+	}
+	return lit * 0.25;
+}
+
+// Function to look up a point or spot light's cube shadow map, 1 where nothing is between the fragment and the light 
+const vec3 cubeForward[6] = vec3[](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), 
+                                   vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+const vec3 cubeUp[6] = vec3[](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), 
+                              vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
+float CalcPointShadow(Light light, vec3 fragPos, vec3 normal) {
+	float near = pointShadowPlanes.x;
+	float far = light.range > 0.0 ? max(min(light.range, pointShadowPlanes.y), near * 2.0) : pointShadowPlanes.y;
+	// the face is the one of the largest axis 
+	vec3 toFrag = fragPos - light.position;
+	vec3 a = abs(toFrag);
+	int face = a.x >= a.y && a.x >= a.z ? (toFrag.x > 0.0 ? 0 : 1) : (a.y >= a.z ? (toFrag.y > 0.0 ? 2 : 3) : (toFrag.z > 0.0 ? 4 : 5));
+	// looked up a couple of texels out along the normal, a texel being 2 * distance / resolution wide 
+	vec2 texel = 1.0 / vec2(textureSize(pointShadowMaps, 0).xy);
+	toFrag += normal * (4.0 * max(a.x, max(a.y, a.z)) * texel.x);
+	// projected like the face was drawn, glm::lookAt and a 90 degree perspective 
+	vec3 forward = cubeForward[face];
+	vec3 side = cross(forward, cubeUp[face]);
+	vec3 up = cross(side, forward);
+	float w = dot(forward, toFrag);
+	if (w >= far)
+		return 1.0;
+	vec2 position = vec2(dot(side, toFrag), dot(up, toFrag)) / w * 0.5 + 0.5;
+	float depth = ((far + near) / (far - near) - 2.0 * far * near / ((far - near) * w)) * 0.5 + 0.5;
+	// four lookups, each comparing and blending four texels, kept inside the face 
+	float layer = float((light.shadow - 1) * 6 + face);
+	float lit = 0.0;
+	for (int i = 0; i < 4; i++) {
+		vec2 offset = vec2((i & 1) != 0 ? 0.5 : -0.5, (i & 2) != 0 ? 0.5 : -0.5) * texel;
+		lit += texture(pointShadowMaps, vec4(clamp(position + offset, 0.5 * texel, 1.0 - 0.5 * texel), layer, depth));
+	}
+	return lit * 0.25;
 }
@@ -10,11 +10,13 @@ uniform mat4 projection;
 out vec3 Normal; 
 out vec3 FragPos; 
 out vec2 TexCoords; 
+out float ViewDepth; 
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0)); 
     Normal = mat3(transpose(inverse(model))) * aNormal;
+    ViewDepth = -(view * vec4(FragPos, 1.0)).z; 
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     TexCoords = aTexCoords; 
 }
@@ -8,8 +8,22 @@
 #include "shader_m.h"
 #include "camera.h"
 #include "stb_image.h"
-
+#include "sphericalHarmonics.h"
+#include "../lightManager.h"
+#include "lightClusters.h"
+#include "deferredRenderer.h"
+#include "cascadedShadows.h"
+#include "../pointShadows.h"
+#include "lightCuller.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../headless.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -19,6 +33,8 @@ void processInput(GLFWwindow *window);
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// radius of the cubes' bounding spheres: half the diagonal of a unit cube
+const float CUBE_RADIUS = sqrtf(3.0f) / 2.0f;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -33,43 +49,110 @@ float lastFrame = 0.0f;
 // lighting 
 float radiusOfLight = 2.0f; 
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
-
-int main()
+// clustered shading, C switches to evaluating every light per fragment and back
+bool clustered = true;
+bool clusterKeyPressed = false;
+// forward shading with a list of lights per object instead of clusters, O switches it on and off 
+bool objectLights = false;
+bool objectKeyPressed = false;
+// deferred shading instead, G switches between the two 
+bool deferred = false;
+bool deferredKeyPressed = false;
+// the directional light casts shadows through cascaded shadow maps 
+bool shadows = true;
+// the first point lights cast shadows through cube shadow maps, the first cube turns when spin is set 
+unsigned int pointShadowCount = 4;
+bool spin = false;
+
+int main(int argc, char **argv)
 {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
-#endif
-
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
+    // --headless renders offscreen instead, see headless.h
+    Headless headless(argc, argv);
+    // --lights N adds point lights scattered through the scene until there are N of them
+    unsigned int pointLightCount = 4;
+    for (int i = 1; i + 1 < argc; i++)
+        if (strcmp(argv[i], "--lights") == 0)
+            pointLightCount = max(4, atoi(argv[i + 1]));
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--no-clusters") == 0)
+            clustered = false;
+        else if (strcmp(argv[i], "--object-lights") == 0)
+            objectLights = true;
+        else if (strcmp(argv[i], "--deferred") == 0)
+            deferred = true;
+        else if (strcmp(argv[i], "--no-shadows") == 0)
+            shadows = false;
+        else if (strcmp(argv[i], "--spin") == 0)
+            spin = true;
+    // --point-shadows N gives the first N point lights shadows, 0 none; --light-threshold T ends the lights'
+    // ranges where they fall below T instead of 5/256
+    float lightThreshold = Light::DEFAULT_THRESHOLD;
+    for (int i = 1; i + 1 < argc; i++)
+        if (strcmp(argv[i], "--point-shadows") == 0)
+            pointShadowCount = max(0, atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--light-threshold") == 0)
+            lightThreshold = (float)atof(argv[i + 1]);
+    // --cascades N, --cascade-sizes A,B,C,D and --cascade-intervals A,B,C,D (in frames) trade the shadows'
+    // quality for their cost; --no-layered-shadows draws each cascade in a pass of its own
+    CascadeSettings cascadeSettings;
+    for (int i = 1; i < argc; i++)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        unsigned int values[4];
+        int count = i + 1 < argc ? sscanf(argv[i + 1], "%u,%u,%u,%u", &values[0], &values[1], &values[2], &values[3]) : 0;
+        if (strcmp(argv[i], "--cascades") == 0 && count > 0)
+            cascadeSettings.Count = values[0];
+        else if (strcmp(argv[i], "--cascade-sizes") == 0)
+            for (int j = 0; j < count; j++)
+                cascadeSettings.Resolution[j] = values[j];
+        else if (strcmp(argv[i], "--cascade-intervals") == 0)
+            for (int j = 0; j < count; j++)
+                cascadeSettings.UpdateInterval[j] = values[j];
+        else if (strcmp(argv[i], "--no-layered-shadows") == 0)
+            cascadeSettings.Layered = false;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    GLFWwindow* window = NULL;
+    if (headless.Enabled)
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        if (!headless.CreateContext(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
+    }
+    else
+    {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    #ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
+    #endif
+
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
     }
 
     // configure global opengl state
@@ -80,6 +163,8 @@ int main()
     // ------------------------------------
     Shader lightingShader("lighting.vs", "lighting.fs");
     Shader lampShader("lamp.vs", "lamp.fs");
+    Shader gBufferShader("lighting.vs", "gbuffer.fs");
+    Shader deferredShader("deferred.vs", "deferred.fs");
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -226,144 +311,337 @@ int main()
 	cout << "Failed to load texture" << endl;
     }
     stbi_image_free(data); 
-	
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(window))
+
+    // ambient light: the skybox's irradiance, projected once and cached, in a uniform block at binding point 0
+    vector<string> skyboxFaces;
+    skyboxFaces.push_back("../cubemap/right.jpg");
+    skyboxFaces.push_back("../cubemap/left.jpg");
+    skyboxFaces.push_back("../cubemap/top.jpg");
+    skyboxFaces.push_back("../cubemap/bottom.jpg");
+    skyboxFaces.push_back("../cubemap/front.jpg");
+    skyboxFaces.push_back("../cubemap/back.jpg");
+    SHIrradiance irradiance;
+    if (!SphericalHarmonics::Load(skyboxFaces, "skybox.shcache", irradiance))
+        irradiance = SHIrradiance();
+    unsigned int irradianceUBO = SphericalHarmonics::CreateUniformBuffer(irradiance, 0);
+    glUniformBlockBinding(lightingShader.ID, glGetUniformBlockIndex(lightingShader.ID, "Irradiance"), 0);
+
+    // the lights, clusters, G-buffer and shadow maps are deleted at the end of this block, before glfwTerminate
     {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-
-        // render
-        // ------
-	//  Clear screen 
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        // be sure to activate shader when setting uniforms/drawing objects
+        // every light goes into one buffer, the shaders loop over however many there are. the four colored
+        // point lights and the flashlight change each frame, the other lights are uploaded once.
+        LightManager lightManager(pointLightCount + 2);
+        lightManager.SetThreshold(lightThreshold);
+        Light sun = Light::Directional(glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec3(0.4f), glm::vec3(0.5f));
+        sun.Shadow = shadows ? 1.0f : 0.0f;
+        lightManager.Add(sun);
+        int pointLights[4];
+        for (int i = 0; i < 4; i++)
+            pointLights[i] = lightManager.Add(Light::Point(pointLightPositions[i], glm::vec3(0.0f), glm::vec3(1.0f), 1.0f, 0.007f, 0.0002f));
+        int flashLight = lightManager.Add(Light::Spot(camera.Position, camera.Front, glm::vec3(1.0f), glm::vec3(1.0f), 1.0f, 0.09f, 0.032f,
+                                                      glm::cos(glm::radians(12.5f)), glm::cos(glm::radians(15.0f))));
+        mt19937 random(1);
+        uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (unsigned int i = 4; i < pointLightCount; i++)
+        {
+            glm::vec3 position(-6.0f + 12.0f * unit(random), -5.0f + 10.0f * unit(random), -16.0f + 18.0f * unit(random));
+            glm::vec3 color(unit(random), unit(random), unit(random));
+            // short ranged, so thousands of them don't wash the scene out
+            if (lightManager.Add(Light::Point(position, color * 0.5f, color * 0.5f, 1.0f, 0.7f, 1.8f)) < 0)
+                break;
+        }
+        lightManager.Upload();
+        cout << lightManager.Count() << " lights, " << lightManager.UploadedBytes << " bytes uploaded" << endl;
+
+        // samplers and constants don't change from frame to frame
         lightingShader.use();
+        lightingShader.setInt("material.diffuse", 0);
+        lightingShader.setInt("material.specular", 1);
+        lightingShader.setInt("lights", 2);
+        lightingShader.setFloat("material.shininess", 32.0f);
+        // Set how much of the skybox's light reaches the cubes 
+        lightingShader.setFloat("ambientStrength", 0.3f);
+        glUniformBlockBinding(lightingShader.ID, glGetUniformBlockIndex(lightingShader.ID, "LightCount"), LightManager::UNIFORM_BINDING);
+        // the lights are binned into clusters of the view frustum every frame
+        LightClusters lightClusters;
+        lightingShader.setInt("clusterRanges", 3);
+        lightingShader.setInt("clusterLights", 4);
+        glUniformBlockBinding(lightingShader.ID, glGetUniformBlockIndex(lightingShader.ID, "Clusters"), LightClusters::UNIFORM_BINDING);
+        // or culled against the view frustum and each cube's bounding sphere, every cube gets the lights that reach it
+        LightCuller lightCuller;
+        vector<glm::vec4> cubeBounds;
+        for (unsigned int i = 0; i < 10; i++)
+            cubeBounds.push_back(glm::vec4(cubePositions[i], CUBE_RADIUS));
+        lightingShader.setInt("objectLights", 10);
+        GLint objectLightRange = glGetUniformLocation(lightingShader.ID, "objectLightRange");
+        lampShader.use();
+        lampShader.setInt("lights", 2);
+        lampShader.setFloat("lampSize", 0.2f);
+        // the deferred path draws the same cubes into a G-buffer, then lights it from the same light buffer
+        DeferredRenderer deferredRenderer;
+        gBufferShader.use();
+        gBufferShader.setInt("material.diffuse", 0);
+        gBufferShader.setInt("material.specular", 1);
+        gBufferShader.setFloat("material.shininess", 32.0f);
+        deferredShader.use();
+        deferredShader.setInt("lights", 2);
+        deferredShader.setInt("gAlbedoSpecular", 5);
+        deferredShader.setInt("gNormalShininess", 6);
+        deferredShader.setInt("gDepth", 7);
+        deferredShader.setFloat("ambientStrength", 0.3f);
+        deferredShader.setFloat("zNear", 0.1f);
+        deferredShader.setFloat("zFar", 100.0f);
+        deferredShader.setVec3("background", glm::vec3(0.1f));
+        deferredShader.setInt("clusterRanges", 3);
+        deferredShader.setInt("clusterLights", 4);
+        glUniformBlockBinding(deferredShader.ID, glGetUniformBlockIndex(deferredShader.ID, "Irradiance"), 0);
+        glUniformBlockBinding(deferredShader.ID, glGetUniformBlockIndex(deferredShader.ID, "Clusters"), LightClusters::UNIFORM_BINDING);
+        // the directional light's shadows, the cubes are the casters and only the first one moves, with --spin
+        CascadedShadows cascadedShadows(cascadeSettings);
+        vector<ShadowCaster> casters;
+        glm::mat4 cubeModels[10];
+        for (unsigned int i = 0; i < 10; i++)
+        {
+            cubeModels[i] = glm::translate(cubeModels[i], cubePositions[i]);
+            cubeModels[i] = glm::rotate(cubeModels[i], glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
+            ShadowCaster caster;
+            caster.Center = cubePositions[i];
+            caster.Radius = CUBE_RADIUS;
+            caster.Moving = spin && i == 0;
+            casters.push_back(caster);
+        }
+        lightingShader.use();
+        lightingShader.setInt("shadowMap", 8);
+        glUniformBlockBinding(lightingShader.ID, glGetUniformBlockIndex(lightingShader.ID, "Shadows"), CascadedShadows::UNIFORM_BINDING);
+        deferredShader.use();
+        deferredShader.setInt("shadowMap", 8);
+        glUniformBlockBinding(deferredShader.ID, glGetUniformBlockIndex(deferredShader.ID, "Shadows"), CascadedShadows::UNIFORM_BINDING);
+        // the point lights' shadows, a cube each in the atlas; a light's Shadow tells the shaders its slot
+        PointShadowSettings pointShadowSettings;
+        pointShadowSettings.Slots = max(1u, pointShadowCount);
+        PointShadows pointShadows(pointShadowSettings);
+        vector<int> shadowedLights;
+        for (unsigned int i = 0; i < lightManager.Count() && shadowedLights.size() < pointShadowCount; i++)
+        {
+            Light light = lightManager.Get(i);
+            if (light.Type != LIGHT_POINT)
+                continue;
+            int slot = pointShadows.Add(i);
+            if (slot < 0)
+                break;
+            light.Shadow = slot + 1.0f;
+            lightManager.Set(i, light);
+            shadowedLights.push_back(i);
+        }
+        lightManager.Upload();
+        glm::vec2 pointShadowPlanes(pointShadowSettings.Near, pointShadowSettings.MaxRange);
+        lightingShader.use();
+        lightingShader.setInt("pointShadowMaps", 9);
+        lightingShader.setVec2("pointShadowPlanes", pointShadowPlanes);
+        deferredShader.use();
+        deferredShader.setInt("pointShadowMaps", 9);
+        deferredShader.setVec2("pointShadowPlanes", pointShadowPlanes);
 	
-	// Assign preferred texture unit to the material.diffuse uniform sampler
-	// and bind the container texture to the texture unit  	
-	lightingShader.setInt("material.diffuse", 0); 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, diffuseMap); 
-	// Assign preferred texture unit to the material.specular uniform sampler
- 	// and bind the container texture to the texture unit 
-	lightingShader.setInt("material.specular", 1); 
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, specularMap); 
-	
-	// Set camera position 
-	lightingShader.setVec3("viewPos", camera.Position);
-	// Set material shininess 
-	lightingShader.setFloat("material.shininess", 32.0f);
-	
-	// Set lighting color
-	glm::vec3 lightColor[4];
-	for (int i = 0; i < 4; i++) { 
-		lightColor[i].x = sin(i + glfwGetTime() * 2.0f);
-		lightColor[i].y = sin(i + glfwGetTime() * 0.7f);
-		lightColor[i].z = sin(i + glfwGetTime() * 1.3f); 
-	}
-	glm::vec3 diffuseColor[4]; 
-	for (int i = 0; i < 4; i++) {
-		diffuseColor[i] = lightColor[i] * glm::vec3(0.8);
-	}
-	glm::vec3 ambientColor[4];
-	for (int i = 0; i < 4; i++) {
-		ambientColor[i]  = diffuseColor[i] * glm::vec3(0.05);
-	}
-
-	// directional light
-        lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        lightingShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-        // point light 1
-        lightingShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-        lightingShader.setVec3("pointLights[0].ambient", ambientColor[0]);
-        lightingShader.setVec3("pointLights[0].diffuse", diffuseColor[0]);
-        lightingShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[0].constant", 1.0f);
-        lightingShader.setFloat("pointLights[0].linear", 0.007);
-        lightingShader.setFloat("pointLights[0].quadratic", 0.0002);
-        // point light 2
-        lightingShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-        lightingShader.setVec3("pointLights[1].ambient", ambientColor[1]);
-        lightingShader.setVec3("pointLights[1].diffuse", diffuseColor[1]);
-        lightingShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[1].constant", 1.0f);
-        lightingShader.setFloat("pointLights[1].linear", 0.007);
-        lightingShader.setFloat("pointLights[1].quadratic", 0.0002);
-        // point light 3
-        lightingShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-        lightingShader.setVec3("pointLights[2].ambient", ambientColor[2]);
-        lightingShader.setVec3("pointLights[2].diffuse", diffuseColor[2]);
-        lightingShader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[2].constant", 1.0f);
-        lightingShader.setFloat("pointLights[2].linear", 0.007);
-        lightingShader.setFloat("pointLights[2].quadratic", 0.0002);
-        // point light 4
-        lightingShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-        lightingShader.setVec3("pointLights[3].ambient", ambientColor[3]);
-        lightingShader.setVec3("pointLights[3].diffuse", diffuseColor[3]);
-        lightingShader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[3].constant", 1.0f);
-        lightingShader.setFloat("pointLights[3].linear", 0.007);
-        lightingShader.setFloat("pointLights[3].quadratic", 0.0002);
-        
-	// view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
-
-        // draw cubes 
-	for (unsigned int i = 0; i < 10; i++) {
-		glm::mat4 model; 
-		model = glm::translate(model, cubePositions[i]);
-		float angle = 20.0f * i;
-		model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-		lightingShader.setMat4("model", model);
-		glBindVertexArray(cubeVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-	}
-	
-	// draw the lamp objects
-	for (unsigned int i = 0; i < 4; i++) {
-		lampShader.use();
-		lampShader.setVec3("lampColor", lightColor[i]);
-		lampShader.setMat4("projection", projection);
-		lampShader.setMat4("view", view);
-		glm::mat4 model = glm::mat4(1.0f);	
-		model = glm::translate(model, pointLightPositions[i]);
-		model = glm::scale(model, glm::vec3(0.2f));
-		lampShader.setMat4("model", model);
-	
-		glBindVertexArray(lampVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-	}
-
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        unsigned int reportFrames = 0;
+        unsigned int pointRedraws = 0;
+        double binMs = 0.0, updateMs = 0.0, cullMs = 0.0, lastReport = headless.Time();
+
+        // render loop
+        // -----------
+        while (headless.Running(window))
+        {
+            // per-frame time logic
+            // --------------------
+            float currentFrame = headless.Time();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            // input
+            // -----
+            if (headless.Enabled)
+                headless.MoveCamera(camera);
+            else
+                processInput(window);
+
+            // render
+            // ------
+            // view/projection transformations
+            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+            glm::mat4 view = camera.GetViewMatrix();
+
+            // the first cube turns in place 
+            if (spin) {
+                cubeModels[0] = glm::translate(glm::mat4(), cubePositions[0]);
+                cubeModels[0] = glm::rotate(cubeModels[0], headless.Time(), glm::vec3(1.0f, 0.3f, 0.5f));
+            }
+
+            // the cascades that are due this frame follow the camera and draw the cubes into their shadow maps 
+            if (shadows) {
+                cascadedShadows.Update(view, glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, sun.Direction, casters);
+                cascadedShadows.Render([&](Shader &shader, unsigned int i) {
+                    shader.setMat4("model", cubeModels[i]);
+                    glBindVertexArray(cubeVAO);
+                    glDrawArrays(GL_TRIANGLES, 0, 36);
+                });
+                cascadedShadows.Bind(8);
+                updateMs += cascadedShadows.Stats.UpdateMs;
+            }
+            // point lights are only drawn again when something moved within their range 
+            for (unsigned int i = 0; i < shadowedLights.size(); i++) {
+                const Light &light = lightManager.Get(shadowedLights[i]);
+                pointShadows.SetLight(i, light.Position, light.Range);
+            }
+            pointShadows.Update(casters);
+            pointShadows.Render([&](Shader &shader, unsigned int i) {
+                shader.setMat4("model", cubeModels[i]);
+                glBindVertexArray(cubeVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            });
+            pointShadows.Bind(9);
+            pointRedraws += pointShadows.Redrawn;
+
+            int framebufferWidth, framebufferHeight;
+            headless.GetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            //  Clear screen, or the G-buffer 
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            if (deferred) {
+                deferredRenderer.Resize(framebufferWidth, framebufferHeight);
+                deferredRenderer.BeginGeometry();
+            } else {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+
+            // be sure to activate shader when setting uniforms/drawing objects
+            Shader &sceneShader = deferred ? gBufferShader : lightingShader;
+            sceneShader.use();
+
+            // Bind the container texture to the material.diffuse texture unit 
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, diffuseMap); 
+            // Bind the container texture to the material.specular texture unit 
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, specularMap); 
+
+            // Set camera position 
+            bool perObject = objectLights && !deferred;
+            if (!deferred) {
+                lightingShader.setVec3("viewPos", camera.Position);
+                lightingShader.setBool("clustered", clustered);
+                lightingShader.setBool("objectCulled", perObject);
+            }
+
+            // Set lighting color
+            glm::vec3 lightColor[4];
+            for (int i = 0; i < 4; i++) { 
+                lightColor[i].x = sin(i + headless.Time() * 2.0f);
+                lightColor[i].y = sin(i + headless.Time() * 0.7f);
+                lightColor[i].z = sin(i + headless.Time() * 1.3f); 
+            }
+            // point lights take their new colors, the flashlight follows the camera 
+            for (int i = 0; i < 4; i++) {
+                Light light = lightManager.Get(pointLights[i]);
+                light.Diffuse = lightColor[i] * glm::vec3(0.8);
+                lightManager.Set(pointLights[i], light);
+            }
+            Light spot = lightManager.Get(flashLight);
+            spot.Position = camera.Position;
+            spot.Direction = camera.Front;
+            lightManager.Set(flashLight, spot);
+            // only the lights that changed are sent 
+            lightManager.Upload();
+            lightManager.Bind(2);
+
+            sceneShader.setMat4("projection", projection);
+            sceneShader.setMat4("view", view);
+
+            // bin the lights for this view, or make each cube's list 
+            if (perObject) {
+                lightCuller.Cull(lightManager, projection * view, cubeBounds);
+                lightCuller.Bind(10);
+                cullMs += lightCuller.Stats.CullMs;
+            } else if (clustered) {
+                lightClusters.Build(lightManager, view, projection, 0.1f, 100.0f, framebufferWidth, framebufferHeight);
+                lightClusters.Bind(3, 4);
+                binMs += lightClusters.Stats.BinMs;
+            }
+
+            // draw cubes 
+            for (unsigned int i = 0; i < 10; i++) {
+                sceneShader.setMat4("model", cubeModels[i]);
+                if (perObject) {
+                    glm::uvec2 range = lightCuller.Range(i);
+                    glUniform2ui(objectLightRange, range.x, range.y);
+                }
+                glBindVertexArray(cubeVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+
+            // light the G-buffer, every light only where its range reaches: clustered in one full screen pass, or 
+            // as one quad per light 
+            if (deferred) {
+                deferredRenderer.BindTextures(5);
+                deferredShader.use();
+                deferredShader.setMat4("projection", projection);
+                deferredShader.setMat4("view", view);
+                deferredShader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+                deferredShader.setVec3("viewPos", camera.Position);
+                deferredShader.setBool("clustered", clustered);
+                deferredRenderer.ShadeLights(deferredShader, clustered ? 0 : lightManager.Count());
+            }
+
+            // draw the lamp objects, one instance per light 
+            lampShader.use();
+            lampShader.setMat4("projection", projection);
+            lampShader.setMat4("view", view);
+            glBindVertexArray(lampVAO);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, lightManager.Count());
+            if (deferred)
+                deferredRenderer.Present();
+
+            // binning and shadow statistics, once a second 
+            reportFrames++;
+            if (currentFrame - lastReport >= 1.0) {
+                if (perObject)
+                    cout << "object lights: " << cullMs / reportFrames << " ms culling, " << lightCuller.Stats.VisibleLights << " of "
+                         << lightManager.Count() << " lights visible, " << lightCuller.Stats.Indices << " indices, at most "
+                         << lightCuller.Stats.MaxPerObject << " lights per object" << endl;
+                else if (clustered)
+                    cout << "clusters: " << binMs / reportFrames << " ms binning " << lightManager.Count() << " lights, "
+                         << lightClusters.Stats.Indices << " indices, at most " << lightClusters.Stats.MaxPerCluster << " lights per cluster" << endl;
+                if (shadows) {
+                    cout << "shadows: " << updateMs / reportFrames << " ms fitting and culling, casters per cascade";
+                    for (unsigned int i = 0; i < cascadedShadows.Settings().Count; i++)
+                        cout << " " << cascadedShadows.Stats.Casters[i];
+                    cout << " in " << cascadedShadows.Stats.Passes << " passes" << endl;
+                }
+                if (!shadowedLights.empty()) {
+                    cout << "point shadows: " << (float)pointRedraws / reportFrames << " lights drawn per frame;";
+                    for (unsigned int i = 0; i < pointShadows.Stats.size(); i++)
+                        cout << " light " << pointShadows.Stats[i].Light << " " << pointShadows.Stats[i].GpuMs << " ms, "
+                             << pointShadows.Stats[i].Casters << " casters, " << pointShadows.Stats[i].Redraws << " redraws;";
+                    cout << endl;
+                }
+                reportFrames = 0;
+                binMs = 0.0;
+                updateMs = 0.0;
+                cullMs = 0.0;
+                pointRedraws = 0;
+                lastReport = currentFrame;
+            }
+
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // -------------------------------------------------------------------------------
+            headless.SwapBuffers(window);
+        }
+
+        // optional: de-allocate all resources once they've outlived their purpose:
+        // ------------------------------------------------------------------------
+        glDeleteVertexArrays(1, &cubeVAO);
+        glDeleteVertexArrays(1, &lampVAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &irradianceUBO);
     }
 
-    // optional: de-allocate all resources once they've outlived their purpose:
-    // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteVertexArrays(1, &lampVAO);
-    glDeleteBuffers(1, &VBO);
-
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -385,6 +663,27 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !clusterKeyPressed)
+    {
+        clustered = !clustered;
+        cout << (clustered ? "clustered shading" : "every light for every fragment") << endl;
+    }
+    clusterKeyPressed = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !objectKeyPressed)
+    {
+        objectLights = !objectLights;
+        cout << (objectLights ? "lights culled per object" : "lights culled per cluster or not at all") << endl;
+    }
+    objectKeyPressed = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && !deferredKeyPressed)
+    {
+        deferred = !deferred;
+        cout << (deferred ? "deferred shading" : "forward shading") << endl;
+    }
+    deferredKeyPressed = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
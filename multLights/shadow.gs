@@ -0,0 +1,33 @@
+#version 330 core
+// Copies each triangle into the layer of every cascade it is drawn into (see cascadedShadows.h)
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 12) out;
+
+uniform mat4 cascadeClip[4];
+// how much of its layer each cascade uses, from the lower left corner 
+uniform float cascadeExtent[4];
+// a bit per cascade 
+uniform int cascadeMask;
+
+void main()
+{
+    for (int cascade = 0; cascade < 4; cascade++)
+    {
+        if ((cascadeMask & (1 << cascade)) == 0)
+            continue;
+        for (int i = 0; i < 3; i++)
+        {
+            vec4 position = cascadeClip[cascade] * gl_in[i].gl_Position;
+            // clipped to the cascade's own square before it is squeezed into its corner 
+            gl_ClipDistance[0] = position.w + position.x;
+            gl_ClipDistance[1] = position.w - position.x;
+            gl_ClipDistance[2] = position.w + position.y;
+            gl_ClipDistance[3] = position.w - position.y;
+            position.xy = (position.xy + position.w) * cascadeExtent[cascade] - position.w;
+            gl_Position = position;
+            gl_Layer = cascade;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
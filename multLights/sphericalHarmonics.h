@@ -0,0 +1,259 @@
+#ifndef SPHERICAL_HARMONICS_H
+#define SPHERICAL_HARMONICS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../cubemap/cubemapLoader.h"
+#include "../parallel.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+using namespace std;
+
+// irradiance as 9 L2 spherical harmonics coefficients, laid out as the Irradiance uniform block in lighting.fs.
+// The clamped cosine convolution, the basis constants and 1/pi are folded in, so for a unit normal n
+//   irradiance(n) = c0 + c1 n.y + c2 n.z + c3 n.x + c4 n.x n.y + c5 n.y n.z + c6 (3 n.z^2 - 1) + c7 n.x n.z
+//                   + c8 (n.x^2 - n.y^2)
+// is the light a white diffuse surface reflects.
+struct SHIrradiance {
+    glm::vec4 Coefficients[9];      // rgb, std140 rounds array elements up to a vec4 anyway
+};
+
+// Projects a cubemap onto L2 spherical harmonics on the CPU, for image based ambient lighting: the shader
+// evaluates a handful of multiply adds per pixel instead of sampling an irradiance map. Every texel of the
+// faces is projected, in linear color and weighted by its solid angle. Rows are spread over all cores and
+// each row is done four texels at a time with SSE. Decoding the faces takes far longer than the projection,
+// so the coefficients are cached and recomputed when a face's size or modification time changes. Decoding,
+// stamping the faces and writing the cache are CubemapLoader's.
+class SphericalHarmonics
+{
+public:
+    // reads the coefficients from cachePath or projects the faces (+X, -X, +Y, -Y, +Z, -Z). cachePath may be empty.
+    static bool Load(const vector<string> &faces, const string &cachePath, SHIrradiance &sh)
+    {
+        if (!cachePath.empty() && ReadCache(cachePath, faces, sh))
+            return true;
+        if (!Project(faces, sh))
+            return false;
+        if (!cachePath.empty() && !WriteCache(cachePath, faces, sh))
+            cout << "ERROR::SH:: Could not write cache " << cachePath << endl;
+        return true;
+    }
+
+    static bool Project(const vector<string> &faces, SHIrradiance &sh, unsigned int threads = 0)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        CubemapImage image;
+        if (!CubemapLoader::Decode(faces, image, false))
+            return false;
+        double decodeMs = milliseconds(start);
+
+        chrono::steady_clock::time_point projectStart = chrono::steady_clock::now();
+        int size = image.Size;
+        if (threads == 0)
+            threads = defaultThreadCount();
+        // one set of sums per thread, added up once all rows are done
+        vector<double> sums((size_t)threads * 27, 0.0);
+        srgbToLinear(); // fills the table before the threads share it
+        parallelFor(6 * size, [&](size_t begin, size_t end, unsigned int thread) {
+            for (size_t row = begin; row < end; row++)
+                projectRow(&image.Pixels[image.Offset(row / size, 0)], row / size, size, row % size, &sums[thread * 27]);
+        }, threads);
+
+        double total[27] = {0.0};
+        for (unsigned int t = 0; t < threads; t++)
+            for (int i = 0; i < 27; i++)
+                total[i] += sums[t * 27 + i];
+        finish(total, sh);
+        cout << "Irradiance SH projected from 6 " << size << "x" << size << " faces in "
+             << milliseconds(projectStart) << " ms on " << threads << " threads (decoded in " << decodeMs << " ms)" << endl;
+        return true;
+    }
+
+    // a uniform buffer holding sh, bound to bindingPoint. Shaders attach their Irradiance block to the same point.
+    static unsigned int CreateUniformBuffer(const SHIrradiance &sh, unsigned int bindingPoint)
+    {
+        unsigned int ubo;
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(sh.Coefficients), sh.Coefficients, GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, ubo, 0, sizeof(sh.Coefficients));
+        return ubo;
+    }
+
+    static bool ReadCache(const string &path, const vector<string> &faces, SHIrradiance &sh)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+        CacheFile cache, expected;
+        bool valid = fread(&cache, sizeof(cache), 1, file) == 1 && CubemapLoader::StampSources(faces, expected.Sources) &&
+                     memcmp(&cache, &expected, offsetof(CacheFile, Coefficients)) == 0;
+        fclose(file);
+        if (valid)
+            memcpy(sh.Coefficients, cache.Coefficients, sizeof(sh.Coefficients));
+        else
+            cout << "SH cache " << path << " is out of date, projecting the faces again" << endl;
+        return valid;
+    }
+
+    static bool WriteCache(const string &path, const vector<string> &faces, const SHIrradiance &sh)
+    {
+        CacheFile cache;
+        if (!CubemapLoader::StampSources(faces, cache.Sources))
+            return false;
+        memcpy(cache.Coefficients, sh.Coefficients, sizeof(cache.Coefficients));
+        CacheFileWriter writer(path);
+        writer.Write(&cache, 1);
+        return writer.Commit();
+    }
+
+private:
+    struct CacheFile {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t Padding;
+        CubemapLoader::SourceStamp Sources[6];
+        float Coefficients[9][4];
+
+        CacheFile()
+        {
+            memset(this, 0, sizeof(*this));
+            memcpy(Magic, "SHIRRAD", 8);
+            Version = 2;            // 1 stored the face sizes and times as two separate arrays
+        }
+    };
+
+    // the direction through a face's texel (s, t) in [-1, 1] is Major + s SAxis + t TAxis, as laid out by the GL spec
+    static const float *faceAxes(unsigned int face)
+    {
+        static const float axes[6][9] = {
+            { 1, 0, 0,   0, 0, -1,   0, -1, 0},
+            {-1, 0, 0,   0, 0, 1,    0, -1, 0},
+            { 0, 1, 0,   1, 0, 0,    0, 0, 1},
+            { 0, -1, 0,  1, 0, 0,    0, 0, -1},
+            { 0, 0, 1,   1, 0, 0,    0, -1, 0},
+            { 0, 0, -1, -1, 0, 0,    0, -1, 0}
+        };
+        return axes[face];
+    }
+
+    static const float *srgbToLinear()
+    {
+        static float table[256];
+        static bool filled = false;
+        if (!filled)
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                float c = i / 255.0f;
+                table[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+            }
+            filled = true;
+        }
+        return table;
+    }
+
+    // adds a row's texels times their solid angle times the 9 basis functions to sums (9 rgb triples)
+    static void projectRow(const unsigned char *pixels, unsigned int face, int size, int y, double *sums)
+    {
+        const float *axes = faceAxes(face);
+        const float *decode = srgbToLinear();
+        const unsigned char *row = pixels + (size_t)y * size * 4;
+        float t = 2.0f * (y + 0.5f) / size - 1.0f;
+        // the parts of the direction that don't change along the row
+        float bx = axes[0] + axes[6] * t, by = axes[1] + axes[7] * t, bz = axes[2] + axes[8] * t;
+        float texelArea = 4.0f / ((float)size * size);
+        float rowSums[27] = {0.0f};
+        int x = 0;
+#ifdef __SSE__
+        __m128 acc[27];
+        for (int i = 0; i < 27; i++)
+            acc[i] = _mm_setzero_ps();
+        __m128 ax = _mm_set1_ps(axes[3]), ay = _mm_set1_ps(axes[4]), az = _mm_set1_ps(axes[5]);
+        __m128 one = _mm_set1_ps(1.0f), tt = _mm_set1_ps(t * t), area = _mm_set1_ps(texelArea);
+        for (; x + 4 <= size; x += 4)
+        {
+            __m128 s = _mm_set_ps(2.0f * (x + 3.5f) / size - 1.0f, 2.0f * (x + 2.5f) / size - 1.0f,
+                                  2.0f * (x + 1.5f) / size - 1.0f, 2.0f * (x + 0.5f) / size - 1.0f);
+            // 1 / |(s, t, 1)| normalizes the direction, its cube is the texel's solid angle over its area
+            __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(one, tt), _mm_mul_ps(s, s))));
+            __m128 dx = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(bx), _mm_mul_ps(ax, s)), inverseLength);
+            __m128 dy = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(by), _mm_mul_ps(ay, s)), inverseLength);
+            __m128 dz = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(bz), _mm_mul_ps(az, s)), inverseLength);
+            __m128 weight = _mm_mul_ps(area, _mm_mul_ps(inverseLength, _mm_mul_ps(inverseLength, inverseLength)));
+
+            const unsigned char *p = row + x * 4;
+            __m128 color[3];
+            for (int c = 0; c < 3; c++)
+                color[c] = _mm_mul_ps(weight, _mm_set_ps(decode[p[12 + c]], decode[p[8 + c]], decode[p[4 + c]], decode[p[c]]));
+
+            __m128 basis[9] = {
+                one, dy, dz, dx, _mm_mul_ps(dx, dy), _mm_mul_ps(dy, dz),
+                _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(dz, dz)), one), _mm_mul_ps(dx, dz),
+                _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))
+            };
+            for (int i = 0; i < 9; i++)
+                for (int c = 0; c < 3; c++)
+                    acc[i * 3 + c] = _mm_add_ps(acc[i * 3 + c], _mm_mul_ps(basis[i], color[c]));
+        }
+        for (int i = 0; i < 27; i++)
+        {
+            float lanes[4];
+            _mm_storeu_ps(lanes, acc[i]);
+            rowSums[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+#endif
+        // what's left of the row, or all of it without SSE
+        for (; x < size; x++)
+        {
+            float s = 2.0f * (x + 0.5f) / size - 1.0f;
+            float inverseLength = 1.0f / sqrtf(1.0f + s * s + t * t);
+            float dx = (bx + axes[3] * s) * inverseLength;
+            float dy = (by + axes[4] * s) * inverseLength;
+            float dz = (bz + axes[5] * s) * inverseLength;
+            float weight = texelArea * inverseLength * inverseLength * inverseLength;
+            float basis[9] = {1.0f, dy, dz, dx, dx * dy, dy * dz, 3.0f * dz * dz - 1.0f, dx * dz, dx * dx - dy * dy};
+            const unsigned char *p = row + x * 4;
+            for (int i = 0; i < 9; i++)
+                for (int c = 0; c < 3; c++)
+                    rowSums[i * 3 + c] += basis[i] * weight * decode[p[c]];
+        }
+        for (int i = 0; i < 27; i++)
+            sums[i] += rowSums[i];
+    }
+
+    // turns the radiance sums into irradiance coefficients in the form the shader evaluates
+    static void finish(const double *sums, SHIrradiance &sh)
+    {
+        // basis constants, the cosine lobe's band factors A0 = pi, A1 = 2pi/3, A2 = pi/4 and the 1/pi of a
+        // lambertian surface. each basis constant appears twice: once projecting, once evaluating.
+        const double basis[9] = {0.282095, 0.488603, 0.488603, 0.488603, 1.092548, 1.092548, 0.315392, 1.092548, 0.546274};
+        const double band[9] = {1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25};
+        for (int i = 0; i < 9; i++)
+        {
+            double scale = basis[i] * basis[i] * band[i];
+            sh.Coefficients[i] = glm::vec4((float)(sums[i * 3] * scale), (float)(sums[i * 3 + 1] * scale),
+                                           (float)(sums[i * 3 + 2] * scale), 0.0f);
+        }
+    }
+
+    static double milliseconds(chrono::steady_clock::time_point since)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+    }
+};
+#endif
@@ -0,0 +1,166 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Shared by every demo that works on the CPU in parallel, like headless.h.
+
+// number of worker threads used when the caller doesn't ask for a specific amount
+inline unsigned int defaultThreadCount()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// Worker threads that are started once and kept until the program exits, so parallelFor costs a wake-up instead of
+// creating and joining threads on every call. A job is a number of chunks; the workers and the thread that posted
+// the job take chunks from it until none are left. The poster always helps, so a parallelFor inside a parallelFor
+// (or inside any other thread) finishes even when every worker is busy.
+class ThreadPool
+{
+public:
+    static ThreadPool &Instance()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueChanged.notify_all();
+        for (unsigned int i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    // calls func(chunk) for every chunk in [0, chunks), on up to threads threads including the calling one
+    void Run(size_t chunks, const std::function<void(size_t)> &func, unsigned int threads)
+    {
+        std::shared_ptr<Job> job = std::make_shared<Job>(chunks, func);
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            // more threads than ever asked for before: the pool grows, it never shrinks
+            while (workers.size() + 1 < threads)
+                workers.push_back(std::thread(&ThreadPool::work, this));
+            jobs.push_back(job);
+        }
+        if (threads > 2)
+            queueChanged.notify_all();
+        else
+            queueChanged.notify_one();
+
+        runChunks(*job);
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            std::deque<std::shared_ptr<Job> >::iterator found = std::find(jobs.begin(), jobs.end(), job);
+            if (found != jobs.end())
+                jobs.erase(found);
+        }
+        std::unique_lock<std::mutex> lock(job->DoneMutex);
+        while (job->Done.load() < chunks)
+            job->Finished.wait(lock);
+    }
+
+private:
+    struct Job {
+        size_t Chunks;
+        const std::function<void(size_t)> &Func;    // lives on the poster's stack until every chunk is done
+        std::atomic<size_t> Next;
+        std::atomic<size_t> Done;
+        std::mutex DoneMutex;
+        std::condition_variable Finished;
+
+        Job(size_t chunks, const std::function<void(size_t)> &func) : Chunks(chunks), Func(func), Next(0), Done(0)
+        {
+        }
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<std::shared_ptr<Job> > jobs;
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    bool stopping;
+
+    ThreadPool() : stopping(false)
+    {
+    }
+
+    // takes chunks until the job has none left; false if there were none to take
+    static bool runChunks(Job &job)
+    {
+        bool ran = false;
+        for (size_t chunk = job.Next++; chunk < job.Chunks; chunk = job.Next++)
+        {
+            job.Func(chunk);
+            ran = true;
+            if (++job.Done == job.Chunks)
+            {
+                std::unique_lock<std::mutex> lock(job.DoneMutex);
+                job.Finished.notify_all();
+            }
+        }
+        return ran;
+    }
+
+    void work()
+    {
+        for (;;)
+        {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                while (jobs.empty() && !stopping)
+                    queueChanged.wait(lock);
+                if (stopping)
+                    return;
+                job = jobs.front();
+            }
+            // a job whose chunks are all taken is dropped from the queue by whoever notices first
+            if (!runChunks(*job))
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                if (!jobs.empty() && jobs.front() == job)
+                    jobs.pop_front();
+            }
+        }
+    }
+};
+
+// splits the range [0, count) into one contiguous chunk per thread and calls func(begin, end, threadIndex) for each chunk.
+// every chunk runs exactly once, so threadIndex can pick per-thread scratch space. The chunks run on the ThreadPool
+// and the calling thread, which works on chunks itself; running with a single thread never involves the pool.
+template<typename Func>
+void parallelFor(size_t count, Func func, unsigned int threads = 0)
+{
+    if (threads == 0)
+        threads = defaultThreadCount();
+    threads = (unsigned int)std::max<size_t>(1, std::min<size_t>(threads, count));
+    if (count == 0)
+        return;
+
+    size_t chunk = (count + threads - 1) / threads;
+    // rounding the chunk size up can leave the last threads without work
+    unsigned int chunks = (unsigned int)((count + chunk - 1) / chunk);
+    if (chunks == 1)
+    {
+        func((size_t)0, count, 0u);
+        return;
+    }
+    std::function<void(size_t)> run = [&](size_t t) {
+        func(t * chunk, std::min(count, (t + 1) * chunk), (unsigned int)t);
+    };
+    ThreadPool::Instance().Run(chunks, run, chunks);
+}
+#endif
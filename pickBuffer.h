@@ -0,0 +1,179 @@
+#ifndef PICK_BUFFER_H
+#define PICK_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+using namespace std;
+
+// Shared by asteroidField and modelLoading, like meshBvh.h. Each demo keeps its own pick.vs and pick.fs.
+
+// what a pixel of a PickBuffer holds
+struct PickResult {
+    unsigned int Object;        // the ID the object was drawn with, 0 where nothing was drawn
+    unsigned int Instance;      // the instance index, or the mesh index for a Model drawn mesh by mesh
+
+    PickResult() : Object(0), Instance(0)
+    {
+    }
+
+    bool operator==(const PickResult &other) const
+    {
+        return Object == other.Object && Instance == other.Instance;
+    }
+
+    bool operator!=(const PickResult &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// Finds the object under the cursor without stalling the pipeline.
+// A picking pass draws the objects again into an RG32UI attachment, writing their object ID and instance index in
+// place of a color (see pick.fs), with a depth buffer of its own so the nearest one wins. Begin() limits the pass to
+// the pixel under the cursor with the scissor test, so all it costs is the geometry drawn; culling that to
+// PickProjection leaves only what can cover the pixel. End() reads the pixel into the next pixel buffer object of a
+// ring and puts a fence after it, and Read() hands back the oldest read whose fence has passed without waiting,
+// normally the one of the frame before. When every buffer is still in flight the pick is skipped, not waited for.
+class PickBuffer
+{
+public:
+    static const unsigned int RING = 3;
+
+    unsigned int FBO;
+    unsigned int IdTexture;
+    unsigned int Width, Height;
+
+    PickBuffer(unsigned int width, unsigned int height) : Width(0), Height(0), next(0), pending(0), pickX(0), pickY(0)
+    {
+        glGenFramebuffers(1, &FBO);
+        glGenTextures(1, &IdTexture);
+        glGenRenderbuffers(1, &depthRBO);
+        glGenBuffers(RING, pbos);
+        for (unsigned int i = 0; i < RING; i++)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, 2 * sizeof(GLuint), NULL, GL_STREAM_READ);
+            fences[i] = 0;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        Resize(width, height);
+    }
+
+    ~PickBuffer()
+    {
+        for (unsigned int i = 0; i < RING; i++)
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        glDeleteBuffers(RING, pbos);
+        glDeleteRenderbuffers(1, &depthRBO);
+        glDeleteTextures(1, &IdTexture);
+        glDeleteFramebuffers(1, &FBO);
+    }
+
+    void Resize(unsigned int width, unsigned int height)
+    {
+        if (width == Width && height == Height)
+            return;
+        Width = width;
+        Height = height;
+        glBindTexture(GL_TEXTURE_2D, IdTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, width, height, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, IdTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::PICK:: Framebuffer is not complete!" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // starts the picking pass for the pixel at x, y (window pixels, origin at the bottom left like glReadPixels):
+    // binds the ID framebuffer and clears that pixel to 0
+    void Begin(int x, int y)
+    {
+        pickX = glm::clamp(x, 0, (int)Width - 1);
+        pickY = glm::clamp(y, 0, (int)Height - 1);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, Width, Height);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(pickX, pickY, 1, 1);
+        const GLuint nothing[4] = { 0, 0, 0, 0 };
+        glClearBufferuiv(GL_COLOR, 0, nothing);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // queues the read of the pixel and goes back to the default framebuffer
+    void End()
+    {
+        if (pending < RING)
+        {
+            unsigned int slot = (next + pending) % RING;
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glReadPixels(pickX, pickY, 1, 1, GL_RG_INTEGER, GL_UNSIGNED_INT, (void*)0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            pending++;
+        }
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // the newest finished pick, if a read finished since the last call
+    bool Read(PickResult &result)
+    {
+        bool found = false;
+        // reads finish in the order they were issued, so the oldest ones are checked first
+        while (pending > 0)
+        {
+            GLenum status = glClientWaitSync(fences[next], 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(fences[next]);
+            fences[next] = 0;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[next]);
+            const GLuint *ids = (const GLuint *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 2 * sizeof(GLuint), GL_MAP_READ_BIT);
+            if (ids)
+            {
+                result.Object = ids[0];
+                result.Instance = ids[1];
+                found = true;
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            next = (next + 1) % RING;
+            pending--;
+        }
+        return found;
+    }
+
+    // the projection narrowed to the pixel at x, y: whatever covers the pixel fills its clip space, so culling against
+    // PickProjection * view keeps just the geometry the picking pass needs
+    static glm::mat4 PickProjection(const glm::mat4 &projection, int x, int y, unsigned int width, unsigned int height)
+    {
+        glm::vec2 center(2.0f * (x + 0.5f) / width - 1.0f, 2.0f * (y + 0.5f) / height - 1.0f);
+        glm::mat4 narrow = glm::scale(glm::mat4(), glm::vec3((float)width, (float)height, 1.0f));
+        narrow = glm::translate(narrow, glm::vec3(-center, 0.0f));
+        return narrow * projection;
+    }
+
+private:
+    unsigned int depthRBO;
+    unsigned int pbos[RING];
+    GLsync fences[RING];
+    unsigned int next;          // the oldest read in flight
+    unsigned int pending;       // reads in flight
+    int pickX, pickY;
+};
+#endif
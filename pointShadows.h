@@ -0,0 +1,277 @@
+#ifndef POINT_SHADOWS_H
+#define POINT_SHADOWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shadowCaster.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Shared by lightCasters' pointLights and multLights, like pickBuffer.h. Uses the demo's Shader, so shader_m.h has
+// to be included first; each demo keeps its own pointShadow.gs, shadow.vs and shadow.fs.
+
+struct PointShadowSettings {
+    unsigned int Slots;             // lights that can cast shadows at once
+    int Resolution;                 // of each cube face
+    float Near;                     // near plane of the cube faces
+    float MaxRange;                 // a light's shadow reaches its range, but no further than this
+
+    PointShadowSettings() : Slots(4), Resolution(512), Near(0.05f), MaxRange(50.0f)
+    {
+    }
+};
+
+// what one light's shadow costs
+struct PointShadowCost {
+    int Light;                      // the id the slot was added with
+    unsigned int Casters;           // drawn by the last redraw
+    unsigned int Redraws;           // since the slot was added
+    double GpuMs;                   // GPU time of the last redraw that was timed, not counting the clear
+
+    PointShadowCost(int light = -1) : Light(light), Casters(0), Redraws(0), GpuMs(0.0)
+    {
+    }
+};
+
+// Shadows of point (and spot) lights, a cube shadow map per light. GL 3.3 has no cube map arrays, so the cubes
+// live in an atlas of six layers per light in one depth texture array; layer slot * 6 + face holds a face in
+// cube map order (+x, -x, +y, -y, +z, -z) looking out with cube map's up vectors, the lighting shaders pick
+// the face and project into it themselves (CalcPointShadow). A light's shadow reaches as far as its range,
+// no further than MaxRange, which is also the far plane of its faces.
+//  - a light is drawn in one pass: every caster that reaches into its range is drawn once, and a geometry
+//    shader copies each triangle into the faces it can be seen in (pointShadow.gs);
+//  - shadow maps are kept from frame to frame. A light is only drawn again when it moved or its range changed,
+//    or when a moving caster is (or was, last time) inside its range, so a scene of still casters costs nothing
+//    after the first frame;
+//  - each redraw is timed with a GL_TIME_ELAPSED query that is read back frames later, once it is available.
+class PointShadows
+{
+public:
+    static const int FACES = 6;
+
+    vector<PointShadowCost> Stats;  // a slot each
+    unsigned int Redrawn;           // lights drawn by the last Render
+
+    PointShadows(const PointShadowSettings &settings)
+        : Redrawn(0), settings(settings), shader("shadow.vs", "shadow.fs", "pointShadow.gs")
+    {
+        this->settings.Slots = max(1u, settings.Slots);
+        GLint maxLayers = 0;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        if (this->settings.Slots * FACES > (unsigned int)maxLayers)
+        {
+            cout << "ERROR::POINT_SHADOWS:: At most " << maxLayers / FACES << " lights fit into the shadow atlas" << endl;
+            this->settings.Slots = maxLayers / FACES;
+        }
+
+        glGenTextures(1, &atlas);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, atlas);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, settings.Resolution, settings.Resolution,
+                     this->settings.Slots * FACES, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        // hardware depth comparison, with linear filtering it already averages four texels
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(1, &layeredBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, layeredBuffer);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, atlas, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::POINT_SHADOWS:: The layered shadow framebuffer is not complete" << endl;
+        // a layered attachment is cleared all at once, a light's faces are cleared a layer at a time
+        glGenFramebuffers(1, &layerBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, layerBuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, atlas, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~PointShadows()
+    {
+        glDeleteTextures(1, &atlas);
+        glDeleteFramebuffers(1, &layeredBuffer);
+        glDeleteFramebuffers(1, &layerBuffer);
+        for (size_t i = 0; i < slots.size(); i++)
+            glDeleteQueries(1, &slots[i].Query);
+    }
+
+    const PointShadowSettings &Settings() const
+    {
+        return settings;
+    }
+
+    // gives a light a cube of the atlas, light is only an id for the Stats. returns the slot, which the
+    // shaders need to find the light's layers, or -1 when the atlas is full.
+    int Add(int light)
+    {
+        if (slots.size() >= settings.Slots)
+            return -1;
+        Slot slot;
+        glGenQueries(1, &slot.Query);
+        slots.push_back(slot);
+        Stats.push_back(PointShadowCost(light));
+        return (int)slots.size() - 1;
+    }
+
+    // where the slot's light is and how far it reaches, a negative range reaches MaxRange
+    void SetLight(unsigned int slot, glm::vec3 position, float range)
+    {
+        slots[slot].Position = position;
+        slots[slot].Far = Far(range);
+    }
+
+    // the far plane of a light's faces, the shaders work it out the same way
+    float Far(float range) const
+    {
+        return range > 0.0f ? max(min(range, settings.MaxRange), settings.Near * 2.0f) : settings.MaxRange;
+    }
+
+    // picks the lights that need drawing again and culls the casters for them
+    void Update(const vector<ShadowCaster> &casters)
+    {
+        for (size_t s = 0; s < slots.size(); s++)
+        {
+            Slot &slot = slots[s];
+            readQuery(s);
+            bool movingInside = false;
+            slot.Casters.clear();
+            for (size_t c = 0; c < casters.size(); c++)
+            {
+                float reach = slot.Far + casters[c].Radius;
+                glm::vec3 offset = casters[c].Center - slot.Position;
+                if (glm::dot(offset, offset) > reach * reach)
+                    continue;
+                slot.Casters.push_back((unsigned int)c);
+                movingInside = movingInside || casters[c].Moving;
+            }
+            // a moving caster that just left still has its shadow in the map
+            slot.Due = !slot.Drawn || slot.Position != slot.DrawnPosition || slot.Far != slot.DrawnFar ||
+                       movingInside || slot.HadMoving;
+            slot.HadMoving = movingInside;
+        }
+    }
+
+    // draws the lights that are due. drawCaster(shader, index) draws caster index (the index into Update's
+    // casters) with shader, which is in use and only needs the caster's "model" matrix.
+    template <typename DrawCaster>
+    void Render(DrawCaster drawCaster)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glEnable(GL_DEPTH_TEST);
+        // a slope scaled bias against acne on surfaces at a grazing angle to the light
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.5f, 2.0f);
+        glViewport(0, 0, settings.Resolution, settings.Resolution);
+        shader.use();
+        shader.setMat4("lightSpace", glm::mat4());
+
+        // the faces in cube map order, and their up vectors
+        static const glm::vec3 forward[FACES] = {
+            glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+        };
+        static const glm::vec3 up[FACES] = {
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+            glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+        };
+
+        Redrawn = 0;
+        for (size_t s = 0; s < slots.size(); s++)
+        {
+            Slot &slot = slots[s];
+            if (!slot.Due)
+                continue;
+            glBindFramebuffer(GL_FRAMEBUFFER, layerBuffer);
+            for (int face = 0; face < FACES; face++)
+            {
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, atlas, 0, (GLint)s * FACES + face);
+                glClear(GL_DEPTH_BUFFER_BIT);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, layeredBuffer);
+            // only one query can be waited on per slot, redraws while it is pending go untimed. the clears
+            // stay out of it: some drivers (llvmpipe) report nonsense for a query begun before them.
+            bool timed = !slot.Pending;
+            if (timed)
+                glBeginQuery(GL_TIME_ELAPSED, slot.Query);
+            glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, settings.Near, slot.Far);
+            for (int face = 0; face < FACES; face++)
+                shader.setMat4("faceMatrices[" + to_string(face) + "]",
+                               projection * glm::lookAt(slot.Position, slot.Position + forward[face], up[face]));
+            shader.setInt("layerBase", (int)s * FACES);
+            for (size_t c = 0; c < slot.Casters.size(); c++)
+                drawCaster(shader, slot.Casters[c]);
+
+            if (timed)
+            {
+                glEndQuery(GL_TIME_ELAPSED);
+                slot.Pending = true;
+            }
+            slot.Drawn = true;
+            slot.DrawnPosition = slot.Position;
+            slot.DrawnFar = slot.Far;
+            Stats[s].Casters = (unsigned int)slot.Casters.size();
+            Stats[s].Redraws++;
+            Redrawn++;
+        }
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // binds the atlas to a texture unit for the shaders' sampler2DArrayShadow
+    void Bind(unsigned int textureUnit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + textureUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, atlas);
+    }
+
+private:
+    struct Slot {
+        glm::vec3 Position, DrawnPosition;
+        float Far, DrawnFar;
+        bool Drawn, Due, HadMoving, Pending;
+        unsigned int Query;
+        vector<unsigned int> Casters;       // reaching into the light's range
+
+        Slot() : Far(0.0f), DrawnFar(0.0f), Drawn(false), Due(false), HadMoving(false), Pending(false), Query(0)
+        {
+        }
+    };
+
+    PointShadowSettings settings;
+    Shader shader;
+    unsigned int atlas, layeredBuffer, layerBuffer;
+    vector<Slot> slots;
+
+    // takes a slot's redraw time if the GPU got to it, without waiting
+    void readQuery(size_t s)
+    {
+        if (!slots[s].Pending)
+            return;
+        GLint available = 0;
+        glGetQueryObjectiv(slots[s].Query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(slots[s].Query, GL_QUERY_RESULT, &elapsed);
+        Stats[s].GpuMs = elapsed / 1.0e6;
+        slots[s].Pending = false;
+    }
+};
+#endif
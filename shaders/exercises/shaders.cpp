@@ -3,6 +3,7 @@
 #include <iostream>
 #include <math.h>
 #include "shader_s.h"
+#include "../../headless.h"
 using namespace std; 
 
 // Function definition for window resize callback function 
@@ -12,35 +13,46 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow * window);
 
 // Main 
-int main()
+int main(int argc, char **argv)
 {
-	// Initialize GLFW 
-	glfwInit();
-	// Configure GLFW 
-	// First argument defines option to configure 
-	// Second argument sets the value of option 
-	// Define version of OpenGL in use 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
-	// Define Core_Profile mode 
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	
-	// Create window object 
-	GLFWwindow* window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
-	if (window == NULL){ 
-		cout << "Failed to create GLFW window" << endl;
-		return -1;
+	// --headless renders offscreen instead, see headless.h
+	Headless headless(argc, argv);
+	GLFWwindow* window = NULL;
+	if (headless.Enabled)
+	{
+		if (!headless.CreateContext(800, 600))
+			return -1;
 	}
-	// Make the context of window the main context for current thread
-	glfwMakeContextCurrent(window);
-	// callback function for resizing window 
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); 
-
-	// Initialize glad 
-	if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) 
+	else
 	{
-		cout << "Failed to initialize GLAD" << endl;
-		return -1; 
+		// Initialize GLFW 
+		glfwInit();
+		// Configure GLFW 
+		// First argument defines option to configure 
+		// Second argument sets the value of option 
+		// Define version of OpenGL in use 
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
+		// Define Core_Profile mode 
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		
+		// Create window object 
+		window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
+		if (window == NULL){ 
+			cout << "Failed to create GLFW window" << endl;
+			return -1;
+		}
+		// Make the context of window the main context for current thread
+		glfwMakeContextCurrent(window);
+		// callback function for resizing window 
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); 
+
+		// Initialize glad 
+		if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) 
+		{
+			cout << "Failed to initialize GLAD" << endl;
+			return -1; 
+		}
 	}
 
 	Shader ourShader("shader.vs", "shader.fs");
@@ -82,10 +94,11 @@ int main()
  
 	// Set-up render loop
 	// Check if GLFW has been instructed to close
-	while(!glfwWindowShouldClose(window))
+	while (headless.Running(window))
 	{
 		//Catch inputs 
-		processInput(window); 
+		if (!headless.Enabled)
+			processInput(window);
 		
 		// Rendering commands here: 
 		// Clear screen with color of choice 
@@ -107,9 +120,7 @@ int main()
 
 		// Swap color buffer that has been used to draw in
 		// during this iteration and show as output onto screen
-		glfwSwapBuffers(window);
-		// Check if any events are triggered 
-		glfwPollEvents();
+		headless.SwapBuffers(window);
 	
 	}	
 	// Terminate after exiting render loop
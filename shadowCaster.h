@@ -0,0 +1,20 @@
+#ifndef SHADOW_CASTER_H
+#define SHADOW_CASTER_H
+
+#include <glm/glm.hpp>
+
+// Shared by pointShadows.h and multLights' cascaded shadows.
+
+// a shadow caster's bounding sphere in world space, what the shadow maps cull with. Moving casters change from
+// frame to frame, so shadow maps they reach can't be kept from one frame to the next.
+struct ShadowCaster {
+    glm::vec3 Center;
+    float Radius;
+    bool Moving;
+
+    ShadowCaster(glm::vec3 center = glm::vec3(0.0f), float radius = 0.0f, bool moving = false)
+        : Center(center), Radius(radius), Moving(moving)
+    {
+    }
+};
+#endif
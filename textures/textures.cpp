@@ -4,6 +4,7 @@
 #include "shader_s.h"
 #include "stb_image.h"
 #include <iostream>
+#include "../headless.h"
 using namespace std;
 
 const int SCREEN_WIDTH = 800;
@@ -14,31 +15,42 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
 
 // Main
-int main()
+int main(int argc, char **argv)
 {
-  // Initialize GLFW
-  glfwInit();
-  // Define version
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  // Define Core_Profile mode
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-  // Create window object
-  GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "LearnOpenGL", NULL, NULL);
-  // Catch error
-  if (window == NULL) {
-    cout << "Failed to create GLFW window" << endl;
-    return -1;
+  // --headless renders offscreen instead, see headless.h
+  Headless headless(argc, argv);
+  GLFWwindow* window = NULL;
+  if (headless.Enabled)
+  {
+    if (!headless.CreateContext(SCREEN_WIDTH, SCREEN_HEIGHT))
+      return -1;
   }
-  // Set window context and initialize callback function for window resizing
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-  // Initialize GLAD
-  if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    cout << "Faield to initialize GLAD" << endl;
-    return -1;
+  else
+  {
+    // Initialize GLFW
+    glfwInit();
+    // Define version
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // Define Core_Profile mode
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // Create window object
+    window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "LearnOpenGL", NULL, NULL);
+    // Catch error
+    if (window == NULL) {
+      cout << "Failed to create GLFW window" << endl;
+      return -1;
+    }
+    // Set window context and initialize callback function for window resizing
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+    // Initialize GLAD
+    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      cout << "Faield to initialize GLAD" << endl;
+      return -1;
+    }
   }
 
   // Instantiate shader object
@@ -146,9 +158,10 @@ int main()
   ourShader.setInt("texture2", 1);
 
   // Render loop
-  while(!glfwWindowShouldClose(window)) {
+  while (headless.Running(window)) {
     // Catch inputs
-    processInput(window);
+    if (!headless.Enabled)
+      processInput(window);
 
     // Clear screen
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
@@ -174,9 +187,7 @@ int main()
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
     // Swap color buffers
-    glfwSwapBuffers(window);
-    // Check if any events are triggered
-    glfwPollEvents();
+    headless.SwapBuffers(window);
   }
   // De-allocate resources
   glDeleteVertexArrays(1, &VAO);
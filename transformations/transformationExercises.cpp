@@ -8,6 +8,7 @@
 #include "shader_s.h"
 #include "stb_image.h"
 #include <iostream>
+#include "../headless.h"
 using namespace std;
 
 const int SCREEN_WIDTH = 800;
@@ -18,31 +19,42 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
 
 // Main
-int main()
+int main(int argc, char **argv)
 {
-  // Initialize GLFW
-  glfwInit();
-  // Define version
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  // Define Core_Profile mode
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-  // Create window object
-  GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "LearnOpenGL", NULL, NULL);
-  // Catch error
-  if (window == NULL) {
-    cout << "Failed to create GLFW window" << endl;
-    return -1;
+  // --headless renders offscreen instead, see headless.h
+  Headless headless(argc, argv);
+  GLFWwindow* window = NULL;
+  if (headless.Enabled)
+  {
+    if (!headless.CreateContext(SCREEN_WIDTH, SCREEN_HEIGHT))
+      return -1;
   }
-  // Set window context and initialize callback function for window resizing
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-  // Initialize GLAD
-  if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    cout << "Faield to initialize GLAD" << endl;
-    return -1;
+  else
+  {
+    // Initialize GLFW
+    glfwInit();
+    // Define version
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // Define Core_Profile mode
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // Create window object
+    window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "LearnOpenGL", NULL, NULL);
+    // Catch error
+    if (window == NULL) {
+      cout << "Failed to create GLFW window" << endl;
+      return -1;
+    }
+    // Set window context and initialize callback function for window resizing
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+    // Initialize GLAD
+    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      cout << "Faield to initialize GLAD" << endl;
+      return -1;
+    }
   }
 
   // Instantiate shader object
@@ -150,9 +162,10 @@ int main()
   ourShader.setInt("texture2", 1);
   
   // Render loop
-  while(!glfwWindowShouldClose(window)) {
+  while (headless.Running(window)) {
     // Catch inputs
-    processInput(window);
+    if (!headless.Enabled)
+      processInput(window);
 
     // Clear screen
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
@@ -173,14 +186,14 @@ int main()
     
     // Apply Transformations  
     // Scale 
-    float scaleAmount = 0.4*sin(4.0 * glfwGetTime()) + 0.6; 
+    float scaleAmount = 0.4*sin(4.0 * headless.Time()) + 0.6; 
     // Transformation I 
     glm::mat4 trans = glm::mat4(1.0f); 
     unsigned int transformLoc = glGetUniformLocation(ourShader.ID, "transform"); 
     trans = glm::scale(trans, glm::vec3(scaleAmount, scaleAmount, scaleAmount));
-    trans = glm::rotate(trans, (float)glfwGetTime(), glm::vec3(0.0, 0.0, 1.0));
+    trans = glm::rotate(trans, (float)headless.Time(), glm::vec3(0.0, 0.0, 1.0));
     trans = glm::translate(trans, glm::vec3(0.5f, 0.5f, 0.0f));
-    trans = glm::rotate(trans, (float)glfwGetTime(), glm::vec3(0.0, 0.0, 1.0));
+    trans = glm::rotate(trans, (float)headless.Time(), glm::vec3(0.0, 0.0, 1.0));
     glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
     
     // Bind VAO
@@ -192,17 +205,15 @@ int main()
     // Transformation II 
     trans = glm::mat4(1.0f); 
     trans = glm::scale(trans, glm::vec3(scaleAmount, scaleAmount, scaleAmount));
-    trans = glm::rotate(trans, (float)glfwGetTime(), glm::vec3(0.0, 0.0, 1.0));
+    trans = glm::rotate(trans, (float)headless.Time(), glm::vec3(0.0, 0.0, 1.0));
     trans = glm::translate(trans, glm::vec3(-0.5f, -0.5f, 0.0f));
-    trans = glm::rotate(trans, (float)glfwGetTime(), glm::vec3(0.0, 0.0, 1.0));
+    trans = glm::rotate(trans, (float)headless.Time(), glm::vec3(0.0, 0.0, 1.0));
     glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
     // Draw triangle II
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0); 
 
     // Swap color buffers
-    glfwSwapBuffers(window);
-    // Check if any events are triggered
-    glfwPollEvents();
+    headless.SwapBuffers(window);
   }
   // De-allocate resources
   glDeleteVertexArrays(1, &VAO);